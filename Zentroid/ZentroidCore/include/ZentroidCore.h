@@ -1,6 +1,9 @@
 #pragma once
+#include <functional>
+#include <QImage>
 #include <QPointer>
 #include <QMouseEvent>
+#include <QStringList>
 
 #include "ZentroidCoreDef.h"
 
@@ -26,7 +29,20 @@ public:
         Q_UNUSED(linesizeU);
         Q_UNUSED(linesizeV);
     }
+    // onFrame with the tiles that changed since the previous frame; the default
+    // forwards to onFrame, override it to skip work on unchanged parts
+    virtual void onFrameDiff(int width, int height, uint8_t* dataY, uint8_t* dataU, uint8_t* dataV, int linesizeY, int linesizeU, int linesizeV,
+                             const FrameDirtyMap &dirty) {
+        Q_UNUSED(dirty);
+        onFrame(width, height, dataY, dataU, dataV, linesizeY, linesizeU, linesizeV);
+    }
+    // small rgb copy of the screen, see IDevice::setThumbnail; only a frame that
+    // changed gives a new one. Main thread
+    virtual void onThumbnail(const QImage &image) { Q_UNUSED(image); }
+    // a region probe matched, stopped matching or changed, see IDevice::setRegionProbes. Main thread
+    virtual void onRegionProbe(const RegionProbeEvent &event) { Q_UNUSED(event); }
     virtual void updateFPS(quint32 fps) { Q_UNUSED(fps); }
+    virtual void updateHealth(DeviceHealth health) { Q_UNUSED(health); }
     virtual void grabCursor(bool grab) {Q_UNUSED(grab);}
 
     virtual void mouseEvent(const QMouseEvent *from, const QSize &frameSize, const QSize &showSize) {
@@ -117,14 +133,43 @@ public:
     virtual void pushFileRequest(const QString &file, const QString &devicePath = "") = 0;
     virtual void installApkRequest(const QString &apkFile) = 0;
 
+    // saved to DeviceParams::recordPath in the background, see screenshotFormat
     virtual void screenshot() = 0;
     virtual void showTouch(bool show) = 0;
+    // save every nth decoded frame, count frames in total (0: until stopped);
+    // frames are dropped when the encoders fall behind
+    virtual bool startScreenshotBurst(int everyNth, int count = 0) = 0;
+    virtual void stopScreenshotBurst() = 0;
+    // scale decoded frames down to width pixels (height keeps the aspect ratio) for
+    // DeviceObserver::onThumbnail, at most maxFps per second; 0 width turns it off.
+    // Costs a fraction of rendering, an undelivered thumbnail is replaced by the next
+    virtual void setThumbnail(int width, int maxFps = 5) = 0;
+    // regions checked on the decoding thread against the yuv frame, no rgb conversion
+    // or copy; replaces the previous set, an empty list stops probing. Results reach
+    // DeviceObserver::onRegionProbe only when something changed
+    virtual void setRegionProbes(const QList<RegionProbe> &probes) = 0;
+    // look for an element on the latest decoded frame on a worker thread; onResult is
+    // called on the main thread, not at all if the device is gone first. Requests of
+    // one device run one after the other. False when there is no frame to search
+    virtual bool locateTemplate(const TemplateSearch &search, std::function<void(const TemplateMatch &match)> onResult) = 0;
 
     virtual bool isReversePort(quint16 port) = 0;
     virtual const QString &getSerial() = 0;
 
     virtual void updateScript(QString script) = 0;
     virtual bool isCurrentCustomKeymap() = 0;
+
+    // capture the input stream entering mouseEvent/wheelEvent/keyEvent, see IDeviceManage::replayInput
+    virtual bool startInputRecord(const QString &file) = 0;
+    virtual void stopInputRecord() = 0;
+
+    // raw h264 (annex b) packets as received: config (sps/pps) packets, then frames,
+    // the first frame after a config packet carries it again. Runs on the stream
+    // thread, an empty function removes the callback
+    virtual void setVideoPacketCallback(std::function<void(const QByteArray &data, bool config, bool keyFrame)> callback) = 0;
+    // device audio for the recording (DeviceParams::recordAudio): 48kHz stereo s16 pcm
+    // as it arrives, timed on arrival. Ignored when not recording
+    virtual void pushRecordAudio(const QByteArray &pcm) = 0;
 };
 
 class IDeviceManage : public QObject {
@@ -135,10 +180,47 @@ public:
     virtual bool disconnectDevice(const QString &serial) = 0;
     virtual void disconnectAllDevice() = 0;
     virtual QPointer<IDevice> getDevice(const QString& serial) = 0;
+    // device whose adb tunnel uses the local port
+    virtual QPointer<IDevice> getDeviceByPort(quint16 port) = 0;
+    virtual QList<QPointer<IDevice>> getDevices() = 0;
+    // directory for compiled keymap caches, "" disables the cache
+    virtual void setKeyMapCacheDir(const QString& dir) = 0;
+    // run a recorded input session through the keymap without a device, blocks until done
+    virtual bool replayInput(const InputReplayParams& params, InputReplayStats& stats) = 0;
+    // bring up many devices at once: one adb devices scan, then at most maxConcurrent
+    // bring-ups in flight. deviceConnected fires per device, bulkConnectFinished once all are done
+    virtual bool connectDevices(const QList<DeviceParams>& params, int maxConcurrent = 8) = 0;
+    // server jar pushes done and skipped since start, across all devices
+    virtual void getServerPushStats(ServerPushStats& stats) = 0;
+    // group control: every control message the host sends (after its own input
+    // conversion) is also written to the targets, positions rescaled to each
+    // target's frame size. An empty target list stops mirroring the host
+    virtual void setBroadcastTargets(const QString& hostSerial, const QStringList& targetSerials) = 0;
+    // synchronized broadcast: targets with a faster control link are held back so all
+    // of them apply a message within skewWindowMs of each other and of the host.
+    // Only devices with DeviceParams::controlProbe have a measured link, devices
+    // connected while sync is on get it
+    virtual void setBroadcastSync(bool enabled, int skewWindowMs = 5) = 0;
+    virtual void getBroadcastSyncStats(QList<BroadcastSyncStats>& stats) = 0;
+    // watchdog over every connected device, on by default: a silent video stream
+    // gets an encoder reset, a stall restarts the stream (warm reconnect when the
+    // device has autoReconnect), a restart that does not help disconnects
+    virtual void setHealthMonitor(bool enabled, bool autoRecover = true) = 0;
+    virtual void getDeviceHealth(QList<DeviceHealthStats>& stats) = 0;
+    // prometheus text format on http://127.0.0.1:<port>/metrics, 0 stops it
+    virtual bool startMetricsServer(quint16 port) = 0;
+    // adaptive streaming: keeps all video streams together within the receive
+    // bandwidth and the decoder time budget by restarting single streams with a
+    // lower bit rate or max size, and back up to the connect settings once there
+    // is room again. 0 leaves that budget unlimited
+    virtual void setStreamBudget(bool enabled, quint32 bandwidthKbps, double decodeCores) = 0;
+    virtual void getStreamLoad(QList<StreamLoadStats>& stats) = 0;
 
 signals:
     void deviceConnected(bool success, const QString& serial, const QString& deviceName, const QSize& size);
     void deviceDisconnected(QString serial);
+    void bulkConnectFinished(const QList<qsc::DeviceConnectTimings>& timings);
+    void deviceHealthChanged(const QString& serial, qsc::DeviceHealth health);
 };
 
 }
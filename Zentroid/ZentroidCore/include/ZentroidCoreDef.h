@@ -1,4 +1,6 @@
 #pragma once
+#include <QImage>
+#include <QRect>
 #include <QString>
 
 namespace qsc {
@@ -32,13 +34,179 @@ struct DeviceParams {
     QString recordPath = "";          // video save path
     QString recordFileFormat = "mp4"; // video save format: mp4/mkv
     bool recordFile = false;          // record to file
+    // add an audio track to the recording, fed through IDevice::pushRecordAudio
+    bool recordAudio = false;
+    QString screenshotFormat = "png"; // png/jpg/webp (webp needs the qt imageformats plugin)
+    int screenshotQuality = -1;       // 0-100, -1: encoder default
+    // DeviceObserver::onThumbnail output, see IDevice::setThumbnail
+    int thumbnailWidth = 0;           // 0: off
+    int thumbnailFps = 5;             // at most this many thumbnails per second
 
     QString pushFilePath = "/sdcard/"; // file save path on Android device (must end with /)
 
     bool closeScreen = false;         // auto turn off screen on start
-    bool display = true;              // whether to display video (or just record in background)
+    bool display = true;              // decode video for observers; control works without it (headless)
     bool renderExpiredFrames = false; // whether to render expired video frames
     QString gameScript = "";          // game mapping script
+    int maxTouchPoints = 10;          // simultaneous touches the keymap may use, up to 64
+    // keep the adb tunnel after connecting and restart only the device server when the
+    // stream drops, reusing decoder and window; not used while recording to file
+    bool autoReconnect = false;
+    int reconnectAttempts = 3;        // tries per drop, the last ones rebuild the tunnel too
+    // measure the control round trip (broadcast sync, health monitor) with get clipboard
+    // requests: the server runs without clipboard autosync to answer them, device
+    // clipboard changes then reach the pc with the next answered probe
+    bool controlProbe = false;
 };
-    
+
+struct InputReplayParams {
+    QString recordFile = "";          // file written by IDevice::startInputRecord
+    QString gameScript = "";          // keymap to convert with, "" replays through the normal mapping
+    bool realtime = true;             // true: keep the recorded timing, false: feed events back to back
+    int maxTouchPoints = 10;
+    QString controlDumpFile = "";     // optional, receives the serialized control message stream
+};
+
+struct InputReplayStats {
+    quint32 mouseEvents = 0;
+    quint32 wheelEvents = 0;
+    quint32 keyEvents = 0;
+    quint32 controlMsgs = 0;          // messages written to the control socket
+    quint64 controlBytes = 0;
+    qint64 recordedTimeUs = 0;        // timestamp of the last recorded event
+    qint64 wallTimeUs = 0;            // replay duration
+    // per input event: conversion until the resulting messages are written
+    qint64 latencyMinUs = 0;
+    qint64 latencyAvgUs = 0;
+    qint64 latencyP99Us = 0;
+    qint64 latencyMaxUs = 0;
+};
+
+struct DeviceConnectTimings {
+    QString serial = "";
+    bool success = false;
+    quint16 localPort = 0;            // port the bring-up ran on
+    // phases of the bring-up, ms
+    qint64 queuedMs = 0;              // waiting for a free bring-up slot
+    qint64 pushMs = 0;                // adb push of the server
+    qint64 tunnelMs = 0;              // adb reverse/forward, including the forward fallback
+    qint64 executeMs = 0;             // until the server process is up
+    qint64 connectMs = 0;             // until video and control sockets are connected
+    qint64 totalMs = 0;               // from the slot being granted to the result
+};
+
+struct ServerPushStats {
+    quint32 checks = 0;               // remote sha256 compared before a push
+    quint32 pushes = 0;               // jar actually pushed
+    quint32 skipped = 0;              // push skipped, the device copy was identical
+    quint64 bytesPushed = 0;
+    quint64 bytesSaved = 0;
+    qint64 checkMs = 0;               // total time spent on the remote checks
+    qint64 pushMs = 0;                // total time spent pushing
+    qint64 savedMs = 0;               // skipped pushes at the average push time, minus checkMs, at least 0
+};
+
+struct BroadcastSyncStats {
+    QString serial = "";              // target device
+    qint64 roundTripUs = 0;           // smoothed control round trip, 0 until measured
+    qint64 delayUs = 0;               // hold currently applied to its messages
+    // apply time against the host: the moment each message actually left plus
+    // half of the latest measured round trip, host and target alike
+    qint64 skewAvgUs = 0;
+    qint64 skewMaxUs = 0;
+    quint32 messages = 0;
+    quint32 skewSamples = 0;          // messages sent while both round trips were measured
+    quint32 outsideWindow = 0;        // samples outside the skew window
+};
+
+enum DeviceHealth {
+    DH_HEALTHY = 0,
+    DH_DEGRADED,                      // slow or lossy, or a session being rebuilt
+    DH_STALLED                        // no video after a reset request, or control gone silent
+};
+
+struct DeviceHealthStats {
+    QString serial = "";
+    DeviceHealth health = DH_HEALTHY;
+    qint64 videoIdleMs = 0;           // since the last video packet
+    qint64 screenIdleMs = 0;          // since the last decoded frame that differed from the one before
+    quint32 packetRate = 0;           // video packets per second over the last check
+    quint32 decodeRate = 0;           // decoded frames per second over the last check
+    qint64 roundTripUs = 0;           // smoothed control round trip, 0 until measured
+    int lostProbes = 0;               // unanswered control probes in a row
+    quint32 videoResets = 0;          // encoder restarts requested for a silent stream
+    quint32 recoveries = 0;           // stream restarts forced on a stall
+};
+
+// tiles of the frame (any of Y, U, V) that changed since the previous frame handed to the observers
+struct FrameDirtyMap {
+    bool changed = true;              // false: identical to the previous frame, nothing to redo
+    int tileSize = 0;                 // tile side in pixels, the last row and column may be cut
+    int columns = 0;
+    int rows = 0;
+    const quint8 *tiles = nullptr;    // columns * rows row by row, non zero: changed; valid during the call
+
+    bool isDirty(int column, int row) const { return !tiles || 0 != tiles[row * columns + column]; }
+};
+
+// a screen region checked on the decoded yuv frame, see IDevice::setRegionProbes
+struct RegionProbe {
+    int id = 0;                       // chosen by the caller, reported back in RegionProbeEvent
+    QRect rect;                       // frame pixels, clipped to the frame
+    // the mean colour of the region is within colorTolerance of color
+    bool matchColor = false;
+    quint32 color = 0;                // 0xRRGGBB
+    int colorTolerance = 16;          // largest difference per channel, 0-255
+    // the region hash is within hashTolerance bits of hash
+    bool matchHash = false;
+    quint64 hash = 0;                 // RegionProbeEvent::hash taken from a reference frame
+    int hashTolerance = 6;            // differing bits out of 64
+    // an event each time the hash moves more than changeTolerance bits
+    bool reportChanges = false;
+    int changeTolerance = 2;
+};
+
+struct RegionProbeEvent {
+    int id = 0;
+    bool matched = false;             // every enabled match holds, false without any
+    bool matchChanged = false;        // matched is new with this frame (or the first result)
+    bool changed = false;             // the region changed (RegionProbe::reportChanges)
+    quint32 color = 0;                // mean colour, 0xRRGGBB
+    quint64 hash = 0;                 // difference hash of the luma, stable under encoder noise
+    qint64 timestampMs = 0;           // msecs since epoch when the frame was checked
+};
+
+// an on-screen element to find, see IDevice::locateTemplate
+struct TemplateSearch {
+    QImage image;                     // the element, any format, matched in grayscale
+    QSize sourceSize;                 // size of the frame the image was cut from, scaled to the
+                                      // current frame; empty: cut from a frame of the current size
+    QRectF area = QRectF(0, 0, 1, 1); // where to look, relative to the frame like KeyMap positions
+    double minScore = 0.8;            // normalized cross correlation, 1 is a perfect match
+};
+
+struct TemplateMatch {
+    bool found = false;               // score reached TemplateSearch::minScore
+    double score = 0.0;               // best score anywhere in the area
+    QPointF pos;                      // centre of the best match, relative to the frame like KeyMap positions
+    QRectF rect;                      // the best match, relative to the frame
+    QSize frameSize;                  // size of the frame that was searched
+    int elapsedMs = 0;                // time spent searching
+};
+
+struct StreamLoadStats {
+    QString serial = "";
+    quint16 maxSize = 0;              // encoder settings in use
+    quint32 bitRate = 0;
+    quint16 baseMaxSize = 0;          // settings the device was connected with
+    quint32 baseBitRate = 0;
+    quint32 recvKbps = 0;             // measured over the last check
+    quint32 backlogBytes = 0;         // received but not yet read by the demuxer
+    quint32 decodeFps = 0;
+    quint32 skippedFps = 0;           // decoded frames the renderer never took
+    quint32 decodeUsPerFrame = 0;
+    double decodeCores = 0.0;         // decoder time per second of wall time
+    quint32 reconfigures = 0;         // stream restarts with new settings
+};
+
 }
@@ -24,6 +24,9 @@ public:
     virtual ~AdbProcess();
 
     static void setAdbPath(const QString& adbPath);
+    // devices/forward/reverse/shell/push go straight to the adb server when it is
+    // up, everything else (and a missing server) runs the adb binary
+    static void setNativeProtocolEnabled(bool enabled);
 
     void execute(const QString &serial, const QStringList &args);
     void forward(const QString &serial, quint16 localPort, const QString &deviceSocketName);
@@ -8,6 +8,7 @@
 #include "adbprocessimpl.h"
 
 QString g_adbPath;
+bool g_adbNative = true;
 
 namespace qsc {
 
@@ -21,7 +22,7 @@ AdbProcess::AdbProcess(QObject *parent)
 AdbProcess::~AdbProcess()
 {
     if (m_adbImpl->isRuning()) {
-        m_adbImpl->kill();
+        m_adbImpl->cancel();
     }
     delete m_adbImpl;
 }
@@ -31,6 +32,11 @@ void AdbProcess::setAdbPath(const QString &adbPath)
     g_adbPath = adbPath;
 }
 
+void AdbProcess::setNativeProtocolEnabled(bool enabled)
+{
+    g_adbNative = enabled;
+}
+
 void AdbProcess::execute(const QString &serial, const QStringList &args)
 {
     m_adbImpl->execute(serial, args);
@@ -48,12 +54,12 @@ void AdbProcess::setShowTouchesEnabled(const QString &serial, bool enabled)
 
 void AdbProcess::kill()
 {
-    m_adbImpl->kill();
+    m_adbImpl->cancel();
 }
 
 QStringList AdbProcess::arguments()
 {
-    return m_adbImpl->arguments();
+    return m_adbImpl->requestArguments();
 }
 
 QStringList AdbProcess::getDevicesSerialFromStdOut()
@@ -3,6 +3,7 @@
 #include <QDir>
 #include <QFileInfo>
 #include <QProcess>
+#include <QTimer>
 #if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
 #include <QRegExp>
 #else
@@ -10,9 +11,11 @@
 #endif
 
 #include "adbprocessimpl.h"
+#include "adbwireclient.h"
 
 QString AdbProcessImpl::s_adbPath = "";
 extern QString g_adbPath;
+extern bool g_adbNative;
 
 AdbProcessImpl::AdbProcessImpl(QObject *parent) : QProcess(parent)
 {
@@ -21,7 +24,8 @@ AdbProcessImpl::AdbProcessImpl(QObject *parent) : QProcess(parent)
 
 AdbProcessImpl::~AdbProcessImpl()
 {
-    if (isRuning()) {
+    stopNative();
+    if (QProcess::NotRunning != state()) {
         close();
     }
 }
@@ -92,7 +96,13 @@ void AdbProcessImpl::initSignals()
         qInfo() << QString("AdbProcessImpl::out:%1").arg(tmp).toStdString().data();
     });
 
-    connect(this, &QProcess::started, this, [this]() { emit adbProcessImplResult(qsc::AdbProcess::AER_SUCCESS_START); });
+    connect(this, &QProcess::started, this, [this]() {
+        if (m_startReported) {
+            return;
+        }
+        m_startReported = true;
+        emit adbProcessImplResult(qsc::AdbProcess::AER_SUCCESS_START);
+    });
 }
 
 void AdbProcessImpl::execute(const QString &serial, const QStringList &args)
@@ -104,12 +114,90 @@ void AdbProcessImpl::execute(const QString &serial, const QStringList &args)
         adbArgs << "-s" << serial;
     }
     adbArgs << args;
+
+    stopNative();
+    m_startReported = false;
+    if (executeNative(serial, args)) {
+        m_nativeArgs = adbArgs;
+        qDebug() << "adb server" << adbArgs.join(" ");
+        return;
+    }
+
+    m_nativeArgs.clear();
     qDebug() << getAdbPath() << adbArgs.join(" ");
     start(getAdbPath(), adbArgs);
 }
 
+bool AdbProcessImpl::executeNative(const QString &serial, const QStringList &args)
+{
+    if (!g_adbNative || "0" == qgetenv("ZENTROID_ADB_NATIVE") || !AdbWireClient::supports(args)) {
+        return false;
+    }
+
+    quint32 generation = ++m_nativeGeneration;
+    AdbWireClient *client = new AdbWireClient(this);
+    m_wireClient = client;
+
+    connect(client, &AdbWireClient::started, this, [this, generation]() {
+        if (generation == m_nativeGeneration && !m_startReported) {
+            m_startReported = true;
+            emit adbProcessImplResult(qsc::AdbProcess::AER_SUCCESS_START);
+        }
+    });
+    connect(client, &AdbWireClient::standardOutput, this, [this](const QByteArray &data) {
+        QString tmp = QString::fromUtf8(data).trimmed();
+        m_standardOutput += tmp;
+        qInfo() << QString("AdbProcessImpl::out:%1").arg(tmp).toStdString().data();
+    });
+    connect(client, &AdbWireClient::errorOutput, this, [this](const QString &error) {
+        QString tmp = error.trimmed();
+        m_errorOutput += tmp;
+        qWarning() << QString("AdbProcessImpl::error:%1").arg(tmp).toStdString().data();
+    });
+    connect(client, &AdbWireClient::finished, this, [this, client, generation](bool success) {
+        client->deleteLater();
+        if (generation != m_nativeGeneration) {
+            return;
+        }
+        qDebug() << "adb server return" << success;
+        emit adbProcessImplResult(success ? qsc::AdbProcess::AER_SUCCESS_EXEC : qsc::AdbProcess::AER_ERROR_EXEC);
+    });
+    connect(client, &AdbWireClient::unreachable, this, [this, client, generation]() {
+        client->deleteLater();
+        if (generation != m_nativeGeneration) {
+            return;
+        }
+        // no adb server yet (the binary starts one on its way) or a device that
+        // refused shell v2; a start already reported is not reported again
+        QStringList adbArgs = m_nativeArgs;
+        m_nativeArgs.clear();
+        qDebug() << getAdbPath() << adbArgs.join(" ");
+        start(getAdbPath(), adbArgs);
+    });
+
+    if (!client->start(serial, args)) {
+        stopNative();
+        return false;
+    }
+    return true;
+}
+
+void AdbProcessImpl::stopNative()
+{
+    if (!m_wireClient) {
+        return;
+    }
+    ++m_nativeGeneration;
+    m_wireClient->abort();
+    m_wireClient->deleteLater();
+    m_wireClient = nullptr;
+}
+
 bool AdbProcessImpl::isRuning()
 {
+    if (m_wireClient && m_wireClient->isActive()) {
+        return true;
+    }
     if (QProcess::NotRunning == state()) {
         return false;
     } else {
@@ -117,6 +205,30 @@ bool AdbProcessImpl::isRuning()
     }
 }
 
+void AdbProcessImpl::cancel()
+{
+    if (m_wireClient && m_wireClient->isActive()) {
+        stopNative();
+        // a killed adb binary reports a failed exit from the event loop, keep that
+        quint32 generation = m_nativeGeneration;
+        QTimer::singleShot(0, this, [this, generation]() {
+            if (generation == m_nativeGeneration) {
+                emit adbProcessImplResult(qsc::AdbProcess::AER_ERROR_EXEC);
+            }
+        });
+        return;
+    }
+    QProcess::kill();
+}
+
+QStringList AdbProcessImpl::requestArguments()
+{
+    if (!m_nativeArgs.isEmpty()) {
+        return m_nativeArgs;
+    }
+    return QProcess::arguments();
+}
+
 void AdbProcessImpl::setShowTouchesEnabled(const QString &serial, bool enabled)
 {
     QStringList adbArgs;
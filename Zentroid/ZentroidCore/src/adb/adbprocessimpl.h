@@ -1,8 +1,11 @@
 #pragma once
 
+#include <QPointer>
 #include <QProcess>
 #include "adbprocess.h"
 
+class AdbWireClient;
+
 class AdbProcessImpl : public QProcess
 {
     Q_OBJECT
@@ -20,6 +23,10 @@ public:
     void install(const QString &serial, const QString &local);
     void removePath(const QString &serial, const QString &path);
     bool isRuning();
+    // cover both the adb binary and a native request; own names, QProcess::kill()
+    // and QProcess::arguments() are not virtual and know nothing of the latter
+    void cancel();
+    QStringList requestArguments();
     void setShowTouchesEnabled(const QString &serial, bool enabled);
     QStringList getDevicesSerialFromStdOut();
     QString getDeviceIPFromStdOut();
@@ -34,9 +41,20 @@ signals:
 
 private:
     void initSignals();
+    // talk to the adb server directly, false when args need the adb binary
+    bool executeNative(const QString &serial, const QStringList &args);
+    void stopNative();
 
 private:
     QString m_standardOutput = "";
     QString m_errorOutput = "";
     static QString s_adbPath;
+
+    QPointer<AdbWireClient> m_wireClient;
+    QStringList m_nativeArgs;
+    // bumped per request so results of an aborted native request are dropped
+    quint32 m_nativeGeneration = 0;
+    // AER_SUCCESS_START goes out once per request, also when a native request
+    // falls back to the adb binary after it had started
+    bool m_startReported = false;
 };
@@ -0,0 +1,418 @@
+#include <QDateTime>
+#include <QDebug>
+#include <QFileInfo>
+#include <QtEndian>
+
+#include "adbwireclient.h"
+
+#define ADB_SERVER_HOST "127.0.0.1"
+#define ADB_SERVER_PORT 5037
+#define ADB_SYNC_DATA_MAX (64 * 1024)
+// keep at most this much push data queued in the socket
+#define ADB_SYNC_WRITE_WATERMARK (4 * ADB_SYNC_DATA_MAX)
+#define ADB_SYNC_DEFAULT_MODE 0100644
+#define ADB_S_IFDIR 0040000
+// shell v2 packets: id, 4 byte little endian length, payload
+#define ADB_SHELL_HEADER_SIZE 5
+#define ADB_SHELL_ID_STDOUT 1
+#define ADB_SHELL_ID_STDERR 2
+#define ADB_SHELL_ID_EXIT 3
+#define ADB_SHELL_ID_CLOSE_STDIN 4
+
+namespace {
+
+void serverAddress(QString &host, quint16 &port)
+{
+    host = ADB_SERVER_HOST;
+    port = ADB_SERVER_PORT;
+
+    // same variables the adb binary honours, "tcp:port" or "tcp:host:port"
+    QString socketSpec = QString::fromLocal8Bit(qgetenv("ADB_SERVER_SOCKET"));
+    if (socketSpec.startsWith("tcp:")) {
+        QStringList parts = socketSpec.mid(4).split(':');
+        if (2 == parts.size()) {
+            host = parts[0];
+            port = parts[1].toUShort();
+        } else if (1 == parts.size()) {
+            port = parts[0].toUShort();
+        }
+        return;
+    }
+    bool ok = false;
+    quint16 envPort = QString::fromLocal8Bit(qgetenv("ANDROID_ADB_SERVER_PORT")).toUShort(&ok);
+    if (ok && envPort) {
+        port = envPort;
+    }
+}
+
+}
+
+AdbWireClient::AdbWireClient(QObject *parent) : QObject(parent)
+{
+    connect(&m_socket, &QTcpSocket::connected, this, &AdbWireClient::onConnected);
+    connect(&m_socket, &QTcpSocket::readyRead, this, &AdbWireClient::onReadyRead);
+    connect(&m_socket, &QTcpSocket::bytesWritten, this, &AdbWireClient::onBytesWritten);
+    connect(&m_socket, &QTcpSocket::disconnected, this, &AdbWireClient::onDisconnected);
+#if (QT_VERSION < QT_VERSION_CHECK(5, 15, 0))
+    connect(&m_socket, static_cast<void (QAbstractSocket::*)(QAbstractSocket::SocketError)>(&QAbstractSocket::error), this, &AdbWireClient::onError);
+#else
+    connect(&m_socket, &QAbstractSocket::errorOccurred, this, &AdbWireClient::onError);
+#endif
+}
+
+AdbWireClient::~AdbWireClient()
+{
+    m_socket.abort();
+}
+
+bool AdbWireClient::supports(const QStringList &args)
+{
+    if (args.isEmpty()) {
+        return false;
+    }
+    const QString &command = args[0];
+    if ("devices" == command) {
+        return 1 == args.size();
+    }
+    if ("shell" == command) {
+        // interactive shells and shell options stay with the binary
+        return 2 <= args.size() && !args[1].startsWith("-");
+    }
+    if ("forward" == command || "reverse" == command) {
+        return 3 == args.size() && (!args[1].startsWith("-") || "--remove" == args[1]);
+    }
+    if ("push" == command) {
+        return 3 == args.size() && QFileInfo(args[1]).isFile();
+    }
+    return false;
+}
+
+bool AdbWireClient::start(const QString &serial, const QStringList &args)
+{
+    if (WST_IDLE != m_step || !supports(args)) {
+        return false;
+    }
+
+    m_serial = serial;
+    m_buffer.clear();
+    m_needTransport = false;
+    m_statusLeft = 1;
+    m_sendDone = false;
+
+    const QString &command = args[0];
+    QString host = serial.isEmpty() ? QString("host:") : QString("host-serial:%1:").arg(serial);
+    if ("devices" == command) {
+        m_service = WS_DEVICES;
+        m_request = "host:devices";
+    } else if ("shell" == command) {
+        m_service = WS_SHELL;
+        m_needTransport = true;
+        // v2 frames stdout/stderr and ends with the exit status, the legacy shell: has none
+        m_request = "shell,v2,raw:" + args.mid(1).join(" ").toUtf8();
+    } else if ("forward" == command) {
+        // on the host the first OKAY acknowledges the request, the second one the result
+        m_service = WS_FORWARD;
+        m_statusLeft = 2;
+        m_request = ("--remove" == args[1] ? host + "killforward:" + args[2] : host + "forward:" + args[1] + ";" + args[2]).toUtf8();
+    } else if ("reverse" == command) {
+        m_service = WS_TRANSPORT_STATUS;
+        m_needTransport = true;
+        m_statusLeft = 2;
+        m_request = ("--remove" == args[1] ? "reverse:killforward:" + args[2] : "reverse:forward:" + args[1] + ";" + args[2]).toUtf8();
+    } else if ("push" == command) {
+        m_service = WS_PUSH;
+        m_needTransport = true;
+        m_request = "sync:";
+        m_pushFile.setFileName(args[1]);
+        m_remotePath = args[2];
+    }
+
+    QString serverHost;
+    quint16 serverPort = 0;
+    serverAddress(serverHost, serverPort);
+    m_step = WST_CONNECTING;
+    m_socket.connectToHost(serverHost, serverPort);
+    return true;
+}
+
+void AdbWireClient::abort()
+{
+    if (WST_IDLE == m_step) {
+        return;
+    }
+    m_step = WST_IDLE;
+    m_pushFile.close();
+    m_socket.abort();
+}
+
+bool AdbWireClient::isActive()
+{
+    return WST_IDLE != m_step;
+}
+
+void AdbWireClient::onConnected()
+{
+    emit started();
+    if (m_needTransport) {
+        m_step = WST_TRANSPORT;
+        sendRequest(m_serial.isEmpty() ? QByteArray("host:transport-any") : "host:transport:" + m_serial.toUtf8());
+    } else {
+        m_step = WST_STATUS;
+        sendRequest(m_request);
+    }
+}
+
+void AdbWireClient::onReadyRead()
+{
+    m_buffer.append(m_socket.readAll());
+    processBuffer();
+}
+
+void AdbWireClient::onBytesWritten()
+{
+    if (WST_SYNC_SEND != m_step || m_sendDone) {
+        return;
+    }
+
+    while (m_socket.bytesToWrite() < ADB_SYNC_WRITE_WATERMARK) {
+        QByteArray chunk = m_pushFile.read(ADB_SYNC_DATA_MAX);
+        if (chunk.isEmpty()) {
+            if (!m_pushFile.atEnd()) {
+                emit errorOutput(QString("adb: read %1 failed: %2").arg(m_pushFile.fileName()).arg(m_pushFile.errorString()));
+                finish(false);
+                return;
+            }
+            sendSync("DONE", static_cast<quint32>(QFileInfo(m_pushFile).lastModified().toMSecsSinceEpoch() / 1000));
+            m_pushFile.close();
+            m_sendDone = true;
+            m_step = WST_SYNC_DONE;
+            return;
+        }
+        sendSync("DATA", chunk);
+    }
+}
+
+void AdbWireClient::onDisconnected()
+{
+    if (WST_STREAM == m_step) {
+        // the exit packet finishes a shell, closing without one means it was cut off
+        emit errorOutput("adb: shell closed without an exit status");
+        finish(false);
+    } else if (WST_IDLE != m_step) {
+        emit errorOutput("adb: connection closed by the adb server");
+        finish(false);
+    }
+}
+
+void AdbWireClient::onError(QAbstractSocket::SocketError error)
+{
+    if (WST_CONNECTING == m_step) {
+        qWarning() << "adb server not reachable:" << m_socket.errorString();
+        m_step = WST_IDLE;
+        emit unreachable();
+        return;
+    }
+    // the remote side closing a stream is reported through disconnected
+    if (QAbstractSocket::RemoteHostClosedError != error && WST_IDLE != m_step) {
+        emit errorOutput(QString("adb: %1").arg(m_socket.errorString()));
+        finish(false);
+    }
+}
+
+void AdbWireClient::sendRequest(const QByteArray &request)
+{
+    m_socket.write(QString("%1").arg(request.size(), 4, 16, QChar('0')).toLatin1() + request);
+}
+
+void AdbWireClient::sendSync(const char *id, const QByteArray &data)
+{
+    sendSync(id, static_cast<quint32>(data.size()));
+    m_socket.write(data);
+}
+
+void AdbWireClient::sendSync(const char *id, quint32 value)
+{
+    char header[8];
+    memcpy(header, id, 4);
+    qToLittleEndian<quint32>(value, reinterpret_cast<uchar *>(header + 4));
+    m_socket.write(header, sizeof(header));
+}
+
+int AdbWireClient::readStatus(bool reportFail)
+{
+    if (m_buffer.size() < 4) {
+        return -1;
+    }
+    if (m_buffer.startsWith("OKAY")) {
+        m_buffer.remove(0, 4);
+        return 1;
+    }
+    if (m_buffer.size() < 8) {
+        return -1;
+    }
+    int length = m_buffer.mid(4, 4).toInt(nullptr, 16);
+    if (m_buffer.size() < 8 + length) {
+        return -1;
+    }
+    if (reportFail) {
+        emit errorOutput(QString::fromUtf8(m_buffer.mid(8, length)));
+    } else {
+        qInfo() << "adb server refused:" << QString::fromUtf8(m_buffer.mid(8, length));
+    }
+    m_buffer.remove(0, 8 + length);
+    return 0;
+}
+
+void AdbWireClient::processBuffer()
+{
+    while (WST_IDLE != m_step) {
+        switch (m_step) {
+        case WST_TRANSPORT: {
+            int status = readStatus();
+            if (-1 == status) {
+                return;
+            }
+            if (0 == status) {
+                finish(false);
+                return;
+            }
+            m_step = WST_STATUS;
+            sendRequest(m_request);
+        } break;
+        case WST_STATUS: {
+            int status = readStatus(WS_SHELL != m_service);
+            if (-1 == status) {
+                return;
+            }
+            if (0 == status) {
+                if (WS_SHELL == m_service) {
+                    // devices without shell_v2 refuse the request, the adb binary still runs it
+                    m_step = WST_IDLE;
+                    m_socket.abort();
+                    emit unreachable();
+                    return;
+                }
+                finish(false);
+                return;
+            }
+            if (--m_statusLeft > 0) {
+                break;
+            }
+            switch (m_service) {
+            case WS_DEVICES:
+                m_step = WST_HOST_DATA;
+                break;
+            case WS_SHELL: {
+                // nothing is piped in, a command reading stdin sees eof instead of hanging
+                const char closeStdin[ADB_SHELL_HEADER_SIZE] = { ADB_SHELL_ID_CLOSE_STDIN, 0, 0, 0, 0 };
+                m_socket.write(closeStdin, sizeof(closeStdin));
+                m_step = WST_STREAM;
+            } break;
+            case WS_PUSH:
+                if (m_remotePath.endsWith('/')) {
+                    startSend(m_remotePath + QFileInfo(m_pushFile).fileName());
+                } else {
+                    m_step = WST_SYNC_STAT;
+                    sendSync("STAT", m_remotePath.toUtf8());
+                }
+                break;
+            default:
+                finish(true);
+                return;
+            }
+        } break;
+        case WST_HOST_DATA: {
+            if (m_buffer.size() < 4) {
+                return;
+            }
+            int length = m_buffer.left(4).toInt(nullptr, 16);
+            if (m_buffer.size() < 4 + length) {
+                return;
+            }
+            emit standardOutput(m_buffer.mid(4, length));
+            m_buffer.clear();
+            finish(true);
+            return;
+        }
+        case WST_STREAM: {
+            if (m_buffer.size() < ADB_SHELL_HEADER_SIZE) {
+                return;
+            }
+            quint32 length = qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(m_buffer.constData() + 1));
+            if (static_cast<quint32>(m_buffer.size()) < ADB_SHELL_HEADER_SIZE + length) {
+                return;
+            }
+            char id = m_buffer.at(0);
+            QByteArray payload = m_buffer.mid(ADB_SHELL_HEADER_SIZE, static_cast<int>(length));
+            m_buffer.remove(0, ADB_SHELL_HEADER_SIZE + static_cast<int>(length));
+            if (ADB_SHELL_ID_STDOUT == id) {
+                emit standardOutput(payload);
+            } else if (ADB_SHELL_ID_STDERR == id) {
+                emit errorOutput(QString::fromUtf8(payload));
+            } else if (ADB_SHELL_ID_EXIT == id) {
+                int exitCode = payload.isEmpty() ? -1 : static_cast<uchar>(payload.at(0));
+                if (0 != exitCode) {
+                    qWarning() << "adb shell exit code" << exitCode;
+                }
+                finish(0 == exitCode);
+                return;
+            }
+        } break;
+        case WST_SYNC_STAT: {
+            // "STAT" mode size mtime
+            if (m_buffer.size() < 16) {
+                return;
+            }
+            quint32 mode = qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(m_buffer.constData() + 4));
+            m_buffer.remove(0, 16);
+            if ((mode & ADB_S_IFDIR) == ADB_S_IFDIR) {
+                startSend(m_remotePath + "/" + QFileInfo(m_pushFile).fileName());
+            } else {
+                startSend(m_remotePath);
+            }
+        } break;
+        case WST_SYNC_SEND:
+            // the device only answers after DONE, anything earlier is a failure report
+        case WST_SYNC_DONE: {
+            if (m_buffer.size() < 8) {
+                return;
+            }
+            quint32 length = qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(m_buffer.constData() + 4));
+            if (m_buffer.startsWith("OKAY")) {
+                m_buffer.remove(0, 8);
+                sendSync("QUIT", 0u);
+                finish(true);
+                return;
+            }
+            if (static_cast<quint32>(m_buffer.size()) < 8 + length) {
+                return;
+            }
+            emit errorOutput(QString("adb: push failed: %1").arg(QString::fromUtf8(m_buffer.mid(8, static_cast<int>(length)))));
+            finish(false);
+            return;
+        }
+        default:
+            return;
+        }
+    }
+}
+
+void AdbWireClient::startSend(const QString &remotePath)
+{
+    if (!m_pushFile.open(QIODevice::ReadOnly)) {
+        emit errorOutput(QString("adb: open %1 failed: %2").arg(m_pushFile.fileName()).arg(m_pushFile.errorString()));
+        finish(false);
+        return;
+    }
+    m_step = WST_SYNC_SEND;
+    sendSync("SEND", QString("%1,%2").arg(remotePath).arg(ADB_SYNC_DEFAULT_MODE).toUtf8());
+    onBytesWritten();
+}
+
+void AdbWireClient::finish(bool success)
+{
+    m_step = WST_IDLE;
+    m_pushFile.close();
+    m_socket.disconnectFromHost();
+    emit finished(success);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QObject>
+#include <QStringList>
+#include <QTcpSocket>
+
+// Talks the adb host protocol straight to the local adb server instead of
+// spawning the adb binary: host:devices, host-serial:...:forward,
+// host:transport + shell,v2,raw:, reverse:forward and sync SEND for push.
+// One request per instance; see supports() for the accepted argument lists.
+class AdbWireClient : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit AdbWireClient(QObject *parent = nullptr);
+    virtual ~AdbWireClient();
+
+    // args use the adb command line form, e.g. {"forward", "tcp:27183", "localabstract:x"}
+    static bool supports(const QStringList &args);
+    bool start(const QString &serial, const QStringList &args);
+    void abort();
+    bool isActive();
+
+signals:
+    // connected to the adb server, the request is on its way
+    void started();
+    // the adb server could not be reached or refused the service (no shell_v2 on the
+    // device), nothing ran: hand the request to the adb binary
+    void unreachable();
+    void standardOutput(const QByteArray &data);
+    void errorOutput(const QString &error);
+    void finished(bool success);
+
+private:
+    enum Service
+    {
+        WS_DEVICES,
+        WS_FORWARD,
+        WS_TRANSPORT_STATUS, // reverse:forward / reverse:killforward
+        WS_SHELL,
+        WS_PUSH
+    };
+
+    enum Step
+    {
+        WST_IDLE,
+        WST_CONNECTING,
+        WST_TRANSPORT,
+        WST_STATUS,
+        WST_HOST_DATA,
+        WST_STREAM,
+        WST_SYNC_STAT,
+        WST_SYNC_SEND,
+        WST_SYNC_DONE
+    };
+
+    void onConnected();
+    void onReadyRead();
+    void onBytesWritten();
+    void onDisconnected();
+    void onError(QAbstractSocket::SocketError error);
+
+    void sendRequest(const QByteArray &request);
+    void sendSync(const char *id, const QByteArray &data);
+    void sendSync(const char *id, quint32 value);
+    // -1: need more data, 0: FAIL (message consumed), 1: OKAY
+    int readStatus(bool reportFail = true);
+    void processBuffer();
+    void startSend(const QString &remotePath);
+    void finish(bool success);
+
+private:
+    QTcpSocket m_socket;
+    QByteArray m_buffer;
+    Service m_service = WS_DEVICES;
+    Step m_step = WST_IDLE;
+    QString m_serial;
+    QByteArray m_request;
+    bool m_needTransport = false;
+    int m_statusLeft = 0;
+    // push
+    QFile m_pushFile;
+    QString m_remotePath;
+    bool m_sendDone = false;
+};
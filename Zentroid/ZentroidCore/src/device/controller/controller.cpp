@@ -1,18 +1,27 @@
-#include <QApplication>
+#include <QGuiApplication>
 #include <QClipboard>
 
 #include "controller.h"
 #include "controlmsg.h"
+#include "devicemsg.h"
 #include "inputconvertgame.h"
 #include "receiver.h"
 #include "videosocket.h"
 
+#define CLIPBOARD_REQUEST_TIMEOUT_US 1000000
+// weight of a new round trip sample, in 1/8
+#define ROUND_TRIP_SMOOTHING 2
+
 Controller::Controller(std::function<qint64(const QByteArray&)> sendData, QString gameScript, QObject *parent)
     : QObject(parent)
     , m_sendData(sendData)
 {
     m_receiver = new Receiver(this);
     Q_ASSERT(m_receiver);
+    m_rttClock.start();
+    // headless (QCoreApplication only): no cursor and no clipboard to touch
+    m_hasGui = Q_NULLPTR != qobject_cast<QGuiApplication *>(QCoreApplication::instance());
+    m_hostCursorControl = m_hasGui;
 
     updateScript(gameScript);
 }
@@ -32,9 +41,93 @@ void Controller::recvDeviceMsg(DeviceMsg *deviceMsg)
         return;
     }
 
+    qint64 nowUs = m_rttClock.nsecsElapsed() / 1000;
+    if (DeviceMsg::DMT_GET_CLIPBOARD == deviceMsg->type()) {
+        expireClipboardRequests(nowUs);
+        QString text;
+        deviceMsg->getClipboardMsgData(text);
+        bool changed = m_deviceClipboardKnown && text != m_deviceClipboard;
+        m_deviceClipboard = text;
+        m_deviceClipboardKnown = true;
+        // nothing pending: a message we did not ask for, pass it on
+        if (!m_clipboardRequests.isEmpty()) {
+            ClipboardRequest request = m_clipboardRequests.dequeue();
+            if (request.probe) {
+                addRoundTripSample(nowUs - request.sentUs);
+                // the server runs without clipboard autosync while probing,
+                // probe answers stand in for it: a changed device clipboard goes to the pc
+                if (!changed) {
+                    return;
+                }
+            }
+        }
+    }
+
     m_receiver->recvDeviceMsg(deviceMsg);
 }
 
+void Controller::setRoundTripProbe(bool enable)
+{
+    m_roundTripProbe = enable;
+}
+
+void Controller::probeRoundTrip()
+{
+    if (!m_roundTripProbe) {
+        return;
+    }
+    // one probe at a time, an unanswered one has to time out first
+    expireClipboardRequests(m_rttClock.nsecsElapsed() / 1000);
+    for (const ClipboardRequest &request : m_clipboardRequests) {
+        if (request.probe) {
+            return;
+        }
+    }
+
+    // read only: the device clipboard stays as it is
+    ControlMsg controlMsg(ControlMsg::CMT_GET_CLIPBOARD);
+    controlMsg.setGetClipboardMsgData(ControlMsg::GCCK_NONE);
+    // sent right away, a queued probe would also measure the local event queue
+    if (sendControl(controlMsg.serializeData())) {
+        trackClipboardRequest(true);
+    }
+}
+
+qint64 Controller::roundTripUs()
+{
+    return m_roundTripUs;
+}
+
+int Controller::lostProbes()
+{
+    expireClipboardRequests(m_rttClock.nsecsElapsed() / 1000);
+    return m_lostProbes;
+}
+
+void Controller::expireClipboardRequests(qint64 nowUs)
+{
+    while (!m_clipboardRequests.isEmpty() && nowUs - m_clipboardRequests.head().sentUs > CLIPBOARD_REQUEST_TIMEOUT_US) {
+        // also what an empty device clipboard gives: no answer at all
+        if (m_clipboardRequests.dequeue().probe) {
+            m_lostProbes++;
+        }
+    }
+}
+
+void Controller::addRoundTripSample(qint64 sampleUs)
+{
+    m_lostProbes = 0;
+    m_roundTripUs = m_roundTripUs ? (m_roundTripUs * (8 - ROUND_TRIP_SMOOTHING) + sampleUs * ROUND_TRIP_SMOOTHING) / 8 : qMax<qint64>(1, sampleUs);
+}
+
+void Controller::trackClipboardRequest(bool probe)
+{
+    ClipboardRequest request;
+    request.sentUs = m_rttClock.nsecsElapsed() / 1000;
+    request.probe = probe;
+    m_clipboardRequests.enqueue(request);
+}
+
 void Controller::test(QRect rc)
 {
     ControlMsg *controlMsg = new ControlMsg(ControlMsg::CMT_INJECT_TOUCH);
@@ -66,6 +159,8 @@ void Controller::updateScript(QString gameScript)
     }
     if (!gameScript.isEmpty()) {
         InputConvertGame *convertgame = new InputConvertGame(this);
+        convertgame->setMaxTouchPoints(m_maxTouchPoints);
+        convertgame->setHostCursorControl(m_hostCursorControl);
         convertgame->loadKeyMap(gameScript);
         m_inputConvert = convertgame;
         qInfo() << "[Keymap] Created new InputConvertGame";
@@ -77,6 +172,24 @@ void Controller::updateScript(QString gameScript)
     connect(m_inputConvert, &InputConvertBase::grabCursor, this, &Controller::grabCursor);
 }
 
+void Controller::setMaxTouchPoints(int count)
+{
+    m_maxTouchPoints = count;
+    InputConvertGame *convertgame = dynamic_cast<InputConvertGame*>(m_inputConvert.data());
+    if (convertgame) {
+        convertgame->setMaxTouchPoints(count);
+    }
+}
+
+void Controller::setHostCursorControl(bool enable)
+{
+    m_hostCursorControl = enable && m_hasGui;
+    InputConvertGame *convertgame = dynamic_cast<InputConvertGame*>(m_inputConvert.data());
+    if (convertgame) {
+        convertgame->setHostCursorControl(m_hostCursorControl);
+    }
+}
+
 bool Controller::isCurrentCustomKeymap()
 {
     if (!m_inputConvert) {
@@ -159,6 +272,15 @@ void Controller::collapsePanel()
     postControlMsg(controlMsg);
 }
 
+void Controller::resetVideo()
+{
+    ControlMsg *controlMsg = new ControlMsg(ControlMsg::CMT_RESET_VIDEO);
+    if (!controlMsg) {
+        return;
+    }
+    postControlMsg(controlMsg);
+}
+
 void Controller::requestDeviceClipboard()
 {
     ControlMsg *controlMsg = new ControlMsg(ControlMsg::CMT_GET_CLIPBOARD);
@@ -181,7 +303,10 @@ void Controller::getDeviceClipboard(bool cut)
 
 void Controller::setDeviceClipboard(bool pause)
 {
-    QClipboard *board = QApplication::clipboard();
+    if (!m_hasGui) {
+        return;
+    }
+    QClipboard *board = QGuiApplication::clipboard();
     QString text = board->text();
     ControlMsg *controlMsg = new ControlMsg(ControlMsg::CMT_SET_CLIPBOARD);
     if (!controlMsg) {
@@ -189,11 +314,17 @@ void Controller::setDeviceClipboard(bool pause)
     }
     controlMsg->setSetClipboardMsgData(text, pause);
     postControlMsg(controlMsg);
+    // what the device holds now, not to be sent back by the next probe
+    m_deviceClipboard = text;
+    m_deviceClipboardKnown = true;
 }
 
 void Controller::clipboardPaste()
 {
-    QClipboard *board = QApplication::clipboard();
+    if (!m_hasGui) {
+        return;
+    }
+    QClipboard *board = QGuiApplication::clipboard();
     QString text = board->text();
     postTextInput(text);
 }
@@ -244,7 +375,10 @@ bool Controller::event(QEvent *event)
     if (event && static_cast<ControlMsg::Type>(event->type()) == ControlMsg::Control) {
         ControlMsg *controlMsg = dynamic_cast<ControlMsg *>(event);
         if (controlMsg) {
-            sendControl(controlMsg->serializeData());
+            QByteArray buffer = controlMsg->serializeData();
+            if (sendControl(buffer) && ControlMsg::CMT_GET_CLIPBOARD == static_cast<quint8>(buffer[0])) {
+                trackClipboardRequest(false);
+            }
         }
         return true;
     }
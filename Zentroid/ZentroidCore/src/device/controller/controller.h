@@ -2,8 +2,10 @@
 #ifndef CONTROLLER_H
 #define CONTROLLER_H
 
+#include <QElapsedTimer>
 #include <QObject>
 #include <QPointer>
+#include <QQueue>
 
 #include "inputconvertbase.h"
 
@@ -24,6 +26,20 @@ public:
 
     void updateScript(QString gameScript = "");
     bool isCurrentCustomKeymap();
+    void setMaxTouchPoints(int count);
+    // false: never hide, grab or warp the local cursor (replay without a window)
+    void setHostCursorControl(bool enable);
+
+    // true only when the server runs without clipboard autosync: it answers a
+    // get clipboard then (for a non-empty clipboard), with autosync it never does
+    void setRoundTripProbe(bool enable);
+    // control round trip, measured with a get clipboard; an answer that shows a
+    // changed device clipboard still reaches the pc clipboard. 0 until measured,
+    // sends nothing without setRoundTripProbe
+    void probeRoundTrip();
+    qint64 roundTripUs();
+    // probes that timed out since the last answered one
+    int lostProbes();
 
     void postGoBack();
     void postGoHome();
@@ -37,6 +53,8 @@ public:
     void expandNotificationPanel();
     void collapsePanel();
     void setDisplayPower(bool on);
+    // restart the encoder, the device sends config packets and a key frame again
+    void resetVideo();
 
     // for input convert
     void mouseEvent(const QMouseEvent *from, const QSize &frameSize, const QSize &showSize);
@@ -59,13 +77,36 @@ protected:
     bool event(QEvent *event);
 
 private:
+    struct ClipboardRequest
+    {
+        qint64 sentUs = 0;
+        bool probe = false;
+    };
+
     bool sendControl(const QByteArray &buffer);
     void postKeyCodeClick(AndroidKeycode keycode);
+    void trackClipboardRequest(bool probe);
+    void expireClipboardRequests(qint64 nowUs);
+    void addRoundTripSample(qint64 sampleUs);
 
 private:
     QPointer<Receiver> m_receiver;
     QPointer<InputConvertBase> m_inputConvert;
     std::function<qint64(const QByteArray&)> m_sendData = Q_NULLPTR;
+    int m_maxTouchPoints = 10;
+    bool m_hostCursorControl = true;
+    bool m_hasGui = true;
+
+    // clipboard replies come back in request order; the device stays silent
+    // for an empty clipboard, so stale entries time out
+    QQueue<ClipboardRequest> m_clipboardRequests;
+    QElapsedTimer m_rttClock;
+    qint64 m_roundTripUs = 0;
+    int m_lostProbes = 0;
+    bool m_roundTripProbe = false;
+    // the device clipboard as last seen, probe answers only pass changes on
+    QString m_deviceClipboard;
+    bool m_deviceClipboardKnown = false;
 };
 
 #endif // CONTROLLER_H
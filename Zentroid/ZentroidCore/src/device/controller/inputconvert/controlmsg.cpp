@@ -75,6 +75,8 @@ void ControlMsg::setGetClipboardMsgData(ControlMsg::GetClipboardCopyKey copyKey)
 
 void ControlMsg::setSetClipboardMsgData(QString &text, bool paste)
 {
+    m_data.setClipboard.paste = paste;
+    m_data.setClipboard.sequence = 0;
     if (text.isEmpty()) {
         m_data.setClipboard.text = Q_NULLPTR;
         return;
@@ -87,8 +89,6 @@ void ControlMsg::setSetClipboardMsgData(QString &text, bool paste)
     m_data.setClipboard.text = new char[tmp.length() + 1];
     memcpy(m_data.setClipboard.text, tmp.data(), tmp.length());
     m_data.setClipboard.text[tmp.length()] = '\0';
-    m_data.setClipboard.paste = paste;
-    m_data.setClipboard.sequence = 0;
 }
 
 void ControlMsg::setDisplayPowerData(bool on)
@@ -196,6 +196,7 @@ QByteArray ControlMsg::serializeData()
     case CMT_EXPAND_SETTINGS_PANEL:
     case CMT_COLLAPSE_PANELS:
     case CMT_ROTATE_DEVICE:
+    case CMT_RESET_VIDEO:
         break;
     default:
         qDebug() << "Unknown event type:" << m_data.type;
@@ -41,7 +41,9 @@ public:
         CMT_GET_CLIPBOARD,
         CMT_SET_CLIPBOARD,
         CMT_SET_DISPLAY_POWER,
-        CMT_ROTATE_DEVICE
+        CMT_ROTATE_DEVICE,
+        // 12-16 are uhid, keyboard settings and start app, not used here
+        CMT_RESET_VIDEO = 17
     };
 
     enum GetClipboardCopyKey {
@@ -13,6 +13,8 @@ InputConvertGame::InputConvertGame(Controller *controller) : InputConvertNormal(
     m_ctrlSteerWheel.delayData.timer = new QTimer(this);
     m_ctrlSteerWheel.delayData.timer->setSingleShot(true);
     connect(m_ctrlSteerWheel.delayData.timer, &QTimer::timeout, this, &InputConvertGame::onSteerWheelTimer);
+
+    m_macroScheduler = new MacroScheduler([this](int key, const KeyMap::MacroEvent &event) { executeMacroEvent(key, event); }, this);
 }
 
 InputConvertGame::~InputConvertGame() {}
@@ -82,11 +84,14 @@ void InputConvertGame::keyEvent(const QKeyEvent *from, const QSize &frameSize, c
             if (!m_suspended) {
                 m_suspended = true;
                 qInfo() << "[Keymap] Suspend key HELD — game mode temporarily disabled";
+                // key releases are not routed here while suspended
+                m_macroScheduler->cancelAll();
                 // Release cursor while suspended
                 if (m_keyMap.isValidMouseMoveMap()) {
                     emit grabCursor(false);
                     hideMouseCursor(false);
                     stopMouseMoveTimer();
+                    stopMouseLook();
                     mouseMoveStopTouch();
                 }
             }
@@ -163,6 +168,10 @@ void InputConvertGame::keyEvent(const QKeyEvent *from, const QSize &frameSize, c
             return;
         case KeyMap::KMT_ANDROID_KEY:
             processAndroidKey(node.data.androidKey.keyNode.androidKey, from);
+            return;
+        case KeyMap::KMT_MACRO:
+            processMacro(node, from->key(), QEvent::KeyPress == from->type());
+            return;
         default:
             break;
         }
@@ -184,7 +193,16 @@ bool InputConvertGame::isCurrentCustomKeymap()
 
 void InputConvertGame::loadKeyMap(const QString &json)
 {
+    // running timelines point into the old keymap
+    m_macroScheduler->cancelAll();
     m_keyMap.loadKeyMap(json);
+    if (m_keyMap.isValidMouseMoveMap()) {
+        const KeyMap::KeyMapNode &node = m_keyMap.getMouseMoveMap();
+        m_mouseLook.setSpeedRatio(node.data.mouseMove.speedRatio);
+        m_mouseLook.setSmoothing(node.data.mouseMove.smoothing);
+        m_mouseLook.setAcceleration(node.data.mouseMove.acceleration);
+        m_mouseLook.setTouchRate(static_cast<int>(node.data.mouseMove.touchRate));
+    }
     qInfo() << "[Keymap] InputConvertGame loaded keymap, switchOnKeyboard:"
             << m_keyMap.isSwitchOnKeyboard()
             << "switchKey:" << m_keyMap.getSwitchKey()
@@ -200,6 +218,17 @@ void InputConvertGame::loadKeyMap(const QString &json)
     }
 }
 
+void InputConvertGame::setMaxTouchPoints(int count)
+{
+    m_touchSlots.setCapacity(count);
+    qInfo() << "[Keymap] max touch points:" << m_touchSlots.capacity();
+}
+
+void InputConvertGame::setHostCursorControl(bool enable)
+{
+    m_hostCursorControl = enable;
+}
+
 void InputConvertGame::updateSize(const QSize &frameSize, const QSize &showSize)
 {
     if (showSize != m_showSize) {
@@ -229,7 +258,7 @@ void InputConvertGame::sendTouchUpEvent(int id, QPointF pos)
 
 void InputConvertGame::sendTouchEvent(int id, QPointF pos, AndroidMotioneventAction action)
 {
-    if (0 > id || MULTI_TOUCH_MAX_NUM - 1 < id) {
+    if (0 > id || TOUCH_SLOT_MAX_NUM - 1 < id) {
         Q_ASSERT(0);
         return;
     }
@@ -285,33 +314,65 @@ QPointF InputConvertGame::calcScreenAbsolutePos(QPointF relativePos)
 
 int InputConvertGame::attachTouchID(int key)
 {
-    for (int i = 0; i < MULTI_TOUCH_MAX_NUM; i++) {
-        if (0 == m_multiTouchID[i]) {
-            m_multiTouchID[i] = key;
-            return i;
-        }
+    int id = m_touchSlots.attach(key);
+    if (-1 == id) {
+        qWarning() << "[Keymap] all" << m_touchSlots.capacity() << "touch slots in use, drop key" << key;
     }
-    return -1;
+    return id;
 }
 
 void InputConvertGame::detachTouchID(int key)
 {
-    for (int i = 0; i < MULTI_TOUCH_MAX_NUM; i++) {
-        if (key == m_multiTouchID[i]) {
-            m_multiTouchID[i] = 0;
-            return;
-        }
-    }
+    m_touchSlots.detach(key);
 }
 
 int InputConvertGame::getTouchID(int key)
 {
-    for (int i = 0; i < MULTI_TOUCH_MAX_NUM; i++) {
-        if (key == m_multiTouchID[i]) {
-            return i;
+    return m_touchSlots.get(key);
+}
+
+// -------- macro event --------
+
+void InputConvertGame::processMacro(const KeyMap::KeyMapNode &node, int key, bool press)
+{
+    if (press) {
+        const QVector<KeyMap::MacroEvent> &events = m_keyMap.getMacroEvents();
+        m_macroScheduler->start(
+            key, events.constData() + node.data.macro.firstEvent, node.data.macro.eventCount, node.data.macro.duration, node.data.macro.repeat);
+    } else {
+        m_macroScheduler->release(key, node.data.macro.cancelOnRelease);
+    }
+}
+
+void InputConvertGame::executeMacroEvent(int key, const KeyMap::MacroEvent &event)
+{
+    switch (event.op) {
+    case KeyMap::MO_TOUCH_DOWN: {
+        int id = attachTouchID(key);
+        if (-1 != id) {
+            sendTouchDownEvent(id, event.pos);
+        }
+    } break;
+    case KeyMap::MO_TOUCH_MOVE: {
+        int id = getTouchID(key);
+        if (-1 != id) {
+            sendTouchMoveEvent(id, event.pos);
         }
+    } break;
+    case KeyMap::MO_TOUCH_UP: {
+        int id = getTouchID(key);
+        if (-1 != id) {
+            sendTouchUpEvent(id, event.pos);
+            detachTouchID(key);
+        }
+    } break;
+    case KeyMap::MO_KEY_DOWN:
+        sendKeyEvent(AKEY_EVENT_ACTION_DOWN, event.androidKey);
+        break;
+    case KeyMap::MO_KEY_UP:
+        sendKeyEvent(AKEY_EVENT_ACTION_UP, event.androidKey);
+        break;
     }
-    return -1;
 }
 
 // -------- steer wheel event --------
@@ -598,6 +659,13 @@ bool InputConvertGame::processMouseClick(const QMouseEvent *from)
         return false;
     }
 
+    if (KeyMap::KMT_MACRO == node.type) {
+        if (QEvent::MouseButtonPress == from->type() || QEvent::MouseButtonRelease == from->type()) {
+            processMacro(node, from->button(), QEvent::MouseButtonPress == from->type());
+        }
+        return true;
+    }
+
     if (QEvent::MouseButtonPress == from->type() || QEvent::MouseButtonDblClick == from->type()) {
         int id = attachTouchID(from->button());
         sendTouchDownEvent(id, node.data.click.keyNode.pos);
@@ -618,59 +686,85 @@ bool InputConvertGame::processMouseMove(const QMouseEvent *from)
         return false;
     }
 
-    if (checkCursorPos(from)) {
-        m_ctrlMouseMove.lastPos = QPointF(0.0, 0.0);
-        return true;
-    }
-
     auto lastPos = m_ctrlMouseMove.lastPos;
 #if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
-    m_ctrlMouseMove.lastPos = from->localPos();
+    QPointF pos = from->localPos();
 #else
-    m_ctrlMouseMove.lastPos = from->position();
+    QPointF pos = from->position();
 #endif
+    m_ctrlMouseMove.lastPos = pos;
 
-    if (m_ctrlMouseMove.ignoreCount > 0) {
-        --m_ctrlMouseMove.ignoreCount;
-        return true;
+    // keep the motion that brought the cursor to the border, the warp itself is not motion
+    if (!lastPos.isNull() && m_processMouseMove) {
+        m_mouseLook.addMotion(pos - lastPos, m_showSize);
+        startMouseMoveTimer();
+        if (0 == m_mouseLook.sampleInterval()) {
+            applyMouseLookSample();
+        } else if (0 == m_ctrlMouseMove.sampleTimer) {
+            m_ctrlMouseMove.sampleTimer = startTimer(m_mouseLook.sampleInterval(), Qt::PreciseTimer);
+        }
     }
 
-    if (!lastPos.isNull() && m_processMouseMove) {
-#if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
-        QPointF distance_raw{from->localPos() - lastPos};
-#else
-        QPointF distance_raw{from->position() - lastPos};
-#endif
-        QPointF speedRatio  {m_keyMap.getMouseMoveMap().data.mouseMove.speedRatio};
-        QPointF distance    {distance_raw.x() / speedRatio.x(), distance_raw.y() / speedRatio.y()};
+    if (checkCursorPos(from)) {
+        m_ctrlMouseMove.lastPos = QPointF(0.0, 0.0);
+    }
 
-        mouseMoveStartTouch(from);
-        startMouseMoveTimer();
+    return true;
+}
 
-        m_ctrlMouseMove.lastConverPos.setX(m_ctrlMouseMove.lastConverPos.x() + distance.x() / m_showSize.width());
-        m_ctrlMouseMove.lastConverPos.setY(m_ctrlMouseMove.lastConverPos.y() + distance.y() / m_showSize.height());
+void InputConvertGame::applyMouseLookSample()
+{
+    if (m_ctrlMouseMove.recentering) {
+        // lifted on the previous sample, press again at the start pos and carry on from there
+        m_ctrlMouseMove.recentering = false;
+        mouseMoveStartTouch(nullptr);
+        startMouseMoveTimer();
+        return;
+    }
 
-        if (m_ctrlMouseMove.lastConverPos.x() < 0.05 || m_ctrlMouseMove.lastConverPos.x() > 0.95 || m_ctrlMouseMove.lastConverPos.y() < 0.05
-            || m_ctrlMouseMove.lastConverPos.y() > 0.95) {
-            if (m_ctrlMouseMove.smallEyes) {
-                m_processMouseMove = false;
-                int delay = 30;
-                QTimer::singleShot(delay, this, [this]() { mouseMoveStopTouch(); });
-                QTimer::singleShot(delay * 2, this, [this]() {
-                    mouseMoveStartTouch(nullptr);
-                    m_processMouseMove = true;
-                });
-            } else {
-                mouseMoveStopTouch();
-                m_ctrlMouseMove.ignoreCount = 5;
-                return true;
-            }
+    if (!m_mouseLook.hasPending()) {
+        if (m_ctrlMouseMove.sampleTimer) {
+            killTimer(m_ctrlMouseMove.sampleTimer);
+            m_ctrlMouseMove.sampleTimer = 0;
+        }
+        // drained: the idle timer lifts the finger, it must not stay down without one
+        if (m_ctrlMouseMove.touching && 0 == m_ctrlMouseMove.timer) {
+            startMouseMoveTimer();
         }
+        return;
+    }
 
-        sendTouchMoveEvent(getTouchID(Qt::ExtraButton24), m_ctrlMouseMove.lastConverPos);
+    mouseMoveStartTouch(nullptr);
+
+    QPointF sample = m_mouseLook.takeSample();
+    QPointF target = m_ctrlMouseMove.lastConverPos + sample;
+    if (target.x() < 0.05 || target.x() > 0.95 || target.y() < 0.05 || target.y() > 0.95) {
+        if (!m_ctrlMouseMove.freshTouch) {
+            m_mouseLook.giveBack(sample);
+            mouseMoveStopTouch();
+            m_ctrlMouseMove.recentering = true;
+            return;
+        }
+        // a single sample wider than the usable area, nothing left to do but clamp
+        target.setX(qBound(0.05, target.x(), 0.95));
+        target.setY(qBound(0.05, target.y(), 0.95));
     }
 
-    return true;
+    m_ctrlMouseMove.lastConverPos = target;
+    m_ctrlMouseMove.freshTouch = false;
+    sendTouchMoveEvent(getTouchID(Qt::ExtraButton24), m_ctrlMouseMove.lastConverPos);
+    // idle counts from the last applied sample: a smoothed drain can outlast the mouse by far
+    startMouseMoveTimer();
+}
+
+void InputConvertGame::stopMouseLook()
+{
+    if (m_ctrlMouseMove.sampleTimer) {
+        killTimer(m_ctrlMouseMove.sampleTimer);
+        m_ctrlMouseMove.sampleTimer = 0;
+    }
+    m_ctrlMouseMove.recentering = false;
+    m_mouseLook.reset();
 }
 
 bool InputConvertGame::checkCursorPos(const QMouseEvent *from)
@@ -700,6 +794,9 @@ bool InputConvertGame::checkCursorPos(const QMouseEvent *from)
 
 void InputConvertGame::moveCursorTo(const QMouseEvent *from, const QPoint &localPosPixel)
 {
+    if (!m_hostCursorControl) {
+        return;
+    }
 #if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
     QPoint posOffset = from->pos() - localPosPixel;
     QPoint globalPos = from->globalPos();
@@ -722,6 +819,7 @@ void InputConvertGame::mouseMoveStartTouch(const QMouseEvent *from)
         sendTouchDownEvent(id, mouseMoveStartPos);
         m_ctrlMouseMove.lastConverPos = mouseMoveStartPos;
         m_ctrlMouseMove.touching = true;
+        m_ctrlMouseMove.freshTouch = true;
     }
 }
 
@@ -770,7 +868,13 @@ bool InputConvertGame::switchGameMap()
         emit grabCursor(false);
         hideMouseCursor(false);
         stopMouseMoveTimer();
+        stopMouseLook();
         mouseMoveStopTouch();
+        m_macroScheduler->cancelAll();
+        // every finger should be up by now, anything left is a leaked slot
+        if (m_touchSlots.activeCount()) {
+            qWarning() << "[Keymap]" << m_touchSlots.activeCount() << "touch slots still held after leaving game mode";
+        }
     }
 
     return m_gameMap;
@@ -778,6 +882,9 @@ bool InputConvertGame::switchGameMap()
 
 void InputConvertGame::hideMouseCursor(bool hide)
 {
+    if (!m_hostCursorControl) {
+        return;
+    }
     if (hide) {
 #ifdef QT_NO_DEBUG
         QGuiApplication::setOverrideCursor(QCursor(Qt::BlankCursor));
@@ -793,6 +900,12 @@ void InputConvertGame::timerEvent(QTimerEvent *event)
 {
     if (m_ctrlMouseMove.timer == event->timerId()) {
         stopMouseMoveTimer();
+        if (m_mouseLook.hasPending() && m_ctrlMouseMove.sampleTimer) {
+            // still draining, the next sample restarts the idle timer
+            return;
+        }
         mouseMoveStopTouch();
+    } else if (m_ctrlMouseMove.sampleTimer == event->timerId()) {
+        applyMouseLookSample();
     }
 }
@@ -6,8 +6,10 @@
 
 #include "inputconvertnormal.h"
 #include "keymap.h"
+#include "macroscheduler.h"
+#include "mouselook.h"
+#include "touchslotallocator.h"
 
-#define MULTI_TOUCH_MAX_NUM 10
 class InputConvertGame : public InputConvertNormal
 {
     Q_OBJECT
@@ -21,6 +23,9 @@ public:
     virtual bool isCurrentCustomKeymap();
 
     void loadKeyMap(const QString &json);
+    // number of simultaneous pointers the device accepts
+    void setMaxTouchPoints(int count);
+    void setHostCursorControl(bool enable);
 
 protected:
     void updateSize(const QSize &frameSize, const QSize &showSize);
@@ -52,6 +57,10 @@ protected:
     // android key
     void processAndroidKey(AndroidKeycode androidKey, const QKeyEvent *from);
 
+    // macro
+    void processMacro(const KeyMap::KeyMapNode &node, int key, bool press);
+    void executeMacroEvent(int key, const KeyMap::MacroEvent &event);
+
     // mouse
     bool processMouseClick(const QMouseEvent *from);
     bool processMouseMove(const QMouseEvent *from);
@@ -60,6 +69,8 @@ protected:
     void mouseMoveStopTouch();
     void startMouseMoveTimer();
     void stopMouseMoveTimer();
+    void applyMouseLookSample();
+    void stopMouseLook();
 
     bool switchGameMap();
     bool checkCursorPos(const QMouseEvent *from);
@@ -83,7 +94,8 @@ private:
     bool m_gameMap = false;
     bool m_suspended = false;  // true while suspend key (X) is held — temporarily disables game mode
     bool m_needBackMouseMove = false;
-    int m_multiTouchID[MULTI_TOUCH_MAX_NUM] = { 0 };
+    bool m_hostCursorControl = true;
+    TouchSlotAllocator m_touchSlots;
     KeyMap m_keyMap;
 
     bool m_processMouseMove = true;
@@ -116,8 +128,15 @@ private:
         bool touching = false;
         int timer = 0;
         bool smallEyes = false;
-        int ignoreCount = 0;
+        // touch sample timer, runs while motion is pending
+        int sampleTimer = 0;
+        // finger was lifted at the border, goes back down on the next sample
+        bool recentering = false;
+        bool freshTouch = false;
     } m_ctrlMouseMove;
+    MouseLook m_mouseLook;
+
+    QPointer<MacroScheduler> m_macroScheduler;
 
     // for drag delay
     struct {
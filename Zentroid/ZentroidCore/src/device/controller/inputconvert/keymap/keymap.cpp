@@ -7,6 +7,7 @@
 #include <QMetaEnum>
 
 #include "keymap.h"
+#include "keymapcache.h"
 
 KeyMap::KeyMap(QObject *parent) : QObject(parent) {}
 
@@ -16,11 +17,20 @@ void KeyMap::loadKeyMap(const QString &json)
 {
     // Clear previous state so hot-reloads don't accumulate duplicate nodes
     m_keyMapNodes.clear();
+    m_macroEvents.clear();
     m_idxMouseMove = -1;
     m_idxSteerWheel = -1;
     m_rmapKey.clear();
     m_rmapMouse.clear();
 
+    // compiled cache hit: skip json parsing and validation entirely
+    QByteArray sourceHash = KeyMapCache::sourceHash(json);
+    if (loadKeyMapCache(sourceHash)) {
+        makeReverseMap();
+        qInfo() << "[Keymap] Loaded compiled keymap from cache," << m_keyMapNodes.size() << "nodes";
+        return;
+    }
+
     QString errorString;
     QJsonParseError jsonError;
     QJsonDocument jsonDoc;
@@ -139,6 +149,21 @@ void KeyMap::loadKeyMap(const QString &json)
             goto parseError;
         }
 
+        // aim smoothing / acceleration / resampling (optional)
+        if (checkItemDouble(mouseMoveMap, "smoothing")) {
+            keyMapNode.data.mouseMove.smoothing = static_cast<float>(getItemDouble(mouseMoveMap, "smoothing"));
+        }
+        if (checkItemDouble(mouseMoveMap, "acceleration")) {
+            keyMapNode.data.mouseMove.acceleration = static_cast<float>(getItemDouble(mouseMoveMap, "acceleration"));
+        }
+        if (checkItemDouble(mouseMoveMap, "touchRate")) {
+            keyMapNode.data.mouseMove.touchRate = static_cast<quint32>(qMax(0.0, getItemDouble(mouseMoveMap, "touchRate")));
+        }
+        if (keyMapNode.data.mouseMove.smoothing < 0.0f || keyMapNode.data.mouseMove.smoothing > 0.95f) {
+            errorString = QString("json error: mouseMoveMap smoothing must be between 0 and 0.95");
+            goto parseError;
+        }
+
         if (!checkItemObject(mouseMoveMap, "startPos")) {
             errorString = QString("json error: mouseMoveMap on find startPos");
             goto parseError;
@@ -364,6 +389,29 @@ void KeyMap::loadKeyMap(const QString &json)
                 keyMapNode.data.androidKey.keyNode.androidKey = static_cast<AndroidKeycode>(getItemDouble(node, "androidKey"));
                 m_keyMapNodes.push_back(keyMapNode);
             } break;
+            case KeyMap::KMT_MACRO: {
+                // safe check
+                if (!checkForMacro(node)) {
+                    qWarning() << "json error: keyMapNodes node format error";
+                    break;
+                }
+
+                QPair<ActionType, int> key = getItemKey(node, "key");
+                if (key.first == AT_INVALID) {
+                    qWarning() << "json error: keyMapNodes node invalid key: " << node.value("key").toString();
+                    break;
+                }
+                KeyMapNode keyMapNode;
+                keyMapNode.type = type;
+                keyMapNode.data.macro.keyNode.type = key.first;
+                keyMapNode.data.macro.keyNode.key = key.second;
+                keyMapNode.data.macro.repeat = getItemBool(node, "repeat");
+                keyMapNode.data.macro.cancelOnRelease = getItemBool(node, "cancelOnRelease");
+                if (!compileMacro(node.value("steps").toArray(), keyMapNode)) {
+                    break;
+                }
+                m_keyMapNodes.push_back(keyMapNode);
+            } break;
             default:
                 qWarning() << "json error: keyMapNodes invalid node type:" << node.value("type").toString();
                 break;
@@ -372,6 +420,7 @@ void KeyMap::loadKeyMap(const QString &json)
     }
     // this must be called after m_keyMapNodes is stable
     makeReverseMap();
+    storeKeyMapCache(sourceHash);
     qInfo() << "Script updated, current keymap mode:normal, Press ~ key to switch keymap mode";
 
 parseError:
@@ -430,6 +479,11 @@ const KeyMap::KeyMapNode &KeyMap::getMouseMoveMap()
     return m_keyMapNodes[m_idxMouseMove];
 }
 
+const QVector<KeyMap::MacroEvent> &KeyMap::getMacroEvents()
+{
+    return m_macroEvents;
+}
+
 bool KeyMap::isValidMouseMoveMap()
 {
     return m_idxMouseMove != -1;
@@ -440,6 +494,40 @@ bool KeyMap::isValidSteerWheelMap()
     return m_idxSteerWheel != -1;
 }
 
+bool KeyMap::loadKeyMapCache(const QByteArray &sourceHash)
+{
+    KeyMapCache::Image image;
+    if (!KeyMapCache::load(sourceHash, image)) {
+        return false;
+    }
+
+    m_keyMapNodes = image.nodes;
+    m_macroEvents = image.macroEvents;
+    m_switchKey = image.switchKey;
+    m_switchModifiers = image.switchModifiers;
+    m_suspendKey = image.suspendKey;
+    m_idxSteerWheel = image.idxSteerWheel;
+    m_idxMouseMove = image.idxMouseMove;
+    return true;
+}
+
+void KeyMap::storeKeyMapCache(const QByteArray &sourceHash)
+{
+    if (!KeyMapCache::isEnabled()) {
+        return;
+    }
+
+    KeyMapCache::Image image;
+    image.nodes = m_keyMapNodes;
+    image.macroEvents = m_macroEvents;
+    image.switchKey = m_switchKey;
+    image.switchModifiers = m_switchModifiers;
+    image.suspendKey = m_suspendKey;
+    image.idxSteerWheel = m_idxSteerWheel;
+    image.idxMouseMove = m_idxMouseMove;
+    KeyMapCache::store(sourceHash, image);
+}
+
 void KeyMap::makeReverseMap()
 {
     m_rmapKey.clear();
@@ -477,6 +565,10 @@ void KeyMap::makeReverseMap()
             QMultiHash<int, KeyMapNode *> &m = node.data.androidKey.keyNode.type == AT_KEY ? m_rmapKey : m_rmapMouse;
             m.insert(node.data.androidKey.keyNode.key, &node);
         } break;
+        case KMT_MACRO: {
+            QMultiHash<int, KeyMapNode *> &m = node.data.macro.keyNode.type == AT_KEY ? m_rmapKey : m_rmapMouse;
+            m.insert(node.data.macro.keyNode.key, &node);
+        } break;
         default:
             break;
         }
@@ -612,6 +704,111 @@ bool KeyMap::checkForAndroidKey(const QJsonObject &node)
     return checkItemString(node, "key") && checkItemDouble(node, "androidKey");
 }
 
+bool KeyMap::checkForMacro(const QJsonObject &node)
+{
+    if (!checkItemString(node, "key")) {
+        return false;
+    }
+    if (!node.contains("steps") || !node.value("steps").isArray() || node.value("steps").toArray().isEmpty()) {
+        qWarning("json error: no find steps");
+        return false;
+    }
+    return true;
+}
+
+bool KeyMap::compileMacro(const QJsonArray &steps, KeyMapNode &keyMapNode)
+{
+    // swipes are precomputed as moves at this interval
+    const quint32 swipeStep = 10;
+
+    QVector<MacroEvent> events;
+    quint32 time = 0;
+    for (int i = 0; i < steps.size(); i++) {
+        if (!steps.at(i).isObject()) {
+            qWarning("json error: macro step must be json object");
+            return false;
+        }
+        QJsonObject step = steps.at(i).toObject();
+        QString action = getItemString(step, "action");
+        double duration = checkItemDouble(step, "duration") ? getItemDouble(step, "duration") : -1.0;
+        MacroEvent event;
+
+        if ("tap" == action || "hold" == action) {
+            if (!checkItemPos(step, "pos")) {
+                return false;
+            }
+            quint32 length = duration < 0 ? ("tap" == action ? 20 : 500) : static_cast<quint32>(duration);
+            event.pos = getItemPos(step, "pos");
+            event.time = time;
+            event.op = MO_TOUCH_DOWN;
+            events.push_back(event);
+            time += length;
+            event.time = time;
+            event.op = MO_TOUCH_UP;
+            events.push_back(event);
+        } else if ("swipe" == action) {
+            if (!checkItemPos(step, "pos") || !checkItemPos(step, "endPos")) {
+                return false;
+            }
+            quint32 length = duration < 0 ? 200 : static_cast<quint32>(duration);
+            QPointF startPos = getItemPos(step, "pos");
+            QPointF endPos = getItemPos(step, "endPos");
+            event.pos = startPos;
+            event.time = time;
+            event.op = MO_TOUCH_DOWN;
+            events.push_back(event);
+            event.op = MO_TOUCH_MOVE;
+            for (quint32 t = swipeStep; t < length; t += swipeStep) {
+                event.time = time + t;
+                event.pos = startPos + (endPos - startPos) * (static_cast<double>(t) / length);
+                events.push_back(event);
+            }
+            time += length;
+            event.time = time;
+            event.pos = endPos;
+            events.push_back(event);
+            event.op = MO_TOUCH_UP;
+            events.push_back(event);
+        } else if ("wait" == action) {
+            if (duration < 0) {
+                qWarning("json error: macro wait needs duration");
+                return false;
+            }
+            time += static_cast<quint32>(duration);
+        } else if ("key" == action) {
+            if (!checkItemDouble(step, "androidKey")) {
+                return false;
+            }
+            event.androidKey = static_cast<AndroidKeycode>(getItemDouble(step, "androidKey"));
+            event.time = time;
+            event.op = MO_KEY_DOWN;
+            events.push_back(event);
+            time += duration < 0 ? 20 : static_cast<quint32>(duration);
+            event.time = time;
+            event.op = MO_KEY_UP;
+            events.push_back(event);
+        } else {
+            qWarning() << "json error: invalid macro action:" << action;
+            return false;
+        }
+    }
+
+    if (events.size() + m_macroEvents.size() > MAX_MACRO_EVENTS) {
+        qWarning() << "json error: macros too long, up to" << MAX_MACRO_EVENTS << "events in total";
+        return false;
+    }
+    if (keyMapNode.data.macro.repeat && 0 == time) {
+        qWarning("json error: repeating macro needs a non-zero duration");
+        return false;
+    }
+
+    keyMapNode.data.macro.firstEvent = m_macroEvents.size();
+    keyMapNode.data.macro.eventCount = events.size();
+    keyMapNode.data.macro.duration = time;
+    m_macroEvents += events;
+    return true;
+}
+
 bool KeyMap::checkForSteerWhell(const QJsonObject &node)
 {
     return checkItemString(node, "leftKey") && checkItemString(node, "rightKey") && checkItemString(node, "upKey") && checkItemString(node, "downKey")
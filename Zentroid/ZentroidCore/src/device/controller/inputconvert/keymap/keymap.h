@@ -1,5 +1,6 @@
 #ifndef KEYMAP_H
 #define KEYMAP_H
+#include <QJsonArray>
 #include <QJsonObject>
 #include <QMetaEnum>
 #include <QMultiHash>
@@ -12,6 +13,7 @@
 #include "keycodes.h"
 
 #define MAX_DELAY_CLICK_NODES 50
+#define MAX_MACRO_EVENTS 4096
 
 class KeyMap : public QObject
 {
@@ -26,7 +28,8 @@ public:
         KMT_STEER_WHEEL,
         KMT_DRAG,
         KMT_MOUSE_MOVE,
-        KMT_ANDROID_KEY
+        KMT_ANDROID_KEY,
+        KMT_MACRO
     };
     Q_ENUM(KeyMapType)
 
@@ -44,6 +47,24 @@ public:
         QPointF pos = QPointF(0, 0);
     };
 
+    // one entry of a compiled macro timeline, time is relative to the macro start
+    enum MacroOp
+    {
+        MO_TOUCH_DOWN = 0,
+        MO_TOUCH_MOVE,
+        MO_TOUCH_UP,
+        MO_KEY_DOWN,
+        MO_KEY_UP
+    };
+
+    struct MacroEvent
+    {
+        quint32 time = 0;
+        MacroOp op = MO_TOUCH_DOWN;
+        QPointF pos = QPointF(0, 0);
+        AndroidKeycode androidKey = AKEYCODE_UNKNOWN;
+    };
+
     struct KeyNode
     {
         ActionType type = AT_INVALID;
@@ -100,12 +121,24 @@ public:
             {
                 QPointF startPos   = { 0.0, 0.0 };
                 QPointF speedRatio = { 1.0, 1.0 };
+                float smoothing    = 0.0f; // 0-0.95, share of motion deferred to later touch samples
+                float acceleration = 0.0f; // extra gain per px/ms of mouse speed
+                quint32 touchRate  = 120;  // touch moves per second, 0 = one per mouse event
                 KeyNode smallEyes;
             } mouseMove;
             struct
             {
                 KeyNode keyNode;
             } androidKey;
+            struct
+            {
+                KeyNode keyNode;
+                int firstEvent = 0;      // index into getMacroEvents()
+                int eventCount = 0;
+                quint32 duration = 0;    // length of one pass, ms
+                bool repeat = false;     // loop while the key is held
+                bool cancelOnRelease = false;
+            } macro;
             DATA() {}
             ~DATA() {}
         } data;
@@ -130,11 +163,16 @@ public:
     bool isValidMouseMoveMap();
     bool isValidSteerWheelMap();
     const KeyMap::KeyMapNode &getMouseMoveMap();
+    const QVector<MacroEvent> &getMacroEvents();
 
 private:
     // set up the reverse map from key/event event to keyMapNode
     void makeReverseMap();
 
+    // compiled binary cache, keyed by the hash of the json source
+    bool loadKeyMapCache(const QByteArray &sourceHash);
+    void storeKeyMapCache(const QByteArray &sourceHash);
+
     // safe check for base
     bool checkItemString(const QJsonObject &node, const QString &name);
     bool checkItemDouble(const QJsonObject &node, const QString &name);
@@ -150,6 +188,10 @@ private:
     bool checkForSteerWhell(const QJsonObject &node);
     bool checkForDrag(const QJsonObject &node);
     bool checkForAndroidKey(const QJsonObject &node);
+    bool checkForMacro(const QJsonObject &node);
+
+    // turn macro steps into timeline entries appended to m_macroEvents
+    bool compileMacro(const QJsonArray &steps, KeyMapNode &keyMapNode);
 
     // get keymap from json object
     QString getItemString(const QJsonObject &node, const QString &name);
@@ -164,6 +206,8 @@ private:
     static QString s_keyMapPath;
 
     QVector<KeyMapNode> m_keyMapNodes;
+    // timelines of all KMT_MACRO nodes, back to back
+    QVector<MacroEvent> m_macroEvents;
     KeyNode m_switchKey = { AT_KEY, Qt::Key_QuoteLeft };
     Qt::KeyboardModifiers m_switchModifiers = Qt::NoModifier;
     KeyNode m_suspendKey = { AT_INVALID, -1 }; // hold-to-disable key (e.g. Key_X)
@@ -0,0 +1,435 @@
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include "keymapcache.h"
+
+// bump when the record layout or the meaning of a field changes
+#define KEYMAP_CACHE_VERSION 3
+#define KEYMAP_CACHE_MAGIC "ZKMC"
+#define KEYMAP_CACHE_SUFFIX ".kmc"
+#define KEYMAP_CACHE_MAX_FILES 64
+#define KEYMAP_CACHE_HASH_SIZE 20
+
+namespace {
+
+// all records are naturally aligned and only hold fixed-width fields, the file
+// is only ever read back by the build that wrote it (see the headerSize/nodeSize checks)
+struct CacheHeader
+{
+    char magic[4];
+    quint32 version;
+    quint32 headerSize;
+    quint32 nodeSize;
+    quint32 nodeCount;
+    quint32 delayClickCount;
+    quint8 sourceHash[KEYMAP_CACHE_HASH_SIZE];
+    qint32 switchKeyType;
+    qint32 switchKey;
+    quint32 switchModifiers;
+    qint32 suspendKeyType;
+    qint32 suspendKey;
+    qint32 idxSteerWheel;
+    qint32 idxMouseMove;
+    quint32 macroEventCount;
+    quint32 reserved;
+};
+
+struct CacheKeyNode
+{
+    qint32 type;
+    qint32 key;
+    double pos[2];
+    double extendPos[2];
+    double extendOffset;
+    qint32 androidKey;
+    qint32 delayClickOffset;
+    qint32 delayClickCount;
+    qint32 reserved;
+};
+
+struct CacheDelayClick
+{
+    qint32 delay;
+    qint32 reserved;
+    double pos[2];
+};
+
+struct CacheMacroEvent
+{
+    quint32 time;
+    qint32 op;
+    double pos[2];
+    qint32 androidKey;
+    qint32 reserved;
+};
+
+struct CacheNode
+{
+    qint32 type;
+    quint32 switchMap;
+    quint32 startDelay;
+    float dragSpeed;
+    float smoothing;    // mouseMove
+    float acceleration; // mouseMove
+    quint32 touchRate;  // mouseMove
+    quint32 macroRepeat;
+    qint32 macroFirstEvent;
+    qint32 macroEventCount;
+    quint32 macroDuration;
+    quint32 macroCancelOnRelease;
+    double centerPos[2];  // steerWheel.centerPos / mouseMove.startPos
+    double speedRatio[2]; // mouseMove.speedRatio
+    CacheKeyNode keys[4]; // steerWheel: left right up down, others: keys[0]
+};
+
+Q_STATIC_ASSERT(sizeof(CacheHeader) == 80);
+Q_STATIC_ASSERT(sizeof(CacheKeyNode) == 64);
+Q_STATIC_ASSERT(sizeof(CacheDelayClick) == 24);
+Q_STATIC_ASSERT(sizeof(CacheNode) == 336);
+Q_STATIC_ASSERT(sizeof(CacheMacroEvent) == 32);
+
+void packKeyNode(const KeyMap::KeyNode &node, CacheKeyNode &out, QVector<CacheDelayClick> &delayClicks)
+{
+    memset(&out, 0, sizeof(out));
+    out.type = node.type;
+    out.key = node.key;
+    out.pos[0] = node.pos.x();
+    out.pos[1] = node.pos.y();
+    out.extendPos[0] = node.extendPos.x();
+    out.extendPos[1] = node.extendPos.y();
+    out.extendOffset = node.extendOffset;
+    out.androidKey = node.androidKey;
+    out.delayClickOffset = delayClicks.size();
+    out.delayClickCount = node.delayClickNodesCount;
+    for (int i = 0; i < node.delayClickNodesCount; i++) {
+        CacheDelayClick click;
+        memset(&click, 0, sizeof(click));
+        click.delay = node.delayClickNodes[i].delay;
+        click.pos[0] = node.delayClickNodes[i].pos.x();
+        click.pos[1] = node.delayClickNodes[i].pos.y();
+        delayClicks.push_back(click);
+    }
+}
+
+bool unpackKeyNode(const CacheKeyNode &in, const CacheDelayClick *delayClicks, quint32 delayClickCount, KeyMap::KeyNode &node)
+{
+    if (in.delayClickCount < 0 || in.delayClickCount > MAX_DELAY_CLICK_NODES || in.delayClickOffset < 0
+        || static_cast<quint32>(in.delayClickOffset) + static_cast<quint32>(in.delayClickCount) > delayClickCount) {
+        return false;
+    }
+    node.type = static_cast<KeyMap::ActionType>(in.type);
+    node.key = in.key;
+    node.pos = QPointF(in.pos[0], in.pos[1]);
+    node.extendPos = QPointF(in.extendPos[0], in.extendPos[1]);
+    node.extendOffset = in.extendOffset;
+    node.androidKey = static_cast<AndroidKeycode>(in.androidKey);
+    node.delayClickNodesCount = in.delayClickCount;
+    for (int i = 0; i < in.delayClickCount; i++) {
+        const CacheDelayClick &click = delayClicks[in.delayClickOffset + i];
+        node.delayClickNodes[i].delay = click.delay;
+        node.delayClickNodes[i].pos = QPointF(click.pos[0], click.pos[1]);
+    }
+    return true;
+}
+
+void packNode(const KeyMap::KeyMapNode &node, CacheNode &out, QVector<CacheDelayClick> &delayClicks)
+{
+    memset(&out, 0, sizeof(out));
+    out.type = node.type;
+    out.dragSpeed = 1.0f;
+    switch (node.type) {
+    case KeyMap::KMT_CLICK:
+        packKeyNode(node.data.click.keyNode, out.keys[0], delayClicks);
+        out.switchMap = node.data.click.switchMap ? 1 : 0;
+        break;
+    case KeyMap::KMT_CLICK_TWICE:
+        packKeyNode(node.data.clickTwice.keyNode, out.keys[0], delayClicks);
+        break;
+    case KeyMap::KMT_CLICK_MULTI:
+        packKeyNode(node.data.clickMulti.keyNode, out.keys[0], delayClicks);
+        break;
+    case KeyMap::KMT_STEER_WHEEL:
+        out.centerPos[0] = node.data.steerWheel.centerPos.x();
+        out.centerPos[1] = node.data.steerWheel.centerPos.y();
+        packKeyNode(node.data.steerWheel.left, out.keys[0], delayClicks);
+        packKeyNode(node.data.steerWheel.right, out.keys[1], delayClicks);
+        packKeyNode(node.data.steerWheel.up, out.keys[2], delayClicks);
+        packKeyNode(node.data.steerWheel.down, out.keys[3], delayClicks);
+        break;
+    case KeyMap::KMT_DRAG:
+        packKeyNode(node.data.drag.keyNode, out.keys[0], delayClicks);
+        out.startDelay = node.data.drag.startDelay;
+        out.dragSpeed = node.data.drag.dragSpeed;
+        break;
+    case KeyMap::KMT_MOUSE_MOVE:
+        out.centerPos[0] = node.data.mouseMove.startPos.x();
+        out.centerPos[1] = node.data.mouseMove.startPos.y();
+        out.speedRatio[0] = node.data.mouseMove.speedRatio.x();
+        out.speedRatio[1] = node.data.mouseMove.speedRatio.y();
+        out.smoothing = node.data.mouseMove.smoothing;
+        out.acceleration = node.data.mouseMove.acceleration;
+        out.touchRate = node.data.mouseMove.touchRate;
+        packKeyNode(node.data.mouseMove.smallEyes, out.keys[0], delayClicks);
+        break;
+    case KeyMap::KMT_ANDROID_KEY:
+        packKeyNode(node.data.androidKey.keyNode, out.keys[0], delayClicks);
+        break;
+    case KeyMap::KMT_MACRO:
+        packKeyNode(node.data.macro.keyNode, out.keys[0], delayClicks);
+        out.macroRepeat = node.data.macro.repeat ? 1 : 0;
+        out.macroCancelOnRelease = node.data.macro.cancelOnRelease ? 1 : 0;
+        out.macroFirstEvent = node.data.macro.firstEvent;
+        out.macroEventCount = node.data.macro.eventCount;
+        out.macroDuration = node.data.macro.duration;
+        break;
+    default:
+        break;
+    }
+}
+
+bool unpackNode(const CacheNode &in, const CacheDelayClick *delayClicks, quint32 delayClickCount, KeyMap::KeyMapNode &node)
+{
+    node.type = static_cast<KeyMap::KeyMapType>(in.type);
+    switch (node.type) {
+    case KeyMap::KMT_CLICK:
+        node.data.click.switchMap = in.switchMap != 0;
+        return unpackKeyNode(in.keys[0], delayClicks, delayClickCount, node.data.click.keyNode);
+    case KeyMap::KMT_CLICK_TWICE:
+        return unpackKeyNode(in.keys[0], delayClicks, delayClickCount, node.data.clickTwice.keyNode);
+    case KeyMap::KMT_CLICK_MULTI:
+        return unpackKeyNode(in.keys[0], delayClicks, delayClickCount, node.data.clickMulti.keyNode);
+    case KeyMap::KMT_STEER_WHEEL:
+        node.data.steerWheel.centerPos = QPointF(in.centerPos[0], in.centerPos[1]);
+        return unpackKeyNode(in.keys[0], delayClicks, delayClickCount, node.data.steerWheel.left)
+               && unpackKeyNode(in.keys[1], delayClicks, delayClickCount, node.data.steerWheel.right)
+               && unpackKeyNode(in.keys[2], delayClicks, delayClickCount, node.data.steerWheel.up)
+               && unpackKeyNode(in.keys[3], delayClicks, delayClickCount, node.data.steerWheel.down);
+    case KeyMap::KMT_DRAG:
+        node.data.drag.startDelay = in.startDelay;
+        node.data.drag.dragSpeed = in.dragSpeed;
+        return unpackKeyNode(in.keys[0], delayClicks, delayClickCount, node.data.drag.keyNode);
+    case KeyMap::KMT_MOUSE_MOVE:
+        node.data.mouseMove.startPos = QPointF(in.centerPos[0], in.centerPos[1]);
+        node.data.mouseMove.speedRatio = QPointF(in.speedRatio[0], in.speedRatio[1]);
+        node.data.mouseMove.smoothing = in.smoothing;
+        node.data.mouseMove.acceleration = in.acceleration;
+        node.data.mouseMove.touchRate = in.touchRate;
+        return unpackKeyNode(in.keys[0], delayClicks, delayClickCount, node.data.mouseMove.smallEyes);
+    case KeyMap::KMT_ANDROID_KEY:
+        return unpackKeyNode(in.keys[0], delayClicks, delayClickCount, node.data.androidKey.keyNode);
+    case KeyMap::KMT_MACRO:
+        node.data.macro.repeat = in.macroRepeat != 0;
+        node.data.macro.cancelOnRelease = in.macroCancelOnRelease != 0;
+        node.data.macro.firstEvent = in.macroFirstEvent;
+        node.data.macro.eventCount = in.macroEventCount;
+        node.data.macro.duration = in.macroDuration;
+        return unpackKeyNode(in.keys[0], delayClicks, delayClickCount, node.data.macro.keyNode);
+    default:
+        return false;
+    }
+}
+
+// -1: no such node
+bool validNodeIndex(qint32 idx, quint32 nodeCount)
+{
+    return -1 <= idx && static_cast<qint64>(idx) < static_cast<qint64>(nodeCount);
+}
+
+} // namespace
+
+QString KeyMapCache::s_cacheDir = "";
+
+void KeyMapCache::setCacheDir(const QString &dir)
+{
+    s_cacheDir = dir;
+    if (s_cacheDir.isEmpty()) {
+        return;
+    }
+    QDir cacheDir(s_cacheDir);
+    if (!cacheDir.exists() && !cacheDir.mkpath(".")) {
+        qWarning() << "[Keymap] Could not create keymap cache dir:" << s_cacheDir;
+        s_cacheDir = "";
+    }
+}
+
+const QString &KeyMapCache::getCacheDir()
+{
+    return s_cacheDir;
+}
+
+bool KeyMapCache::isEnabled()
+{
+    return !s_cacheDir.isEmpty();
+}
+
+QByteArray KeyMapCache::sourceHash(const QString &json)
+{
+    return QCryptographicHash::hash(json.toUtf8(), QCryptographicHash::Sha1);
+}
+
+QString KeyMapCache::cacheFilePath(const QByteArray &hash)
+{
+    return QDir(s_cacheDir).absoluteFilePath(QString::fromLatin1(hash.toHex()) + KEYMAP_CACHE_SUFFIX);
+}
+
+bool KeyMapCache::load(const QByteArray &hash, Image &image)
+{
+    if (!isEnabled() || KEYMAP_CACHE_HASH_SIZE != hash.size()) {
+        return false;
+    }
+
+    QFile file(cacheFilePath(hash));
+    if (!file.exists() || !file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+    const qint64 fileSize = file.size();
+    if (fileSize < static_cast<qint64>(sizeof(CacheHeader))) {
+        return false;
+    }
+    uchar *data = file.map(0, fileSize);
+    if (!data) {
+        return false;
+    }
+
+    bool ok = false;
+    const CacheHeader *header = reinterpret_cast<const CacheHeader *>(data);
+    const qint64 expectSize = static_cast<qint64>(sizeof(CacheHeader)) + static_cast<qint64>(header->nodeCount) * sizeof(CacheNode)
+                              + static_cast<qint64>(header->delayClickCount) * sizeof(CacheDelayClick)
+                              + static_cast<qint64>(header->macroEventCount) * sizeof(CacheMacroEvent);
+    if (0 == memcmp(header->magic, KEYMAP_CACHE_MAGIC, 4) && KEYMAP_CACHE_VERSION == header->version && sizeof(CacheHeader) == header->headerSize
+        && sizeof(CacheNode) == header->nodeSize && expectSize == fileSize && 0 == memcmp(header->sourceHash, hash.constData(), KEYMAP_CACHE_HASH_SIZE)
+        && validNodeIndex(header->idxMouseMove, header->nodeCount) && validNodeIndex(header->idxSteerWheel, header->nodeCount)) {
+        const CacheNode *nodes = reinterpret_cast<const CacheNode *>(data + sizeof(CacheHeader));
+        const CacheDelayClick *delayClicks = reinterpret_cast<const CacheDelayClick *>(data + sizeof(CacheHeader) + header->nodeCount * sizeof(CacheNode));
+        const CacheMacroEvent *macroEvents = reinterpret_cast<const CacheMacroEvent *>(
+            data + sizeof(CacheHeader) + header->nodeCount * sizeof(CacheNode) + header->delayClickCount * sizeof(CacheDelayClick));
+
+        image.nodes.clear();
+        image.nodes.resize(static_cast<int>(header->nodeCount));
+        ok = true;
+        for (quint32 i = 0; i < header->nodeCount; i++) {
+            KeyMap::KeyMapNode &node = image.nodes[static_cast<int>(i)];
+            if (!unpackNode(nodes[i], delayClicks, header->delayClickCount, node)
+                || (KeyMap::KMT_MACRO == node.type
+                    && (node.data.macro.firstEvent < 0 || node.data.macro.eventCount < 0
+                        || static_cast<quint32>(node.data.macro.firstEvent) + static_cast<quint32>(node.data.macro.eventCount) > header->macroEventCount))) {
+                ok = false;
+                break;
+            }
+        }
+        // the special nodes are looked up by index and used as their type without a check
+        if (ok
+            && ((-1 != header->idxMouseMove && KeyMap::KMT_MOUSE_MOVE != image.nodes[header->idxMouseMove].type)
+                || (-1 != header->idxSteerWheel && KeyMap::KMT_STEER_WHEEL != image.nodes[header->idxSteerWheel].type))) {
+            ok = false;
+        }
+        if (ok) {
+            image.macroEvents.resize(static_cast<int>(header->macroEventCount));
+            for (quint32 i = 0; i < header->macroEventCount; i++) {
+                KeyMap::MacroEvent &event = image.macroEvents[static_cast<int>(i)];
+                event.time = macroEvents[i].time;
+                event.op = static_cast<KeyMap::MacroOp>(macroEvents[i].op);
+                event.pos = QPointF(macroEvents[i].pos[0], macroEvents[i].pos[1]);
+                event.androidKey = static_cast<AndroidKeycode>(macroEvents[i].androidKey);
+            }
+        }
+        if (ok) {
+            image.switchKey.type = static_cast<KeyMap::ActionType>(header->switchKeyType);
+            image.switchKey.key = header->switchKey;
+            image.switchModifiers = Qt::KeyboardModifiers(QFlag(static_cast<int>(header->switchModifiers)));
+            image.suspendKey.type = static_cast<KeyMap::ActionType>(header->suspendKeyType);
+            image.suspendKey.key = header->suspendKey;
+            image.idxSteerWheel = header->idxSteerWheel;
+            image.idxMouseMove = header->idxMouseMove;
+        }
+    }
+
+    file.unmap(data);
+    if (!ok) {
+        // stale layout or damaged file, rebuild it from the json source
+        qWarning() << "[Keymap] Discarding invalid keymap cache:" << file.fileName();
+        file.close();
+        file.remove();
+    }
+    return ok;
+}
+
+bool KeyMapCache::store(const QByteArray &hash, const Image &image)
+{
+    if (!isEnabled() || KEYMAP_CACHE_HASH_SIZE != hash.size()) {
+        return false;
+    }
+
+    QVector<CacheNode> nodes(image.nodes.size());
+    QVector<CacheDelayClick> delayClicks;
+    for (int i = 0; i < image.nodes.size(); i++) {
+        packNode(image.nodes[i], nodes[i], delayClicks);
+    }
+
+    QVector<CacheMacroEvent> macroEvents(image.macroEvents.size());
+    for (int i = 0; i < image.macroEvents.size(); i++) {
+        memset(&macroEvents[i], 0, sizeof(CacheMacroEvent));
+        macroEvents[i].time = image.macroEvents[i].time;
+        macroEvents[i].op = image.macroEvents[i].op;
+        macroEvents[i].pos[0] = image.macroEvents[i].pos.x();
+        macroEvents[i].pos[1] = image.macroEvents[i].pos.y();
+        macroEvents[i].androidKey = image.macroEvents[i].androidKey;
+    }
+
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, KEYMAP_CACHE_MAGIC, 4);
+    header.version = KEYMAP_CACHE_VERSION;
+    header.headerSize = sizeof(CacheHeader);
+    header.nodeSize = sizeof(CacheNode);
+    header.nodeCount = static_cast<quint32>(nodes.size());
+    header.delayClickCount = static_cast<quint32>(delayClicks.size());
+    header.macroEventCount = static_cast<quint32>(macroEvents.size());
+    memcpy(header.sourceHash, hash.constData(), KEYMAP_CACHE_HASH_SIZE);
+    header.switchKeyType = image.switchKey.type;
+    header.switchKey = image.switchKey.key;
+    header.switchModifiers = static_cast<quint32>(image.switchModifiers);
+    header.suspendKeyType = image.suspendKey.type;
+    header.suspendKey = image.suspendKey.key;
+    header.idxSteerWheel = image.idxSteerWheel;
+    header.idxMouseMove = image.idxMouseMove;
+
+    QString filePath = cacheFilePath(hash);
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "[Keymap] Could not write keymap cache:" << filePath;
+        return false;
+    }
+    file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    if (!nodes.isEmpty()) {
+        file.write(reinterpret_cast<const char *>(nodes.constData()), nodes.size() * sizeof(CacheNode));
+    }
+    if (!delayClicks.isEmpty()) {
+        file.write(reinterpret_cast<const char *>(delayClicks.constData()), delayClicks.size() * sizeof(CacheDelayClick));
+    }
+    if (!macroEvents.isEmpty()) {
+        file.write(reinterpret_cast<const char *>(macroEvents.constData()), macroEvents.size() * sizeof(CacheMacroEvent));
+    }
+    if (!file.commit()) {
+        qWarning() << "[Keymap] Could not commit keymap cache:" << filePath;
+        return false;
+    }
+
+    prune(filePath);
+    return true;
+}
+
+void KeyMapCache::prune(const QString &keepFile)
+{
+    QDir dir(s_cacheDir);
+    QFileInfoList files = dir.entryInfoList(QStringList() << "*" KEYMAP_CACHE_SUFFIX, QDir::Files, QDir::Time);
+    for (int i = KEYMAP_CACHE_MAX_FILES; i < files.size(); i++) {
+        if (files[i].absoluteFilePath() != keepFile) {
+            QFile::remove(files[i].absoluteFilePath());
+        }
+    }
+}
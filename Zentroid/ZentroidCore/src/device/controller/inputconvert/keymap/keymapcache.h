@@ -0,0 +1,48 @@
+#ifndef KEYMAPCACHE_H
+#define KEYMAPCACHE_H
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+#include "keymap.h"
+
+// Compiled binary form of a keymap json.
+// The cache file is named after the sha1 of the json source, so any edit of the
+// source produces a new key and the stale entry is simply never hit again
+// (old entries are pruned when a new one is stored).
+// Loading maps the file and copies fixed-size records, no json parsing is
+// involved. Counts and indices are bounds checked, a file that fails is removed
+// and the keymap is parsed from the json again.
+class KeyMapCache
+{
+public:
+    struct Image
+    {
+        QVector<KeyMap::KeyMapNode> nodes;
+        QVector<KeyMap::MacroEvent> macroEvents;
+        KeyMap::KeyNode switchKey;
+        Qt::KeyboardModifiers switchModifiers = Qt::NoModifier;
+        KeyMap::KeyNode suspendKey;
+        int idxSteerWheel = -1;
+        int idxMouseMove = -1;
+    };
+
+    // empty dir disables the cache
+    static void setCacheDir(const QString &dir);
+    static const QString &getCacheDir();
+    static bool isEnabled();
+
+    static QByteArray sourceHash(const QString &json);
+    static bool load(const QByteArray &hash, Image &image);
+    static bool store(const QByteArray &hash, const Image &image);
+
+private:
+    static QString cacheFilePath(const QByteArray &hash);
+    static void prune(const QString &keepFile);
+
+private:
+    static QString s_cacheDir;
+};
+
+#endif // KEYMAPCACHE_H
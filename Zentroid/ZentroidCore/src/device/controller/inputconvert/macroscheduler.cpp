@@ -0,0 +1,187 @@
+#include <QDebug>
+#include <QTimerEvent>
+
+#include "macroscheduler.h"
+
+MacroScheduler::MacroScheduler(Executor executor, QObject *parent) : QObject(parent), m_executor(executor)
+{
+    m_runs.resize(MACRO_MAX_RUNNING);
+    m_clock.start();
+}
+
+MacroScheduler::~MacroScheduler() {}
+
+void MacroScheduler::start(int key, const KeyMap::MacroEvent *events, int count, quint32 duration, bool repeat)
+{
+    if (!events || 0 >= count) {
+        return;
+    }
+
+    // pressing again restarts the macro from the top
+    int index = findRun(key);
+    if (-1 != index) {
+        stopRun(index, true);
+    }
+    if (MACRO_MAX_RUNNING <= m_runCount) {
+        qWarning() << "[Keymap] too many macros running, drop key" << key;
+        return;
+    }
+
+    Run &run = m_runs[m_runCount++];
+    run = Run();
+    run.key = key;
+    run.events = events;
+    run.count = count;
+    run.duration = duration;
+    run.repeat = repeat;
+    run.held = true;
+    run.startMs = m_clock.elapsed();
+
+    process();
+}
+
+void MacroScheduler::release(int key, bool cancel)
+{
+    int index = findRun(key);
+    if (-1 == index) {
+        return;
+    }
+    if (cancel) {
+        stopRun(index, true);
+        schedule();
+        return;
+    }
+    m_runs[index].held = false;
+}
+
+void MacroScheduler::cancel(int key)
+{
+    int index = findRun(key);
+    if (-1 != index) {
+        stopRun(index, true);
+        schedule();
+    }
+}
+
+void MacroScheduler::cancelAll()
+{
+    while (m_runCount) {
+        stopRun(m_runCount - 1, true);
+    }
+    schedule();
+}
+
+bool MacroScheduler::isRunning(int key) const
+{
+    return -1 != findRun(key);
+}
+
+void MacroScheduler::timerEvent(QTimerEvent *event)
+{
+    if (m_timer == event->timerId()) {
+        killTimer(m_timer);
+        m_timer = 0;
+        process();
+    }
+}
+
+int MacroScheduler::findRun(int key) const
+{
+    for (int i = 0; i < m_runCount; i++) {
+        if (key == m_runs[i].key) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void MacroScheduler::execute(Run &run, const KeyMap::MacroEvent &event)
+{
+    switch (event.op) {
+    case KeyMap::MO_TOUCH_DOWN:
+    case KeyMap::MO_TOUCH_MOVE:
+        run.touchDown = true;
+        run.touchPos = event.pos;
+        break;
+    case KeyMap::MO_TOUCH_UP:
+        run.touchDown = false;
+        break;
+    case KeyMap::MO_KEY_DOWN:
+        run.keyDown = event.androidKey;
+        break;
+    case KeyMap::MO_KEY_UP:
+        run.keyDown = AKEYCODE_UNKNOWN;
+        break;
+    }
+    m_executor(run.key, event);
+}
+
+void MacroScheduler::stopRun(int index, bool undo)
+{
+    Run &run = m_runs[index];
+    if (undo) {
+        KeyMap::MacroEvent event;
+        if (run.touchDown) {
+            event.op = KeyMap::MO_TOUCH_UP;
+            event.pos = run.touchPos;
+            m_executor(run.key, event);
+        }
+        if (AKEYCODE_UNKNOWN != run.keyDown) {
+            event.op = KeyMap::MO_KEY_UP;
+            event.androidKey = run.keyDown;
+            m_executor(run.key, event);
+        }
+    }
+
+    // keep the live runs packed at the front
+    m_runCount--;
+    if (index != m_runCount) {
+        m_runs[index] = m_runs[m_runCount];
+    }
+}
+
+void MacroScheduler::process()
+{
+    qint64 now = m_clock.elapsed();
+    for (int i = 0; i < m_runCount;) {
+        Run &run = m_runs[i];
+        while (run.next < run.count && run.startMs + run.events[run.next].time <= now) {
+            execute(run, run.events[run.next]);
+            run.next++;
+        }
+
+        if (run.next < run.count) {
+            i++;
+            continue;
+        }
+        if (run.repeat && run.held && run.duration) {
+            // next pass starts where this one ended, so the period does not drift
+            run.startMs += run.duration;
+            run.next = 0;
+            continue;
+        }
+        stopRun(i, false);
+    }
+    schedule();
+}
+
+void MacroScheduler::schedule()
+{
+    if (m_timer) {
+        killTimer(m_timer);
+        m_timer = 0;
+    }
+
+    qint64 due = -1;
+    for (int i = 0; i < m_runCount; i++) {
+        const Run &run = m_runs[i];
+        qint64 runDue = run.startMs + (run.next < run.count ? run.events[run.next].time : run.duration);
+        if (-1 == due || runDue < due) {
+            due = runDue;
+        }
+    }
+    if (-1 == due) {
+        return;
+    }
+    m_timer = startTimer(static_cast<int>(qMax<qint64>(0, due - m_clock.elapsed())), Qt::PreciseTimer);
+}
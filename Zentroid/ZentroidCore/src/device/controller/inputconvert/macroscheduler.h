@@ -0,0 +1,70 @@
+#ifndef MACROSCHEDULER_H
+#define MACROSCHEDULER_H
+
+#include <functional>
+#include <QElapsedTimer>
+#include <QObject>
+#include <QVector>
+
+#include "keymap.h"
+
+#define MACRO_MAX_RUNNING 16
+
+// Plays compiled KMT_MACRO timelines.
+// All running macros of a device share one precise single-shot timer armed for
+// the earliest pending entry. Run slots are preallocated, and the timeline is
+// read in place from the KeyMap, so nothing is allocated per step.
+class MacroScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    // executes one timeline entry for the macro bound to key
+    typedef std::function<void(int key, const KeyMap::MacroEvent &event)> Executor;
+
+    MacroScheduler(Executor executor, QObject *parent = Q_NULLPTR);
+    virtual ~MacroScheduler();
+
+    // events must stay valid until the macro finishes or is cancelled
+    void start(int key, const KeyMap::MacroEvent *events, int count, quint32 duration, bool repeat);
+    // key released: repeating macros stop after the current pass, unless cancel is set
+    void release(int key, bool cancel);
+    // stops right away, lifting whatever the macro holds down
+    void cancel(int key);
+    void cancelAll();
+    bool isRunning(int key) const;
+
+protected:
+    void timerEvent(QTimerEvent *event);
+
+private:
+    struct Run
+    {
+        int key = 0;
+        const KeyMap::MacroEvent *events = Q_NULLPTR;
+        int count = 0;
+        int next = 0;
+        quint32 duration = 0;
+        bool repeat = false;
+        bool held = false;
+        qint64 startMs = 0;
+        // what must be undone on cancel
+        bool touchDown = false;
+        QPointF touchPos;
+        AndroidKeycode keyDown = AKEYCODE_UNKNOWN;
+    };
+
+    int findRun(int key) const;
+    void execute(Run &run, const KeyMap::MacroEvent &event);
+    void stopRun(int index, bool undo);
+    void process();
+    void schedule();
+
+private:
+    Executor m_executor;
+    QElapsedTimer m_clock;
+    QVector<Run> m_runs;
+    int m_runCount = 0;
+    int m_timer = 0;
+};
+
+#endif // MACROSCHEDULER_H
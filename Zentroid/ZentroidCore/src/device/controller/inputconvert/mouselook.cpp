@@ -0,0 +1,89 @@
+#include <QtMath>
+
+#include "mouselook.h"
+
+#define MOUSE_LOOK_MAX_SMOOTHING 0.95
+#define MOUSE_LOOK_MAX_GAIN 4.0
+#define MOUSE_LOOK_MAX_TOUCH_RATE 1000
+// mouse events further apart than this are treated as a fresh start for acceleration
+#define MOUSE_LOOK_MAX_EVENT_GAP_MS 50
+// below this (normalized units, well under a pixel) smoothing flushes the rest
+#define MOUSE_LOOK_MIN_PENDING 0.0001
+
+MouseLook::MouseLook()
+{
+    m_clock.start();
+}
+
+void MouseLook::setSpeedRatio(const QPointF &speedRatio)
+{
+    m_speedRatio = speedRatio;
+}
+
+void MouseLook::setSmoothing(double smoothing)
+{
+    m_smoothing = qBound(0.0, smoothing, MOUSE_LOOK_MAX_SMOOTHING);
+}
+
+void MouseLook::setAcceleration(double acceleration)
+{
+    m_acceleration = qMax(0.0, acceleration);
+}
+
+void MouseLook::setTouchRate(int touchRate)
+{
+    m_touchRate = qBound(0, touchRate, MOUSE_LOOK_MAX_TOUCH_RATE);
+}
+
+int MouseLook::sampleInterval() const
+{
+    if (0 >= m_touchRate) {
+        return 0;
+    }
+    return qMax(1, 1000 / m_touchRate);
+}
+
+void MouseLook::addMotion(const QPointF &delta, const QSize &showSize)
+{
+    if (showSize.isEmpty()) {
+        return;
+    }
+
+    qint64 now = m_clock.elapsed();
+    double gain = 1.0;
+    if (m_acceleration > 0.0) {
+        qint64 elapsed = m_lastMotionMs < 0 ? MOUSE_LOOK_MAX_EVENT_GAP_MS : now - m_lastMotionMs;
+        double speed = qSqrt(delta.x() * delta.x() + delta.y() * delta.y()) / qBound<qint64>(1, elapsed, MOUSE_LOOK_MAX_EVENT_GAP_MS);
+        gain = qMin(1.0 + m_acceleration * speed, MOUSE_LOOK_MAX_GAIN);
+    }
+    m_lastMotionMs = now;
+
+    m_pending.rx() += gain * delta.x() / m_speedRatio.x() / showSize.width();
+    m_pending.ry() += gain * delta.y() / m_speedRatio.y() / showSize.height();
+}
+
+bool MouseLook::hasPending() const
+{
+    return !m_pending.isNull();
+}
+
+QPointF MouseLook::takeSample()
+{
+    QPointF sample = m_pending;
+    if (m_smoothing > 0.0 && qAbs(m_pending.x()) + qAbs(m_pending.y()) > MOUSE_LOOK_MIN_PENDING) {
+        sample *= 1.0 - m_smoothing;
+    }
+    m_pending -= sample;
+    return sample;
+}
+
+void MouseLook::giveBack(const QPointF &motion)
+{
+    m_pending += motion;
+}
+
+void MouseLook::reset()
+{
+    m_pending = QPointF();
+    m_lastMotionMs = -1;
+}
@@ -0,0 +1,45 @@
+#ifndef MOUSELOOK_H
+#define MOUSELOOK_H
+
+#include <QElapsedTimer>
+#include <QPointF>
+#include <QSize>
+
+// Aim input for KMT_MOUSE_MOVE.
+// Raw mouse deltas are accumulated in double precision (normalized to the
+// show size and divided by speedRatio), and handed out as one touch move per
+// sample period. Nothing is rounded or thrown away here: what a sample does
+// not emit stays pending for the next one.
+class MouseLook
+{
+public:
+    MouseLook();
+
+    void setSpeedRatio(const QPointF &speedRatio);
+    // 0 = raw, the closer to 1 the more of the pending motion is deferred to later samples
+    void setSmoothing(double smoothing);
+    // extra gain per (show pixel / ms) of mouse speed, 0 = linear
+    void setAcceleration(double acceleration);
+    // touch samples per second, 0 = one sample per mouse event
+    void setTouchRate(int touchRate);
+    int sampleInterval() const;
+
+    void addMotion(const QPointF &delta, const QSize &showSize);
+    bool hasPending() const;
+    QPointF takeSample();
+    // return part of a sample that could not be applied
+    void giveBack(const QPointF &motion);
+    void reset();
+
+private:
+    QPointF m_speedRatio = { 1.0, 1.0 };
+    double m_smoothing = 0.0;
+    double m_acceleration = 0.0;
+    int m_touchRate = 0;
+
+    QPointF m_pending;
+    QElapsedTimer m_clock;
+    qint64 m_lastMotionMs = -1;
+};
+
+#endif // MOUSELOOK_H
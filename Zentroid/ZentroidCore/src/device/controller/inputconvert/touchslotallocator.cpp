@@ -0,0 +1,75 @@
+#include <QtAlgorithms>
+
+#include "touchslotallocator.h"
+
+TouchSlotAllocator::TouchSlotAllocator(int capacity)
+{
+    setCapacity(capacity);
+}
+
+void TouchSlotAllocator::setCapacity(int capacity)
+{
+    m_capacity = qBound(1, capacity, TOUCH_SLOT_MAX_NUM);
+}
+
+int TouchSlotAllocator::capacity() const
+{
+    return m_capacity;
+}
+
+int TouchSlotAllocator::attach(int key)
+{
+    quint64 capacityMask = TOUCH_SLOT_MAX_NUM == m_capacity ? ~quint64(0) : ((quint64(1) << m_capacity) - 1);
+    quint64 freeMask = ~m_used & capacityMask;
+    if (!freeMask) {
+        return -1;
+    }
+
+    int slot = lowestSlot(freeMask);
+    quint64 bit = quint64(1) << slot;
+    m_used |= bit;
+    m_keySlots[key] |= bit;
+    return slot;
+}
+
+int TouchSlotAllocator::detach(int key)
+{
+    auto it = m_keySlots.find(key);
+    if (it == m_keySlots.end()) {
+        return -1;
+    }
+
+    int slot = lowestSlot(it.value());
+    quint64 bit = quint64(1) << slot;
+    m_used &= ~bit;
+    it.value() &= ~bit;
+    if (!it.value()) {
+        m_keySlots.erase(it);
+    }
+    return slot;
+}
+
+int TouchSlotAllocator::get(int key) const
+{
+    auto it = m_keySlots.constFind(key);
+    if (it == m_keySlots.constEnd()) {
+        return -1;
+    }
+    return lowestSlot(it.value());
+}
+
+int TouchSlotAllocator::activeCount() const
+{
+    return qPopulationCount(m_used);
+}
+
+void TouchSlotAllocator::reset()
+{
+    m_used = 0;
+    m_keySlots.clear();
+}
+
+int TouchSlotAllocator::lowestSlot(quint64 mask)
+{
+    return static_cast<int>(qCountTrailingZeroBits(mask));
+}
@@ -0,0 +1,43 @@
+#ifndef TOUCHSLOTALLOCATOR_H
+#define TOUCHSLOTALLOCATOR_H
+
+#include <QHash>
+
+#define TOUCH_SLOT_MAX_NUM 64
+
+// Hands out android pointer ids (0 .. capacity-1) to the keys/buttons that
+// currently hold a finger down.
+// Free slots live in a 64 bit mask, so attach/detach are a bit scan instead of
+// an array walk. A key may own several slots at once (fast repeated clicks),
+// lookups always resolve to its lowest slot, which is what the old linear scan
+// returned as well.
+class TouchSlotAllocator
+{
+public:
+    explicit TouchSlotAllocator(int capacity = 10);
+
+    // clamped to [1, TOUCH_SLOT_MAX_NUM]; slots already held above the new
+    // capacity stay valid until they are detached
+    void setCapacity(int capacity);
+    int capacity() const;
+
+    // -1 when every slot is taken
+    int attach(int key);
+    // returns the released slot, -1 if key holds none
+    int detach(int key);
+    int get(int key) const;
+
+    int activeCount() const;
+    void reset();
+
+private:
+    static int lowestSlot(quint64 mask);
+
+private:
+    int m_capacity = 10;
+    quint64 m_used = 0;
+    // key -> mask of the slots it owns
+    QHash<int, quint64> m_keySlots;
+};
+
+#endif // TOUCHSLOTALLOCATOR_H
@@ -33,7 +33,7 @@ qint32 DeviceMsg::deserialize(QByteArray &byteArray)
     qint32 ret = 0;
 
     if (len < 5) {
-        // at least type + empty string length
+        // at least type + empty string length, or type + half a sequence
         return 0; // not available
     }
 
@@ -42,13 +42,14 @@ qint32 DeviceMsg::deserialize(QByteArray &byteArray)
     switch (m_data.type) {
     case DMT_GET_CLIPBOARD: {
         m_data.clipboardMsg.text = Q_NULLPTR;
-        quint16 clipboardLen = BufferUtil::read32(buf);
+        quint32 clipboardLen = BufferUtil::read32(buf);
         if (clipboardLen > len - 5) {
             ret = 0; // not available
             break;
         }
 
-        QByteArray text = buf.readAll();
+        // the next message may follow in the same buffer
+        QByteArray text = buf.read(clipboardLen);
         m_data.clipboardMsg.text = new char[text.length() + 1];
         memcpy(m_data.clipboardMsg.text, text.data(), text.length());
         m_data.clipboardMsg.text[text.length()] = '\0';
@@ -56,6 +57,15 @@ qint32 DeviceMsg::deserialize(QByteArray &byteArray)
         ret = 5 + clipboardLen;
         break;
     }
+    case DMT_ACK_CLIPBOARD: {
+        if (len < 9) {
+            ret = 0; // not available
+            break;
+        }
+        m_data.ackClipboardMsg.sequence = BufferUtil::read64(buf);
+        ret = 9;
+        break;
+    }
     default:
         qWarning("Unsupported device msg type: %d", (int)m_data.type);
         ret = -1; // error, we cannot recover
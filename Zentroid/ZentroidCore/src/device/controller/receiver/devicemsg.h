@@ -16,6 +16,7 @@ public:
         DMT_NULL = -1,
         // corresponds to server-side message types
         DMT_GET_CLIPBOARD = 0,
+        DMT_ACK_CLIPBOARD = 1,
     };
     explicit DeviceMsg(QObject *parent = nullptr);
     virtual ~DeviceMsg();
@@ -35,6 +36,10 @@ private:
             {
                 char *text = Q_NULLPTR;
             } clipboardMsg;
+            struct
+            {
+                quint64 sequence;
+            } ackClipboardMsg;
         };
         DeviceMsgData() {}
         ~DeviceMsgData() {}
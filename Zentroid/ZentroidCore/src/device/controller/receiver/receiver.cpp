@@ -1,4 +1,4 @@
-#include <QApplication>
+#include <QGuiApplication>
 #include <QClipboard>
 
 #include "devicemsg.h"
@@ -13,7 +13,11 @@ void Receiver::recvDeviceMsg(DeviceMsg *deviceMsg)
     switch (deviceMsg->type()) {
     case DeviceMsg::DMT_GET_CLIPBOARD: {
         qInfo("Device clipboard copied");
-        QClipboard *board = QApplication::clipboard();
+        // headless runs have no pc clipboard
+        if (!qobject_cast<QGuiApplication *>(QCoreApplication::instance())) {
+            break;
+        }
+        QClipboard *board = QGuiApplication::clipboard();
         QString text;
         deviceMsg->getClipboardMsgData(text);
 
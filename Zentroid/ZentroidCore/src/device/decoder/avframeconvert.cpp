@@ -35,12 +35,12 @@ void AVFrameConvert::getDstFrameInfo(int &dstWidth, int &dstHeight, AVPixelForma
     dstFormat = m_dstFormat;
 }
 
-bool AVFrameConvert::init()
+bool AVFrameConvert::init(int flags)
 {
     if (m_convertCtx) {
         return true;
     }
-    m_convertCtx = sws_getContext(m_srcWidth, m_srcHeight, m_srcFormat, m_dstWidth, m_dstHeight, m_dstFormat, SWS_BICUBIC, Q_NULLPTR, Q_NULLPTR, Q_NULLPTR);
+    m_convertCtx = sws_getContext(m_srcWidth, m_srcHeight, m_srcFormat, m_dstWidth, m_dstHeight, m_dstFormat, flags, Q_NULLPTR, Q_NULLPTR, Q_NULLPTR);
     if (!m_convertCtx) {
         return false;
     }
@@ -21,7 +21,8 @@ public:
     void setDstFrameInfo(int dstWidth, int dstHeight, AVPixelFormat dstFormat);
     void getDstFrameInfo(int &dstWidth, int &dstHeight, AVPixelFormat &dstFormat);
 
-    bool init();
+    // flags: sws scaling algorithm
+    bool init(int flags = SWS_BICUBIC);
     bool isInit();
     void deInit();
     bool convert(const AVFrame *srcFrame, AVFrame *dstFrame);
@@ -1,10 +1,11 @@
 #include <QDebug>
+#include <QElapsedTimer>
 
 #include "compat.h"
 #include "decoder.h"
 #include "videobuffer.h"
 
-Decoder::Decoder(std::function<void(int, int, uint8_t*, uint8_t*, uint8_t*, int, int, int)> onFrame, QObject *parent)
+Decoder::Decoder(FrameCallback onFrame, QObject *parent)
     : QObject(parent)
     , m_vb(new VideoBuffer())
     , m_onFrame(onFrame)
@@ -58,6 +59,15 @@ void Decoder::close()
 }
 
 bool Decoder::push(const AVPacket *packet)
+{
+    QElapsedTimer decodeClock;
+    decodeClock.start();
+    bool ret = decode(packet);
+    m_decodeUs.fetchAndAddRelease(static_cast<int>(decodeClock.nsecsElapsed() / 1000));
+    return ret;
+}
+
+bool Decoder::decode(const AVPacket *packet)
 {
     if (!m_codecCtx || !m_vb) {
         return false;
@@ -120,7 +130,7 @@ bool Decoder::push(const AVPacket *packet)
     return true;
 }
 
-void Decoder::peekFrame(std::function<void (int, int, uint8_t *)> onFrame)
+void Decoder::peekFrame(std::function<void(const AVFrame *)> onFrame)
 {
     if (!m_vb) {
         return;
@@ -128,14 +138,48 @@ void Decoder::peekFrame(std::function<void (int, int, uint8_t *)> onFrame)
     m_vb->peekRenderedFrame(onFrame);
 }
 
+void Decoder::setFrameTap(std::function<void(const AVFrame *, bool)> tap)
+{
+    m_frameTap = tap;
+}
+
+quint32 Decoder::decodedFrames()
+{
+    return static_cast<quint32>(m_decodedFrames.loadAcquire());
+}
+
+quint32 Decoder::skippedFrames()
+{
+    return static_cast<quint32>(m_skippedFrames.loadAcquire());
+}
+
+quint32 Decoder::decodeTimeUs()
+{
+    return static_cast<quint32>(m_decodeUs.loadAcquire());
+}
+
+quint32 Decoder::changedFrames()
+{
+    return static_cast<quint32>(m_changedFrames.loadAcquire());
+}
+
 void Decoder::pushFrame()
 {
     if (!m_vb) {
         return;
     }
+    m_decodedFrames.fetchAndAddRelease(1);
+    m_frameDiff.update(m_vb->decodingFrame());
+    if (m_frameDiff.changed()) {
+        m_changedFrames.fetchAndAddRelease(1);
+    }
+    if (m_frameTap) {
+        m_frameTap(m_vb->decodingFrame(), m_frameDiff.changed());
+    }
     bool previousFrameSkipped = true;
-    m_vb->offerDecodedFrame(previousFrameSkipped);
+    m_vb->offerDecodedFrame(previousFrameSkipped, &m_frameDiff);
     if (previousFrameSkipped) {
+        m_skippedFrames.fetchAndAddRelease(1);
         // the previous newFrame will consume this frame
         return;
     }
@@ -149,6 +193,14 @@ void Decoder::onNewFrame() {
 
     m_vb->lock();
     const AVFrame *frame = m_vb->consumeRenderedFrame();
-    m_onFrame(frame->width, frame->height, frame->data[0], frame->data[1], frame->data[2], frame->linesize[0], frame->linesize[1], frame->linesize[2]);
+    qsc::FrameDirtyMap dirty;
+    dirty.changed = m_vb->renderedFrameChanged();
+    dirty.tileSize = m_frameDiff.tileSize();
+    dirty.columns = (frame->width + dirty.tileSize - 1) / dirty.tileSize;
+    dirty.rows = (frame->height + dirty.tileSize - 1) / dirty.tileSize;
+    const QVector<quint8> &tiles = m_vb->renderedDirtyTiles();
+    // a map of another size belongs to a frame before a resize: all dirty
+    dirty.tiles = tiles.size() == dirty.columns * dirty.rows ? tiles.constData() : Q_NULLPTR;
+    m_onFrame(frame->width, frame->height, frame->data[0], frame->data[1], frame->data[2], frame->linesize[0], frame->linesize[1], frame->linesize[2], dirty);
     m_vb->unLock();
 }
@@ -1,5 +1,6 @@
 #ifndef DECODER_H
 #define DECODER_H
+#include <QAtomicInt>
 #include <QObject>
 
 extern "C"
@@ -9,18 +10,36 @@ extern "C"
 
 #include <functional>
 
+#include "ZentroidCoreDef.h"
+#include "framediff.h"
+
 class VideoBuffer;
 class Decoder : public QObject
 {
     Q_OBJECT
 public:
-    Decoder(std::function<void(int width, int height, uint8_t* dataY, uint8_t* dataU, uint8_t* dataV, int linesizeY, int linesizeU, int linesizeV)> onFrame, QObject *parent = Q_NULLPTR);
+    using FrameCallback = std::function<void(int width, int height, uint8_t* dataY, uint8_t* dataU, uint8_t* dataV, int linesizeY, int linesizeU, int linesizeV,
+                                             const qsc::FrameDirtyMap &dirty)>;
+
+    Decoder(FrameCallback onFrame, QObject *parent = Q_NULLPTR);
     virtual ~Decoder();
 
     bool open();
     void close();
     bool push(const AVPacket *packet);
-    void peekFrame(std::function<void(int width, int height, uint8_t* dataRGB32)> onFrame);
+    void peekFrame(std::function<void(const AVFrame *frame)> onFrame);
+    // sees every decoded frame on the decoding thread before it is offered for
+    // rendering, changed: any of its y, u or v planes differs from the frame before it;
+    // set before decoding starts
+    void setFrameTap(std::function<void(const AVFrame *frame, bool changed)> tap);
+    // frames decoded so far, rendered or skipped, readable from any thread
+    quint32 decodedFrames();
+    // frames replaced before the renderer took them
+    quint32 skippedFrames();
+    // time spent in the codec, wraps around
+    quint32 decodeTimeUs();
+    // decoded frames that differ from the frame before them
+    quint32 changedFrames();
 
 signals:
     void updateFPS(quint32 fps);
@@ -32,13 +51,20 @@ signals:
     void newFrame();
 
 private:
+    bool decode(const AVPacket *packet);
     void pushFrame();
 
 private:
     VideoBuffer *m_vb = Q_NULLPTR;
     AVCodecContext *m_codecCtx = Q_NULLPTR;
     bool m_isCodecCtxOpen = false;
-    std::function<void(int, int, uint8_t*, uint8_t*, uint8_t*, int, int, int)> m_onFrame = Q_NULLPTR;
+    QAtomicInt m_decodedFrames;
+    QAtomicInt m_skippedFrames;
+    QAtomicInt m_decodeUs;
+    QAtomicInt m_changedFrames;
+    FrameDiff m_frameDiff; // decoding thread only
+    FrameCallback m_onFrame = Q_NULLPTR;
+    std::function<void(const AVFrame *, bool)> m_frameTap = Q_NULLPTR;
 };
 
 #endif // DECODER_H
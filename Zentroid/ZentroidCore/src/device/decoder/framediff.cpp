@@ -0,0 +1,134 @@
+#include <cstring>
+
+extern "C"
+{
+#include "libavutil/frame.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/pixdesc.h"
+}
+
+#include "framediff.h"
+
+// tile side in luma pixels, chroma tiles are subsampled with the plane
+#define FD_TILE_SIZE 64
+
+FrameDiff::FrameDiff() {}
+
+void FrameDiff::update(const AVFrame *frame)
+{
+    if (!frame || !frame->data[0] || 0 >= frame->width || 0 >= frame->height) {
+        return;
+    }
+
+    bool resized = frame->width != m_width || frame->height != m_height || frame->format != m_format;
+    if (resized) {
+        resize(frame);
+    }
+
+    bool changed = resized;
+    for (int row = 0; row < m_rows; row++) {
+        for (int column = 0; column < m_columns; column++) {
+            int x = column * FD_TILE_SIZE;
+            int y = row * FD_TILE_SIZE;
+            // every plane is compared: each one refreshes its own copy
+            bool dirty = resized;
+            for (int i = 0; i < m_planes; i++) {
+                dirty = updateTile(i, frame, x, y) || dirty;
+            }
+            m_tiles[row * m_columns + column] = dirty ? 1 : 0;
+            changed = changed || dirty;
+        }
+    }
+    m_changed = changed;
+}
+
+void FrameDiff::resize(const AVFrame *frame)
+{
+    m_width = frame->width;
+    m_height = frame->height;
+    m_format = frame->format;
+    m_columns = (m_width + FD_TILE_SIZE - 1) / FD_TILE_SIZE;
+    m_rows = (m_height + FD_TILE_SIZE - 1) / FD_TILE_SIZE;
+    m_tiles.fill(1, m_columns * m_rows);
+
+    // 8 bit planar yuv compares all three planes, anything else the first one as bytes
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+    bool planarYuv = desc && 3 <= desc->nb_components && (desc->flags & AV_PIX_FMT_FLAG_PLANAR) && !(desc->flags & AV_PIX_FMT_FLAG_RGB)
+                     && 8 >= desc->comp[0].depth && frame->data[1] && frame->data[2];
+    m_planes = planarYuv ? 3 : 1;
+    for (int i = 0; i < m_planes; i++) {
+        Plane &plane = m_plane[i];
+        plane.shiftX = 0 == i ? 0 : desc->log2_chroma_w;
+        plane.shiftY = 0 == i ? 0 : desc->log2_chroma_h;
+        plane.bytes = 1;
+        if (!planarYuv) {
+            plane.bytes = qMax(1, av_image_get_linesize(static_cast<AVPixelFormat>(frame->format), m_width, 0) / m_width);
+        }
+        plane.width = ((m_width + (1 << plane.shiftX) - 1) >> plane.shiftX) * plane.bytes;
+        plane.height = (m_height + (1 << plane.shiftY) - 1) >> plane.shiftY;
+        // the first compare after a resize copies everything
+        plane.kept.resize(plane.width * plane.height);
+    }
+}
+
+bool FrameDiff::updateTile(int index, const AVFrame *frame, int x, int y)
+{
+    Plane &plane = m_plane[index];
+    int tileWidth = (FD_TILE_SIZE >> plane.shiftX) * plane.bytes;
+    int tileHeight = FD_TILE_SIZE >> plane.shiftY;
+    int planeX = (x >> plane.shiftX) * plane.bytes;
+    int planeY = y >> plane.shiftY;
+    int width = qMin(tileWidth, plane.width - planeX);
+    int height = qMin(tileHeight, plane.height - planeY);
+    if (0 >= width || 0 >= height) {
+        return false;
+    }
+
+    int linesize = frame->linesize[index];
+    const quint8 *src = frame->data[index] + static_cast<qint64>(planeY) * linesize + planeX;
+    quint8 *kept = plane.kept.data() + static_cast<qint64>(planeY) * plane.width + planeX;
+    bool dirty = false;
+    for (int row = 0; row < height; row++) {
+        const quint8 *srcRow = src + static_cast<qint64>(row) * linesize;
+        quint8 *keptRow = kept + static_cast<qint64>(row) * plane.width;
+        // once a row differed the rest is copied without looking
+        if (dirty || memcmp(srcRow, keptRow, width)) {
+            memcpy(keptRow, srcRow, width);
+            dirty = true;
+        }
+    }
+    return dirty;
+}
+
+void FrameDiff::reset()
+{
+    m_width = 0;
+    m_height = 0;
+    m_format = -1;
+    m_changed = true;
+}
+
+bool FrameDiff::changed() const
+{
+    return m_changed;
+}
+
+int FrameDiff::tileSize() const
+{
+    return FD_TILE_SIZE;
+}
+
+int FrameDiff::columns() const
+{
+    return m_columns;
+}
+
+int FrameDiff::rows() const
+{
+    return m_rows;
+}
+
+const QVector<quint8> &FrameDiff::tiles() const
+{
+    return m_tiles;
+}
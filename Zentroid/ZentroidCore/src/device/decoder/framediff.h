@@ -0,0 +1,61 @@
+#ifndef FRAMEDIFF_H
+#define FRAMEDIFF_H
+#include <QVector>
+
+// forward declarations
+typedef struct AVFrame AVFrame;
+
+// Tells which tiles of the frame changed since the previous frame.
+// A copy of the previous Y, U and V planes is kept and every tile compared
+// against it row by row with memcmp, so the answer is exact: no hash that two
+// different tiles can share, and a colour change that leaves luma alone still
+// marks its tile. Only the rows of changed tiles are copied; a 1080x2400
+// yuv420p frame costs well under a millisecond.
+// Decoding thread only.
+class FrameDiff
+{
+public:
+    FrameDiff();
+
+    // compare the frame with the previous one and mark the tiles that differ;
+    // the first frame and a frame of another size or format are dirty everywhere
+    void update(const AVFrame *frame);
+    void reset();
+
+    bool changed() const;
+    int tileSize() const;
+    int columns() const;
+    int rows() const;
+    // columns * rows, non zero for a changed tile
+    const QVector<quint8> &tiles() const;
+
+private:
+    struct Plane
+    {
+        int width = 0; // bytes
+        int height = 0;
+        int bytes = 1; // per pixel
+        // log2 of the subsampling against the luma plane
+        int shiftX = 0;
+        int shiftY = 0;
+        QVector<quint8> kept; // width * height, the plane of the previous frame
+    };
+
+    void resize(const AVFrame *frame);
+    // compares one tile of plane index with the kept copy and refreshes the copy,
+    // x and y in luma pixels
+    bool updateTile(int index, const AVFrame *frame, int x, int y);
+
+private:
+    int m_width = 0;
+    int m_height = 0;
+    int m_format = -1;
+    int m_planes = 0;
+    int m_columns = 0;
+    int m_rows = 0;
+    bool m_changed = true;
+    Plane m_plane[3];
+    QVector<quint8> m_tiles;
+};
+
+#endif // FRAMEDIFF_H
@@ -0,0 +1,210 @@
+#include <QDateTime>
+#include <QMutexLocker>
+
+extern "C"
+{
+#include "libavutil/frame.h"
+#include "libavutil/pixfmt.h"
+}
+
+#include "regionprober.h"
+
+// difference hash grid, one more column than bits per row
+#define RP_HASH_COLUMNS 9
+#define RP_HASH_ROWS 8
+// events the main thread has not taken, the oldest go first
+#define RP_MAX_PENDING_EVENTS 1024
+
+namespace {
+
+int bitCount(quint64 value)
+{
+    int count = 0;
+    while (value) {
+        value &= value - 1;
+        count++;
+    }
+    return count;
+}
+
+int channelDistance(quint32 a, quint32 b)
+{
+    int distance = 0;
+    for (int shift = 0; shift <= 16; shift += 8) {
+        int da = static_cast<int>((a >> shift) & 0xff);
+        int db = static_cast<int>((b >> shift) & 0xff);
+        distance = qMax(distance, qAbs(da - db));
+    }
+    return distance;
+}
+
+quint32 toRgb(double y, double u, double v, bool fullRange)
+{
+    u -= 128.0;
+    v -= 128.0;
+    // bt.601, what the device encoder uses
+    double r, g, b;
+    if (fullRange) {
+        r = y + 1.402 * v;
+        g = y - 0.344 * u - 0.714 * v;
+        b = y + 1.772 * u;
+    } else {
+        y = 1.164 * (y - 16.0);
+        r = y + 1.596 * v;
+        g = y - 0.392 * u - 0.813 * v;
+        b = y + 2.017 * u;
+    }
+    quint32 ri = static_cast<quint32>(qBound(0.0, r + 0.5, 255.0));
+    quint32 gi = static_cast<quint32>(qBound(0.0, g + 0.5, 255.0));
+    quint32 bi = static_cast<quint32>(qBound(0.0, b + 0.5, 255.0));
+    return (ri << 16) | (gi << 8) | bi;
+}
+
+quint64 planeSum(const quint8 *plane, int linesize, int left, int top, int width, int height)
+{
+    quint64 sum = 0;
+    for (int y = top; y < top + height; y++) {
+        const quint8 *row = plane + static_cast<qint64>(y) * linesize;
+        for (int x = left; x < left + width; x++) {
+            sum += row[x];
+        }
+    }
+    return sum;
+}
+
+}
+
+RegionProber::RegionProber(QObject *parent) : QObject(parent) {}
+
+RegionProber::~RegionProber() {}
+
+void RegionProber::setProbes(const QList<qsc::RegionProbe> &probes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_probes.clear();
+    for (const auto &probe : probes) {
+        ProbeState state;
+        state.probe = probe;
+        m_probes.append(state);
+    }
+    m_probesChanged = true;
+}
+
+void RegionProber::offerFrame(const AVFrame *frame, bool changed)
+{
+    if (!frame) {
+        return;
+    }
+
+    bool notify = false;
+    {
+        // held while measuring: a few regions cost far less than the decoding
+        QMutexLocker locker(&m_mutex);
+        // changed covers the chroma planes too, colour probes can rely on it
+        if (m_probes.isEmpty() || (!changed && !m_probesChanged)) {
+            return;
+        }
+        m_probesChanged = false;
+
+        qint64 now = QDateTime::currentMSecsSinceEpoch();
+        for (auto &state : m_probes) {
+            const qsc::RegionProbe &probe = state.probe;
+            qsc::RegionProbeEvent event;
+            if (!measure(frame, probe.rect, event.color, event.hash)) {
+                continue;
+            }
+
+            bool hasMatch = probe.matchColor || probe.matchHash;
+            bool matched = hasMatch;
+            if (probe.matchColor && channelDistance(event.color, probe.color) > probe.colorTolerance) {
+                matched = false;
+            }
+            if (probe.matchHash && bitCount(event.hash ^ probe.hash) > probe.hashTolerance) {
+                matched = false;
+            }
+            event.id = probe.id;
+            event.matched = matched;
+            event.matchChanged = hasMatch && (!state.evaluated || matched != state.matched);
+            // the first result is the baseline changes are measured against
+            event.changed = probe.reportChanges && (!state.evaluated || bitCount(event.hash ^ state.hash) > probe.changeTolerance);
+            event.timestampMs = now;
+
+            state.matched = matched;
+            if (!state.evaluated || event.changed) {
+                state.hash = event.hash;
+            }
+            state.evaluated = true;
+
+            if (event.matchChanged || event.changed) {
+                if (RP_MAX_PENDING_EVENTS <= m_events.size()) {
+                    m_events.removeFirst();
+                }
+                m_events.append(event);
+                notify = !m_pending;
+                m_pending = true;
+            }
+        }
+    }
+    if (notify) {
+        emit eventsReady();
+    }
+}
+
+QList<qsc::RegionProbeEvent> RegionProber::takeEvents()
+{
+    QMutexLocker locker(&m_mutex);
+    QList<qsc::RegionProbeEvent> events;
+    events.swap(m_events);
+    m_pending = false;
+    return events;
+}
+
+bool RegionProber::measure(const AVFrame *frame, const QRect &rect, quint32 &color, quint64 &hash)
+{
+    AVPixelFormat format = static_cast<AVPixelFormat>(frame->format);
+    bool fullRange = AV_PIX_FMT_YUVJ420P == format || AVCOL_RANGE_JPEG == frame->color_range;
+    if (AV_PIX_FMT_YUV420P != format && AV_PIX_FMT_YUVJ420P != format) {
+        return false;
+    }
+    QRect area = rect.intersected(QRect(0, 0, frame->width, frame->height));
+    if (area.isEmpty()) {
+        return false;
+    }
+
+    // luma cells; a region narrower than the grid leaves empty cells at 0
+    quint64 cells[RP_HASH_ROWS][RP_HASH_COLUMNS];
+    quint64 lumaSum = 0;
+    int width = area.width();
+    int height = area.height();
+    for (int row = 0; row < RP_HASH_ROWS; row++) {
+        int top = area.top() + row * height / RP_HASH_ROWS;
+        int bottom = area.top() + (row + 1) * height / RP_HASH_ROWS;
+        for (int column = 0; column < RP_HASH_COLUMNS; column++) {
+            int left = area.left() + column * width / RP_HASH_COLUMNS;
+            int right = area.left() + (column + 1) * width / RP_HASH_COLUMNS;
+            quint64 sum = planeSum(frame->data[0], frame->linesize[0], left, top, right - left, bottom - top);
+            lumaSum += sum;
+            qint64 count = static_cast<qint64>(right - left) * (bottom - top);
+            // compared as means, scaled to keep the fraction
+            cells[row][column] = 0 < count ? sum * 256 / static_cast<quint64>(count) : 0;
+        }
+    }
+    hash = 0;
+    for (int row = 0; row < RP_HASH_ROWS; row++) {
+        for (int column = 0; column < RP_HASH_COLUMNS - 1; column++) {
+            hash = (hash << 1) | (cells[row][column] > cells[row][column + 1] ? 1 : 0);
+        }
+    }
+
+    // chroma is half size in both directions
+    int chromaLeft = area.left() / 2;
+    int chromaTop = area.top() / 2;
+    int chromaWidth = qMax(1, (area.right() + 1 + 1) / 2 - chromaLeft);
+    int chromaHeight = qMax(1, (area.bottom() + 1 + 1) / 2 - chromaTop);
+    double chromaCount = static_cast<double>(chromaWidth) * chromaHeight;
+    double y = static_cast<double>(lumaSum) / (static_cast<double>(width) * height);
+    double u = planeSum(frame->data[1], frame->linesize[1], chromaLeft, chromaTop, chromaWidth, chromaHeight) / chromaCount;
+    double v = planeSum(frame->data[2], frame->linesize[2], chromaLeft, chromaTop, chromaWidth, chromaHeight) / chromaCount;
+    color = toRgb(y, u, v, fullRange);
+    return true;
+}
@@ -0,0 +1,56 @@
+#ifndef REGIONPROBER_H
+#define REGIONPROBER_H
+#include <QList>
+#include <QMutex>
+#include <QObject>
+
+#include "ZentroidCoreDef.h"
+
+// forward declarations
+typedef struct AVFrame AVFrame;
+
+// Checks screen regions on the decoded yuv frame for test automation: the mean
+// colour comes from the y, u and v planes averaged over the region, the hash is
+// a 64 bit difference hash of the luma (9x8 cell means, one bit per
+// neighbouring pair) so encoder noise moves few bits. Nothing is converted to
+// rgb or copied. Frames identical to the one before in all three planes are
+// not looked at: a colour change that leaves the luma alone still counts.
+class RegionProber : public QObject
+{
+    Q_OBJECT
+public:
+    explicit RegionProber(QObject *parent = Q_NULLPTR);
+    virtual ~RegionProber();
+
+    // any thread, replaces the probes and their state
+    void setProbes(const QList<qsc::RegionProbe> &probes);
+    // decoding thread, every decoded frame
+    void offerFrame(const AVFrame *frame, bool changed);
+    // the events since the last call
+    QList<qsc::RegionProbeEvent> takeEvents();
+
+signals:
+    // events wait in takeEvents, not emitted again until they are taken
+    void eventsReady();
+
+private:
+    struct ProbeState
+    {
+        qsc::RegionProbe probe;
+        bool evaluated = false;
+        bool matched = false;
+        quint64 hash = 0;
+    };
+
+    bool measure(const AVFrame *frame, const QRect &rect, quint32 &color, quint64 &hash);
+
+private:
+    QMutex m_mutex;
+    QList<ProbeState> m_probes;
+    // new probes are checked on the next frame, changed or not
+    bool m_probesChanged = false;
+    QList<qsc::RegionProbeEvent> m_events;
+    bool m_pending = false;
+};
+
+#endif // REGIONPROBER_H
@@ -0,0 +1,369 @@
+#include <QElapsedTimer>
+#include <QtMath>
+#include <QRunnable>
+#include <QVector>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TL_HAS_SSE2
+#endif
+
+extern "C"
+{
+#include "libavutil/frame.h"
+}
+
+#include "templatelocator.h"
+
+// the pyramid stops before the template side gets smaller than this; smaller
+// templates lose their detail to the half pixel phase of the coarse grid
+#define TL_MIN_SIDE 24
+#define TL_MAX_LEVELS 4
+// coarse candidates kept for refinement, and how much lower they may score
+#define TL_CANDIDATES 8
+#define TL_COARSE_SLACK 0.25
+// a refined position is searched this far around twice the coarse one
+#define TL_REFINE_RADIUS 2
+// windows flatter than this (variance per pixel) cannot hold the element
+#define TL_FLAT_VARIANCE 4.0
+
+namespace {
+
+struct Plane
+{
+    int width = 0;
+    int height = 0;
+    QVector<quint8> data;
+
+    const quint8 *row(int y) const { return data.constData() + static_cast<qint64>(y) * width; }
+};
+
+// sums of pixels and squared pixels, (width + 1) * (height + 1)
+struct Integral
+{
+    int stride = 0;
+    QVector<quint64> sum;
+    QVector<quint64> squares;
+
+    void build(const Plane &plane)
+    {
+        stride = plane.width + 1;
+        sum.fill(0, stride * (plane.height + 1));
+        squares.fill(0, stride * (plane.height + 1));
+        for (int y = 0; y < plane.height; y++) {
+            const quint8 *row = plane.row(y);
+            quint64 rowSum = 0;
+            quint64 rowSquares = 0;
+            for (int x = 0; x < plane.width; x++) {
+                rowSum += row[x];
+                rowSquares += static_cast<quint64>(row[x]) * row[x];
+                int index = (y + 1) * stride + x + 1;
+                sum[index] = sum[index - stride] + rowSum;
+                squares[index] = squares[index - stride] + rowSquares;
+            }
+        }
+    }
+
+    static quint64 area(const QVector<quint64> &table, int stride, int x, int y, int width, int height)
+    {
+        const quint64 *t = table.constData();
+        return t[(y + height) * stride + x + width] - t[y * stride + x + width] - t[(y + height) * stride + x] + t[y * stride + x];
+    }
+};
+
+struct Level
+{
+    Plane image;
+    Integral integral; // coarsest level only, the finer ones only see a few windows
+    Plane templ;
+    double templSum = 0.0;
+    double templNorm = 0.0; // sqrt of the summed squared deviation
+};
+
+Plane halve(const Plane &plane)
+{
+    Plane half;
+    half.width = plane.width / 2;
+    half.height = plane.height / 2;
+    half.data.resize(half.width * half.height);
+    quint8 *out = half.data.data();
+    for (int y = 0; y < half.height; y++) {
+        const quint8 *top = plane.row(y * 2);
+        const quint8 *bottom = plane.row(y * 2 + 1);
+        for (int x = 0; x < half.width; x++) {
+            *out++ = static_cast<quint8>((top[x * 2] + top[x * 2 + 1] + bottom[x * 2] + bottom[x * 2 + 1] + 2) / 4);
+        }
+    }
+    return half;
+}
+
+quint64 dotRow(const quint8 *a, const quint8 *b, int count)
+{
+    quint64 total = 0;
+    int x = 0;
+#ifdef TL_HAS_SSE2
+    // 16 pixels a step: widen to 16 bit, madd gives 32 bit pair sums, at most
+    // 2 * 255 * 255 per lane per step, flushed before a lane can overflow
+    const __m128i zero = _mm_setzero_si128();
+    while (x + 16 <= count) {
+        __m128i acc = _mm_setzero_si128();
+        int end = qMin(count & ~15, x + 16 * 1024);
+        for (; x < end; x += 16) {
+            __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + x));
+            __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + x));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero)));
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero)));
+        }
+        alignas(16) quint32 lanes[4];
+        _mm_store_si128(reinterpret_cast<__m128i *>(lanes), acc);
+        total += static_cast<quint64>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+    }
+#endif
+    for (; x < count; x++) {
+        total += static_cast<quint64>(a[x]) * b[x];
+    }
+    return total;
+}
+
+// -2 for a window that cannot match
+double scoreAt(const Level &level, int x, int y)
+{
+    const Plane &templ = level.templ;
+    double count = static_cast<double>(templ.width) * templ.height;
+    double sum = 0.0;
+    double squares = 0.0;
+    if (0 < level.integral.stride) {
+        sum = static_cast<double>(Integral::area(level.integral.sum, level.integral.stride, x, y, templ.width, templ.height));
+        squares = static_cast<double>(Integral::area(level.integral.squares, level.integral.stride, x, y, templ.width, templ.height));
+    } else {
+        for (int row = 0; row < templ.height; row++) {
+            const quint8 *pixels = level.image.row(y + row) + x;
+            sum += static_cast<double>(std::accumulate(pixels, pixels + templ.width, static_cast<quint64>(0)));
+            squares += static_cast<double>(dotRow(pixels, pixels, templ.width));
+        }
+    }
+    double variance = squares - sum * sum / count;
+    if (variance < TL_FLAT_VARIANCE * count) {
+        return -2.0;
+    }
+
+    quint64 dot = 0;
+    for (int row = 0; row < templ.height; row++) {
+        dot += dotRow(level.image.row(y + row) + x, templ.row(row), templ.width);
+    }
+    return (static_cast<double>(dot) - sum * level.templSum / count) / (std::sqrt(variance) * level.templNorm);
+}
+
+struct Candidate
+{
+    Candidate() {}
+    Candidate(int x, int y, double score) : x(x), y(y), score(score) {}
+
+    int x = 0;
+    int y = 0;
+    double score = -2.0;
+};
+
+class LocateJob : public QRunnable
+{
+public:
+    LocateJob(const Plane &image, const Plane &templ, const QRect &area, double minScore, QObject *context,
+              std::function<void(const qsc::TemplateMatch &)> onResult)
+        : m_image(image)
+        , m_templ(templ)
+        , m_area(area)
+        , m_minScore(minScore)
+        , m_context(context)
+        , m_onResult(onResult)
+    {
+    }
+
+    void run() override
+    {
+        QElapsedTimer timer;
+        timer.start();
+        qsc::TemplateMatch match = search();
+        match.frameSize = QSize(m_image.width, m_image.height);
+        match.elapsedMs = static_cast<int>(timer.elapsed());
+
+        // the locator waits for its jobs before it goes, the context is alive here
+        std::function<void(const qsc::TemplateMatch &)> onResult = m_onResult;
+        QMetaObject::invokeMethod(m_context, [onResult, match]() {
+            if (onResult) {
+                onResult(match);
+            }
+        }, Qt::QueuedConnection);
+    }
+
+private:
+    qsc::TemplateMatch search()
+    {
+        qsc::TemplateMatch match;
+        QVector<Level> levels(1);
+        levels[0].image = m_image;
+        levels[0].templ = m_templ;
+        while (TL_MAX_LEVELS > levels.size()) {
+            const Level &last = levels.last();
+            if (TL_MIN_SIDE > qMin(last.templ.width, last.templ.height) / 2) {
+                break;
+            }
+            Level next;
+            next.image = halve(last.image);
+            next.templ = halve(last.templ);
+            levels.append(next);
+        }
+        levels.last().integral.build(levels.last().image);
+        for (auto &level : levels) {
+            double sum = 0.0;
+            double squares = 0.0;
+            for (quint8 value : level.templ.data) {
+                sum += value;
+                squares += static_cast<double>(value) * value;
+            }
+            double count = level.templ.data.size();
+            level.templSum = sum;
+            level.templNorm = std::sqrt(qMax(0.0, squares - sum * sum / count));
+        }
+        if (TL_FLAT_VARIANCE * m_templ.data.size() > levels[0].templNorm * levels[0].templNorm) {
+            qWarning("TemplateLocator::template is flat, nothing to correlate");
+            return match;
+        }
+
+        // every window of the area at the coarsest level
+        int top = levels.size() - 1;
+        const Level &coarse = levels[top];
+        QRect area(m_area.left() >> top, m_area.top() >> top, m_area.width() >> top, m_area.height() >> top);
+        int lastX = qMin(area.right() + 1, coarse.image.width) - coarse.templ.width;
+        int lastY = qMin(area.bottom() + 1, coarse.image.height) - coarse.templ.height;
+        QVector<Candidate> scored;
+        for (int y = area.top(); y <= lastY; y++) {
+            for (int x = area.left(); x <= lastX; x++) {
+                double score = scoreAt(coarse, x, y);
+                if (score >= m_minScore - TL_COARSE_SLACK) {
+                    scored.append(Candidate(x, y, score));
+                }
+            }
+        }
+        std::sort(scored.begin(), scored.end(), [](const Candidate &a, const Candidate &b) { return a.score > b.score; });
+
+        // strongest first, one candidate per template sized neighbourhood
+        QVector<Candidate> candidates;
+        for (const auto &candidate : scored) {
+            bool near = false;
+            for (const auto &kept : candidates) {
+                if (qAbs(kept.x - candidate.x) < coarse.templ.width / 2 && qAbs(kept.y - candidate.y) < coarse.templ.height / 2) {
+                    near = true;
+                    break;
+                }
+            }
+            if (!near) {
+                candidates.append(candidate);
+                if (TL_CANDIDATES <= candidates.size()) {
+                    break;
+                }
+            }
+        }
+
+        Candidate best;
+        for (auto candidate : candidates) {
+            for (int index = top - 1; index >= 0; index--) {
+                const Level &level = levels[index];
+                int centerX = candidate.x * 2;
+                int centerY = candidate.y * 2;
+                candidate.score = -2.0;
+                for (int y = qMax(0, centerY - TL_REFINE_RADIUS); y <= qMin(level.image.height - level.templ.height, centerY + TL_REFINE_RADIUS); y++) {
+                    for (int x = qMax(0, centerX - TL_REFINE_RADIUS); x <= qMin(level.image.width - level.templ.width, centerX + TL_REFINE_RADIUS); x++) {
+                        double score = scoreAt(level, x, y);
+                        if (score > candidate.score) {
+                            candidate = Candidate(x, y, score);
+                        }
+                    }
+                }
+            }
+            if (candidate.score > best.score) {
+                best = candidate;
+            }
+        }
+        if (-2.0 >= best.score) {
+            return match;
+        }
+
+        double width = m_image.width;
+        double height = m_image.height;
+        match.score = best.score;
+        match.found = best.score >= m_minScore;
+        match.rect = QRectF(best.x / width, best.y / height, m_templ.width / width, m_templ.height / height);
+        match.pos = match.rect.center();
+        return match;
+    }
+
+private:
+    Plane m_image;
+    Plane m_templ;
+    QRect m_area;
+    double m_minScore;
+    QObject *m_context;
+    std::function<void(const qsc::TemplateMatch &)> m_onResult;
+};
+
+}
+
+TemplateLocator::TemplateLocator(QObject *parent) : QObject(parent)
+{
+    m_pool.setMaxThreadCount(1);
+}
+
+TemplateLocator::~TemplateLocator()
+{
+    // queued searches are dropped, a running one finishes before we go
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+bool TemplateLocator::locate(const AVFrame *frame, const qsc::TemplateSearch &search, std::function<void(const qsc::TemplateMatch &)> onResult)
+{
+    if (!frame || !frame->data[0] || 0 >= frame->width || 0 >= frame->height || search.image.isNull()) {
+        return false;
+    }
+
+    QImage image = search.image;
+    if (search.sourceSize.isValid() && search.sourceSize != QSize(frame->width, frame->height)) {
+        QSize size(qRound(static_cast<double>(image.width()) * frame->width / search.sourceSize.width()),
+                   qRound(static_cast<double>(image.height()) * frame->height / search.sourceSize.height()));
+        image = image.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+    }
+    image = image.convertToFormat(QImage::Format_Grayscale8);
+    if (image.isNull() || image.width() > frame->width || image.height() > frame->height) {
+        qWarning("TemplateLocator::template larger than the frame");
+        return false;
+    }
+    QRect area = QRect(qFloor(search.area.left() * frame->width), qFloor(search.area.top() * frame->height),
+                       qCeil(search.area.width() * frame->width), qCeil(search.area.height() * frame->height))
+                     .intersected(QRect(0, 0, frame->width, frame->height));
+    if (area.width() < image.width() || area.height() < image.height()) {
+        qWarning("TemplateLocator::search area smaller than the template");
+        return false;
+    }
+
+    Plane luma;
+    luma.width = frame->width;
+    luma.height = frame->height;
+    luma.data.resize(luma.width * luma.height);
+    for (int y = 0; y < luma.height; y++) {
+        memcpy(luma.data.data() + static_cast<qint64>(y) * luma.width, frame->data[0] + static_cast<qint64>(y) * frame->linesize[0], luma.width);
+    }
+    Plane templ;
+    templ.width = image.width();
+    templ.height = image.height();
+    templ.data.resize(templ.width * templ.height);
+    for (int y = 0; y < templ.height; y++) {
+        memcpy(templ.data.data() + static_cast<qint64>(y) * templ.width, image.constScanLine(y), templ.width);
+    }
+
+    m_pool.start(new LocateJob(luma, templ, area, search.minScore, this, onResult));
+    return true;
+}
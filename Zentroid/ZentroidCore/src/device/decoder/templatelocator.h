@@ -0,0 +1,35 @@
+#ifndef TEMPLATELOCATOR_H
+#define TEMPLATELOCATOR_H
+#include <functional>
+#include <QObject>
+#include <QThreadPool>
+
+#include "ZentroidCoreDef.h"
+
+// forward declarations
+typedef struct AVFrame AVFrame;
+
+// Finds an element on the luma plane of a decoded frame by normalized cross
+// correlation, which ignores brightness and contrast differences (and so the
+// limited range luma against a full range grayscale template).
+// Frame and template are halved into a pyramid until the template gets small,
+// the whole area is searched at the coarsest level and the best candidates
+// are refined level by level. Integral images give every window its mean and
+// variance for free, flat windows are skipped before the sse2 correlation.
+// Every device has one worker thread, requests run in order.
+class TemplateLocator : public QObject
+{
+    Q_OBJECT
+public:
+    explicit TemplateLocator(QObject *parent = Q_NULLPTR);
+    virtual ~TemplateLocator();
+
+    // copies the luma plane of frame and queues the search; onResult runs on
+    // this object's thread
+    bool locate(const AVFrame *frame, const qsc::TemplateSearch &search, std::function<void(const qsc::TemplateMatch &match)> onResult);
+
+private:
+    QThreadPool m_pool;
+};
+
+#endif // TEMPLATELOCATOR_H
@@ -0,0 +1,110 @@
+#include <QMutexLocker>
+
+#include "thumbnailer.h"
+
+Thumbnailer::Thumbnailer(QObject *parent) : QObject(parent) {}
+
+Thumbnailer::~Thumbnailer()
+{
+    m_convert.deInit();
+}
+
+void Thumbnailer::setOutput(int width, int maxFps)
+{
+    m_maxFps.storeRelease(qMax(0, maxFps));
+    m_width.storeRelease(qMax(0, width));
+}
+
+void Thumbnailer::offerFrame(const AVFrame *frame, bool changed)
+{
+    int width = m_width.loadAcquire();
+    if (0 >= width) {
+        // the first thumbnail after turning it on must not wait for a change
+        m_stale = true;
+        return;
+    }
+    m_stale = m_stale || changed;
+    if (!m_stale || !frame) {
+        return;
+    }
+
+    if (!m_clock.isValid()) {
+        m_clock.start();
+    }
+    qint64 now = m_clock.elapsed();
+    int maxFps = m_maxFps.loadAcquire();
+    if (0 < maxFps && 0 <= m_lastMs && now - m_lastMs < 1000 / maxFps) {
+        return;
+    }
+
+    QImage image;
+    if (!scale(frame, width, image)) {
+        return;
+    }
+    m_lastMs = now;
+    m_stale = false;
+
+    bool notify = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        m_thumbnail = image;
+        notify = !m_pending;
+        m_pending = true;
+    }
+    if (notify) {
+        emit thumbnailReady();
+    }
+}
+
+QImage Thumbnailer::takeThumbnail()
+{
+    QMutexLocker locker(&m_mutex);
+    QImage image = m_thumbnail;
+    m_thumbnail = QImage();
+    m_pending = false;
+    return image;
+}
+
+bool Thumbnailer::scale(const AVFrame *frame, int width, QImage &image)
+{
+    if (!frame->data[0] || 0 >= frame->width || 0 >= frame->height) {
+        return false;
+    }
+    // never scale up, keep the height even for the chroma planes
+    width = qMin(width, frame->width) & ~1;
+    int height = qMax(2, static_cast<int>(static_cast<qint64>(width) * frame->height / frame->width) & ~1);
+    if (2 > width) {
+        return false;
+    }
+
+    int srcWidth = 0;
+    int srcHeight = 0;
+    AVPixelFormat srcFormat = AV_PIX_FMT_NONE;
+    int dstWidth = 0;
+    int dstHeight = 0;
+    AVPixelFormat dstFormat = AV_PIX_FMT_NONE;
+    m_convert.getSrcFrameInfo(srcWidth, srcHeight, srcFormat);
+    m_convert.getDstFrameInfo(dstWidth, dstHeight, dstFormat);
+    if (srcWidth != frame->width || srcHeight != frame->height || srcFormat != frame->format || dstWidth != width || dstHeight != height) {
+        m_convert.deInit();
+        m_convert.setSrcFrameInfo(frame->width, frame->height, static_cast<AVPixelFormat>(frame->format));
+        m_convert.setDstFrameInfo(width, height, AV_PIX_FMT_RGB32);
+    }
+    // area averages every source pixel, bilinear would alias text at these ratios
+    if (!m_convert.isInit() && !m_convert.init(SWS_AREA)) {
+        qWarning("Thumbnailer::init convert failed");
+        return false;
+    }
+
+    image = QImage(width, height, QImage::Format_RGB32);
+    AVFrame *dst = av_frame_alloc();
+    if (image.isNull() || !dst) {
+        av_frame_free(&dst);
+        return false;
+    }
+    dst->data[0] = image.bits();
+    dst->linesize[0] = image.bytesPerLine();
+    bool ok = m_convert.convert(frame, dst);
+    av_frame_free(&dst);
+    return ok;
+}
@@ -0,0 +1,54 @@
+#ifndef THUMBNAILER_H
+#define THUMBNAILER_H
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QImage>
+#include <QMutex>
+#include <QObject>
+
+#include "avframeconvert.h"
+
+// Scales decoded frames down to a small rgb image for overview pages.
+// The frame is converted and scaled in one swscale pass (area filter, simd
+// where ffmpeg has it) on the decoding thread, at most maxFps times a second
+// and only when the picture changed. A thumbnail the main thread has not taken
+// yet is replaced, never queued.
+class Thumbnailer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit Thumbnailer(QObject *parent = Q_NULLPTR);
+    virtual ~Thumbnailer();
+
+    // any thread, 0 width turns it off
+    void setOutput(int width, int maxFps);
+    // decoding thread, every decoded frame
+    void offerFrame(const AVFrame *frame, bool changed);
+    // the latest thumbnail, null once taken
+    QImage takeThumbnail();
+
+signals:
+    // a thumbnail waits in takeThumbnail, not emitted again until it is taken
+    void thumbnailReady();
+
+private:
+    bool scale(const AVFrame *frame, int width, QImage &image);
+
+private:
+    QAtomicInt m_width;
+    QAtomicInt m_maxFps;
+
+    // decoding thread only
+    AVFrameConvert m_convert;
+    QElapsedTimer m_clock;
+    qint64 m_lastMs = -1;
+    // a change not shown yet, the encoder repeats the last frame of a still
+    // screen so a change held back by the rate cap goes out with it
+    bool m_stale = true;
+
+    QMutex m_mutex;
+    QImage m_thumbnail;
+    bool m_pending = false;
+};
+
+#endif // THUMBNAILER_H
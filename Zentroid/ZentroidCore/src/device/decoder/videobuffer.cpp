@@ -1,10 +1,11 @@
+#include <algorithm>
+
 #include "videobuffer.h"
-#include "avframeconvert.h"
+#include "framediff.h"
 extern "C"
 {
 #include "libavformat/avformat.h"
 #include "libavutil/avutil.h"
-#include "libavutil/imgutils.h"
 }
 
 VideoBuffer::VideoBuffer(QObject *parent) : QObject(parent) {
@@ -70,7 +71,7 @@ AVFrame *VideoBuffer::decodingFrame()
     return m_decodingFrame;
 }
 
-void VideoBuffer::offerDecodedFrame(bool &previousFrameSkipped)
+void VideoBuffer::offerDecodedFrame(bool &previousFrameSkipped, const FrameDiff *diff)
 {
     m_mutex.lock();
 
@@ -89,6 +90,25 @@ void VideoBuffer::offerDecodedFrame(bool &previousFrameSkipped)
     swap();
     previousFrameSkipped = !m_renderingFrameConsumed;
     m_renderingFrameConsumed = false;
+
+    if (diff) {
+        const QVector<quint8> &tiles = diff->tiles();
+        if (m_renderingDirty.size() != tiles.size()) {
+            m_renderingDirty = tiles;
+            m_renderingChanged = diff->changed();
+        } else if (previousFrameSkipped) {
+            // the changes of the skipped frame were never shown
+            quint8 *dirty = m_renderingDirty.data();
+            for (int i = 0; i < tiles.size(); i++) {
+                dirty[i] |= tiles[i];
+            }
+            m_renderingChanged = m_renderingChanged || diff->changed();
+        } else {
+            // copied in place, sharing would make both sides reallocate every frame
+            std::copy(tiles.constBegin(), tiles.constEnd(), m_renderingDirty.begin());
+            m_renderingChanged = diff->changed();
+        }
+    }
     m_mutex.unlock();
 }
 
@@ -107,52 +127,28 @@ const AVFrame *VideoBuffer::consumeRenderedFrame()
     return m_renderingframe;
 }
 
-void VideoBuffer::peekRenderedFrame(std::function<void(int width, int height, uint8_t* dataRGB32)> onFrame)
+bool VideoBuffer::renderedFrameChanged()
+{
+    return m_renderingChanged;
+}
+
+const QVector<quint8> &VideoBuffer::renderedDirtyTiles()
+{
+    return m_renderingDirty;
+}
+
+void VideoBuffer::peekRenderedFrame(std::function<void(const AVFrame *frame)> onFrame)
 {
     if (!onFrame) {
         return;
     }
 
+    // the last frame stays valid after it was consumed, it is only swapped out
     lock();
-    auto frame = m_renderingframe;
-    int width = frame->width;
-    int height = frame->height;
-    int linesize = frame->linesize[0];
-
-    // create buffer
-    uint8_t* rgbBuffer = new uint8_t[linesize * height * 4];
-    AVFrame *rgbFrame = av_frame_alloc();
-    if (!rgbFrame) {
-        delete [] rgbBuffer;
-        return;
-    }
-
-    // bind buffer to AVFrame
-    av_image_fill_arrays(rgbFrame->data, rgbFrame->linesize, rgbBuffer, AV_PIX_FMT_RGB32, width, height, 4);
-
-    // convert
-    AVFrameConvert convert;
-    convert.setSrcFrameInfo(width, height, AV_PIX_FMT_YUV420P);
-    convert.setDstFrameInfo(width, height, AV_PIX_FMT_RGB32);
-    bool ret = false;
-    ret = convert.init();
-    if (!ret) {
-        delete [] rgbBuffer;
-        av_free(rgbFrame);
-        return;
-    }
-    ret = convert.convert(frame, rgbFrame);
-    if (!ret) {
-        delete [] rgbBuffer;
-        av_free(rgbFrame);
-        return;
+    if (0 < m_renderingframe->width && 0 < m_renderingframe->height) {
+        onFrame(m_renderingframe);
     }
-    convert.deInit();
-    av_free(rgbFrame);
     unLock();
-
-    onFrame(width, height, rgbBuffer);
-    delete [] rgbBuffer;
 }
 
 void VideoBuffer::interrupt()
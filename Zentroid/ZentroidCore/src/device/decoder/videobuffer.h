@@ -2,6 +2,7 @@
 #define VIDEO_BUFFER_H
 
 #include <QMutex>
+#include <QVector>
 #include <QWaitCondition>
 #include <QObject>
 
@@ -10,6 +11,7 @@
 
 // forward declarations
 typedef struct AVFrame AVFrame;
+class FrameDiff;
 
 class VideoBuffer : public QObject
 {
@@ -28,15 +30,21 @@ public:
     // set the decoder frame as ready for rendering
     // this function locks m_mutex during its execution
     // returns true if the previous frame had been consumed
-    void offerDecodedFrame(bool &previousFrameSkipped);
+    // diff compares the decoded frame with the one decoded before it
+    void offerDecodedFrame(bool &previousFrameSkipped, const FrameDiff *diff = Q_NULLPTR);
 
     // mark the rendering frame as consumed and return it
     // MUST be called with m_mutex locked!!!
     // the caller is expected to render the returned frame to some texture before
     // unlocking m_mutex
     const AVFrame *consumeRenderedFrame();
+    // tiles changed since the previously consumed frame, skipped frames included
+    // MUST be called with m_mutex locked!!!
+    bool renderedFrameChanged();
+    const QVector<quint8> &renderedDirtyTiles();
 
-    void peekRenderedFrame(std::function<void(int width, int height, uint8_t* dataRGB32)> onFrame);
+    // the last decoded frame (yuv) under m_mutex, nothing if there is none yet
+    void peekRenderedFrame(std::function<void(const AVFrame *frame)> onFrame);
 
     // wake up and avoid any blocking call
     void interrupt();
@@ -52,6 +60,8 @@ private:
     AVFrame *m_renderingframe = Q_NULLPTR;
     QMutex m_mutex;
     bool m_renderingFrameConsumed = true;
+    bool m_renderingChanged = true;
+    QVector<quint8> m_renderingDirty;
     FpsCounter m_fpsCounter;
 
     bool m_renderExpiredFrames = false;
@@ -1,3 +1,4 @@
+#include <climits>
 #include <QDebug>
 #include <QTime>
 
@@ -96,7 +97,7 @@ qint32 Demuxer::recvData(quint8 *buf, qint32 bufSize)
         return 0;
     }
 
-    qint32 len = m_videoSocket->subThreadRecvData(buf, bufSize);
+    qint32 len = m_videoSocket->subThreadRecvData(buf, bufSize, &m_stopRequest);
     return len;
 }
 
@@ -105,6 +106,7 @@ bool Demuxer::startDecode()
     if (!m_videoSocket) {
         return false;
     }
+    m_stopRequest.storeRelease(0);
     start();
     return true;
 }
@@ -114,6 +116,26 @@ void Demuxer::stopDecode()
     wait();
 }
 
+void Demuxer::requestStop()
+{
+    m_stopRequest.storeRelease(1);
+}
+
+quint32 Demuxer::packetCount()
+{
+    return static_cast<quint32>(m_packetCount.loadAcquire());
+}
+
+quint32 Demuxer::recvBytes()
+{
+    return static_cast<quint32>(m_recvBytes.loadAcquire());
+}
+
+quint32 Demuxer::backlogBytes()
+{
+    return static_cast<quint32>(m_backlogBytes.loadAcquire());
+}
+
 void Demuxer::run()
 {
     m_codecCtx = Q_NULLPTR;
@@ -248,6 +270,11 @@ bool Demuxer::recvPacket(AVPacket *packet)
     }
 
     packet->dts = packet->pts;
+    m_packetCount.fetchAndAddRelease(1);
+    m_recvBytes.fetchAndAddRelease(static_cast<int>(HEADER_SIZE + len));
+    if (m_videoSocket) {
+        m_backlogBytes.storeRelease(static_cast<int>(qMin<qint64>(m_videoSocket->bytesAvailable(), INT_MAX)));
+    }
     return true;
 }
 
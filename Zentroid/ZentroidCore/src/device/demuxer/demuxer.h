@@ -1,6 +1,7 @@
 #ifndef STREAM_H
 #define STREAM_H
 
+#include <QAtomicInt>
 #include <QPointer>
 #include <QSize>
 #include <QThread>
@@ -27,6 +28,14 @@ public:
     void setFrameSize(const QSize &frameSize);
     bool startDecode();
     void stopDecode();
+    // unblocks a stalled read from any thread, run() then ends as on a socket error
+    void requestStop();
+    // packets received so far, readable from any thread
+    quint32 packetCount();
+    // stream bytes received so far, wraps around
+    quint32 recvBytes();
+    // bytes already waiting in the socket after the last packet: the read side falls behind
+    quint32 backlogBytes();
 
 signals:
     void onStreamStop();
@@ -51,6 +60,11 @@ private:
     // successive packets may need to be concatenated, until a non-config
     // packet is available
     AVPacket* m_pending = Q_NULLPTR;
+
+    QAtomicInt m_stopRequest;
+    QAtomicInt m_packetCount;
+    QAtomicInt m_recvBytes;
+    QAtomicInt m_backlogBytes;
 };
 
 #endif // STREAM_H
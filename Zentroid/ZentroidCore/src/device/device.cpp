@@ -1,5 +1,5 @@
+#include <QDateTime>
 #include <QDir>
-#include <QMessageBox>
 #include <QTimer>
 
 #include "controller.h"
@@ -7,34 +7,59 @@
 #include "decoder.h"
 #include "device.h"
 #include "filehandler.h"
+#include "inputrecorder.h"
 #include "recorder.h"
+#include "regionprober.h"
+#include "screenshooter.h"
 #include "server.h"
+#include "templatelocator.h"
+#include "thumbnailer.h"
 #include "demuxer.h"
 
+#define DEVICE_RECONNECT_DELAY 200
+// pcm format of the sndcpy audio stream
+#define DEVICE_AUDIO_SAMPLE_RATE 48000
+#define DEVICE_AUDIO_CHANNELS 2
+
 namespace qsc {
 
 Device::Device(DeviceParams params, QObject *parent) : IDevice(parent), m_params(params)
 {
-    if (!params.display && !m_params.recordFile) {
-        qCritical("not display must be recorded");
-        return;
-    }
-
+    // without display nothing is decoded; the stream is still read for the
+    // recorder and the packet callback, and control keeps working
     if (params.display) {
-        m_decoder = new Decoder([this](int width, int height, uint8_t* dataY, uint8_t* dataU, uint8_t* dataV, int linesizeY, int linesizeU, int linesizeV) {
+        m_decoder = new Decoder([this](int width, int height, uint8_t* dataY, uint8_t* dataU, uint8_t* dataV, int linesizeY, int linesizeU, int linesizeV,
+                                       const FrameDirtyMap &dirty) {
+            m_frameSize = QSize(width, height);
             for (const auto& item : m_deviceObservers) {
-                item->onFrame(width, height, dataY, dataU, dataV, linesizeY, linesizeU, linesizeV);
+                item->onFrameDiff(width, height, dataY, dataU, dataV, linesizeY, linesizeU, linesizeV, dirty);
             }
         }, this);
-        m_fileHandler = new FileHandler(this);
-        m_controller = new Controller([this](const QByteArray& buffer) -> qint64 {
-            if (!m_server || !m_server->getControlSocket()) {
-                return 0;
-            }
-
-            return m_server->getControlSocket()->write(buffer.data(), buffer.length());
-        }, params.gameScript, this);
+        m_screenshooter = new Screenshooter(m_params.serial, m_params.recordPath.trimmed(), m_params.screenshotFormat, m_params.screenshotQuality, this);
+        m_thumbnailer = new Thumbnailer(this);
+        m_thumbnailer->setOutput(m_params.thumbnailWidth, m_params.thumbnailFps);
+        m_regionProber = new RegionProber(this);
+        m_templateLocator = new TemplateLocator(this);
+        // burst captures, thumbnails and probes are taken from the frames as they are decoded
+        Screenshooter *screenshooter = m_screenshooter;
+        Thumbnailer *thumbnailer = m_thumbnailer;
+        RegionProber *regionProber = m_regionProber;
+        m_decoder->setFrameTap([screenshooter, thumbnailer, regionProber](const AVFrame *frame, bool changed) {
+            screenshooter->offerFrame(frame);
+            thumbnailer->offerFrame(frame, changed);
+            regionProber->offerFrame(frame, changed);
+        });
     }
+    m_fileHandler = new FileHandler(this);
+    m_controller = new Controller([this](const QByteArray& buffer) -> qint64 {
+        qint64 len = writeControl(buffer);
+        if (m_controlTap) {
+            m_controlTap(buffer);
+        }
+        return len;
+    }, params.gameScript, this);
+    m_controller->setMaxTouchPoints(params.maxTouchPoints);
+    m_controller->setRoundTripProbe(params.controlProbe);
 
     m_stream = new Demuxer(this);
 
@@ -58,6 +83,9 @@ Device::Device(DeviceParams params, QObject *parent) : IDevice(parent), m_params
             absFilePath = dir.absoluteFilePath(fileName);
         }
         m_recorder = new Recorder(absFilePath, this);
+        if (m_params.recordAudio) {
+            m_recorder->setAudioFormat(DEVICE_AUDIO_SAMPLE_RATE, DEVICE_AUDIO_CHANNELS);
+        }
     }
     initSignals();
 }
@@ -101,16 +129,85 @@ void Device::updateScript(QString script)
 
 void Device::screenshot()
 {
-    if (!m_decoder) {
+    if (!m_decoder || !m_screenshooter) {
         return;
     }
 
-    // screenshot
-    m_decoder->peekFrame([this](int width, int height, uint8_t* dataRGB32) {
-       saveFrame(width, height, dataRGB32);
+    // only the yuv copy happens here, the image is encoded in the background
+    m_decoder->peekFrame([this](const AVFrame *frame) {
+        m_screenshooter->capture(frame);
     });
 }
 
+bool Device::startScreenshotBurst(int everyNth, int count)
+{
+    if (!m_screenshooter) {
+        return false;
+    }
+    return m_screenshooter->startBurst(everyNth, count);
+}
+
+void Device::stopScreenshotBurst()
+{
+    if (m_screenshooter) {
+        m_screenshooter->stopBurst();
+    }
+}
+
+void Device::setThumbnail(int width, int maxFps)
+{
+    if (m_thumbnailer) {
+        m_thumbnailer->setOutput(width, maxFps);
+    }
+}
+
+void Device::onThumbnailReady()
+{
+    if (!m_thumbnailer) {
+        return;
+    }
+    QImage image = m_thumbnailer->takeThumbnail();
+    if (image.isNull()) {
+        return;
+    }
+    for (const auto &item : m_deviceObservers) {
+        item->onThumbnail(image);
+    }
+}
+
+void Device::setRegionProbes(const QList<RegionProbe> &probes)
+{
+    if (m_regionProber) {
+        m_regionProber->setProbes(probes);
+    }
+}
+
+bool Device::locateTemplate(const TemplateSearch &search, std::function<void(const TemplateMatch &)> onResult)
+{
+    if (!m_decoder || !m_templateLocator) {
+        return false;
+    }
+    // only the luma plane is copied here, the search runs in the background
+    bool started = false;
+    m_decoder->peekFrame([this, &search, &onResult, &started](const AVFrame *frame) {
+        started = m_templateLocator->locate(frame, search, onResult);
+    });
+    return started;
+}
+
+void Device::onRegionProbeEvents()
+{
+    if (!m_regionProber) {
+        return;
+    }
+    const QList<RegionProbeEvent> events = m_regionProber->takeEvents();
+    for (const auto &event : events) {
+        for (const auto &item : m_deviceObservers) {
+            item->onRegionProbe(event);
+        }
+    }
+}
+
 void Device::showTouch(bool show)
 {
     AdbProcess *adb = new qsc::AdbProcess();
@@ -127,6 +224,136 @@ void Device::showTouch(bool show)
     qInfo() << getSerial() << " show touch " << (show ? "enable" : "disable");
 }
 
+const DeviceConnectTimings &Device::getConnectTimings()
+{
+    return m_connectTimings;
+}
+
+void Device::setControlTap(std::function<void(const QByteArray &)> tap)
+{
+    m_controlTap = tap;
+}
+
+qint64 Device::writeControl(const QByteArray &buffer)
+{
+    if (!m_server || !m_server->getControlSocket()) {
+        return 0;
+    }
+
+    return m_server->getControlSocket()->write(buffer.data(), buffer.length());
+}
+
+void Device::probeControlRoundTrip()
+{
+    if (m_controller && m_serverStartSuccess) {
+        m_controller->probeRoundTrip();
+    }
+}
+
+qint64 Device::controlRoundTripUs()
+{
+    return m_controller ? m_controller->roundTripUs() : 0;
+}
+
+const QSize &Device::frameSize()
+{
+    return m_frameSize;
+}
+
+bool Device::isStreaming()
+{
+    return m_server && m_serverStartSuccess && !m_reconnecting;
+}
+
+quint32 Device::streamPacketCount()
+{
+    return m_stream ? m_stream->packetCount() : 0;
+}
+
+bool Device::isDecoding()
+{
+    return Q_NULLPTR != m_decoder;
+}
+
+quint32 Device::decodedFrameCount()
+{
+    return m_decoder ? m_decoder->decodedFrames() : 0;
+}
+
+quint32 Device::changedFrameCount()
+{
+    return m_decoder ? m_decoder->changedFrames() : 0;
+}
+
+int Device::controlLostProbes()
+{
+    return m_controller ? m_controller->lostProbes() : 0;
+}
+
+void Device::resetVideo()
+{
+    if (m_controller && isStreaming()) {
+        m_controller->resetVideo();
+    }
+}
+
+void Device::recoverStream()
+{
+    if (m_stream && isStreaming()) {
+        m_stream->requestStop();
+    }
+}
+
+void Device::setHealth(DeviceHealth health)
+{
+    for (const auto& item : m_deviceObservers) {
+        item->updateHealth(health);
+    }
+}
+
+quint32 Device::streamRecvBytes()
+{
+    return m_stream ? m_stream->recvBytes() : 0;
+}
+
+quint32 Device::streamBacklogBytes()
+{
+    return m_stream ? m_stream->backlogBytes() : 0;
+}
+
+quint32 Device::skippedFrameCount()
+{
+    return m_decoder ? m_decoder->skippedFrames() : 0;
+}
+
+quint32 Device::decodeTimeUs()
+{
+    return m_decoder ? m_decoder->decodeTimeUs() : 0;
+}
+
+quint16 Device::streamMaxSize()
+{
+    return m_server ? m_server->getParams().maxSize : m_params.maxSize;
+}
+
+quint32 Device::streamBitRate()
+{
+    return m_server ? m_server->getParams().bitRate : m_params.bitRate;
+}
+
+bool Device::reconfigureStream(quint16 maxSize, quint32 bitRate)
+{
+    // a recording cannot change its frame size midway
+    if (!isStreaming() || m_recorder) {
+        return false;
+    }
+
+    qInfo("%s: restarting the stream at %d max size, %u bps", m_params.serial.toUtf8().data(), maxSize, bitRate);
+    m_server->setVideoParams(maxSize, bitRate);
+    restartSession();
+    return true;
+}
+
 bool Device::isReversePort(quint16 port)
 {
     if (m_server && m_server->isReverse() && port == m_server->getParams().localPort) {
@@ -169,7 +396,30 @@ void Device::initSignals()
 
     if (m_server) {
         connect(m_server, &Server::serverStarted, this, [this](bool success, const QString &deviceName, const QSize &size) {
+            if (m_reconnecting) {
+                onReconnectResult(success);
+                if (success) {
+                    startStream(size);
+                    // the new server session starts with the screen on
+                    if (m_params.closeScreen && m_params.display && m_controller) {
+                        m_controller->setDisplayPower(false);
+                    }
+                }
+                return;
+            }
             m_serverStartSuccess = success;
+            if (success) {
+                m_frameSize = size;
+            }
+            Server::StartTimings timings = m_server->getStartTimings();
+            m_connectTimings.serial = m_params.serial;
+            m_connectTimings.success = success;
+            m_connectTimings.localPort = m_params.localPort;
+            m_connectTimings.pushMs = timings.pushMs;
+            m_connectTimings.tunnelMs = timings.tunnelMs;
+            m_connectTimings.executeMs = timings.executeMs;
+            m_connectTimings.connectMs = timings.connectMs;
+            m_connectTimings.totalMs = m_startTimeCount.elapsed();
             emit deviceConnected(success, m_params.serial, deviceName, size);
             if (success) {
                 double diff = m_startTimeCount.elapsed() / 1000.0;
@@ -192,29 +442,8 @@ void Device::initSignals()
                     m_decoder->open();
                 }
 
-                // init stream
-                m_stream->installVideoSocket(m_server->removeVideoSocket());
-                m_stream->setFrameSize(size);
-                m_stream->startDecode();
-
-                // recv device msg
-                connect(m_server->getControlSocket(), &QTcpSocket::readyRead, this, [this](){
-                    if (!m_controller) {
-                        return;
-                    }
-
-                    auto controlSocket = m_server->getControlSocket();
-                    while (controlSocket->bytesAvailable()) {
-                        QByteArray byteArray = controlSocket->peek(controlSocket->bytesAvailable());
-                        DeviceMsg deviceMsg;
-                        qint32 consume = deviceMsg.deserialize(byteArray);
-                        if (0 >= consume) {
-                            break;
-                        }
-                        controlSocket->read(consume);
-                        m_controller->recvDeviceMsg(&deviceMsg);
-                    }
-                });
+                m_reconnectLeft = m_params.reconnectAttempts;
+                startStream(size);
 
                 // only auto turn off screen when display is enabled (m_params.display)
                 if (m_params.closeScreen && m_params.display && m_controller) {
@@ -225,17 +454,18 @@ void Device::initSignals()
             }
         });
         connect(m_server, &Server::serverStoped, this, [this]() {
-            disconnectDevice();
             qDebug() << "server process stop";
+            onSessionLost();
         });
     }
 
     if (m_stream) {
         connect(m_stream, &Demuxer::onStreamStop, this, [this]() {
-            disconnectDevice();
             qDebug() << "stream thread stop";
+            onSessionLost();
         });
         connect(m_stream, &Demuxer::getFrame, this, [this](AVPacket *packet) {
+            forwardPacket(packet, false);
             if (m_decoder && !m_decoder->push(packet)) {
                 qCritical("Could not send packet to decoder");
             }
@@ -245,6 +475,7 @@ void Device::initSignals()
             }
         }, Qt::DirectConnection);
         connect(m_stream, &Demuxer::getConfigFrame, this, [this](AVPacket *packet) {
+            forwardPacket(packet, true);
             if (m_recorder && !m_recorder->push(packet)) {
                 qCritical("Could not send config packet to recorder");
             }
@@ -258,6 +489,120 @@ void Device::initSignals()
             }
         });
     }
+    if (m_thumbnailer) {
+        connect(m_thumbnailer, &Thumbnailer::thumbnailReady, this, &Device::onThumbnailReady);
+    }
+    if (m_regionProber) {
+        connect(m_regionProber, &RegionProber::eventsReady, this, &Device::onRegionProbeEvents);
+    }
+}
+
+void Device::onSessionLost()
+{
+    if (m_reconnecting) {
+        // the other half of the same drop
+        return;
+    }
+    // a recording would get a second stream with restarted timestamps
+    if (!m_server || !m_serverStartSuccess || !m_params.autoReconnect || m_recorder || 0 >= m_reconnectLeft) {
+        disconnectDevice();
+        return;
+    }
+
+    qInfo("%s: stream lost, reconnecting", m_params.serial.toUtf8().data());
+    m_reconnectLeft--;
+    restartSession();
+}
+
+void Device::restartSession()
+{
+    m_reconnecting = true;
+    m_server->stop(true);
+    if (m_stream) {
+        m_stream->requestStop();
+        m_stream->stopDecode();
+    }
+
+    // give a killed adb client time to exit before the server is executed again
+    QTimer::singleShot(DEVICE_RECONNECT_DELAY, this, [this]() {
+        if (!m_server || !m_reconnecting) {
+            return;
+        }
+        m_startTimeCount.start();
+        m_server->restart();
+    });
+}
+
+void Device::setVideoPacketCallback(std::function<void(const QByteArray &, bool, bool)> callback)
+{
+    QMutexLocker locker(&m_packetCallbackLock);
+    m_packetCallback = callback;
+}
+
+void Device::pushRecordAudio(const QByteArray &pcm)
+{
+    if (m_recorder) {
+        m_recorder->pushAudio(pcm);
+    }
+}
+
+void Device::forwardPacket(const AVPacket *packet, bool config)
+{
+    QMutexLocker locker(&m_packetCallbackLock);
+    if (m_packetCallback) {
+        m_packetCallback(QByteArray(reinterpret_cast<const char *>(packet->data), packet->size), config, 0 != (packet->flags & AV_PKT_FLAG_KEY));
+    }
+}
+
+void Device::onReconnectResult(bool success)
+{
+    if (success) {
+        m_reconnecting = false;
+        m_reconnectLeft = m_params.reconnectAttempts;
+        qInfo("%s: reconnected in %lldms", m_params.serial.toUtf8().data(), m_startTimeCount.elapsed());
+        return;
+    }
+
+    if (0 < m_reconnectLeft--) {
+        // the tunnel is likely gone with the device (usb replug), rebuild everything
+        qWarning("%s: warm reconnect failed, restarting the server", m_params.serial.toUtf8().data());
+        m_server->stop();
+        m_startTimeCount.start();
+        m_server->start(m_server->getParams());
+        return;
+    }
+
+    qWarning("%s: reconnect failed", m_params.serial.toUtf8().data());
+    m_reconnecting = false;
+    disconnectDevice();
+}
+
+void Device::startStream(const QSize &size)
+{
+    // a new server session starts with config packets and an IDR frame, the
+    // decoder that is already open simply carries on from there
+    m_stream->installVideoSocket(m_server->removeVideoSocket());
+    m_stream->setFrameSize(size);
+    m_stream->startDecode();
+
+    // recv device msg
+    connect(m_server->getControlSocket(), &QTcpSocket::readyRead, this, [this](){
+        if (!m_controller) {
+            return;
+        }
+
+        auto controlSocket = m_server->getControlSocket();
+        while (controlSocket->bytesAvailable()) {
+            QByteArray byteArray = controlSocket->peek(controlSocket->bytesAvailable());
+            DeviceMsg deviceMsg;
+            qint32 consume = deviceMsg.deserialize(byteArray);
+            if (0 >= consume) {
+                break;
+            }
+            controlSocket->read(consume);
+            m_controller->recvDeviceMsg(&deviceMsg);
+        }
+    });
 }
 
 bool Device::connectDevice()
@@ -294,6 +639,8 @@ bool Device::connectDevice()
 
         params.crop = "";
         params.control = true;
+        params.keepTunnel = m_params.autoReconnect && !m_recorder;
+        params.controlProbe = m_params.controlProbe;
         m_server->start(params);
     });
 
@@ -305,6 +652,7 @@ void Device::disconnectDevice()
     if (!m_server) {
         return;
     }
+    m_reconnecting = false;
     m_server->stop();
     m_server = Q_NULLPTR;
 
@@ -564,6 +912,9 @@ void Device::mouseEvent(const QMouseEvent *from, const QSize &frameSize, const Q
     if (!m_controller) {
         return;
     }
+    if (m_inputRecorder) {
+        m_inputRecorder->recordMouse(from, frameSize, showSize);
+    }
     m_controller->mouseEvent(from, frameSize, showSize);
 
     for (const auto& item : m_deviceObservers) {
@@ -576,6 +927,9 @@ void Device::wheelEvent(const QWheelEvent *from, const QSize &frameSize, const Q
     if (!m_controller) {
         return;
     }
+    if (m_inputRecorder) {
+        m_inputRecorder->recordWheel(from, frameSize, showSize);
+    }
     m_controller->wheelEvent(from, frameSize, showSize);
 
     for (const auto& item : m_deviceObservers) {
@@ -588,6 +942,9 @@ void Device::keyEvent(const QKeyEvent *from, const QSize &frameSize, const QSize
     if (!m_controller) {
         return;
     }
+    if (m_inputRecorder) {
+        m_inputRecorder->recordKey(from, frameSize, showSize);
+    }
     m_controller->keyEvent(from, frameSize, showSize);
 
     for (const auto& item : m_deviceObservers) {
@@ -603,36 +960,19 @@ bool Device::isCurrentCustomKeymap()
     return m_controller->isCurrentCustomKeymap();
 }
 
-bool Device::saveFrame(int width, int height, uint8_t* dataRGB32)
+bool Device::startInputRecord(const QString &file)
 {
-    if (!dataRGB32) {
-        return false;
+    if (!m_inputRecorder) {
+        m_inputRecorder = new InputRecorder(this);
     }
+    return m_inputRecorder->open(file);
+}
 
-    QImage rgbImage(dataRGB32, width, height, QImage::Format_RGB32);
-
-    // save
-    QString absFilePath;
-    QString fileDir(m_params.recordPath);
-    if (fileDir.isEmpty()) {
-        qWarning() << "please select record save path!!!";
-        return false;
-    }
-    QDateTime dateTime = QDateTime::currentDateTime();
-    QString fileName = dateTime.toString("_yyyyMMdd_hhmmss_zzz");
-    fileName = m_params.serial + fileName;
-    fileName.replace(":", "_");
-    fileName.replace(".", "_");
-    fileName += ".png";
-    QDir dir(fileDir);
-    absFilePath = dir.absoluteFilePath(fileName);
-    int ret = rgbImage.save(absFilePath, "PNG", 100);
-    if (!ret) {
-        return false;
+void Device::stopInputRecord()
+{
+    if (m_inputRecorder) {
+        m_inputRecorder->close();
     }
-
-    qInfo() << "screenshot save to " << absFilePath;
-    return true;
 }
 
 }
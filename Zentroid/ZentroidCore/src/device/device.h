@@ -1,13 +1,16 @@
 ﻿#ifndef DEVICE_H
 #define DEVICE_H
 
+#include <functional>
 #include <set>
 #include <QElapsedTimer>
+#include <QMutex>
 #include <QPointer>
 #include <QTime>
 
 #include "../../include/ZentroidCore.h"
 
+struct AVPacket;
 class QMouseEvent;
 class QWheelEvent;
 class QKeyEvent;
@@ -19,6 +22,11 @@ class FileHandler;
 class Demuxer;
 class VideoForm;
 class Controller;
+class InputRecorder;
+class Screenshooter;
+class Thumbnailer;
+class RegionProber;
+class TemplateLocator;
 struct AVFrame;
 
 namespace qsc {
@@ -73,21 +81,88 @@ public:
     void updateScript(QString script) override;
     bool isCurrentCustomKeymap() override;
 
+    bool startInputRecord(const QString &file) override;
+    void stopInputRecord() override;
+    void setVideoPacketCallback(std::function<void(const QByteArray &data, bool config, bool keyFrame)> callback) override;
+    void pushRecordAudio(const QByteArray &pcm) override;
+    bool startScreenshotBurst(int everyNth, int count = 0) override;
+    void stopScreenshotBurst() override;
+    void setThumbnail(int width, int maxFps = 5) override;
+    void setRegionProbes(const QList<RegionProbe> &probes) override;
+    bool locateTemplate(const TemplateSearch &search, std::function<void(const TemplateMatch &match)> onResult) override;
+
+    // phase timings of the last bring-up, filled before deviceConnected is emitted
+    const DeviceConnectTimings &getConnectTimings();
+
+    // group broadcast: the tap sees every control message this device writes,
+    // writeControl sends an already serialized message
+    void setControlTap(std::function<void(const QByteArray &)> tap);
+    qint64 writeControl(const QByteArray &buffer);
+    void probeControlRoundTrip();
+    qint64 controlRoundTripUs();
+    // size of the last decoded frame
+    const QSize &frameSize();
+
+    // health monitor
+    bool isStreaming();
+    quint32 streamPacketCount();
+    bool isDecoding();
+    quint32 decodedFrameCount();
+    // decoded frames that differ from the one before them
+    quint32 changedFrameCount();
+    int controlLostProbes();
+    void resetVideo();
+    // end the current stream as if the socket failed, autoReconnect decides what follows
+    void recoverStream();
+    void setHealth(DeviceHealth health);
+
+    // stream load
+    quint32 streamRecvBytes();
+    quint32 streamBacklogBytes();
+    quint32 skippedFrameCount();
+    quint32 decodeTimeUs();
+    quint16 streamMaxSize();
+    quint32 streamBitRate();
+    // restart the stream with new encoder settings over the kept session,
+    // false while connecting, reconnecting or recording
+    bool reconfigureStream(quint16 maxSize, quint32 bitRate);
+
 private:
     void initSignals();
-    bool saveFrame(int width, int height, uint8_t* dataRGB32);
+    // stream or server process lost, warm reconnect or tear down
+    void onSessionLost();
+    // stop the stream and the device server, then execute the server again
+    void restartSession();
+    void onReconnectResult(bool success);
+    void forwardPacket(const AVPacket *packet, bool config);
+    void startStream(const QSize &size);
+    void onThumbnailReady();
+    void onRegionProbeEvents();
 
 private:
     // server relevant
     QPointer<Server> m_server;
     bool m_serverStartSuccess = false;
+    bool m_reconnecting = false;
+    int m_reconnectLeft = 0;
     QPointer<Decoder> m_decoder;
     QPointer<Controller> m_controller;
     QPointer<FileHandler> m_fileHandler;
     QPointer<Demuxer> m_stream;
     QPointer<Recorder> m_recorder;
+    QPointer<InputRecorder> m_inputRecorder;
+    QPointer<Screenshooter> m_screenshooter;
+    QPointer<Thumbnailer> m_thumbnailer;
+    QPointer<RegionProber> m_regionProber;
+    QPointer<TemplateLocator> m_templateLocator;
 
     QElapsedTimer m_startTimeCount;
+    DeviceConnectTimings m_connectTimings;
+    std::function<void(const QByteArray &)> m_controlTap;
+    // set on the main thread, called on the stream thread
+    QMutex m_packetCallbackLock;
+    std::function<void(const QByteArray &, bool, bool)> m_packetCallback;
+    QSize m_frameSize;
     DeviceParams m_params;
     std::set<DeviceObserver*> m_deviceObservers;
     void* m_userData = nullptr;
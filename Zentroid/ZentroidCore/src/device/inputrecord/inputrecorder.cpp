@@ -0,0 +1,221 @@
+#include <QDebug>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QWheelEvent>
+
+#include "inputrecorder.h"
+
+#define INPUT_RECORD_MAGIC 0x5a494e52 // "ZINR"
+#define INPUT_RECORD_VERSION 1
+
+namespace {
+
+void writeEvent(QDataStream &stream, const InputRecordEvent &event)
+{
+    stream << event.kind << event.timestampUs << event.type << event.frameSize << event.showSize << event.modifiers;
+    switch (event.kind) {
+    case InputRecordEvent::IRK_MOUSE:
+        stream << event.localPos << event.globalPos << event.button << event.buttons;
+        break;
+    case InputRecordEvent::IRK_WHEEL:
+        stream << event.localPos << event.globalPos << event.buttons << event.pixelDelta << event.angleDelta << event.phase << event.inverted;
+        break;
+    case InputRecordEvent::IRK_KEY:
+        stream << event.key << event.text << event.autoRepeat << event.count;
+        break;
+    default:
+        break;
+    }
+}
+
+bool readEvent(QDataStream &stream, InputRecordEvent &event)
+{
+    stream >> event.kind >> event.timestampUs >> event.type >> event.frameSize >> event.showSize >> event.modifiers;
+    switch (event.kind) {
+    case InputRecordEvent::IRK_MOUSE:
+        stream >> event.localPos >> event.globalPos >> event.button >> event.buttons;
+        break;
+    case InputRecordEvent::IRK_WHEEL:
+        stream >> event.localPos >> event.globalPos >> event.buttons >> event.pixelDelta >> event.angleDelta >> event.phase >> event.inverted;
+        break;
+    case InputRecordEvent::IRK_KEY:
+        stream >> event.key >> event.text >> event.autoRepeat >> event.count;
+        break;
+    default:
+        return false;
+    }
+    return QDataStream::Ok == stream.status();
+}
+
+}
+
+QEvent *InputRecordEvent::toEvent() const
+{
+    Qt::KeyboardModifiers eventModifiers = Qt::KeyboardModifiers(QFlag(modifiers));
+    switch (kind) {
+    case IRK_MOUSE:
+        return new QMouseEvent(
+            static_cast<QEvent::Type>(type),
+            localPos,
+            globalPos,
+            static_cast<Qt::MouseButton>(button),
+            Qt::MouseButtons(QFlag(buttons)),
+            eventModifiers);
+    case IRK_WHEEL:
+        return new QWheelEvent(
+            localPos, globalPos, pixelDelta, angleDelta, Qt::MouseButtons(QFlag(buttons)), eventModifiers, static_cast<Qt::ScrollPhase>(phase), inverted);
+    case IRK_KEY:
+        return new QKeyEvent(static_cast<QEvent::Type>(type), key, eventModifiers, text, autoRepeat, count);
+    default:
+        break;
+    }
+    return Q_NULLPTR;
+}
+
+InputRecorder::InputRecorder(QObject *parent) : QObject(parent) {}
+
+InputRecorder::~InputRecorder()
+{
+    close();
+}
+
+bool InputRecorder::open(const QString &fileName)
+{
+    close();
+
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        qWarning() << "input record: open failed:" << fileName << m_file.errorString();
+        return false;
+    }
+
+    m_stream.setDevice(&m_file);
+    m_stream.setVersion(QDataStream::Qt_5_12);
+    m_stream << static_cast<quint32>(INPUT_RECORD_MAGIC) << static_cast<quint32>(INPUT_RECORD_VERSION);
+    m_clock.start();
+    qInfo() << "input record: start" << fileName;
+    return true;
+}
+
+void InputRecorder::close()
+{
+    if (!m_file.isOpen()) {
+        return;
+    }
+    m_stream.setDevice(Q_NULLPTR);
+    m_file.close();
+    qInfo() << "input record: stop" << m_file.fileName();
+}
+
+bool InputRecorder::isOpen() const
+{
+    return m_file.isOpen();
+}
+
+void InputRecorder::recordMouse(const QMouseEvent *from, const QSize &frameSize, const QSize &showSize)
+{
+    if (!from || !isOpen()) {
+        return;
+    }
+
+    InputRecordEvent event;
+    event.kind = InputRecordEvent::IRK_MOUSE;
+    event.type = from->type();
+    event.frameSize = frameSize;
+    event.showSize = showSize;
+    event.modifiers = static_cast<qint32>(from->modifiers());
+#if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
+    event.localPos = from->localPos();
+    event.globalPos = from->screenPos();
+#else
+    event.localPos = from->position();
+    event.globalPos = from->globalPosition();
+#endif
+    event.button = static_cast<qint32>(from->button());
+    event.buttons = static_cast<qint32>(from->buttons());
+    write(event);
+}
+
+void InputRecorder::recordWheel(const QWheelEvent *from, const QSize &frameSize, const QSize &showSize)
+{
+    if (!from || !isOpen()) {
+        return;
+    }
+
+    InputRecordEvent event;
+    event.kind = InputRecordEvent::IRK_WHEEL;
+    event.type = from->type();
+    event.frameSize = frameSize;
+    event.showSize = showSize;
+    event.modifiers = static_cast<qint32>(from->modifiers());
+#if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
+    event.localPos = from->position();
+    event.globalPos = from->globalPosition();
+#else
+    event.localPos = from->posF();
+    event.globalPos = from->globalPosF();
+#endif
+    event.buttons = static_cast<qint32>(from->buttons());
+    event.pixelDelta = from->pixelDelta();
+    event.angleDelta = from->angleDelta();
+    event.phase = static_cast<qint32>(from->phase());
+    event.inverted = from->inverted();
+    write(event);
+}
+
+void InputRecorder::recordKey(const QKeyEvent *from, const QSize &frameSize, const QSize &showSize)
+{
+    if (!from || !isOpen()) {
+        return;
+    }
+
+    InputRecordEvent event;
+    event.kind = InputRecordEvent::IRK_KEY;
+    event.type = from->type();
+    event.frameSize = frameSize;
+    event.showSize = showSize;
+    event.modifiers = static_cast<qint32>(from->modifiers());
+    event.key = from->key();
+    event.text = from->text();
+    event.autoRepeat = from->isAutoRepeat();
+    event.count = static_cast<quint16>(from->count());
+    write(event);
+}
+
+bool InputRecorder::load(const QString &fileName, QVector<InputRecordEvent> &events)
+{
+    events.clear();
+
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "input record: open failed:" << fileName << file.errorString();
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_5_12);
+    quint32 magic = 0;
+    quint32 version = 0;
+    stream >> magic >> version;
+    if (INPUT_RECORD_MAGIC != magic || INPUT_RECORD_VERSION != version) {
+        qWarning() << "input record: not a recording or unsupported version:" << fileName;
+        return false;
+    }
+
+    while (!stream.atEnd()) {
+        InputRecordEvent event;
+        if (!readEvent(stream, event)) {
+            // a session killed mid write leaves a partial tail, keep what is complete
+            qWarning() << "input record: truncated record after" << events.size() << "events";
+            break;
+        }
+        events.push_back(event);
+    }
+    return true;
+}
+
+void InputRecorder::write(InputRecordEvent &event)
+{
+    event.timestampUs = m_clock.nsecsElapsed() / 1000;
+    writeEvent(m_stream, event);
+}
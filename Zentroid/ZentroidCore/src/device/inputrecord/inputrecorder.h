@@ -0,0 +1,82 @@
+#ifndef INPUTRECORDER_H
+#define INPUTRECORDER_H
+
+#include <QDataStream>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QObject>
+#include <QPointF>
+#include <QSize>
+#include <QVector>
+
+class QEvent;
+class QKeyEvent;
+class QMouseEvent;
+class QWheelEvent;
+
+// One input event as it entered Device::mouseEvent/wheelEvent/keyEvent,
+// with the sizes it was converted against.
+struct InputRecordEvent
+{
+    enum Kind
+    {
+        IRK_MOUSE = 0,
+        IRK_WHEEL,
+        IRK_KEY
+    };
+
+    quint8 kind = IRK_MOUSE;
+    qint64 timestampUs = 0; // since the recording started
+    qint32 type = 0;        // QEvent::Type
+    QSize frameSize;
+    QSize showSize;
+    qint32 modifiers = 0;
+
+    // mouse / wheel
+    QPointF localPos;
+    QPointF globalPos;
+    qint32 button = 0;
+    qint32 buttons = 0;
+    // wheel
+    QPoint pixelDelta;
+    QPoint angleDelta;
+    qint32 phase = 0;
+    bool inverted = false;
+    // key
+    qint32 key = 0;
+    QString text;
+    bool autoRepeat = false;
+    quint16 count = 1;
+
+    // caller owns the returned event
+    QEvent *toEvent() const;
+};
+
+// Appends the input stream of a device to a file, see load() for reading it back.
+class InputRecorder : public QObject
+{
+    Q_OBJECT
+public:
+    explicit InputRecorder(QObject *parent = Q_NULLPTR);
+    virtual ~InputRecorder();
+
+    bool open(const QString &fileName);
+    void close();
+    bool isOpen() const;
+
+    void recordMouse(const QMouseEvent *from, const QSize &frameSize, const QSize &showSize);
+    void recordWheel(const QWheelEvent *from, const QSize &frameSize, const QSize &showSize);
+    void recordKey(const QKeyEvent *from, const QSize &frameSize, const QSize &showSize);
+
+    static bool load(const QString &fileName, QVector<InputRecordEvent> &events);
+
+private:
+    void write(InputRecordEvent &event);
+
+private:
+    QFile m_file;
+    QDataStream m_stream;
+    QElapsedTimer m_clock;
+};
+
+#endif // INPUTRECORDER_H
@@ -0,0 +1,154 @@
+#include <QCoreApplication>
+#include <QDebug>
+#include <QEventLoop>
+#include <QFile>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QScopedPointer>
+#include <QTimer>
+#include <QWheelEvent>
+#include <algorithm>
+
+#include "controller.h"
+#include "inputreplayer.h"
+
+// realtime replay keeps the event loop running this long after the last event,
+// long enough for the keymap timers (drag, steer wheel delay, mouse-move lift) to finish
+#define INPUT_REPLAY_DRAIN_MS 1000
+
+InputReplayer::InputReplayer(QObject *parent) : QObject(parent) {}
+
+InputReplayer::~InputReplayer() {}
+
+bool InputReplayer::replay(const qsc::InputReplayParams &params, qsc::InputReplayStats &stats)
+{
+    stats = qsc::InputReplayStats();
+    m_controlStream.clear();
+    m_controlMsgCount = 0;
+
+    QVector<InputRecordEvent> events;
+    if (!InputRecorder::load(params.recordFile, events)) {
+        return false;
+    }
+
+    if (m_controller) {
+        delete m_controller;
+    }
+    m_controller = new Controller([this](const QByteArray &buffer) -> qint64 { return onControlData(buffer); }, params.gameScript, this);
+    m_controller->setHostCursorControl(false);
+    m_controller->setMaxTouchPoints(params.maxTouchPoints);
+
+    QVector<qint64> latencies;
+    latencies.reserve(events.size());
+
+    m_clock.start();
+    for (const auto &event : events) {
+        if (params.realtime) {
+            waitUntil(event.timestampUs);
+        }
+
+        qint64 begin = m_clock.nsecsElapsed();
+        dispatch(event);
+        // conversion posts ControlMsg events to the controller, deliver them now so
+        // the measured latency covers serialization up to the socket write
+        QCoreApplication::sendPostedEvents(m_controller);
+        latencies.push_back((m_clock.nsecsElapsed() - begin) / 1000);
+
+        switch (event.kind) {
+        case InputRecordEvent::IRK_MOUSE:
+            stats.mouseEvents++;
+            break;
+        case InputRecordEvent::IRK_WHEEL:
+            stats.wheelEvents++;
+            break;
+        case InputRecordEvent::IRK_KEY:
+            stats.keyEvents++;
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (params.realtime && !events.isEmpty()) {
+        waitUntil(events.last().timestampUs + INPUT_REPLAY_DRAIN_MS * 1000);
+    } else {
+        QCoreApplication::processEvents();
+    }
+    QCoreApplication::sendPostedEvents(m_controller);
+
+    stats.wallTimeUs = m_clock.nsecsElapsed() / 1000;
+    stats.recordedTimeUs = events.isEmpty() ? 0 : events.last().timestampUs;
+    stats.controlMsgs = m_controlMsgCount;
+    stats.controlBytes = static_cast<quint64>(m_controlStream.size());
+
+    if (!latencies.isEmpty()) {
+        std::sort(latencies.begin(), latencies.end());
+        qint64 total = 0;
+        for (auto latency : latencies) {
+            total += latency;
+        }
+        stats.latencyMinUs = latencies.first();
+        stats.latencyMaxUs = latencies.last();
+        stats.latencyAvgUs = total / latencies.size();
+        stats.latencyP99Us = latencies.at(qMin(latencies.size() - 1, latencies.size() * 99 / 100));
+    }
+
+    if (!params.controlDumpFile.isEmpty()) {
+        QFile dump(params.controlDumpFile);
+        if (!dump.open(QIODevice::WriteOnly | QIODevice::Truncate) || dump.write(m_controlStream) != m_controlStream.size()) {
+            qWarning() << "input replay: write control dump failed:" << params.controlDumpFile << dump.errorString();
+        }
+    }
+
+    qInfo() << "input replay:" << events.size() << "events," << stats.controlMsgs << "control msgs," << stats.controlBytes << "bytes in"
+            << stats.wallTimeUs << "us, latency avg/p99/max us:" << stats.latencyAvgUs << stats.latencyP99Us << stats.latencyMaxUs;
+
+    delete m_controller;
+    return true;
+}
+
+const QByteArray &InputReplayer::controlStream() const
+{
+    return m_controlStream;
+}
+
+void InputReplayer::dispatch(const InputRecordEvent &event)
+{
+    QScopedPointer<QEvent> qevent(event.toEvent());
+    if (!qevent) {
+        return;
+    }
+
+    switch (event.kind) {
+    case InputRecordEvent::IRK_MOUSE:
+        m_controller->mouseEvent(static_cast<QMouseEvent *>(qevent.data()), event.frameSize, event.showSize);
+        break;
+    case InputRecordEvent::IRK_WHEEL:
+        m_controller->wheelEvent(static_cast<QWheelEvent *>(qevent.data()), event.frameSize, event.showSize);
+        break;
+    case InputRecordEvent::IRK_KEY:
+        m_controller->keyEvent(static_cast<QKeyEvent *>(qevent.data()), event.frameSize, event.showSize);
+        break;
+    default:
+        break;
+    }
+}
+
+void InputReplayer::waitUntil(qint64 timestampUs)
+{
+    qint64 remainingMs = (timestampUs - m_clock.nsecsElapsed() / 1000) / 1000;
+    if (remainingMs <= 0) {
+        return;
+    }
+    // keep the loop running so keymap timers fire at their real time in between
+    QEventLoop loop;
+    QTimer::singleShot(static_cast<int>(remainingMs), Qt::PreciseTimer, &loop, &QEventLoop::quit);
+    loop.exec();
+}
+
+qint64 InputReplayer::onControlData(const QByteArray &buffer)
+{
+    m_controlStream.append(buffer);
+    m_controlMsgCount++;
+    return buffer.size();
+}
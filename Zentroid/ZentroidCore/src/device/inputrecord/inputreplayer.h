@@ -0,0 +1,40 @@
+#ifndef INPUTREPLAYER_H
+#define INPUTREPLAYER_H
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QObject>
+#include <QPointer>
+#include <QVector>
+
+#include "../../../include/ZentroidCoreDef.h"
+#include "inputrecorder.h"
+
+class Controller;
+
+// Feeds a recorded input session through a Controller (and so through
+// InputConvertGame when a game script is given) whose control socket is a
+// local buffer, and measures what comes out. No device or server is involved.
+class InputReplayer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit InputReplayer(QObject *parent = Q_NULLPTR);
+    virtual ~InputReplayer();
+
+    bool replay(const qsc::InputReplayParams &params, qsc::InputReplayStats &stats);
+    const QByteArray &controlStream() const;
+
+private:
+    void dispatch(const InputRecordEvent &event);
+    void waitUntil(qint64 timestampUs);
+    qint64 onControlData(const QByteArray &buffer);
+
+private:
+    QPointer<Controller> m_controller;
+    QElapsedTimer m_clock;
+    QByteArray m_controlStream;
+    quint32 m_controlMsgCount = 0;
+};
+
+#endif // INPUTREPLAYER_H
@@ -5,8 +5,21 @@
 #include "compat.h"
 #include "recorder.h"
 
+extern "C"
+{
+#include "libavutil/channel_layout.h"
+}
+
 static const AVRational SCRCPY_TIME_BASE = { 1, 1000000 }; // timestamps in us
 
+#define REC_AUDIO_BIT_RATE 128000
+// samples per packet of a raw pcm track or a variable frame size encoder
+#define REC_AUDIO_FRAME_SAMPLES 1024
+// audio further off its counted position than this starts over at its arrival time
+#define REC_AUDIO_RESYNC_US 100000
+// audio that stops mid recording holds the interleaved video back at most this long
+#define REC_MAX_INTERLEAVE_DELTA_US 500000
+
 Recorder::Recorder(const QString &fileName, QObject *parent) : QThread(parent), m_fileName(fileName), m_format(guessRecordFormat(fileName)) {}
 
 Recorder::~Recorder() {}
@@ -48,6 +61,12 @@ void Recorder::setFormat(Recorder::RecorderFormat format)
     m_format = format;
 }
 
+void Recorder::setAudioFormat(int sampleRate, int channels)
+{
+    m_audioSampleRate = sampleRate;
+    m_audioChannels = channels;
+}
+
 bool Recorder::open()
 {
     // codec
@@ -102,12 +121,19 @@ bool Recorder::open()
     outStream->codec->height = m_declaredFrameSize.height();
 #endif
 
+    if (0 < m_audioSampleRate && 0 < m_audioChannels && !openAudio()) {
+        qWarning("Could not add the audio track, recording video only");
+    }
+    m_formatCtx->max_interleave_delta = REC_MAX_INTERLEAVE_DELTA_US;
+    m_clock.start();
+
     int ret = avio_open(&m_formatCtx->pb, m_fileName.toUtf8().toStdString().c_str(), AVIO_FLAG_WRITE);
     if (ret < 0) {
         char errorbuf[255] = { 0 };
         av_strerror(ret, errorbuf, 254);
         qCritical() << QString("Failed to open output file: %1 %2").arg(errorbuf).arg(m_fileName).toUtf8().toStdString().c_str();
         // ostream will be cleaned up during context cleaning
+        closeAudio();
         avformat_free_context(m_formatCtx);
         m_formatCtx = Q_NULLPTR;
         return false;
@@ -135,6 +161,269 @@ void Recorder::close()
         avformat_free_context(m_formatCtx);
         m_formatCtx = Q_NULLPTR;
     }
+    closeAudio();
+}
+
+bool Recorder::openAudio()
+{
+#ifdef ZENTROID_LAVF_HAS_NEW_ENCODING_DECODING_API
+    const AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_AAC);
+    if (!codec) {
+        codec = avcodec_find_encoder(AV_CODEC_ID_OPUS);
+    }
+    if (!codec && RECORDER_FORMAT_MKV != m_format) {
+        qWarning("No aac or opus encoder in this ffmpeg build");
+        return false;
+    }
+
+    int64_t channelLayout = av_get_default_channel_layout(m_audioChannels);
+    if (!codec) {
+        // matroska stores raw pcm, no encoder needed
+        AVStream *stream = avformat_new_stream(m_formatCtx, Q_NULLPTR);
+        if (!stream) {
+            return false;
+        }
+        stream->time_base = { 1, m_audioSampleRate };
+        stream->codecpar->codec_type = AVMEDIA_TYPE_AUDIO;
+        stream->codecpar->codec_id = AV_CODEC_ID_PCM_S16LE;
+        stream->codecpar->sample_rate = m_audioSampleRate;
+        stream->codecpar->channels = m_audioChannels;
+        stream->codecpar->channel_layout = static_cast<uint64_t>(channelLayout);
+        stream->codecpar->bits_per_coded_sample = 16;
+        stream->codecpar->block_align = m_audioChannels * 2;
+        m_audioStream = stream;
+        m_audioFrameSamples = REC_AUDIO_FRAME_SAMPLES;
+        qInfo("Recording audio as raw pcm");
+        return true;
+    }
+
+    // the pcm is converted by hand, take a format that needs no resampler
+    AVSampleFormat sampleFormat = AV_SAMPLE_FMT_NONE;
+    for (const AVSampleFormat *fmt = codec->sample_fmts; fmt && AV_SAMPLE_FMT_NONE != *fmt; ++fmt) {
+        if (AV_SAMPLE_FMT_S16 == *fmt || AV_SAMPLE_FMT_S16P == *fmt || AV_SAMPLE_FMT_FLT == *fmt || AV_SAMPLE_FMT_FLTP == *fmt) {
+            sampleFormat = *fmt;
+            break;
+        }
+    }
+    if (AV_SAMPLE_FMT_NONE == sampleFormat) {
+        qWarning("No usable sample format for the %s encoder", codec->name);
+        return false;
+    }
+
+    m_audioCodecCtx = avcodec_alloc_context3(codec);
+    if (!m_audioCodecCtx) {
+        return false;
+    }
+    m_audioCodecCtx->sample_fmt = sampleFormat;
+    m_audioCodecCtx->sample_rate = m_audioSampleRate;
+    m_audioCodecCtx->channels = m_audioChannels;
+    m_audioCodecCtx->channel_layout = static_cast<uint64_t>(channelLayout);
+    m_audioCodecCtx->bit_rate = REC_AUDIO_BIT_RATE;
+    m_audioCodecCtx->time_base = { 1, m_audioSampleRate };
+    // the native opus encoder is still marked experimental
+    m_audioCodecCtx->strict_std_compliance = FF_COMPLIANCE_EXPERIMENTAL;
+    if (m_formatCtx->oformat->flags & AVFMT_GLOBALHEADER) {
+        m_audioCodecCtx->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+    }
+    if (avcodec_open2(m_audioCodecCtx, codec, Q_NULLPTR) < 0) {
+        qWarning("Could not open the %s encoder", codec->name);
+        closeAudio();
+        return false;
+    }
+
+    m_audioFrameSamples = m_audioCodecCtx->frame_size;
+    if (0 >= m_audioFrameSamples || (codec->capabilities & AV_CODEC_CAP_VARIABLE_FRAME_SIZE)) {
+        m_audioFrameSamples = REC_AUDIO_FRAME_SAMPLES;
+    }
+    m_audioFrame = av_frame_alloc();
+    if (!m_audioFrame) {
+        closeAudio();
+        return false;
+    }
+    m_audioFrame->format = sampleFormat;
+    m_audioFrame->channels = m_audioChannels;
+    m_audioFrame->channel_layout = static_cast<uint64_t>(channelLayout);
+    m_audioFrame->sample_rate = m_audioSampleRate;
+    m_audioFrame->nb_samples = m_audioFrameSamples;
+    if (av_frame_get_buffer(m_audioFrame, 0) < 0) {
+        closeAudio();
+        return false;
+    }
+
+    AVStream *stream = avformat_new_stream(m_formatCtx, codec);
+    if (!stream || avcodec_parameters_from_context(stream->codecpar, m_audioCodecCtx) < 0) {
+        // a stream without parameters would fail the header, the file is given up with it
+        closeAudio();
+        return false;
+    }
+    stream->time_base = m_audioCodecCtx->time_base;
+    if (AV_CODEC_ID_OPUS == codec->id) {
+        // opus in mp4 is experimental for the muxer as well
+        m_formatCtx->strict_std_compliance = FF_COMPLIANCE_EXPERIMENTAL;
+    }
+    m_audioStream = stream;
+    qInfo("Recording audio with the %s encoder", codec->name);
+    return true;
+#else
+    qWarning("Recording audio needs the send/receive encoding api");
+    return false;
+#endif
+}
+
+void Recorder::closeAudio()
+{
+    if (m_audioCodecCtx) {
+        avcodec_free_context(&m_audioCodecCtx);
+    }
+    if (m_audioFrame) {
+        av_frame_free(&m_audioFrame);
+    }
+    // the stream itself belongs to the format context
+    m_audioStream = Q_NULLPTR;
+    m_audioPending.clear();
+    m_audioPts = AV_NOPTS_VALUE;
+    m_audioWritten = false;
+}
+
+void Recorder::writeAudio(const AudioChunk &chunk, qint64 videoOffsetUs)
+{
+    if (!m_audioStream || !m_headerWritten || AV_NOPTS_VALUE == m_ptsOrigin || AV_NOPTS_VALUE == videoOffsetUs) {
+        // nothing to align with before the first video frame
+        return;
+    }
+
+    int frameBytes = m_audioChannels * 2;
+    qint64 pendingSamples = m_audioPending.size() / frameBytes;
+    // the chunk ends at its arrival, where its first sample sits on the video pts clock
+    qint64 chunkUs = static_cast<qint64>(chunk.pcm.size() / frameBytes) * 1000000 / m_audioSampleRate;
+    qint64 startUs = chunk.hostUs - videoOffsetUs - chunkUs - m_ptsOrigin;
+    qint64 start = av_rescale(startUs, m_audioSampleRate, 1000000);
+    qint64 resync = av_rescale(REC_AUDIO_RESYNC_US, m_audioSampleRate, 1000000);
+    // arrival times jitter, the position advances by the samples counted
+    // and only starts over when the two drift apart
+    if (AV_NOPTS_VALUE == m_audioPts || resync < qAbs(start - (m_audioPts + pendingSamples))) {
+        if (AV_NOPTS_VALUE != m_audioPts) {
+            qWarning("Recorded audio drifted by %lldms, realigning", (start - m_audioPts - pendingSamples) * 1000 / m_audioSampleRate);
+        }
+        // keep a partial sample, the pcm stays aligned to whole samples
+        m_audioPending.remove(0, static_cast<int>(pendingSamples) * frameBytes);
+        m_audioPts = start;
+    }
+    m_audioPending.append(chunk.pcm);
+
+    if (0 > m_audioPts) {
+        // captured before the first video frame
+        qint64 drop = qMin(-m_audioPts, static_cast<qint64>(m_audioPending.size() / frameBytes));
+        m_audioPending.remove(0, static_cast<int>(drop) * frameBytes);
+        m_audioPts += drop;
+    }
+
+    int packetBytes = m_audioFrameSamples * frameBytes;
+    int offset = 0;
+    while (m_audioPending.size() - offset >= packetBytes) {
+        if (!encodeAudio(reinterpret_cast<const quint8 *>(m_audioPending.constData()) + offset, m_audioFrameSamples, m_audioPts)) {
+            qWarning("Could not record audio");
+        }
+        offset += packetBytes;
+        m_audioPts += m_audioFrameSamples;
+    }
+    m_audioPending.remove(0, offset);
+}
+
+bool Recorder::encodeAudio(const quint8 *pcm, int samples, qint64 pts)
+{
+    if (!m_audioCodecCtx) {
+        if (!pcm) {
+            return true;
+        }
+        AVPacket *packet = av_packet_alloc();
+        if (!packet || av_new_packet(packet, samples * m_audioChannels * 2) < 0) {
+            av_packet_free(&packet);
+            return false;
+        }
+        memcpy(packet->data, pcm, packet->size);
+        packet->pts = pts;
+        packet->dts = pts;
+        packet->duration = samples;
+        bool ok = writeAudioPacket(packet);
+        av_packet_free(&packet);
+        return ok;
+    }
+
+#ifdef ZENTROID_LAVF_HAS_NEW_ENCODING_DECODING_API
+    AVFrame *frame = Q_NULLPTR;
+    if (pcm) {
+        if (av_frame_make_writable(m_audioFrame) < 0) {
+            return false;
+        }
+        const qint16 *in = reinterpret_cast<const qint16 *>(pcm);
+        int channels = m_audioChannels;
+        int count = samples * channels;
+        switch (m_audioFrame->format) {
+        case AV_SAMPLE_FMT_S16:
+            memcpy(m_audioFrame->data[0], pcm, count * 2);
+            break;
+        case AV_SAMPLE_FMT_FLT: {
+            float *out = reinterpret_cast<float *>(m_audioFrame->data[0]);
+            for (int i = 0; i < count; i++) {
+                out[i] = in[i] / 32768.0f;
+            }
+            break;
+        }
+        case AV_SAMPLE_FMT_S16P:
+            for (int c = 0; c < channels; c++) {
+                qint16 *out = reinterpret_cast<qint16 *>(m_audioFrame->data[c]);
+                for (int i = 0; i < samples; i++) {
+                    out[i] = in[i * channels + c];
+                }
+            }
+            break;
+        case AV_SAMPLE_FMT_FLTP:
+            for (int c = 0; c < channels; c++) {
+                float *out = reinterpret_cast<float *>(m_audioFrame->data[c]);
+                for (int i = 0; i < samples; i++) {
+                    out[i] = in[i * channels + c] / 32768.0f;
+                }
+            }
+            break;
+        default:
+            return false;
+        }
+        m_audioFrame->nb_samples = samples;
+        m_audioFrame->pts = pts;
+        frame = m_audioFrame;
+    }
+
+    if (avcodec_send_frame(m_audioCodecCtx, frame) < 0) {
+        return false;
+    }
+    AVPacket *packet = av_packet_alloc();
+    if (!packet) {
+        return false;
+    }
+    bool ok = true;
+    while (ok) {
+        int ret = avcodec_receive_packet(m_audioCodecCtx, packet);
+        if (AVERROR(EAGAIN) == ret || AVERROR_EOF == ret) {
+            break;
+        }
+        ok = 0 <= ret && writeAudioPacket(packet);
+    }
+    av_packet_free(&packet);
+    return ok;
+#else
+    Q_UNUSED(pts);
+    return false;
+#endif
+}
+
+bool Recorder::writeAudioPacket(AVPacket *packet)
+{
+    packet->stream_index = m_audioStream->index;
+    av_packet_rescale_ts(packet, { 1, m_audioSampleRate }, m_audioStream->time_base);
+    // takes the packet's data, the muxer orders it with the video by dts
+    m_audioWritten = true;
+    return av_interleaved_write_frame(m_formatCtx, packet) >= 0;
 }
 
 bool Recorder::write(AVPacket *packet)
@@ -158,6 +447,10 @@ bool Recorder::write(AVPacket *packet)
     }
 
     recorderRescalePacket(packet);
+    // until audio shows up the muxer would hold the video back waiting for it
+    if (m_audioWritten) {
+        return av_interleaved_write_frame(m_formatCtx, packet) >= 0;
+    }
     return av_write_frame(m_formatCtx, packet) >= 0;
 }
 
@@ -242,37 +535,58 @@ Recorder::RecorderFormat Recorder::guessRecordFormat(const QString &fileName)
 
 void Recorder::run()
 {
-    qint64 ptsOrigin = AV_NOPTS_VALUE;
     for (;;) {
         AVPacket *rec = Q_NULLPTR;
+        QQueue<AudioChunk> audio;
+        qint64 videoOffsetUs = AV_NOPTS_VALUE;
+        bool finished = false;
         {
             QMutexLocker locker(&m_mutex);
-            while (!m_stopped && m_queue.isEmpty()) {
+            while (!m_stopped && m_queue.isEmpty() && m_audioQueue.isEmpty()) {
                 m_recvDataCond.wait(&m_mutex);
             }
+            audio.swap(m_audioQueue);
+            videoOffsetUs = m_videoOffsetUs;
 
             // if stopped is set, continue to process the remaining events (to
             // finish the recording) before actually stopping
-            if (m_stopped && m_queue.isEmpty()) {
-                AVPacket *last = m_previous;
-                if (last) {
-                    last->pts -= ptsOrigin;
+            finished = m_stopped && m_queue.isEmpty();
+            if (!m_queue.isEmpty()) {
+                rec = m_queue.dequeue();
+            }
+        }
+
+        // audio is encoded here, off the stream thread
+        for (const AudioChunk &chunk : audio) {
+            writeAudio(chunk, videoOffsetUs);
+        }
+
+        if (finished) {
+            AVPacket *last = m_previous;
+            if (last) {
+                if (last->pts != AV_NOPTS_VALUE) {
+                    last->pts -= m_ptsOrigin;
                     last->dts = last->pts;
-                    // assign an arbitrary duration to the last packet
-                    last->duration = 100000;
-                    bool ok = write(last);
-                    if (!ok) {
-                        // failing to write the last frame is not very serious, no
-                        // future frame may depend on it, so the resulting file
-                        // will still be valid
-                        qWarning("Could not record last packet");
-                    }
-                    packetDelete(last);
                 }
-                break;
+                // assign an arbitrary duration to the last packet
+                last->duration = 100000;
+                bool ok = write(last);
+                if (!ok) {
+                    // failing to write the last frame is not very serious, no
+                    // future frame may depend on it, so the resulting file
+                    // will still be valid
+                    qWarning("Could not record last packet");
+                }
+                packetDelete(last);
+                m_previous = Q_NULLPTR;
             }
-
-            rec = m_queue.dequeue();
+            if (m_headerWritten && m_audioStream && !encodeAudio(Q_NULLPTR, 0, 0)) {
+                qWarning("Could not record the end of the audio");
+            }
+            break;
+        }
+        if (!rec) {
+            continue;
         }
 
         // recorder->previous is only written from this thread, no need to lock
@@ -291,12 +605,12 @@ void Recorder::run()
         }
 
         if (previous->pts != AV_NOPTS_VALUE) {
-            if (ptsOrigin == AV_NOPTS_VALUE) {
-                ptsOrigin = previous->pts;
+            if (m_ptsOrigin == AV_NOPTS_VALUE) {
+                m_ptsOrigin = previous->pts;
             }
-            previous->pts -= ptsOrigin;
+            previous->pts -= m_ptsOrigin;
             previous->dts = previous->pts;
-        }        
+        }
 
         bool ok = write(previous);
         packetDelete(previous);
@@ -306,6 +620,7 @@ void Recorder::run()
             m_failed = true;
             // discard pending packets
             queueClear();
+            m_audioQueue.clear();
             break;
         }
     }
@@ -336,6 +651,13 @@ bool Recorder::push(const AVPacket *packet)
         return false;
     }
 
+    if (m_audioStream && packet->pts != AV_NOPTS_VALUE) {
+        // the least delayed packet tells how the host clock maps onto the pts clock;
+        // the minimum creeps up slowly to follow a host clock that drifts
+        qint64 offsetUs = m_clock.nsecsElapsed() / 1000 - packet->pts;
+        m_videoOffsetUs = AV_NOPTS_VALUE == m_videoOffsetUs ? offsetUs : qMin(offsetUs, m_videoOffsetUs + 1);
+    }
+
     AVPacket *rec = packetNew(packet);
     if (rec) {
         m_queue.enqueue(rec);
@@ -343,3 +665,18 @@ bool Recorder::push(const AVPacket *packet)
     }
     return rec != Q_NULLPTR;
 }
+
+bool Recorder::pushAudio(const QByteArray &pcm)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_failed || m_stopped || !m_audioStream) {
+        return false;
+    }
+
+    AudioChunk chunk;
+    chunk.pcm = pcm;
+    chunk.hostUs = m_clock.nsecsElapsed() / 1000;
+    m_audioQueue.enqueue(chunk);
+    m_recvDataCond.wakeOne();
+    return true;
+}
@@ -1,5 +1,7 @@
 #ifndef RECORDER_H
 #define RECORDER_H
+#include <QByteArray>
+#include <QElapsedTimer>
 #include <QMutex>
 #include <QQueue>
 #include <QSize>
@@ -9,6 +11,7 @@
 
 extern "C"
 {
+#include "libavcodec/avcodec.h"
 #include "libavformat/avformat.h"
 }
 
@@ -34,6 +37,25 @@ public:
     bool startRecorder();
     void stopRecorder();
     bool push(const AVPacket *packet);
+    // device audio track from interleaved s16 pcm, set before open()
+    void setAudioFormat(int sampleRate, int channels);
+    // any thread: the pcm is stamped on arrival, encoded on the recorder thread
+    bool pushAudio(const QByteArray &pcm);
+
+private:
+    struct AudioChunk
+    {
+        QByteArray pcm;
+        qint64 hostUs = 0; // arrival on m_clock
+    };
+
+    // aac, then opus; matroska falls back to raw pcm. False: video only
+    bool openAudio();
+    void closeAudio();
+    void writeAudio(const AudioChunk &chunk, qint64 videoOffsetUs);
+    // a null pcm drains the encoder
+    bool encodeAudio(const quint8 *pcm, int samples, qint64 pts);
+    bool writeAudioPacket(AVPacket *packet);
 
 private:
     const AVOutputFormat *findMuxer(const char *name);
@@ -66,6 +88,25 @@ private:
     // "previous" is only accessed from the recorder thread, so it does not
     // need to be protected by the mutex
     AVPacket *m_previous = Q_NULLPTR;
+    qint64 m_ptsOrigin = AV_NOPTS_VALUE; // recorder thread only
+
+    // audio
+    int m_audioSampleRate = 0;
+    int m_audioChannels = 0;
+    AVStream *m_audioStream = Q_NULLPTR;
+    AVCodecContext *m_audioCodecCtx = Q_NULLPTR; // null: raw pcm track
+    AVFrame *m_audioFrame = Q_NULLPTR;
+    int m_audioFrameSamples = 0;
+    QElapsedTimer m_clock;
+    // smallest (arrival - pts) of the video packets, maps arrival times to the video pts clock
+    qint64 m_videoOffsetUs = AV_NOPTS_VALUE;
+    QQueue<AudioChunk> m_audioQueue;
+    // recorder thread only: pcm waiting for a full encoder frame and the pts
+    // of its first sample, in samples from the first video frame
+    QByteArray m_audioPending;
+    qint64 m_audioPts = AV_NOPTS_VALUE;
+    // recorder thread only: video goes through the interleaver once audio packets exist
+    bool m_audioWritten = false;
 };
 
 #endif // RECORDER_H
@@ -0,0 +1,226 @@
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QImage>
+#include <QImageWriter>
+#include <QRunnable>
+#include <QThread>
+#include <QThreadPool>
+
+extern "C"
+{
+#include "libavutil/imgutils.h"
+}
+
+#include "avframeconvert.h"
+#include "screenshooter.h"
+
+// yuv copies waiting for a worker, about 16 frames of 1080x2400
+#define SS_MAX_PENDING_BYTES (64 * 1024 * 1024)
+
+namespace {
+
+// converts one yuv copy to rgb and writes the image file
+class ScreenshotJob : public QRunnable
+{
+public:
+    ScreenshotJob(const QByteArray &yuv, int width, int height, AVPixelFormat format, const QString &file, const QByteArray &imageFormat, int quality,
+                  QSharedPointer<QAtomicInt> pendingBytes)
+        : m_yuv(yuv)
+        , m_width(width)
+        , m_height(height)
+        , m_format(format)
+        , m_file(file)
+        , m_imageFormat(imageFormat)
+        , m_quality(quality)
+        , m_pendingBytes(pendingBytes)
+    {
+    }
+
+    void run() override
+    {
+        QImage image = convert();
+        // the copy is no longer needed, give its budget back before the slow part
+        int size = m_yuv.size();
+        m_yuv.clear();
+        m_pendingBytes->fetchAndAddRelease(-size);
+
+        if (image.isNull()) {
+            qWarning() << "screenshot convert failed" << m_file;
+            return;
+        }
+        if (!image.save(m_file, m_imageFormat.constData(), m_quality)) {
+            qWarning() << "screenshot save failed" << m_file;
+            return;
+        }
+        qInfo() << "screenshot save to " << m_file;
+    }
+
+private:
+    QImage convert()
+    {
+        QImage image(m_width, m_height, QImage::Format_RGB32);
+        AVFrame *src = av_frame_alloc();
+        AVFrame *dst = av_frame_alloc();
+        bool ok = !image.isNull() && src && dst;
+        if (ok) {
+            av_image_fill_arrays(src->data, src->linesize, reinterpret_cast<const uint8_t *>(m_yuv.constData()), m_format, m_width, m_height, 1);
+            dst->data[0] = image.bits();
+            dst->linesize[0] = image.bytesPerLine();
+
+            AVFrameConvert convert;
+            convert.setSrcFrameInfo(m_width, m_height, m_format);
+            convert.setDstFrameInfo(m_width, m_height, AV_PIX_FMT_RGB32);
+            ok = convert.init() && convert.convert(src, dst);
+            convert.deInit();
+        }
+        av_frame_free(&src);
+        av_frame_free(&dst);
+        return ok ? image : QImage();
+    }
+
+private:
+    QByteArray m_yuv;
+    int m_width;
+    int m_height;
+    AVPixelFormat m_format;
+    QString m_file;
+    QByteArray m_imageFormat;
+    int m_quality;
+    QSharedPointer<QAtomicInt> m_pendingBytes;
+};
+
+// one pool for every device, encoding is cpu bound
+struct ScreenshotPool
+{
+    ScreenshotPool()
+    {
+        pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 2));
+    }
+    QThreadPool pool;
+};
+
+QThreadPool *screenshotPool()
+{
+    static ScreenshotPool instance;
+    return &instance.pool;
+}
+
+}
+
+Screenshooter::Screenshooter(const QString &serial, const QString &dir, const QString &format, int quality, QObject *parent)
+    : QObject(parent)
+    , m_serial(serial)
+    , m_dir(dir)
+    , m_quality(quality)
+    , m_pendingBytes(new QAtomicInt(0))
+{
+    QString name = format.trimmed().toLower();
+    if ("jpeg" == name) {
+        name = "jpg";
+    }
+    if ("jpg" != name && "webp" != name) {
+        name = "png";
+    }
+    // webp needs the qt image formats plugin
+    if (!QImageWriter::supportedImageFormats().contains(name.toUtf8())) {
+        qWarning() << "screenshot format" << name << "not supported, using png";
+        name = "png";
+    }
+    m_suffix = name;
+    m_format = name.toUpper().toUtf8();
+}
+
+Screenshooter::~Screenshooter()
+{
+    stopBurst();
+}
+
+bool Screenshooter::capture(const AVFrame *frame)
+{
+    return save(frame, -1);
+}
+
+bool Screenshooter::startBurst(int everyNth, int count)
+{
+    if (0 >= everyNth || 0 > count) {
+        return false;
+    }
+    m_burstLeft.storeRelease(0 == count ? -1 : count);
+    m_burstFrames.storeRelease(0);
+    m_burstEvery.storeRelease(everyNth);
+    return true;
+}
+
+void Screenshooter::stopBurst()
+{
+    m_burstEvery.storeRelease(0);
+}
+
+void Screenshooter::offerFrame(const AVFrame *frame)
+{
+    int every = m_burstEvery.loadAcquire();
+    if (0 >= every) {
+        return;
+    }
+    if (0 != m_burstFrames.fetchAndAddRelaxed(1) % every) {
+        return;
+    }
+    // only this thread counts down
+    int left = m_burstLeft.loadAcquire();
+    if (0 < left) {
+        m_burstLeft.storeRelease(left - 1);
+        if (1 == left) {
+            m_burstEvery.storeRelease(0);
+        }
+    }
+    save(frame, m_burstIndex++);
+}
+
+quint32 Screenshooter::droppedFrames()
+{
+    return static_cast<quint32>(m_droppedFrames.loadAcquire());
+}
+
+bool Screenshooter::save(const AVFrame *frame, int burstIndex)
+{
+    if (!frame || 0 >= frame->width || 0 >= frame->height) {
+        return false;
+    }
+    if (m_dir.isEmpty()) {
+        qWarning() << "please select record save path!!!";
+        return false;
+    }
+
+    AVPixelFormat format = static_cast<AVPixelFormat>(frame->format);
+    int size = av_image_get_buffer_size(format, frame->width, frame->height, 1);
+    if (0 >= size) {
+        return false;
+    }
+    // reserve first, the workers give budget back concurrently
+    if (SS_MAX_PENDING_BYTES < m_pendingBytes->fetchAndAddAcquire(size) + size) {
+        m_pendingBytes->fetchAndAddRelease(-size);
+        m_droppedFrames.fetchAndAddRelease(1);
+        if (0 > burstIndex) {
+            qWarning() << "screenshot dropped, too many waiting to be saved";
+        }
+        return false;
+    }
+
+    QByteArray yuv(size, Qt::Uninitialized);
+    av_image_copy_to_buffer(reinterpret_cast<uint8_t *>(yuv.data()), size, frame->data, frame->linesize, format, frame->width, frame->height, 1);
+
+    QString fileName = QDateTime::currentDateTime().toString("_yyyyMMdd_hhmmss_zzz");
+    fileName = m_serial + fileName;
+    if (0 <= burstIndex) {
+        fileName += QString("_%1").arg(burstIndex, 5, 10, QChar('0'));
+    }
+    fileName.replace(":", "_");
+    fileName.replace(".", "_");
+    fileName += "." + m_suffix;
+    QDir dir(m_dir);
+    QString absFilePath = dir.absoluteFilePath(fileName);
+
+    screenshotPool()->start(new ScreenshotJob(yuv, frame->width, frame->height, format, absFilePath, m_format, m_quality, m_pendingBytes));
+    return true;
+}
@@ -0,0 +1,56 @@
+#ifndef SCREENSHOOTER_H
+#define SCREENSHOOTER_H
+#include <QAtomicInt>
+#include <QObject>
+#include <QSharedPointer>
+#include <QString>
+
+// forward declarations
+typedef struct AVFrame AVFrame;
+
+// Saves screenshots without blocking the caller. A frame is copied as it comes
+// out of the decoder (yuv, no rgb conversion or gl readback), the conversion
+// and the png/jpg/webp encoding run on a worker pool shared by all devices.
+// Burst mode copies every nth decoded frame on the decoding thread.
+// Copies waiting for a worker are bounded, a frame that does not fit is
+// dropped instead of queued.
+class Screenshooter : public QObject
+{
+    Q_OBJECT
+public:
+    // format: "png", "jpg" or "webp"; quality 0-100, -1 for the encoder default
+    Screenshooter(const QString &serial, const QString &dir, const QString &format, int quality, QObject *parent = Q_NULLPTR);
+    virtual ~Screenshooter();
+
+    // any thread, the frame is only read during the call
+    bool capture(const AVFrame *frame);
+
+    // every nth decoded frame, count frames in total (0: until stopped)
+    bool startBurst(int everyNth, int count);
+    void stopBurst();
+    // decoding thread, every decoded frame
+    void offerFrame(const AVFrame *frame);
+
+    // frames dropped because the workers fell behind
+    quint32 droppedFrames();
+
+private:
+    bool save(const AVFrame *frame, int burstIndex);
+
+private:
+    QString m_serial;
+    QString m_dir;
+    QByteArray m_format;
+    QString m_suffix;
+    int m_quality = -1;
+    // bytes of copies not yet converted, shared with the jobs that outlive us
+    QSharedPointer<QAtomicInt> m_pendingBytes;
+    QAtomicInt m_droppedFrames;
+    // burst: 0 every is off, -1 left is unlimited
+    QAtomicInt m_burstEvery;
+    QAtomicInt m_burstLeft;
+    QAtomicInt m_burstFrames;
+    int m_burstIndex = 0; // decoding thread only
+};
+
+#endif // SCREENSHOOTER_H
@@ -1,8 +1,15 @@
 #include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDateTime>
 #include <QDebug>
 #include <QElapsedTimer>
+#include <QFile>
 #include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QRunnable>
 #include <QThread>
+#include <QThreadPool>
 #include <QTimer>
 #include <QTimerEvent>
 
@@ -18,6 +25,72 @@ static quint32 bufferRead32be(quint8 *buf)
     return static_cast<quint32>((buf[0] << 24) | (buf[1] << 16) | (buf[2] << 8) | buf[3]);
 }
 
+struct LocalServerJar
+{
+    qint64 size = 0;
+    QDateTime lastModified;
+    QByteArray sha256; // lowercase hex, empty while hashing or when unreadable
+    bool hashing = false;
+};
+
+static QMutex s_serverJarsLock;
+static QHash<QString, LocalServerJar> s_serverJars;
+
+static void hashServerJar(const QString &path, qint64 size, const QDateTime &lastModified)
+{
+    QByteArray sha256;
+    QFile file(path);
+    if (file.open(QIODevice::ReadOnly)) {
+        QCryptographicHash hash(QCryptographicHash::Sha256);
+        if (hash.addData(&file)) {
+            sha256 = hash.result().toHex();
+        }
+    }
+
+    QMutexLocker locker(&s_serverJarsLock);
+    LocalServerJar &jar = s_serverJars[path];
+    jar.hashing = false;
+    // changed while hashing: the next lookup hashes it again
+    if (jar.size == size && jar.lastModified == lastModified) {
+        jar.sha256 = sha256;
+    }
+}
+
+class ServerJarHashTask : public QRunnable
+{
+public:
+    ServerJarHashTask(const QString &path, qint64 size, const QDateTime &lastModified) : m_path(path), m_size(size), m_lastModified(lastModified) {}
+
+    void run() override
+    {
+        hashServerJar(m_path, m_size, m_lastModified);
+    }
+
+private:
+    QString m_path;
+    qint64 m_size;
+    QDateTime m_lastModified;
+};
+
+// hashed once per jar on the thread pool, again only when the file changes;
+// the first lookups see an empty sha256 until the hash is done
+static LocalServerJar localServerJar(const QString &path)
+{
+    QFileInfo fileInfo(path);
+    QMutexLocker locker(&s_serverJarsLock);
+    LocalServerJar &jar = s_serverJars[path];
+    if (!jar.hashing && fileInfo.isFile() && (jar.size != fileInfo.size() || jar.lastModified != fileInfo.lastModified())) {
+        jar = LocalServerJar();
+        jar.size = fileInfo.size();
+        jar.lastModified = fileInfo.lastModified();
+        jar.hashing = true;
+        QThreadPool::globalInstance()->start(new ServerJarHashTask(path, jar.size, jar.lastModified));
+    }
+    return jar;
+}
+
+qsc::ServerPushStats Server::s_pushStats;
+
 Server::Server(QObject *parent) : QObject(parent)
 {
     connect(&m_workProcess, &qsc::AdbProcess::adbProcessResult, this, &Server::onWorkProcessResult);
@@ -36,10 +109,12 @@ Server::Server(QObject *parent) : QObject(parent)
             if (m_controlSocket && m_controlSocket->isValid()) {
                 // we don't need the server socket anymore
                 // just m_videoSocket is ok
-                m_serverSocket.close();
-                // we don't need the adb tunnel anymore
-                disableTunnelReverse();
-                m_tunnelEnabled = false;
+                if (!m_params.keepTunnel) {
+                    m_serverSocket.close();
+                    // we don't need the adb tunnel anymore
+                    disableTunnelReverse();
+                    m_tunnelEnabled = false;
+                }
                 emit serverStarted(true, m_deviceName, m_deviceSize);
             } else {
                 stop();
@@ -52,11 +127,69 @@ Server::Server(QObject *parent) : QObject(parent)
 
 Server::~Server() {}
 
+qsc::ServerPushStats Server::getPushStats()
+{
+    return s_pushStats;
+}
+
+bool Server::checkServer()
+{
+    if (m_workProcess.isRuning()) {
+        m_workProcess.kill();
+    }
+    LocalServerJar jar = localServerJar(m_params.serverLocalPath);
+    if (jar.sha256.isEmpty() && !jar.hashing) {
+        // nothing to compare with, let the push report the problem
+        m_serverStartStep = SSS_PUSH;
+        return pushServer();
+    }
+    m_pushClock.start();
+    // a device without sha256sum prints nothing on stdout and gets the push, so
+    // does a device that answers before the local hash is done
+    m_workProcess.execute(m_params.serial, QStringList() << "shell" << "sha256sum" << m_params.serverRemotePath << "2>/dev/null");
+    return true;
+}
+
+bool Server::isServerCurrent(const QString &remoteHashOut)
+{
+    // "<hash>  <path>"
+    QByteArray localHash = localServerJar(m_params.serverLocalPath).sha256;
+    QString remoteHash = remoteHashOut.trimmed().section(' ', 0, 0).toLower();
+    return !localHash.isEmpty() && remoteHash == QString::fromLatin1(localHash);
+}
+
+void Server::onServerPushed(bool skipped)
+{
+    qint64 size = localServerJar(m_params.serverLocalPath).size;
+    if (skipped) {
+        s_pushStats.skipped++;
+        s_pushStats.bytesSaved += static_cast<quint64>(size);
+        qInfo("server jar on %s is current, push skipped", m_params.serial.toUtf8().data());
+    } else {
+        s_pushStats.pushes++;
+        s_pushStats.bytesPushed += static_cast<quint64>(size);
+        s_pushStats.pushMs += m_pushClock.elapsed();
+    }
+    if (s_pushStats.pushes) {
+        // checks that found nothing to skip can cost more than the skips saved
+        s_pushStats.savedMs = qMax<qint64>(0, s_pushStats.skipped * s_pushStats.pushMs / s_pushStats.pushes - s_pushStats.checkMs);
+    }
+
+    if (m_params.useReverse) {
+        m_serverStartStep = SSS_ENABLE_TUNNEL_REVERSE;
+    } else {
+        m_tunnelForward = true;
+        m_serverStartStep = SSS_ENABLE_TUNNEL_FORWARD;
+    }
+    startServerByStep();
+}
+
 bool Server::pushServer()
 {
     if (m_workProcess.isRuning()) {
         m_workProcess.kill();
     }
+    m_pushClock.start();
     m_workProcess.push(m_params.serial, m_params.serverLocalPath, m_params.serverRemotePath);
     return true;
 }
@@ -191,6 +324,12 @@ bool Server::execute()
     // default is false, no need to set
     // args << "power_off_on_close=false";
 
+    // only a server without autosync answers get clipboard, the round trip
+    // probes need that; the controller then forwards device clipboard changes
+    if (m_params.controlProbe) {
+        args << "clipboard_autosync=false";
+    }
+
     // the parameters below use server defaults; minimize parameter passing as too many args cause Samsung phones to error: stack corruption detected (-fstack-protector)
     /*
     args << "clipboard_autosync=true";    
@@ -225,7 +364,23 @@ bool Server::execute()
 bool Server::start(Server::ServerParams params)
 {
     m_params = params;
-    m_serverStartStep = SSS_PUSH;
+    m_serverStartStep = SSS_CHECK_SERVER;
+    m_startTimings = StartTimings();
+    m_timedStep = SSS_NULL;
+    return startServerByStep();
+}
+
+bool Server::restart()
+{
+    if (!m_tunnelEnabled) {
+        return start(m_params);
+    }
+
+    // the tunnel survived, only the device side server has to come back
+    m_serverSocket.resetConnectionOrder();
+    m_startTimings = StartTimings();
+    m_timedStep = SSS_NULL;
+    m_serverStartStep = SSS_EXECUTE_SERVER;
     return startServerByStep();
 }
 
@@ -255,6 +410,12 @@ Server::ServerParams Server::getParams()
     return m_params;
 }
 
+void Server::setVideoParams(quint16 maxSize, quint32 bitRate)
+{
+    m_params.maxSize = maxSize;
+    m_params.bitRate = bitRate;
+}
+
 void Server::timerEvent(QTimerEvent *event)
 {
     if (event && m_acceptTimeoutTimer == event->timerId()) {
@@ -277,7 +438,41 @@ QTcpSocket *Server::getControlSocket()
     return m_controlSocket;
 }
 
-void Server::stop()
+Server::StartTimings Server::getStartTimings()
+{
+    StartTimings timings = m_startTimings;
+    if (m_stepClock.isValid()) {
+        qint64 elapsed = m_stepClock.elapsed();
+        switch (m_timedStep) {
+        case SSS_CHECK_SERVER:
+        case SSS_PUSH:
+            timings.pushMs += elapsed;
+            break;
+        case SSS_ENABLE_TUNNEL_REVERSE:
+        case SSS_ENABLE_TUNNEL_FORWARD:
+            timings.tunnelMs += elapsed;
+            break;
+        case SSS_EXECUTE_SERVER:
+            timings.executeMs += elapsed;
+            break;
+        case SSS_RUNNING:
+            timings.connectMs += elapsed;
+            break;
+        default:
+            break;
+        }
+    }
+    return timings;
+}
+
+void Server::markStartStep(SERVER_START_STEP nextStep)
+{
+    m_startTimings = getStartTimings();
+    m_timedStep = nextStep;
+    m_stepClock.start();
+}
+
+void Server::stop(bool keepTunnel)
 {
     if (m_tunnelForward) {
         stopConnectTimeoutTimer();
@@ -289,6 +484,14 @@ void Server::stop()
         m_controlSocket->close();
         m_controlSocket->deleteLater();
     }
+
+    if (keepTunnel && m_tunnelEnabled) {
+        // results of the killed server process belong to the old session
+        m_serverStartStep = SSS_NULL;
+        m_serverProcess.kill();
+        return;
+    }
+
     // ignore failure
     m_serverProcess.kill();
     if (m_tunnelEnabled) {
@@ -306,9 +509,13 @@ void Server::stop()
 bool Server::startServerByStep()
 {
     bool stepSuccess = false;
+    markStartStep(m_serverStartStep);
     // push, enable tunnel et start the server
     if (SSS_NULL != m_serverStartStep) {
         switch (m_serverStartStep) {
+        case SSS_CHECK_SERVER:
+            stepSuccess = checkServer();
+            break;
         case SSS_PUSH:
             stepSuccess = pushServer();
             break;
@@ -445,9 +652,11 @@ result:
         // devices will send 1 byte first on tunnel forward mode
         controlSocket->read(1);
         m_controlSocket = controlSocket;
-        // we don't need the adb tunnel anymore
-        disableTunnelForward();
-        m_tunnelEnabled = false;
+        if (!m_params.keepTunnel) {
+            // we don't need the adb tunnel anymore
+            disableTunnelForward();
+            m_tunnelEnabled = false;
+        }
         m_restartCount = 0;
         emit serverStarted(success, deviceName, deviceSize);
         return;
@@ -478,15 +687,21 @@ void Server::onWorkProcessResult(qsc::AdbProcess::ADB_EXEC_RESULT processResult)
     if (sender() == &m_workProcess) {
         if (SSS_NULL != m_serverStartStep) {
             switch (m_serverStartStep) {
-            case SSS_PUSH:
-                if (qsc::AdbProcess::AER_SUCCESS_EXEC == processResult) {
-                    if (m_params.useReverse) {
-                        m_serverStartStep = SSS_ENABLE_TUNNEL_REVERSE;
+            case SSS_CHECK_SERVER:
+                if (qsc::AdbProcess::AER_SUCCESS_START != processResult) {
+                    s_pushStats.checks++;
+                    s_pushStats.checkMs += m_pushClock.elapsed();
+                    if (qsc::AdbProcess::AER_SUCCESS_EXEC == processResult && isServerCurrent(m_workProcess.getStdOut())) {
+                        onServerPushed(true);
                     } else {
-                        m_tunnelForward = true;
-                        m_serverStartStep = SSS_ENABLE_TUNNEL_FORWARD;
+                        m_serverStartStep = SSS_PUSH;
+                        startServerByStep();
                     }
-                    startServerByStep();
+                }
+                break;
+            case SSS_PUSH:
+                if (qsc::AdbProcess::AER_SUCCESS_EXEC == processResult) {
+                    onServerPushed(false);
                 } else if (qsc::AdbProcess::AER_SUCCESS_START != processResult) {
                     qCritical("adb push failed");
                     m_serverStartStep = SSS_NULL;
@@ -501,6 +716,7 @@ void Server::onWorkProcessResult(qsc::AdbProcess::ADB_EXEC_RESULT processResult)
                     // client can listen before starting the server app, so there is no need to
                     // try to connect until the server socket is listening on the device.
                     m_serverSocket.setMaxPendingConnections(2);
+                    m_serverSocket.resetConnectionOrder();
                     if (!m_serverSocket.listen(QHostAddress::LocalHost, m_params.localPort)) {
                         qCritical() << QString("Could not listen on port %1").arg(m_params.localPort).toStdString().c_str();
                         m_serverStartStep = SSS_NULL;
@@ -539,6 +755,7 @@ void Server::onWorkProcessResult(qsc::AdbProcess::ADB_EXEC_RESULT processResult)
         if (SSS_EXECUTE_SERVER == m_serverStartStep) {
             if (qsc::AdbProcess::AER_SUCCESS_START == processResult) {
                 m_serverStartStep = SSS_RUNNING;
+                markStartStep(SSS_RUNNING);
                 m_tunnelEnabled = true;
                 connectTo();
             } else if (qsc::AdbProcess::AER_ERROR_START == processResult) {
@@ -1,10 +1,12 @@
 #ifndef SERVER_H
 #define SERVER_H
 
+#include <QElapsedTimer>
 #include <QObject>
 #include <QPointer>
 #include <QSize>
 
+#include "../../../include/ZentroidCoreDef.h"
 #include "adbprocess.h"
 #include "tcpserver.h"
 #include "videosocket.h"
@@ -16,6 +18,7 @@ class Server : public QObject
     enum SERVER_START_STEP
     {
         SSS_NULL,
+        SSS_CHECK_SERVER,
         SSS_PUSH,
         SSS_ENABLE_TUNNEL_REVERSE,
         SSS_ENABLE_TUNNEL_FORWARD,
@@ -53,17 +56,37 @@ public:
         QString crop = "";             // video crop
         bool control = true;           // whether Android device accepts keyboard/mouse control
         qint32 scid = -1;             // random number, used as local socket name suffix to allow multiple connections to the same device
+        bool keepTunnel = false;       // keep the adb tunnel (and reverse listener) after connecting, for restart()
+        bool controlProbe = false;     // clipboard autosync off, get clipboard requests are answered
+    };
+
+    // time spent in each start step, ms
+    struct StartTimings
+    {
+        qint64 pushMs = 0;
+        qint64 tunnelMs = 0;
+        qint64 executeMs = 0;
+        qint64 connectMs = 0;
     };
 
     explicit Server(QObject *parent = nullptr);
     virtual ~Server();
 
     bool start(Server::ServerParams params);
-    void stop();
+    // start again after stop(true): with the tunnel still up only the device server is executed
+    bool restart();
+    // keepTunnel leaves a kept tunnel in place for restart()
+    void stop(bool keepTunnel = false);
     bool isReverse();
     Server::ServerParams getParams();
+    // encoder settings for the next start() or restart()
+    void setVideoParams(quint16 maxSize, quint32 bitRate);
     VideoSocket *removeVideoSocket();
     QTcpSocket *getControlSocket();
+    // the step in progress is counted up to now
+    Server::StartTimings getStartTimings();
+    // server jar pushes of all servers in the process
+    static qsc::ServerPushStats getPushStats();
 
 signals:
     void serverStarted(bool success, const QString &deviceName = "", const QSize &size = QSize());
@@ -76,6 +99,9 @@ protected:
     void timerEvent(QTimerEvent *event);
 
 private:
+    bool checkServer();
+    bool isServerCurrent(const QString &remoteHashOut);
+    void onServerPushed(bool skipped);
     bool pushServer();
     bool enableTunnelReverse();
     bool disableTunnelReverse();
@@ -90,6 +116,8 @@ private:
     void startConnectTimeoutTimer();
     void stopConnectTimeoutTimer();
     void onConnectTimer();
+    // close the timing of the current step and start timing nextStep
+    void markStartStep(SERVER_START_STEP nextStep);
 
 private:
     qsc::AdbProcess m_workProcess;
@@ -108,6 +136,12 @@ private:
     ServerParams m_params;
 
     SERVER_START_STEP m_serverStartStep = SSS_NULL;
+    SERVER_START_STEP m_timedStep = SSS_NULL;
+    QElapsedTimer m_stepClock;
+    StartTimings m_startTimings;
+    QElapsedTimer m_pushClock;
+
+    static qsc::ServerPushStats s_pushStats;
 };
 
 #endif // SERVER_H
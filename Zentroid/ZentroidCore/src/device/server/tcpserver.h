@@ -10,6 +10,9 @@ public:
     explicit TcpServer(QObject *parent = nullptr);
     virtual ~TcpServer();
 
+    // the next connection is a video socket again, for a new server session
+    void resetConnectionOrder();
+
 protected:
     virtual void incomingConnection(qintptr handle);
 
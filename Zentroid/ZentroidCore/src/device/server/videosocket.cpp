@@ -4,6 +4,9 @@
 
 #include "videosocket.h"
 
+// how often a blocked read looks at the stop flag
+#define VIDEOSOCKET_WAIT_SLICE_MS 200
+
 VideoSocket::VideoSocket(QObject *parent) : QTcpSocket(parent)
 {
 }
@@ -12,7 +15,7 @@ VideoSocket::~VideoSocket()
 {
 }
 
-qint32 VideoSocket::subThreadRecvData(quint8 *buf, qint32 bufSize)
+qint32 VideoSocket::subThreadRecvData(quint8 *buf, qint32 bufSize, const QAtomicInt *stop)
 {
     if (!buf) {
         return 0;
@@ -21,7 +24,14 @@ qint32 VideoSocket::subThreadRecvData(quint8 *buf, qint32 bufSize)
     Q_ASSERT(QCoreApplication::instance()->thread() != QThread::currentThread());
 
     while (bytesAvailable() < bufSize) {
-        if (!waitForReadyRead(-1)) {
+        if (stop && stop->loadAcquire()) {
+            return 0;
+        }
+        if (!waitForReadyRead(stop ? VIDEOSOCKET_WAIT_SLICE_MS : -1)) {
+            // a silent but healthy connection just times out the slice
+            if (stop && SocketTimeoutError == error() && ConnectedState == state()) {
+                continue;
+            }
             return 0;
         }
     }
@@ -1,6 +1,7 @@
 #ifndef VIDEOSOCKET_H
 #define VIDEOSOCKET_H
 
+#include <QAtomicInt>
 #include <QTcpSocket>
 
 class VideoSocket : public QTcpSocket
@@ -10,7 +11,8 @@ public:
     explicit VideoSocket(QObject *parent = nullptr);
     virtual ~VideoSocket();
 
-    qint32 subThreadRecvData(quint8 *buf, qint32 bufSize);
+    // blocks until bufSize bytes arrived, the socket failed or stop became non zero
+    qint32 subThreadRecvData(quint8 *buf, qint32 bufSize, const QAtomicInt *stop = Q_NULLPTR);
 };
 
 #endif // VIDEOSOCKET_H
@@ -0,0 +1,331 @@
+#include <QTimerEvent>
+#include <QtEndian>
+
+#include "broadcastengine.h"
+#include "controlmsg.h"
+#include "device.h"
+
+// type(1) action(1) pointerId(8) position
+#define BE_TOUCH_POSITION_OFFSET 10
+// type(1) position
+#define BE_SCROLL_POSITION_OFFSET 1
+// x(4) y(4) width(2) height(2)
+#define BE_POSITION_LENGTH 12
+#define BE_PROBE_INTERVAL_MS 1000
+// a single very slow link must not hold the whole group back further than this
+#define BE_MAX_COMPENSATION_US 250000
+
+namespace qsc {
+
+BroadcastEngine::BroadcastEngine(QObject *parent) : QObject(parent)
+{
+    m_deliveryTimer.setSingleShot(true);
+    m_deliveryTimer.setTimerType(Qt::PreciseTimer);
+    connect(&m_deliveryTimer, &QTimer::timeout, this, &BroadcastEngine::onDeliveryTimer);
+}
+
+BroadcastEngine::~BroadcastEngine()
+{
+    clear();
+}
+
+void BroadcastEngine::setTargets(Device *host, const QVector<Device *> &targets)
+{
+    if (!host) {
+        return;
+    }
+
+    QString serial = host->getSerial();
+    if (targets.isEmpty()) {
+        if (m_groups.contains(serial)) {
+            if (m_groups[serial].host) {
+                m_groups[serial].host->setControlTap(Q_NULLPTR);
+            }
+            m_groups.remove(serial);
+        }
+        return;
+    }
+
+    Group &group = m_groups[serial];
+    group.host = host;
+    group.targets.clear();
+    for (Device *target : targets) {
+        if (target && target != host) {
+            group.targets.append(target);
+        }
+    }
+    host->setControlTap([this, serial](const QByteArray &buffer) { fanOut(serial, buffer); });
+}
+
+void BroadcastEngine::clear()
+{
+    for (auto it = m_groups.begin(); it != m_groups.end(); ++it) {
+        if (it->host) {
+            it->host->setControlTap(Q_NULLPTR);
+        }
+    }
+    m_groups.clear();
+    m_deliveryTimer.stop();
+    m_deliveries.clear();
+}
+
+void BroadcastEngine::fanOut(const QString &hostSerial, const QByteArray &buffer)
+{
+    auto it = m_groups.find(hostSerial);
+    if (it == m_groups.end()) {
+        return;
+    }
+
+    // the pc clipboard follows the host alone, round trip probes and encoder
+    // resets of the health monitor are per device
+    if (!buffer.isEmpty()) {
+        quint8 type = static_cast<quint8>(buffer[0]);
+        if (ControlMsg::CMT_GET_CLIPBOARD == type || ControlMsg::CMT_RESET_VIDEO == type) {
+            return;
+        }
+    }
+
+    int offset = positionOffset(buffer);
+    qint64 groupUs = m_sync ? groupOneWayUs(*it) : 0;
+    qint64 hostOneWayUs = it->host ? it->host->controlRoundTripUs() / 2 : 0;
+    // most farms run identical phones, so this usually holds a single entry
+    QSize lastSize;
+    QByteArray lastBuffer = buffer;
+    for (const QPointer<Device> &target : it->targets) {
+        if (!target) {
+            continue;
+        }
+        if (0 > offset) {
+            deliver(target, buffer, groupUs, hostOneWayUs);
+            continue;
+        }
+        const QSize &size = target->frameSize();
+        if (size.isEmpty()) {
+            // no frame yet, the server would drop a position for an unknown size
+            continue;
+        }
+        if (size != lastSize) {
+            lastSize = size;
+            lastBuffer = rescale(buffer, offset, size);
+        }
+        deliver(target, lastBuffer, groupUs, hostOneWayUs);
+    }
+}
+
+void BroadcastEngine::setSync(bool enabled, int skewWindowMs)
+{
+    m_skewWindowUs = qMax(0, skewWindowMs) * 1000;
+    if (enabled == m_sync) {
+        return;
+    }
+
+    m_sync = enabled;
+    m_syncStates.clear();
+    if (m_sync) {
+        m_clock.start();
+        m_probeTimer = startTimer(BE_PROBE_INTERVAL_MS);
+        probeAll();
+        return;
+    }
+
+    if (m_probeTimer) {
+        killTimer(m_probeTimer);
+        m_probeTimer = 0;
+    }
+    // nothing held back may get lost
+    m_deliveryTimer.stop();
+    for (const Delivery &delivery : m_deliveries) {
+        if (delivery.target) {
+            delivery.target->writeControl(delivery.buffer);
+        }
+    }
+    m_deliveries.clear();
+}
+
+void BroadcastEngine::getSyncStats(QList<BroadcastSyncStats> &stats)
+{
+    for (auto it = m_groups.begin(); it != m_groups.end(); ++it) {
+        for (const QPointer<Device> &target : it->targets) {
+            if (!target) {
+                continue;
+            }
+            BroadcastSyncStats item;
+            item.serial = target->getSerial();
+            item.roundTripUs = target->controlRoundTripUs();
+            SyncState state = m_syncStates.value(item.serial);
+            item.delayUs = state.delayUs;
+            item.skewAvgUs = state.skewSamples ? state.skewSumUs / state.skewSamples : 0;
+            item.skewSamples = state.skewSamples;
+            item.skewMaxUs = state.skewMaxUs;
+            item.messages = state.messages;
+            item.outsideWindow = state.outsideWindow;
+            stats.append(item);
+        }
+    }
+}
+
+void BroadcastEngine::timerEvent(QTimerEvent *event)
+{
+    if (event && m_probeTimer == event->timerId()) {
+        probeAll();
+    }
+}
+
+qint64 BroadcastEngine::groupOneWayUs(const Group &group)
+{
+    // the host applies right away, nobody can be ahead of it
+    qint64 oneWayUs = group.host ? group.host->controlRoundTripUs() / 2 : 0;
+    for (const QPointer<Device> &target : group.targets) {
+        if (target) {
+            oneWayUs = qMax(oneWayUs, target->controlRoundTripUs() / 2);
+        }
+    }
+    return qMin(oneWayUs, static_cast<qint64>(BE_MAX_COMPENSATION_US));
+}
+
+void BroadcastEngine::deliver(Device *target, const QByteArray &buffer, qint64 groupOneWayUs, qint64 hostOneWayUs)
+{
+    if (!m_sync) {
+        target->writeControl(buffer);
+        return;
+    }
+
+    SyncState &state = m_syncStates[target->getSerial()];
+    qint64 nowUs = m_clock.nsecsElapsed() / 1000;
+    qint64 roundTripUs = target->controlRoundTripUs();
+    // not measured yet: send at once and assume it lands with the group
+    qint64 oneWayUs = roundTripUs ? roundTripUs / 2 : groupOneWayUs;
+    qint64 holdUs = groupOneWayUs - oneWayUs;
+    if (holdUs < m_skewWindowUs / 2) {
+        holdUs = 0;
+    }
+    // never reorder the messages of one target
+    qint64 dueUs = qMax(nowUs + holdUs, state.lastDueUs);
+    state.lastDueUs = dueUs;
+    state.delayUs = dueUs - nowUs;
+    state.messages++;
+
+    Delivery delivery;
+    delivery.dueUs = dueUs;
+    delivery.fanOutUs = nowUs;
+    delivery.hostOneWayUs = hostOneWayUs;
+    delivery.target = target;
+    delivery.buffer = buffer;
+    if (dueUs <= nowUs) {
+        write(delivery);
+        return;
+    }
+    schedule(delivery);
+}
+
+void BroadcastEngine::write(const Delivery &delivery)
+{
+    if (!delivery.target) {
+        return;
+    }
+    qint64 writeUs = m_clock.nsecsElapsed() / 1000;
+    delivery.target->writeControl(delivery.buffer);
+
+    // skew against the host from what was measured: when the message really
+    // left (timer lateness and ordering included) plus half of the latest
+    // round trip of each side. Unmeasured round trips give no sample
+    qint64 targetOneWayUs = delivery.target->controlRoundTripUs() / 2;
+    if (0 >= targetOneWayUs || 0 >= delivery.hostOneWayUs) {
+        return;
+    }
+    SyncState &state = m_syncStates[delivery.target->getSerial()];
+    qint64 skewUs = qAbs(writeUs + targetOneWayUs - (delivery.fanOutUs + delivery.hostOneWayUs));
+    state.skewSamples++;
+    state.skewSumUs += skewUs;
+    state.skewMaxUs = qMax(state.skewMaxUs, skewUs);
+    if (skewUs > m_skewWindowUs) {
+        state.outsideWindow++;
+    }
+}
+
+void BroadcastEngine::schedule(const Delivery &delivery)
+{
+    // due times mostly grow, search from the back
+    int index = m_deliveries.size();
+    while (index > 0 && m_deliveries[index - 1].dueUs > delivery.dueUs) {
+        index--;
+    }
+    m_deliveries.insert(index, delivery);
+
+    if (0 == index) {
+        qint64 waitUs = delivery.dueUs - m_clock.nsecsElapsed() / 1000;
+        m_deliveryTimer.start(static_cast<int>(qMax<qint64>(0, (waitUs + 999) / 1000)));
+    }
+}
+
+void BroadcastEngine::onDeliveryTimer()
+{
+    // the timer has ms resolution, take what is due within half of one
+    qint64 nowUs = m_clock.nsecsElapsed() / 1000 + 500;
+    while (!m_deliveries.isEmpty() && m_deliveries.first().dueUs <= nowUs) {
+        write(m_deliveries.takeFirst());
+    }
+
+    if (!m_deliveries.isEmpty()) {
+        qint64 waitUs = m_deliveries.first().dueUs - m_clock.nsecsElapsed() / 1000;
+        m_deliveryTimer.start(static_cast<int>(qMax<qint64>(0, (waitUs + 999) / 1000)));
+    }
+}
+
+void BroadcastEngine::probeAll()
+{
+    for (auto it = m_groups.begin(); it != m_groups.end(); ++it) {
+        if (it->host) {
+            it->host->probeControlRoundTrip();
+        }
+        for (const QPointer<Device> &target : it->targets) {
+            if (target) {
+                target->probeControlRoundTrip();
+            }
+        }
+    }
+}
+
+int BroadcastEngine::positionOffset(const QByteArray &buffer)
+{
+    if (buffer.isEmpty()) {
+        return -1;
+    }
+
+    int offset = -1;
+    switch (static_cast<quint8>(buffer[0])) {
+    case ControlMsg::CMT_INJECT_TOUCH:
+        offset = BE_TOUCH_POSITION_OFFSET;
+        break;
+    case ControlMsg::CMT_INJECT_SCROLL:
+        offset = BE_SCROLL_POSITION_OFFSET;
+        break;
+    default:
+        break;
+    }
+    if (offset + BE_POSITION_LENGTH > buffer.size()) {
+        return -1;
+    }
+    return offset;
+}
+
+QByteArray BroadcastEngine::rescale(const QByteArray &buffer, int offset, const QSize &size)
+{
+    QByteArray out = buffer;
+    uchar *position = reinterpret_cast<uchar *>(out.data()) + offset;
+    qint32 x = qFromBigEndian<qint32>(position);
+    qint32 y = qFromBigEndian<qint32>(position + 4);
+    quint16 width = qFromBigEndian<quint16>(position + 8);
+    quint16 height = qFromBigEndian<quint16>(position + 10);
+    if (!width || !height) {
+        return out;
+    }
+
+    qToBigEndian<qint32>(static_cast<qint32>(static_cast<qint64>(x) * size.width() / width), position);
+    qToBigEndian<qint32>(static_cast<qint32>(static_cast<qint64>(y) * size.height() / height), position + 4);
+    qToBigEndian<quint16>(static_cast<quint16>(size.width()), position + 8);
+    qToBigEndian<quint16>(static_cast<quint16>(size.height()), position + 10);
+    return out;
+}
+
+}
@@ -0,0 +1,101 @@
+#ifndef BROADCASTENGINE_H
+#define BROADCASTENGINE_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QSize>
+#include <QTimer>
+#include <QVector>
+
+#include "../../include/ZentroidCoreDef.h"
+
+namespace qsc {
+
+class Device;
+
+// Group control fan-out. The host converts its input once (its own keymap,
+// its own frame size) and every serialized control message it writes is
+// copied to the targets. Touch and scroll positions are rescaled to each
+// target's last frame size, once per distinct size; all other messages are
+// shared as is.
+// In sync mode each device's control round trip is probed periodically and a
+// message is held back for targets whose one way time (half the round trip)
+// is shorter than the slowest of the group, so all apply it at about the same
+// moment.
+class BroadcastEngine : public QObject
+{
+    Q_OBJECT
+public:
+    explicit BroadcastEngine(QObject *parent = Q_NULLPTR);
+    virtual ~BroadcastEngine();
+
+    // an empty target list stops mirroring the host
+    void setTargets(Device *host, const QVector<Device *> &targets);
+    void clear();
+
+    void setSync(bool enabled, int skewWindowMs);
+    void getSyncStats(QList<qsc::BroadcastSyncStats> &stats);
+
+protected:
+    void timerEvent(QTimerEvent *event);
+
+private:
+    struct Group
+    {
+        QPointer<Device> host;
+        QVector<QPointer<Device>> targets;
+    };
+
+    struct Delivery
+    {
+        qint64 dueUs = 0;
+        qint64 fanOutUs = 0;      // when the host wrote it
+        qint64 hostOneWayUs = 0;  // half the host round trip at that moment
+        QPointer<Device> target;
+        QByteArray buffer;
+    };
+
+    struct SyncState
+    {
+        qint64 lastDueUs = 0;
+        qint64 delayUs = 0;
+        qint64 skewSumUs = 0;
+        qint64 skewMaxUs = 0;
+        quint32 messages = 0;
+        quint32 skewSamples = 0;
+        quint32 outsideWindow = 0;
+    };
+
+    void fanOut(const QString &hostSerial, const QByteArray &buffer);
+    // the moment (from now) every member of the group is expected to apply a message
+    qint64 groupOneWayUs(const Group &group);
+    void deliver(Device *target, const QByteArray &buffer, qint64 groupOneWayUs, qint64 hostOneWayUs);
+    void schedule(const Delivery &delivery);
+    // writes now and records the skew sample
+    void write(const Delivery &delivery);
+    void onDeliveryTimer();
+    void probeAll();
+    // offset of the position field, -1 for messages without one
+    static int positionOffset(const QByteArray &buffer);
+    static QByteArray rescale(const QByteArray &buffer, int offset, const QSize &size);
+
+private:
+    QHash<QString, Group> m_groups;
+
+    // sync mode
+    bool m_sync = false;
+    qint64 m_skewWindowUs = 0;
+    int m_probeTimer = 0;
+    QElapsedTimer m_clock;
+    QTimer m_deliveryTimer;
+    // ordered by dueUs
+    QList<Delivery> m_deliveries;
+    QHash<QString, SyncState> m_syncStates;
+};
+
+}
+
+#endif // BROADCASTENGINE_H
@@ -0,0 +1,178 @@
+#include <QDebug>
+#include <QFileInfo>
+#include <QHash>
+#include <QSet>
+
+#include "bulkconnector.h"
+
+#define BULK_MAX_CONCURRENT 64
+
+namespace qsc {
+
+BulkConnector::BulkConnector(ConnectFunc connectFunc, TimingsFunc timingsFunc, QObject *parent)
+    : QObject(parent)
+    , m_connectFunc(connectFunc)
+    , m_timingsFunc(timingsFunc)
+{
+    connect(&m_scan, &AdbProcess::adbProcessResult, this, &BulkConnector::onScanResult);
+}
+
+BulkConnector::~BulkConnector() {}
+
+bool BulkConnector::start(const QList<DeviceParams> &params, int maxConcurrent)
+{
+    if (m_running) {
+        qWarning("bulk connect already running");
+        return false;
+    }
+    if (params.isEmpty()) {
+        return false;
+    }
+
+    m_running = true;
+    m_clock.start();
+    m_queue.clear();
+    m_results.clear();
+    m_slots.clear();
+    m_slots.resize(qBound(1, maxConcurrent, BULK_MAX_CONCURRENT));
+
+    // the server jar is shared by most devices, check each path once
+    QHash<QString, bool> jarChecked;
+    QSet<QString> serials;
+    for (const DeviceParams &item : params) {
+        if (item.serial.trimmed().isEmpty() || serials.contains(item.serial)) {
+            fail(item, "empty or duplicate serial");
+            continue;
+        }
+        serials.insert(item.serial);
+        if (!jarChecked.contains(item.serverLocalPath)) {
+            jarChecked[item.serverLocalPath] = QFileInfo(item.serverLocalPath).isFile();
+        }
+        if (!jarChecked[item.serverLocalPath]) {
+            fail(item, "server jar not found");
+            continue;
+        }
+        m_queue.append(item);
+    }
+
+    // one scan for the whole batch instead of a failing push per offline device
+    m_scanning = true;
+    m_scan.execute("", QStringList() << "devices");
+    return true;
+}
+
+bool BulkConnector::isRunning()
+{
+    return m_running;
+}
+
+void BulkConnector::onDeviceConnected(bool success, const QString &serial)
+{
+    for (Slot &slot : m_slots) {
+        if (slot.serial.isEmpty() || slot.serial != serial) {
+            continue;
+        }
+
+        DeviceConnectTimings timings;
+        if (m_timingsFunc) {
+            m_timingsFunc(serial, timings);
+        }
+        timings.serial = serial;
+        timings.success = success;
+        timings.queuedMs = slot.queuedMs;
+        timings.totalMs = m_clock.elapsed() - slot.grantedMs;
+        qInfo("bulk connect %s %s: queued %lldms push %lldms tunnel %lldms execute %lldms connect %lldms total %lldms",
+              serial.toUtf8().data(),
+              success ? "ok" : "failed",
+              timings.queuedMs,
+              timings.pushMs,
+              timings.tunnelMs,
+              timings.executeMs,
+              timings.connectMs,
+              timings.totalMs);
+        m_results.append(timings);
+
+        slot = Slot();
+        pump();
+        return;
+    }
+}
+
+void BulkConnector::onScanResult(AdbProcess::ADB_EXEC_RESULT processResult)
+{
+    if (!m_scanning || AdbProcess::AER_SUCCESS_START == processResult) {
+        return;
+    }
+    m_scanning = false;
+
+    if (AdbProcess::AER_SUCCESS_EXEC == processResult) {
+        QStringList online = m_scan.getDevicesSerialFromStdOut();
+        QList<DeviceParams> queue;
+        for (const DeviceParams &item : m_queue) {
+            if (online.contains(item.serial)) {
+                queue.append(item);
+            } else {
+                fail(item, "not online");
+            }
+        }
+        m_queue = queue;
+    } else {
+        // let every bring-up find out on its own
+        qWarning("bulk connect: adb devices failed, trying all devices");
+    }
+    pump();
+}
+
+void BulkConnector::pump()
+{
+    if (!m_running || m_scanning) {
+        return;
+    }
+
+    for (int i = 0; i < m_slots.size() && !m_queue.isEmpty(); i++) {
+        Slot &slot = m_slots[i];
+        if (!slot.serial.isEmpty()) {
+            continue;
+        }
+        DeviceParams params = m_queue.takeFirst();
+        // busy before the call: a result reported from inside it has to find the slot
+        slot.serial = params.serial;
+        slot.grantedMs = m_clock.elapsed();
+        slot.queuedMs = slot.grantedMs;
+        bool started = m_connectFunc && m_connectFunc(params);
+        if (!m_running) {
+            // a result from inside the call finished the batch
+            return;
+        }
+        if (!started && slot.serial == params.serial) {
+            slot = Slot();
+            fail(params, "connect failed");
+            // retry this slot with the next device
+            i--;
+            continue;
+        }
+    }
+
+    bool idle = m_queue.isEmpty();
+    for (const Slot &slot : m_slots) {
+        idle = idle && slot.serial.isEmpty();
+    }
+    if (idle) {
+        m_running = false;
+        qInfo("bulk connect finished: %d devices in %lldms", m_results.size(), m_clock.elapsed());
+        emit finished(m_results);
+    }
+}
+
+void BulkConnector::fail(const DeviceParams &params, const char *reason)
+{
+    qWarning("bulk connect %s skipped: %s", params.serial.toUtf8().data(), reason);
+    DeviceConnectTimings timings;
+    timings.serial = params.serial;
+    timings.success = false;
+    timings.localPort = params.localPort;
+    timings.queuedMs = m_clock.elapsed();
+    m_results.append(timings);
+}
+
+}
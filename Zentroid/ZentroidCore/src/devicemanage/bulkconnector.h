@@ -0,0 +1,65 @@
+#ifndef BULKCONNECTOR_H
+#define BULKCONNECTOR_H
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QVector>
+#include <functional>
+
+#include "../../include/ZentroidCoreDef.h"
+#include "adbprocess.h"
+
+namespace qsc {
+
+// Runs one batch of device bring-ups. A single adb devices scan drops serials
+// that are not online and the server jar of each distinct path is checked once,
+// then up to maxConcurrent bring-ups are kept in flight. Timings of every
+// device are collected for finished().
+class BulkConnector : public QObject
+{
+    Q_OBJECT
+public:
+    // starts one bring-up, false if it could not be started
+    using ConnectFunc = std::function<bool(const DeviceParams &)>;
+    // fills the phase timings of a bring-up that just reported its result
+    using TimingsFunc = std::function<void(const QString &, DeviceConnectTimings &)>;
+
+    BulkConnector(ConnectFunc connectFunc, TimingsFunc timingsFunc, QObject *parent = Q_NULLPTR);
+    virtual ~BulkConnector();
+
+    bool start(const QList<DeviceParams> &params, int maxConcurrent);
+    bool isRunning();
+    // result of a bring-up, unknown serials are ignored
+    void onDeviceConnected(bool success, const QString &serial);
+
+signals:
+    void finished(const QList<qsc::DeviceConnectTimings> &timings);
+
+private:
+    struct Slot
+    {
+        QString serial = "";
+        qint64 grantedMs = 0;
+        qint64 queuedMs = 0;
+    };
+
+    void onScanResult(AdbProcess::ADB_EXEC_RESULT processResult);
+    void pump();
+    void fail(const DeviceParams &params, const char *reason);
+
+private:
+    ConnectFunc m_connectFunc;
+    TimingsFunc m_timingsFunc;
+    AdbProcess m_scan;
+    bool m_running = false;
+    bool m_scanning = false;
+    QElapsedTimer m_clock;
+    QList<DeviceParams> m_queue;
+    QVector<Slot> m_slots;
+    QList<DeviceConnectTimings> m_results;
+};
+
+}
+
+#endif // BULKCONNECTOR_H
@@ -4,8 +4,16 @@
 #include <QWheelEvent>
 
 #include "devicemanage.h"
+#include "broadcastengine.h"
+#include "bulkconnector.h"
 #include "device.h"
 #include "demuxer.h"
+#include "healthmonitor.h"
+#include "inputreplayer.h"
+#include "keymapcache.h"
+#include "metricsserver.h"
+#include "server.h"
+#include "streambudget.h"
 
 namespace qsc {
 
@@ -16,8 +24,11 @@ IDeviceManage& IDeviceManage::getInstance() {
     return dm;
 }
 
-DeviceManage::DeviceManage() {
+DeviceManage::DeviceManage() : m_ports(m_localPortStart, DM_MAX_DEVICES_NUM) {
     Demuxer::init();
+
+    m_healthMonitor = new HealthMonitor([this]() { return getDevices(); }, this);
+    connect(m_healthMonitor, &HealthMonitor::healthChanged, this, &DeviceManage::deviceHealthChanged);
 }
 
 DeviceManage::~DeviceManage() {
@@ -26,10 +37,28 @@ DeviceManage::~DeviceManage() {
 
 QPointer<IDevice> DeviceManage::getDevice(const QString &serial)
 {
-    if (!m_devices.contains(serial)) {
-        return QPointer<IDevice>();
-    }
-    return m_devices[serial];
+    return m_devices.value(serial);
+}
+
+QPointer<IDevice> DeviceManage::getDeviceByPort(quint16 port)
+{
+    return m_portDevices.value(port);
+}
+
+QList<QPointer<IDevice>> DeviceManage::getDevices()
+{
+    return m_devices.values();
+}
+
+void DeviceManage::setKeyMapCacheDir(const QString &dir)
+{
+    KeyMapCache::setCacheDir(dir);
+}
+
+bool DeviceManage::replayInput(const InputReplayParams &params, InputReplayStats &stats)
+{
+    InputReplayer replayer;
+    return replayer.replay(params, stats);
 }
 
 bool DeviceManage::connectDevice(qsc::DeviceParams params)
@@ -44,36 +73,161 @@ bool DeviceManage::connectDevice(qsc::DeviceParams params)
         qInfo("over the maximum number of connections");
         return false;
     }
-    /*
-    // no need to allocate port, just use 27183; the server releases its listener once connection is established
-    quint16 port = 0;
-    if (params.useReverse) {
-         port = getFreePort();
-        if (0 == port) {
-            qInfo("no port available, automatically switch to forward");
-            params.useReverse = false;
-        } else {
-            params.localPort = port;
-            qInfo("free port %d", port);
+    // compensation needs the round trip of every device in the group
+    if (m_broadcastSync) {
+        params.controlProbe = true;
+    }
+    // every device gets a port of its own for its lifetime, so concurrent
+    // bring-ups never share a reverse listener or a forward
+    bool pooledPort = m_ports.contains(params.localPort);
+    if (pooledPort && !m_ports.reserve(params.localPort)) {
+        params.localPort = m_ports.reserve();
+        if (0 == params.localPort) {
+            qInfo("no port available");
+            return false;
         }
+    } else if (!pooledPort && m_portDevices.value(params.localPort)) {
+        qInfo("port %d already in use", params.localPort);
+        return false;
     }
-    */
+
     IDevice *device = new Device(params);
     connect(device, &Device::deviceConnected, this, &DeviceManage::onDeviceConnected);
     connect(device, &Device::deviceDisconnected, this, &DeviceManage::onDeviceDisconnected);
+    quint16 port = params.localPort;
+    QString serial = params.serial;
+    connect(device, &QObject::destroyed, this, [this, serial, port]() {
+        // guarded pointers are already null here, a newer device under the same key stays
+        if (!m_devices.value(serial)) {
+            m_devices.remove(serial);
+        }
+        if (!m_portDevices.value(port)) {
+            m_portDevices.remove(port);
+        }
+        m_ports.release(port);
+    });
     if (!device->connectDevice()) {
         delete device;
         return false;
     }
-    m_devices[params.serial] = device;
+    m_devices[serial] = device;
+    m_portDevices[port] = device;
     return true;
 }
 
+bool DeviceManage::connectDevices(const QList<DeviceParams> &params, int maxConcurrent)
+{
+    if (!m_bulkConnector) {
+        m_bulkConnector = new BulkConnector(
+            [this](const DeviceParams &item) { return connectDevice(item); },
+            [this](const QString &serial, DeviceConnectTimings &timings) {
+                Device *device = qobject_cast<Device *>(m_devices.value(serial).data());
+                if (device) {
+                    timings = device->getConnectTimings();
+                }
+            },
+            this);
+        connect(m_bulkConnector, &BulkConnector::finished, this, &DeviceManage::bulkConnectFinished);
+    }
+    return m_bulkConnector->start(params, maxConcurrent);
+}
+
+void DeviceManage::getServerPushStats(ServerPushStats &stats)
+{
+    stats = Server::getPushStats();
+}
+
+void DeviceManage::setBroadcastTargets(const QString &hostSerial, const QStringList &targetSerials)
+{
+    Device *host = qobject_cast<Device *>(m_devices.value(hostSerial).data());
+    if (!host) {
+        return;
+    }
+    if (!m_broadcastEngine) {
+        m_broadcastEngine = new BroadcastEngine(this);
+    }
+
+    QVector<Device *> targets;
+    targets.reserve(targetSerials.size());
+    for (const QString &serial : targetSerials) {
+        Device *target = qobject_cast<Device *>(m_devices.value(serial).data());
+        if (target) {
+            targets.append(target);
+        }
+    }
+    m_broadcastEngine->setTargets(host, targets);
+}
+
+void DeviceManage::setBroadcastSync(bool enabled, int skewWindowMs)
+{
+    if (!m_broadcastEngine) {
+        m_broadcastEngine = new BroadcastEngine(this);
+    }
+    m_broadcastSync = enabled;
+    m_broadcastEngine->setSync(enabled, skewWindowMs);
+}
+
+void DeviceManage::getBroadcastSyncStats(QList<BroadcastSyncStats> &stats)
+{
+    stats.clear();
+    if (m_broadcastEngine) {
+        m_broadcastEngine->getSyncStats(stats);
+    }
+}
+
+void DeviceManage::setHealthMonitor(bool enabled, bool autoRecover)
+{
+    m_healthMonitorEnabled = enabled;
+    m_healthAutoRecover = autoRecover;
+    // idle until the first device is up, see onDeviceConnected
+    m_healthMonitor->setEnabled(enabled && !m_devices.isEmpty(), autoRecover);
+}
+
+void DeviceManage::getDeviceHealth(QList<DeviceHealthStats> &stats)
+{
+    stats.clear();
+    m_healthMonitor->getStats(stats);
+}
+
+bool DeviceManage::startMetricsServer(quint16 port)
+{
+    if (0 == port) {
+        if (m_metricsServer) {
+            m_metricsServer->close();
+        }
+        return true;
+    }
+    if (!m_metricsServer) {
+        m_metricsServer = new MetricsServer([this]() { return m_healthMonitor->metricsText(); }, this);
+    }
+    return m_metricsServer->listen(port);
+}
+
+void DeviceManage::setStreamBudget(bool enabled, quint32 bandwidthKbps, double decodeCores)
+{
+    if (!m_streamBudget) {
+        m_streamBudget = new StreamBudget([this]() { return getDevices(); }, this);
+    }
+    m_streamBudget->setBudget(enabled, bandwidthKbps, decodeCores);
+}
+
+void DeviceManage::getStreamLoad(QList<StreamLoadStats> &stats)
+{
+    stats.clear();
+    if (m_streamBudget) {
+        m_streamBudget->getStats(stats);
+    }
+}
+
 bool DeviceManage::disconnectDevice(const QString &serial)
 {
     bool ret = false;
     if (!serial.isEmpty() && m_devices.contains(serial)) {
         auto it = m_devices.find(serial);
+        if (m_bulkConnector) {
+            // a bring-up cancelled by the user still frees its slot
+            m_bulkConnector->onDeviceConnected(false, serial);
+        }
         if (it->data()) {
             delete it->data();
             ret = true;
@@ -84,9 +238,12 @@ bool DeviceManage::disconnectDevice(const QString &serial)
 
 void DeviceManage::disconnectAllDevice()
 {
-    QMapIterator<QString, QPointer<IDevice>> i(m_devices);
+    QHashIterator<QString, QPointer<IDevice>> i(m_devices);
     while (i.hasNext()) {
         i.next();
+        if (m_bulkConnector) {
+            m_bulkConnector->onDeviceConnected(false, i.key());
+        }
         if (i.value()) {
             delete i.value();
         }
@@ -96,8 +253,13 @@ void DeviceManage::disconnectAllDevice()
 void DeviceManage::onDeviceConnected(bool success, const QString &serial, const QString &deviceName, const QSize &size)
 {
     emit deviceConnected(success, serial, deviceName, size);
+    if (m_bulkConnector) {
+        m_bulkConnector->onDeviceConnected(success, serial);
+    }
     if (!success) {
         removeDevice(serial);
+    } else if (m_healthMonitorEnabled && !m_healthMonitor->isEnabled()) {
+        m_healthMonitor->setEnabled(true, m_healthAutoRecover);
     }
 }
 
@@ -107,32 +269,12 @@ void DeviceManage::onDeviceDisconnected(QString serial)
     removeDevice(serial);
 }
 
-quint16 DeviceManage::getFreePort()
-{
-    quint16 port = m_localPortStart;
-    while (port < m_localPortStart + DM_MAX_DEVICES_NUM) {
-        bool used = false;
-        QMapIterator<QString, QPointer<IDevice>> i(m_devices);
-        while (i.hasNext()) {
-            i.next();
-            auto device = i.value();
-            if (device && device->isReversePort(port)) {
-                used = true;
-                break;
-            }
-        }
-        if (!used) {
-            return port;
-        }
-        port++;
-    }
-    return 0;
-}
-
 void DeviceManage::removeDevice(const QString &serial)
 {
     if (!serial.isEmpty() && m_devices.contains(serial)) {
-        m_devices[serial]->deleteLater();
+        if (m_devices[serial]) {
+            m_devices[serial]->deleteLater();
+        }
         m_devices.remove(serial);
     }
 }
@@ -1,12 +1,20 @@
 #ifndef DEVICEMANAGE_H
 #define DEVICEMANAGE_H
 
-#include <QMap>
+#include <QHash>
+#include <QPointer>
 
 #include "../../include/ZentroidCore.h"
+#include "portallocator.h"
 
 namespace qsc {
 
+class BroadcastEngine;
+class BulkConnector;
+class HealthMonitor;
+class MetricsServer;
+class StreamBudget;
+
 class DeviceManage : public IDeviceManage
 {
     Q_OBJECT
@@ -15,8 +23,22 @@ public:
     virtual ~DeviceManage();
 
     virtual QPointer<IDevice> getDevice(const QString& serial) override;
+    QPointer<IDevice> getDeviceByPort(quint16 port) override;
+    QList<QPointer<IDevice>> getDevices() override;
+    void setKeyMapCacheDir(const QString& dir) override;
+    bool replayInput(const InputReplayParams& params, InputReplayStats& stats) override;
 
     bool connectDevice(qsc::DeviceParams params) override;
+    bool connectDevices(const QList<qsc::DeviceParams>& params, int maxConcurrent = 8) override;
+    void getServerPushStats(ServerPushStats& stats) override;
+    void setBroadcastTargets(const QString& hostSerial, const QStringList& targetSerials) override;
+    void setBroadcastSync(bool enabled, int skewWindowMs = 5) override;
+    void getBroadcastSyncStats(QList<BroadcastSyncStats>& stats) override;
+    void setHealthMonitor(bool enabled, bool autoRecover = true) override;
+    void getDeviceHealth(QList<DeviceHealthStats>& stats) override;
+    bool startMetricsServer(quint16 port) override;
+    void setStreamBudget(bool enabled, quint32 bandwidthKbps, double decodeCores) override;
+    void getStreamLoad(QList<StreamLoadStats>& stats) override;
     bool disconnectDevice(const QString &serial) override;
     void disconnectAllDevice() override;
 
@@ -25,13 +47,23 @@ protected slots:
     void onDeviceDisconnected(QString serial);
 
 private:
-    quint16 getFreePort();
     void removeDevice(const QString& serial);
 
 private:
-    QMap<QString, QPointer<IDevice>> m_devices;
+    // registry, entries go away with the device object
+    QHash<QString, QPointer<IDevice>> m_devices;
+    QHash<quint16, QPointer<IDevice>> m_portDevices;
     quint16 m_localPortStart = 27183;
+    PortAllocator m_ports;
     QString m_script;
+    QPointer<BulkConnector> m_bulkConnector;
+    QPointer<BroadcastEngine> m_broadcastEngine;
+    QPointer<HealthMonitor> m_healthMonitor;
+    QPointer<MetricsServer> m_metricsServer;
+    QPointer<StreamBudget> m_streamBudget;
+    bool m_broadcastSync = false;
+    bool m_healthMonitorEnabled = true;
+    bool m_healthAutoRecover = true;
 };
 
 }
@@ -0,0 +1,242 @@
+#include <QDebug>
+#include <QSet>
+#include <QTimerEvent>
+
+#include "healthmonitor.h"
+#include "device.h"
+
+#define HM_CHECK_INTERVAL_MS 1000
+// video silent this long gets an encoder reset
+#define HM_IDLE_MS 5000
+// no packet this long after the reset is a stall
+#define HM_STALL_MS 3000
+// a restarted stream that neither ends nor delivers by then is disconnected
+#define HM_RECOVER_TIMEOUT_MS 5000
+#define HM_LOST_PROBES_STALLED 3
+#define HM_SLOW_ROUND_TRIP_US 300000
+
+namespace qsc {
+
+HealthMonitor::HealthMonitor(DevicesFunc devicesFunc, QObject *parent)
+    : QObject(parent)
+    , m_devicesFunc(devicesFunc)
+{
+}
+
+HealthMonitor::~HealthMonitor()
+{
+    setEnabled(false, m_autoRecover);
+}
+
+void HealthMonitor::setEnabled(bool enabled, bool autoRecover)
+{
+    m_autoRecover = autoRecover;
+    if (enabled == isEnabled()) {
+        return;
+    }
+
+    if (enabled) {
+        m_clock.start();
+        m_checkTimer = startTimer(HM_CHECK_INTERVAL_MS);
+        return;
+    }
+    killTimer(m_checkTimer);
+    m_checkTimer = 0;
+    m_states.clear();
+}
+
+bool HealthMonitor::isEnabled()
+{
+    return 0 != m_checkTimer;
+}
+
+void HealthMonitor::getStats(QList<DeviceHealthStats> &stats)
+{
+    for (auto it = m_states.begin(); it != m_states.end(); ++it) {
+        stats.append(it->stats);
+    }
+}
+
+QByteArray HealthMonitor::metricsText()
+{
+    struct Metric
+    {
+        const char *name;
+        const char *type;
+        const char *help;
+        std::function<qint64(const DeviceHealthStats &)> value;
+    };
+    static const Metric metrics[] = {
+        { "zentroid_device_health", "gauge", "0 healthy, 1 degraded, 2 stalled",
+          [](const DeviceHealthStats &s) { return static_cast<qint64>(s.health); } },
+        { "zentroid_device_video_idle_ms", "gauge", "time since the last video packet",
+          [](const DeviceHealthStats &s) { return s.videoIdleMs; } },
+        { "zentroid_device_screen_idle_ms", "gauge", "time since the last decoded frame that changed, 0 without decoding",
+          [](const DeviceHealthStats &s) { return s.screenIdleMs; } },
+        { "zentroid_device_packet_rate", "gauge", "video packets per second",
+          [](const DeviceHealthStats &s) { return static_cast<qint64>(s.packetRate); } },
+        { "zentroid_device_decode_rate", "gauge", "decoded frames per second",
+          [](const DeviceHealthStats &s) { return static_cast<qint64>(s.decodeRate); } },
+        { "zentroid_device_control_round_trip_us", "gauge", "smoothed control round trip",
+          [](const DeviceHealthStats &s) { return s.roundTripUs; } },
+        { "zentroid_device_lost_probes", "gauge", "unanswered control probes in a row",
+          [](const DeviceHealthStats &s) { return static_cast<qint64>(s.lostProbes); } },
+        { "zentroid_device_video_resets_total", "counter", "encoder resets requested",
+          [](const DeviceHealthStats &s) { return static_cast<qint64>(s.videoResets); } },
+        { "zentroid_device_recoveries_total", "counter", "stream restarts forced on a stall",
+          [](const DeviceHealthStats &s) { return static_cast<qint64>(s.recoveries); } },
+    };
+
+    QByteArray text;
+    for (const Metric &metric : metrics) {
+        text += QByteArray("# HELP ") + metric.name + " " + metric.help + "\n";
+        text += QByteArray("# TYPE ") + metric.name + " " + metric.type + "\n";
+        for (auto it = m_states.begin(); it != m_states.end(); ++it) {
+            text += QByteArray(metric.name) + "{serial=\"" + it.key().toUtf8() + "\"} "
+                    + QByteArray::number(metric.value(it->stats)) + "\n";
+        }
+    }
+    return text;
+}
+
+void HealthMonitor::timerEvent(QTimerEvent *event)
+{
+    if (event && m_checkTimer == event->timerId()) {
+        check();
+    }
+}
+
+void HealthMonitor::check()
+{
+    qint64 nowMs = m_clock.elapsed();
+    QSet<QString> alive;
+    const QList<QPointer<IDevice>> devices = m_devicesFunc();
+    for (const QPointer<IDevice> &item : devices) {
+        Device *device = qobject_cast<Device *>(item.data());
+        if (!device) {
+            continue;
+        }
+        const QString &serial = device->getSerial();
+        alive.insert(serial);
+        if (!m_states.contains(serial)) {
+            State &state = m_states[serial];
+            state.stats.serial = serial;
+            state.packets = device->streamPacketCount();
+            state.frames = device->decodedFrameCount();
+            state.changedFrames = device->changedFrameCount();
+            state.checkMs = nowMs;
+            state.lastPacketMs = nowMs;
+            state.lastChangeMs = nowMs;
+        }
+        check(device, m_states[serial], nowMs);
+    }
+
+    for (auto it = m_states.begin(); it != m_states.end();) {
+        if (alive.contains(it.key())) {
+            ++it;
+        } else {
+            it = m_states.erase(it);
+        }
+    }
+}
+
+void HealthMonitor::check(Device *device, State &state, qint64 nowMs)
+{
+    DeviceHealthStats &stats = state.stats;
+    quint32 packets = device->streamPacketCount();
+    quint32 frames = device->decodedFrameCount();
+    qint64 elapsedMs = qMax<qint64>(1, nowMs - state.checkMs);
+    stats.packetRate = static_cast<quint32>((packets - state.packets) * 1000 / elapsedMs);
+    stats.decodeRate = static_cast<quint32>((frames - state.frames) * 1000 / elapsedMs);
+    if (packets != state.packets) {
+        state.lastPacketMs = nowMs;
+        state.resetSentMs = -1;
+        state.recoverMs = -1;
+    }
+    quint32 changedFrames = device->changedFrameCount();
+    if (changedFrames != state.changedFrames) {
+        state.lastChangeMs = nowMs;
+    }
+    state.packets = packets;
+    state.frames = frames;
+    state.changedFrames = changedFrames;
+    state.checkMs = nowMs;
+    state.decoding = device->isDecoding();
+
+    if (!device->isStreaming()) {
+        // connecting or reconnecting, nothing to judge yet
+        state.lastPacketMs = nowMs;
+        state.resetSentMs = -1;
+        state.recoverMs = -1;
+    } else {
+        // a no-op for devices without DeviceParams::controlProbe
+        device->probeControlRoundTrip();
+    }
+    stats.videoIdleMs = nowMs - state.lastPacketMs;
+    // a static screen still sends frames now and then, only changed ones count
+    stats.screenIdleMs = state.decoding ? nowMs - state.lastChangeMs : 0;
+    stats.roundTripUs = device->controlRoundTripUs();
+    stats.lostProbes = device->controlLostProbes();
+
+    DeviceHealth health = device->isStreaming() ? classify(state, nowMs) : DH_DEGRADED;
+    if (health != stats.health) {
+        stats.health = health;
+        device->setHealth(health);
+        emit healthChanged(stats.serial, health);
+    }
+    if (!device->isStreaming()) {
+        return;
+    }
+
+    // recovery ladder
+    if (HM_IDLE_MS < stats.videoIdleMs && 0 > state.resetSentMs) {
+        state.resetSentMs = nowMs;
+        stats.videoResets++;
+        device->resetVideo();
+        return;
+    }
+    if (DH_STALLED != health || !m_autoRecover) {
+        return;
+    }
+    if (0 > state.recoverMs) {
+        qWarning("%s: stream stalled, restarting it", stats.serial.toUtf8().data());
+        state.recoverMs = nowMs;
+        stats.recoveries++;
+        device->recoverStream();
+    } else if (HM_RECOVER_TIMEOUT_MS < nowMs - state.recoverMs) {
+        qWarning("%s: stream restart did not help, disconnecting", stats.serial.toUtf8().data());
+        device->disconnectDevice();
+    }
+}
+
+DeviceHealth HealthMonitor::classify(const State &state, qint64 nowMs)
+{
+    const DeviceHealthStats &stats = state.stats;
+    // probes are read only get clipboard requests and an empty device clipboard
+    // never answers them: only a link that did answer can be judged by them,
+    // otherwise the video packet and decoder counters decide
+    bool probesAnswered = 0 < stats.roundTripUs;
+    if (probesAnswered && HM_LOST_PROBES_STALLED <= stats.lostProbes) {
+        return DH_STALLED;
+    }
+    if (0 <= state.resetSentMs && HM_STALL_MS < nowMs - state.resetSentMs) {
+        return DH_STALLED;
+    }
+
+    if (probesAnswered && 0 < stats.lostProbes) {
+        return DH_DEGRADED;
+    }
+    if (HM_SLOW_ROUND_TRIP_US < stats.roundTripUs) {
+        return DH_DEGRADED;
+    }
+    // packets that do not turn into frames: decoder errors
+    if (state.decoding && 0 < stats.packetRate && stats.decodeRate * 2 < stats.packetRate) {
+        return DH_DEGRADED;
+    }
+    if (0 <= state.resetSentMs) {
+        return DH_DEGRADED;
+    }
+    return DH_HEALTHY;
+}
+
+}
@@ -0,0 +1,75 @@
+#ifndef HEALTHMONITOR_H
+#define HEALTHMONITOR_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <functional>
+
+#include "../../include/ZentroidCore.h"
+
+namespace qsc {
+
+class Device;
+
+// Periodic watchdog over all devices. Every check samples the video packet and
+// decoded frame counters and, for devices with DeviceParams::controlProbe, probes
+// the control round trip with a read only get clipboard.
+// A screen that does not change sends no video at all, so a silent stream first
+// gets an encoder reset; only when that brings no packet either (or a control
+// link that answered stops answering) the device counts as stalled and its stream
+// is restarted.
+class HealthMonitor : public QObject
+{
+    Q_OBJECT
+public:
+    using DevicesFunc = std::function<QList<QPointer<IDevice>>()>;
+
+    HealthMonitor(DevicesFunc devicesFunc, QObject *parent = Q_NULLPTR);
+    virtual ~HealthMonitor();
+
+    void setEnabled(bool enabled, bool autoRecover);
+    bool isEnabled();
+    void getStats(QList<DeviceHealthStats> &stats);
+    // prometheus text exposition format
+    QByteArray metricsText();
+
+signals:
+    void healthChanged(const QString &serial, qsc::DeviceHealth health);
+
+protected:
+    void timerEvent(QTimerEvent *event);
+
+private:
+    struct State
+    {
+        DeviceHealthStats stats;
+        // counters at the last check
+        quint32 packets = 0;
+        quint32 frames = 0;
+        quint32 changedFrames = 0;
+        qint64 checkMs = 0;
+        qint64 lastPacketMs = 0;
+        qint64 lastChangeMs = 0;
+        qint64 resetSentMs = -1;
+        qint64 recoverMs = -1;
+        bool decoding = true;         // headless devices only read the stream
+    };
+
+    void check();
+    void check(Device *device, State &state, qint64 nowMs);
+    DeviceHealth classify(const State &state, qint64 nowMs);
+
+private:
+    DevicesFunc m_devicesFunc;
+    bool m_autoRecover = true;
+    int m_checkTimer = 0;
+    QElapsedTimer m_clock;
+    QHash<QString, State> m_states;
+};
+
+}
+
+#endif // HEALTHMONITOR_H
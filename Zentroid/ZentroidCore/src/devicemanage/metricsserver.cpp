@@ -0,0 +1,98 @@
+#include <QDebug>
+#include <QTcpSocket>
+
+#include "metricsserver.h"
+
+// a request line and a few headers, anything larger is not a scraper
+#define MS_MAX_REQUEST_SIZE 8192
+
+namespace qsc {
+
+MetricsServer::MetricsServer(BodyFunc bodyFunc, QObject *parent)
+    : QObject(parent)
+    , m_bodyFunc(bodyFunc)
+{
+    connect(&m_server, &QTcpServer::newConnection, this, &MetricsServer::onNewConnection);
+}
+
+MetricsServer::~MetricsServer()
+{
+    close();
+}
+
+bool MetricsServer::listen(quint16 port)
+{
+    close();
+    if (!m_server.listen(QHostAddress::LocalHost, port)) {
+        qWarning("metrics server: cannot listen on port %d: %s", port, m_server.errorString().toUtf8().data());
+        return false;
+    }
+    qInfo("metrics server: http://127.0.0.1:%d/metrics", port);
+    return true;
+}
+
+void MetricsServer::close()
+{
+    if (m_server.isListening()) {
+        m_server.close();
+    }
+}
+
+bool MetricsServer::isListening()
+{
+    return m_server.isListening();
+}
+
+void MetricsServer::onNewConnection()
+{
+    while (m_server.hasPendingConnections()) {
+        QTcpSocket *socket = m_server.nextPendingConnection();
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() { onReadyRead(socket); });
+    }
+}
+
+void MetricsServer::onReadyRead(QTcpSocket *socket)
+{
+    // wait for the whole header block
+    QByteArray request = socket->peek(MS_MAX_REQUEST_SIZE);
+    if (!request.contains("\r\n\r\n")) {
+        if (MS_MAX_REQUEST_SIZE <= request.size()) {
+            reply(socket, "431 Request Header Fields Too Large", "");
+        }
+        return;
+    }
+    socket->readAll();
+
+    QList<QByteArray> requestLine = request.left(request.indexOf("\r\n")).split(' ');
+    if (3 > requestLine.size() || "GET" != requestLine[0]) {
+        reply(socket, "405 Method Not Allowed", "");
+        return;
+    }
+    QByteArray path = requestLine[1];
+    int query = path.indexOf('?');
+    if (0 <= query) {
+        path.truncate(query);
+    }
+    if ("/metrics" != path) {
+        reply(socket, "404 Not Found", "");
+        return;
+    }
+    reply(socket, "200 OK", m_bodyFunc ? m_bodyFunc() : QByteArray());
+}
+
+void MetricsServer::reply(QTcpSocket *socket, const QByteArray &status, const QByteArray &body)
+{
+    // one request per connection
+    disconnect(socket, &QTcpSocket::readyRead, this, Q_NULLPTR);
+
+    QByteArray response = "HTTP/1.1 " + status + "\r\n";
+    response += "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n";
+    response += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+    response += "Connection: close\r\n\r\n";
+    response += body;
+    socket->write(response);
+    socket->disconnectFromHost();
+}
+
+}
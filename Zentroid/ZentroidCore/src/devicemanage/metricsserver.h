@@ -0,0 +1,38 @@
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <QPointer>
+#include <QTcpServer>
+#include <functional>
+
+namespace qsc {
+
+// Minimal http endpoint on the loopback interface: GET /metrics answers with
+// the text of the body function, everything else gets a 404.
+// One request per connection, the connection is closed after the reply.
+class MetricsServer : public QObject
+{
+    Q_OBJECT
+public:
+    using BodyFunc = std::function<QByteArray()>;
+
+    MetricsServer(BodyFunc bodyFunc, QObject *parent = Q_NULLPTR);
+    virtual ~MetricsServer();
+
+    bool listen(quint16 port);
+    void close();
+    bool isListening();
+
+private:
+    void onNewConnection();
+    void onReadyRead(QTcpSocket *socket);
+    void reply(QTcpSocket *socket, const QByteArray &status, const QByteArray &body);
+
+private:
+    BodyFunc m_bodyFunc;
+    QTcpServer m_server;
+};
+
+}
+
+#endif // METRICSSERVER_H
@@ -0,0 +1,74 @@
+#include <QtAlgorithms>
+
+#include "portallocator.h"
+
+namespace qsc {
+
+PortAllocator::PortAllocator(quint16 base, int count) : m_base(base), m_count(qBound(0, count, 65536 - base))
+{
+    m_words.resize((m_count + 63) / 64);
+    // bits past the end of the range are never handed out
+    int tail = m_count % 64;
+    if (tail) {
+        m_words.last() = ~((quint64(1) << tail) - 1);
+    }
+}
+
+quint16 PortAllocator::reserve()
+{
+    for (int i = m_firstFreeWord; i < m_words.size(); i++) {
+        quint64 word = m_words[i];
+        if (~word) {
+            int bit = static_cast<int>(qCountTrailingZeroBits(~word));
+            m_words[i] |= quint64(1) << bit;
+            m_firstFreeWord = i;
+            m_reserved++;
+            return static_cast<quint16>(m_base + i * 64 + bit);
+        }
+    }
+    m_firstFreeWord = m_words.size();
+    return 0;
+}
+
+bool PortAllocator::reserve(quint16 port)
+{
+    if (!contains(port) || isReserved(port)) {
+        return false;
+    }
+    int index = port - m_base;
+    m_words[index / 64] |= quint64(1) << (index % 64);
+    m_reserved++;
+    return true;
+}
+
+void PortAllocator::release(quint16 port)
+{
+    if (!isReserved(port)) {
+        return;
+    }
+    int index = port - m_base;
+    m_words[index / 64] &= ~(quint64(1) << (index % 64));
+    m_firstFreeWord = qMin(m_firstFreeWord, index / 64);
+    m_reserved--;
+}
+
+bool PortAllocator::isReserved(quint16 port) const
+{
+    if (!contains(port)) {
+        return false;
+    }
+    int index = port - m_base;
+    return m_words[index / 64] & (quint64(1) << (index % 64));
+}
+
+bool PortAllocator::contains(quint16 port) const
+{
+    return port >= m_base && port - m_base < m_count;
+}
+
+int PortAllocator::reservedCount() const
+{
+    return m_reserved;
+}
+
+}
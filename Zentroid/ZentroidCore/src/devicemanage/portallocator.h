@@ -0,0 +1,36 @@
+#ifndef PORTALLOCATOR_H
+#define PORTALLOCATOR_H
+
+#include <QVector>
+
+namespace qsc {
+
+// Bitmap over a fixed range of local ports. reserve() takes the lowest free
+// port by skipping full 64-bit words, so a lookup costs at most range / 64
+// word tests no matter how many devices hold a port.
+class PortAllocator
+{
+public:
+    PortAllocator(quint16 base, int count);
+
+    // lowest free port, 0 when the range is exhausted
+    quint16 reserve();
+    // a specific port, false when it is taken or outside the range
+    bool reserve(quint16 port);
+    void release(quint16 port);
+    bool isReserved(quint16 port) const;
+    bool contains(quint16 port) const;
+    int reservedCount() const;
+
+private:
+    quint16 m_base = 0;
+    int m_count = 0;
+    int m_reserved = 0;
+    // lowest word that may have a free bit
+    int m_firstFreeWord = 0;
+    QVector<quint64> m_words;
+};
+
+}
+
+#endif // PORTALLOCATOR_H
@@ -0,0 +1,306 @@
+#include <QDebug>
+#include <QSet>
+#include <QTimerEvent>
+
+#include "streambudget.h"
+#include "device.h"
+
+#define SB_CHECK_INTERVAL_MS 2000
+// a restart costs about a second of video, let the new settings settle first
+#define SB_COOLDOWN_MS 15000
+#define SB_MIN_BIT_RATE 500000
+#define SB_MIN_SIZE 480
+// more than this waiting in the socket: the decoder does not keep up
+#define SB_BACKLOG_BYTES (1024 * 1024)
+// checks in a row a device has to fall behind before it is scaled down alone
+#define SB_PRESSURE_CHECKS 3
+// a frame rate below this says nothing about skipped frames
+#define SB_MIN_FPS 5
+// share of a budget that has to be free before anything steps up
+#define SB_HEADROOM 0.6
+
+namespace qsc {
+
+StreamBudget::StreamBudget(DevicesFunc devicesFunc, QObject *parent)
+    : QObject(parent)
+    , m_devicesFunc(devicesFunc)
+{
+}
+
+StreamBudget::~StreamBudget()
+{
+    setBudget(false, 0, 0.0);
+}
+
+void StreamBudget::setBudget(bool enabled, quint32 bandwidthKbps, double decodeCores)
+{
+    m_bandwidthKbps = bandwidthKbps;
+    m_decodeCores = qMax(0.0, decodeCores);
+    if (enabled == (0 != m_checkTimer)) {
+        return;
+    }
+
+    // states are kept while disabled, they hold the connect settings to return to
+    if (enabled) {
+        m_clock.start();
+        for (auto it = m_states.begin(); it != m_states.end(); ++it) {
+            it->sampleMs = -1;
+            it->measured = false;
+        }
+        m_checkTimer = startTimer(SB_CHECK_INTERVAL_MS);
+        return;
+    }
+    killTimer(m_checkTimer);
+    m_checkTimer = 0;
+}
+
+void StreamBudget::getStats(QList<StreamLoadStats> &stats)
+{
+    for (auto it = m_states.begin(); it != m_states.end(); ++it) {
+        stats.append(it->stats);
+    }
+}
+
+void StreamBudget::timerEvent(QTimerEvent *event)
+{
+    if (event && m_checkTimer == event->timerId()) {
+        check();
+    }
+}
+
+void StreamBudget::check()
+{
+    qint64 nowMs = m_clock.elapsed();
+    QList<Device *> streaming;
+    QSet<QString> alive;
+    const QList<QPointer<IDevice>> devices = m_devicesFunc();
+    for (const QPointer<IDevice> &item : devices) {
+        Device *device = qobject_cast<Device *>(item.data());
+        if (!device) {
+            continue;
+        }
+        const QString &serial = device->getSerial();
+        alive.insert(serial);
+        if (!m_states.contains(serial)) {
+            State &state = m_states[serial];
+            state.stats.serial = serial;
+            state.stats.baseMaxSize = device->streamMaxSize();
+            state.stats.baseBitRate = device->streamBitRate();
+        }
+        if (device->isStreaming()) {
+            streaming.append(device);
+        } else {
+            // counters jump across a restart, measure from scratch
+            m_states[serial].sampleMs = -1;
+            m_states[serial].measured = false;
+        }
+    }
+    for (auto it = m_states.begin(); it != m_states.end();) {
+        if (alive.contains(it.key())) {
+            ++it;
+        } else {
+            it = m_states.erase(it);
+        }
+    }
+
+    // no inserts or removals from here on, the state pointers stay valid
+    QList<QPair<Device *, State *>> active;
+    quint64 totalKbps = 0;
+    double totalCores = 0.0;
+    for (Device *device : streaming) {
+        State &state = m_states[device->getSerial()];
+        sample(device, state, nowMs);
+        if (state.measured) {
+            totalKbps += state.stats.recvKbps;
+            totalCores += state.stats.decodeCores;
+            active.append(qMakePair(device, &state));
+        }
+    }
+
+    bool overBandwidth = 0 < m_bandwidthKbps && m_bandwidthKbps < totalKbps;
+    bool overDecode = 0.0 < m_decodeCores && m_decodeCores < totalCores;
+
+    if (overBandwidth) {
+        // heaviest sender that still has bit rate to give
+        QPair<Device *, State *> target(Q_NULLPTR, Q_NULLPTR);
+        for (const auto &item : active) {
+            const StreamLoadStats &stats = item.second->stats;
+            if (!canChange(*item.second, nowMs) || SB_MIN_BIT_RATE >= stats.bitRate) {
+                continue;
+            }
+            if (!target.first || target.second->stats.recvKbps < stats.recvKbps) {
+                target = item;
+            }
+        }
+        if (target.first) {
+            const StreamLoadStats &stats = target.second->stats;
+            quint32 bitRate = qMax<quint32>(SB_MIN_BIT_RATE, static_cast<quint32>(stats.bitRate * 7ULL / 10));
+            apply(target.first, *target.second, stats.maxSize, bitRate, nowMs);
+        }
+    }
+
+    // over the decode budget the most expensive decoder shrinks, otherwise one
+    // that keeps falling behind on its own
+    QPair<Device *, State *> target(Q_NULLPTR, Q_NULLPTR);
+    quint16 targetSize = 0;
+    for (const auto &item : active) {
+        quint16 maxSize = 0;
+        if (!canChange(*item.second, nowMs) || !smallerSize(*item.second, maxSize)) {
+            continue;
+        }
+        if (!overDecode && SB_PRESSURE_CHECKS > item.second->pressureChecks) {
+            continue;
+        }
+        if (!target.first || target.second->stats.decodeCores < item.second->stats.decodeCores) {
+            target = item;
+            targetSize = maxSize;
+        }
+    }
+    if (target.first) {
+        apply(target.first, *target.second, targetSize, target.second->stats.bitRate, nowMs);
+        return;
+    }
+    if (overBandwidth || overDecode) {
+        return;
+    }
+
+    // room on both budgets: the device furthest below its connect settings steps up
+    double bestRatio = 1.0;
+    target = QPair<Device *, State *>(Q_NULLPTR, Q_NULLPTR);
+    for (const auto &item : active) {
+        const State &state = *item.second;
+        const StreamLoadStats &stats = state.stats;
+        if (!canChange(state, nowMs) || 0 < state.pressureChecks || 0 == stats.baseBitRate) {
+            continue;
+        }
+        quint16 size = effectiveSize(state, stats.maxSize);
+        quint16 baseSize = effectiveSize(state, stats.baseMaxSize);
+        double ratio = static_cast<double>(stats.bitRate) / stats.baseBitRate;
+        if (size && baseSize) {
+            ratio *= static_cast<double>(size) / baseSize;
+        }
+        if (ratio < bestRatio) {
+            bestRatio = ratio;
+            target = item;
+        }
+    }
+    if (!target.first) {
+        return;
+    }
+
+    State &state = *target.second;
+    const StreamLoadStats &stats = state.stats;
+    quint32 bitRate = stats.bitRate;
+    if (bitRate < stats.baseBitRate) {
+        bitRate = qMin<quint32>(stats.baseBitRate, static_cast<quint32>(bitRate * 5ULL / 4));
+        // the raised rate has to fit, as if the stream used all of it
+        quint64 expectedKbps = totalKbps + stats.recvKbps / 4;
+        if (0 < m_bandwidthKbps && m_bandwidthKbps * SB_HEADROOM < expectedKbps) {
+            bitRate = stats.bitRate;
+        }
+    }
+    quint16 maxSize = stats.maxSize;
+    // a step up in size costs about three quarters more decoding
+    bool decodeFits = 0.0 == m_decodeCores || totalCores + stats.decodeCores * 3 / 4 < m_decodeCores * SB_HEADROOM;
+    if (decodeFits) {
+        largerSize(state, maxSize);
+    }
+    if (bitRate != stats.bitRate || maxSize != stats.maxSize) {
+        apply(target.first, state, maxSize, bitRate, nowMs);
+    }
+}
+
+void StreamBudget::sample(Device *device, State &state, qint64 nowMs)
+{
+    StreamLoadStats &stats = state.stats;
+    quint32 bytes = device->streamRecvBytes();
+    quint32 frames = device->decodedFrameCount();
+    quint32 skipped = device->skippedFrameCount();
+    quint32 decodeUs = device->decodeTimeUs();
+    stats.maxSize = device->streamMaxSize();
+    stats.bitRate = device->streamBitRate();
+    stats.backlogBytes = device->streamBacklogBytes();
+    const QSize &frameSize = device->frameSize();
+    if (0 == stats.maxSize && frameSize.isValid()) {
+        state.nativeSize = static_cast<quint16>(qMax(frameSize.width(), frameSize.height()));
+    }
+
+    if (0 <= state.sampleMs) {
+        // counters wrap around, the unsigned differences stay right
+        qint64 elapsedMs = qMax<qint64>(1, nowMs - state.sampleMs);
+        quint32 decodedFrames = frames - state.frames;
+        quint32 decodedUs = decodeUs - state.decodeUs;
+        stats.recvKbps = static_cast<quint32>(static_cast<quint64>(bytes - state.bytes) * 8 / elapsedMs);
+        stats.decodeFps = static_cast<quint32>(decodedFrames * 1000ULL / elapsedMs);
+        stats.skippedFps = static_cast<quint32>((skipped - state.skipped) * 1000ULL / elapsedMs);
+        stats.decodeUsPerFrame = decodedFrames ? decodedUs / decodedFrames : 0;
+        stats.decodeCores = decodedUs / (elapsedMs * 1000.0);
+        state.measured = true;
+
+        bool behind = SB_BACKLOG_BYTES < stats.backlogBytes
+                      || (SB_MIN_FPS <= stats.decodeFps && stats.decodeFps < stats.skippedFps * 2);
+        state.pressureChecks = behind ? state.pressureChecks + 1 : 0;
+    }
+    state.bytes = bytes;
+    state.frames = frames;
+    state.skipped = skipped;
+    state.decodeUs = decodeUs;
+    state.sampleMs = nowMs;
+}
+
+bool StreamBudget::canChange(const State &state, qint64 nowMs)
+{
+    return state.measured && (0 > state.changedMs || SB_COOLDOWN_MS < nowMs - state.changedMs);
+}
+
+bool StreamBudget::apply(Device *device, State &state, quint16 maxSize, quint32 bitRate, qint64 nowMs)
+{
+    // a refused restart (recording) is not retried before the cooldown either
+    state.changedMs = nowMs;
+    if (!device->reconfigureStream(maxSize, bitRate)) {
+        return false;
+    }
+    state.stats.maxSize = maxSize;
+    state.stats.bitRate = bitRate;
+    state.stats.reconfigures++;
+    state.pressureChecks = 0;
+    state.sampleMs = -1;
+    state.measured = false;
+    return true;
+}
+
+quint16 StreamBudget::effectiveSize(const State &state, quint16 maxSize)
+{
+    if (0 == maxSize) {
+        return state.nativeSize;
+    }
+    if (state.nativeSize) {
+        return qMin(maxSize, state.nativeSize);
+    }
+    return maxSize;
+}
+
+bool StreamBudget::smallerSize(const State &state, quint16 &maxSize)
+{
+    quint16 size = effectiveSize(state, state.stats.maxSize);
+    if (SB_MIN_SIZE >= size) {
+        return false;
+    }
+    // the encoder wants multiples of 8
+    maxSize = qMax<quint16>(SB_MIN_SIZE, static_cast<quint16>((size * 3 / 4) & ~7));
+    return true;
+}
+
+bool StreamBudget::largerSize(const State &state, quint16 &maxSize)
+{
+    quint16 size = effectiveSize(state, state.stats.maxSize);
+    quint16 baseSize = effectiveSize(state, state.stats.baseMaxSize);
+    if (0 == size || 0 == baseSize || size >= baseSize) {
+        return false;
+    }
+    quint16 next = static_cast<quint16>((size * 4 / 3 + 7) & ~7);
+    maxSize = next >= baseSize ? state.stats.baseMaxSize : next;
+    return true;
+}
+
+}
@@ -0,0 +1,78 @@
+#ifndef STREAMBUDGET_H
+#define STREAMBUDGET_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <functional>
+
+#include "../../include/ZentroidCore.h"
+
+namespace qsc {
+
+class Device;
+
+// Host wide budget for all video streams. Every check samples receive
+// throughput, demuxer backlog, decoder time and skipped frames per device.
+// The server cannot change its encoder on the fly, so a change is a warm stream
+// restart; at most one step down per budget and one step up happen per check,
+// and a restarted device is left alone for a while.
+// Over the bandwidth budget the heaviest sender gets a lower bit rate, over the
+// decode budget (or when one device keeps falling behind) the most expensive
+// decoder gets a smaller max size. With room on both, the device furthest below
+// its connect settings steps back up.
+class StreamBudget : public QObject
+{
+    Q_OBJECT
+public:
+    using DevicesFunc = std::function<QList<QPointer<IDevice>>()>;
+
+    StreamBudget(DevicesFunc devicesFunc, QObject *parent = Q_NULLPTR);
+    virtual ~StreamBudget();
+
+    void setBudget(bool enabled, quint32 bandwidthKbps, double decodeCores);
+    void getStats(QList<StreamLoadStats> &stats);
+
+protected:
+    void timerEvent(QTimerEvent *event);
+
+private:
+    struct State
+    {
+        StreamLoadStats stats;
+        quint16 nativeSize = 0;       // larger side of the unscaled frame
+        // counters at the last check
+        quint32 bytes = 0;
+        quint32 frames = 0;
+        quint32 skipped = 0;
+        quint32 decodeUs = 0;
+        qint64 sampleMs = -1;
+        bool measured = false;
+        qint64 changedMs = -1;
+        int pressureChecks = 0;       // checks in a row the device fell behind on its own
+    };
+
+    void check();
+    void sample(Device *device, State &state, qint64 nowMs);
+    bool canChange(const State &state, qint64 nowMs);
+    bool apply(Device *device, State &state, quint16 maxSize, quint32 bitRate, qint64 nowMs);
+    // max size as a pixel count of the larger side, 0 if the native size is not known yet
+    quint16 effectiveSize(const State &state, quint16 maxSize);
+    // next max size step, false if there is none
+    bool smallerSize(const State &state, quint16 &maxSize);
+    bool largerSize(const State &state, quint16 &maxSize);
+
+private:
+    DevicesFunc m_devicesFunc;
+    quint32 m_bandwidthKbps = 0;
+    double m_decodeCores = 0.0;
+    int m_checkTimer = 0;
+    QElapsedTimer m_clock;
+    QHash<QString, State> m_states;
+};
+
+}
+
+#endif // STREAMBUDGET_H
@@ -0,0 +1,269 @@
+#include <QDebug>
+#include <cmath>
+#include <cstring>
+
+extern "C"
+{
+#include "libavutil/channel_layout.h"
+#include "libswresample/swresample.h"
+}
+
+#include "audiojitterbuffer.h"
+
+// target fill limits
+#define AJB_MIN_TARGET_US 20000
+#define AJB_MAX_TARGET_US 250000
+// target = min + jitter * factor + underrun floor
+#define AJB_JITTER_FACTOR 3
+#define AJB_UNDERRUN_FLOOR_US 10000
+#define AJB_MAX_FLOOR_US 120000
+// the floor decays by 1 ms per second
+#define AJB_FLOOR_DECAY 1000
+// above target + margin the oldest pcm is dropped
+#define AJB_OVERRUN_MARGIN_US 100000
+// fill errors this small are left alone, the consumer drains in bursts
+#define AJB_DEADBAND_US 3000
+// at most 0.5% speed change, inaudible for speech and music
+#define AJB_MAX_CORRECTION 0.005
+// share of the fill error corrected per second of audio
+#define AJB_CORRECTION_RATE 0.1
+// the ring holds the largest target plus margin with room to spare
+#define AJB_RING_US 500000
+// larger writes are resampled in pieces, the output buffer is sized once for this
+#define AJB_CHUNK_FRAMES 4096
+
+AudioJitterBuffer::AudioJitterBuffer(int sampleRate, int channels)
+    : m_sampleRate(sampleRate)
+    , m_frameBytes(channels * 2)
+    , m_ring(static_cast<int>(static_cast<qint64>(AJB_RING_US) * sampleRate / 1000000 * channels * 2))
+{
+}
+
+AudioJitterBuffer::~AudioJitterBuffer()
+{
+    if (m_swr) {
+        swr_free(&m_swr);
+    }
+    delete[] m_resampled;
+}
+
+bool AudioJitterBuffer::init()
+{
+    if (m_swr) {
+        return true;
+    }
+    int64_t layout = av_get_default_channel_layout(m_frameBytes / 2);
+    m_swr = swr_alloc_set_opts(nullptr, layout, AV_SAMPLE_FMT_S16, m_sampleRate, layout, AV_SAMPLE_FMT_S16, m_sampleRate, 0, nullptr);
+    if (!m_swr || 0 > swr_init(m_swr)) {
+        qWarning("AudioJitterBuffer::cannot init the resampler, drift is not corrected");
+        if (m_swr) {
+            swr_free(&m_swr);
+        }
+        return false;
+    }
+    // compensation needs the resampler, switch it on up front
+    swr_set_compensation(m_swr, 0, 0);
+    // the largest correction plus what the filter holds back
+    m_resampledFrames = swr_get_out_samples(m_swr, AJB_CHUNK_FRAMES * 2);
+    m_resampled = new char[m_resampledFrames * m_frameBytes];
+    reset();
+    return true;
+}
+
+void AudioJitterBuffer::reset()
+{
+    m_clock.start();
+    m_partialSize = 0;
+    m_inputFrames = 0;
+    m_haveTransit = false;
+    m_jitterUs = 0.0;
+    m_errorUs = 0.0;
+    m_deltaCarry = 0.0;
+    m_driftPpm = 0.0;
+    m_floorUs = 0;
+    m_seenUnderruns = 0;
+    m_lastWriteUs = 0;
+    if (m_swr) {
+        // drop what the filter still holds from the last session
+        swr_init(m_swr);
+        swr_set_compensation(m_swr, 0, 0);
+    }
+
+    m_ring.clear();
+    m_filling = true;
+    m_targetUs.storeRelease(AJB_MIN_TARGET_US);
+    m_dropRequest.storeRelease(0);
+    m_underruns.storeRelease(0);
+    m_overruns.storeRelease(0);
+    m_droppedBytes.storeRelease(0);
+    m_jitterStatUs.storeRelease(0);
+    m_driftStatPpm.storeRelease(0);
+}
+
+void AudioJitterBuffer::write(const char *data, int size)
+{
+    if (0 >= size) {
+        return;
+    }
+    qint64 nowUs = m_clock.nsecsElapsed() / 1000;
+
+    // keep frames whole
+    if (m_partialSize) {
+        int take = qMin(m_frameBytes - m_partialSize, size);
+        memcpy(m_partial + m_partialSize, data, static_cast<size_t>(take));
+        m_partialSize += take;
+        data += take;
+        size -= take;
+        if (m_partialSize < m_frameBytes) {
+            return;
+        }
+        m_partialSize = 0;
+        writeFrames(m_partial, 1, nowUs);
+    }
+    int frames = size / m_frameBytes;
+    m_partialSize = size % m_frameBytes;
+    memcpy(m_partial, data + frames * m_frameBytes, static_cast<size_t>(m_partialSize));
+
+    while (0 < frames) {
+        int chunk = qMin(frames, AJB_CHUNK_FRAMES);
+        writeFrames(data, chunk, nowUs);
+        data += chunk * m_frameBytes;
+        frames -= chunk;
+    }
+}
+
+int AudioJitterBuffer::read(char *data, int maxSize)
+{
+    int drop = m_dropRequest.fetchAndStoreAcquire(0);
+    if (drop) {
+        m_droppedBytes.fetchAndAddRelease(m_ring.skip(drop));
+    }
+
+    int available = m_ring.readable();
+    if (m_filling) {
+        if (bytesToUs(available) < m_targetUs.loadAcquire()) {
+            return 0;
+        }
+        m_filling = false;
+    }
+
+    int size = qMin(maxSize - maxSize % m_frameBytes, available);
+    if (0 == size && 0 < maxSize) {
+        // played dry: build the cushion up again, the producer raises the floor
+        m_filling = true;
+        m_underruns.fetchAndAddRelease(1);
+        return 0;
+    }
+    return m_ring.read(data, size);
+}
+
+void AudioJitterBuffer::getStats(AudioJitterStats &stats)
+{
+    stats.fillMs = static_cast<quint32>(bytesToUs(m_ring.readable()) / 1000);
+    stats.targetMs = static_cast<quint32>(m_targetUs.loadAcquire() / 1000);
+    stats.jitterMs = static_cast<quint32>(m_jitterStatUs.loadAcquire() / 1000);
+    stats.driftPpm = m_driftStatPpm.loadAcquire();
+    stats.underruns = static_cast<quint32>(m_underruns.loadAcquire());
+    stats.overruns = static_cast<quint32>(m_overruns.loadAcquire());
+    stats.droppedBytes = static_cast<quint32>(m_droppedBytes.loadAcquire());
+}
+
+qint64 AudioJitterBuffer::bytesToUs(qint64 bytes) const
+{
+    return bytes / m_frameBytes * 1000000 / m_sampleRate;
+}
+
+qint64 AudioJitterBuffer::usToBytes(qint64 us) const
+{
+    return us * m_sampleRate / 1000000 * m_frameBytes;
+}
+
+void AudioJitterBuffer::writeFrames(const char *data, int frames, qint64 nowUs)
+{
+    updateJitter(nowUs, frames);
+    updateTarget(nowUs);
+
+    int fill = m_ring.readable();
+    int outFrames = resample(data, frames, bytesToUs(fill));
+    const char *out = m_swr ? m_resampled : data;
+    int outBytes = (m_swr ? outFrames : frames) * m_frameBytes;
+
+    qint64 targetUs = m_targetUs.loadAcquire();
+    if (fill + outBytes > usToBytes(targetUs + AJB_OVERRUN_MARGIN_US)) {
+        // the consumer owns the read side, let it cut back to the target
+        m_dropRequest.storeRelease(static_cast<int>(fill + outBytes - usToBytes(targetUs)));
+        m_overruns.fetchAndAddRelease(1);
+    }
+    int written = m_ring.write(out, outBytes);
+    if (written < outBytes) {
+        m_droppedBytes.fetchAndAddRelease(outBytes - written);
+    }
+}
+
+void AudioJitterBuffer::updateJitter(qint64 nowUs, int frames)
+{
+    // transit = arrival - media time; its variation is the jitter (rfc 3550)
+    qint64 mediaUs = m_inputFrames * 1000000 / m_sampleRate;
+    qint64 transitUs = nowUs - mediaUs;
+    if (m_haveTransit) {
+        double d = std::abs(static_cast<double>(transitUs - m_lastTransitUs));
+        m_jitterUs += (d - m_jitterUs) / 16.0;
+    }
+    m_lastTransitUs = transitUs;
+    m_haveTransit = true;
+    m_inputFrames += frames;
+    m_jitterStatUs.storeRelease(static_cast<int>(m_jitterUs));
+}
+
+void AudioJitterBuffer::updateTarget(qint64 nowUs)
+{
+    if (m_lastWriteUs) {
+        m_floorUs = qMax<qint64>(0, m_floorUs - (nowUs - m_lastWriteUs) / AJB_FLOOR_DECAY);
+    }
+    m_lastWriteUs = nowUs;
+    int underruns = m_underruns.loadAcquire();
+    if (underruns != m_seenUnderruns) {
+        m_floorUs = qMin<qint64>(AJB_MAX_FLOOR_US, m_floorUs + AJB_UNDERRUN_FLOOR_US * (underruns - m_seenUnderruns));
+        m_seenUnderruns = underruns;
+    }
+
+    qint64 targetUs = AJB_MIN_TARGET_US + static_cast<qint64>(m_jitterUs * AJB_JITTER_FACTOR) + m_floorUs;
+    m_targetUs.storeRelease(static_cast<int>(qBound<qint64>(AJB_MIN_TARGET_US, targetUs, AJB_MAX_TARGET_US)));
+}
+
+int AudioJitterBuffer::resample(const char *data, int frames, qint64 fillUs)
+{
+    if (!m_swr) {
+        return frames;
+    }
+
+    // smooth over about a second of chunks, the consumer drains in bursts
+    double chunkUs = frames * 1000000.0 / m_sampleRate;
+    double weight = qMin(1.0, chunkUs / 1000000.0);
+    m_errorUs += (fillUs - m_targetUs.loadAcquire() - m_errorUs) * weight;
+
+    // too full: play faster by consuming more input than we output (negative delta)
+    double delta = 0.0;
+    if (AJB_DEADBAND_US < std::abs(m_errorUs)) {
+        delta = -m_errorUs / 1000000.0 * m_sampleRate * AJB_CORRECTION_RATE * weight;
+        double limit = frames * AJB_MAX_CORRECTION;
+        delta = qBound(-limit, delta, limit);
+    }
+    delta += m_deltaCarry;
+    int sampleDelta = static_cast<int>(delta);
+    // tiny chunks cannot take a whole sample, carry it to the next one
+    if (qAbs(sampleDelta) * 2 >= frames) {
+        sampleDelta = 0;
+    }
+    m_deltaCarry = delta - sampleDelta;
+    m_driftPpm += (-sampleDelta * 1000000.0 / frames - m_driftPpm) * weight;
+    m_driftStatPpm.storeRelease(static_cast<int>(m_driftPpm));
+
+    if (0 != sampleDelta) {
+        swr_set_compensation(m_swr, sampleDelta, frames + sampleDelta);
+    }
+    uint8_t *out = reinterpret_cast<uint8_t *>(m_resampled);
+    const uint8_t *in = reinterpret_cast<const uint8_t *>(data);
+    int outFrames = swr_convert(m_swr, &out, m_resampledFrames, &in, frames);
+    return qMax(0, outFrames);
+}
@@ -0,0 +1,96 @@
+#ifndef AUDIOJITTERBUFFER_H
+#define AUDIOJITTERBUFFER_H
+
+#include <QAtomicInt>
+#include <QElapsedTimer>
+
+#include "audioring.h"
+
+struct SwrContext;
+
+struct AudioJitterStats
+{
+    quint32 fillMs = 0;           // pcm waiting for the sink
+    quint32 targetMs = 0;         // fill the drift correction steers to
+    quint32 jitterMs = 0;         // smoothed arrival jitter
+    qint32 driftPpm = 0;          // resampling correction, + plays the device faster
+    quint32 underruns = 0;        // sink found the buffer empty
+    quint32 overruns = 0;         // buffer grew past the limit and was cut back
+    quint64 droppedBytes = 0;
+    quint32 latencyMs = 0;        // fill plus the sink buffer, set by AudioOutput
+};
+
+// Adaptive jitter buffer for interleaved s16 pcm between the sndcpy socket and
+// the audio sink.
+// The target fill follows the measured arrival jitter (rfc 3550 estimator) plus
+// a floor that every underrun raises and that decays again over time. Phone and
+// host clocks drift apart, so instead of letting the fill creep up or drain the
+// producer side resamples each chunk by up to AJB_MAX_CORRECTION with
+// swr_set_compensation, steering the fill to the target without audible pitch
+// change. Past the overrun limit the oldest pcm is dropped down to the target,
+// an empty buffer makes the consumer wait until the target is reached again.
+// Producer and consumer share only a lock free ring and a few atomics; after
+// init nothing is allocated on either side.
+class AudioJitterBuffer
+{
+public:
+    AudioJitterBuffer(int sampleRate, int channels);
+    ~AudioJitterBuffer();
+
+    bool init();
+    // only while neither side runs
+    void reset();
+
+    // producer thread
+    void write(const char *data, int size);
+    // consumer thread: whole frames up to maxSize, 0 while filling up
+    int read(char *data, int maxSize);
+
+    // any thread
+    void getStats(AudioJitterStats &stats);
+
+private:
+    qint64 bytesToUs(qint64 bytes) const;
+    qint64 usToBytes(qint64 us) const;
+    void writeFrames(const char *data, int frames, qint64 nowUs);
+    void updateJitter(qint64 nowUs, int frames);
+    void updateTarget(qint64 nowUs);
+    int resample(const char *data, int frames, qint64 fillUs);
+
+private:
+    const int m_sampleRate;
+    const int m_frameBytes;
+    SwrContext *m_swr = nullptr;
+    QElapsedTimer m_clock;
+    AudioRing m_ring;
+
+    // producer state
+    char m_partial[16];           // bytes of a frame split across reads
+    int m_partialSize = 0;
+    char *m_resampled = nullptr;
+    int m_resampledFrames = 0;
+    qint64 m_inputFrames = 0;
+    qint64 m_lastTransitUs = 0;
+    bool m_haveTransit = false;
+    double m_jitterUs = 0.0;
+    double m_errorUs = 0.0;       // smoothed fill - target
+    double m_deltaCarry = 0.0;    // fraction of a sample not corrected yet
+    double m_driftPpm = 0.0;
+    qint64 m_floorUs = 0;         // raised by underruns
+    int m_seenUnderruns = 0;
+    qint64 m_lastWriteUs = 0;
+
+    // consumer state
+    bool m_filling = true;
+
+    // shared
+    QAtomicInt m_targetUs;
+    QAtomicInt m_dropRequest;     // bytes the consumer skips on its next read
+    QAtomicInt m_underruns;
+    QAtomicInt m_overruns;
+    QAtomicInt m_droppedBytes;
+    QAtomicInt m_jitterStatUs;
+    QAtomicInt m_driftStatPpm;
+};
+
+#endif // AUDIOJITTERBUFFER_H
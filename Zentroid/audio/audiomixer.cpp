@@ -0,0 +1,388 @@
+#include <QAudioOutput>
+#include <QDebug>
+#include <cmath>
+#include <cstring>
+
+#if (QT_VERSION >= QT_VERSION_CHECK(6, 0, 0))
+#include <QAudioSink>
+#include <QAudioDevice>
+#include <QMediaDevices>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define AM_HAS_SSE2
+#endif
+
+#include "audiomixer.h"
+
+// sndcpy format: 48 kHz stereo s16le
+#define AM_SAMPLE_RATE 48000
+#define AM_CHANNELS 2
+#define AM_FRAME_BYTES (AM_CHANNELS * 2)
+// the sink only holds a couple of periods, the jitter buffers absorb the rest
+#define AM_SINK_BUFFER_MS 40
+// one mix pass, about 5 ms; gain ramps span one block
+#define AM_BLOCK_FRAMES 256
+#define AM_MAX_GAIN 4.0f
+
+namespace {
+
+// Pull side of the mixer: the sink asks for pcm on whatever thread its backend runs
+class MixerPullDevice : public QIODevice
+{
+public:
+    MixerPullDevice(AudioMixer *mixer, QObject *parent) : QIODevice(parent), m_mixer(mixer) {}
+
+    bool isSequential() const override
+    {
+        return true;
+    }
+
+protected:
+    qint64 readData(char *data, qint64 maxlen) override
+    {
+        int size = static_cast<int>(qMin<qint64>(maxlen, AM_BLOCK_FRAMES * AM_FRAME_BYTES * 64));
+        size -= size % AM_FRAME_BYTES;
+        m_mixer->mix(data, size);
+        return size;
+    }
+    qint64 writeData(const char *data, qint64 len) override
+    {
+        Q_UNUSED(data);
+        Q_UNUSED(len);
+        return -1;
+    }
+
+private:
+    AudioMixer *m_mixer;
+};
+
+// acc += in * gain, the gain moving by step per stereo frame
+void mixInto(float *acc, const qint16 *in, int samples, float gain, float step)
+{
+    int i = 0;
+#ifdef AM_HAS_SSE2
+    // 8 samples = 4 frames per pass, two frames per vector
+    __m128 g = _mm_setr_ps(gain, gain, gain + step, gain + step);
+    __m128 gInc = _mm_set1_ps(step * 2);
+    for (; i + 8 <= samples; i += 8) {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+        __m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(s, s), 16));
+        __m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(s, s), 16));
+        __m128 g2 = _mm_add_ps(g, gInc);
+        _mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), _mm_mul_ps(lo, g)));
+        _mm_storeu_ps(acc + i + 4, _mm_add_ps(_mm_loadu_ps(acc + i + 4), _mm_mul_ps(hi, g2)));
+        g = _mm_add_ps(g2, gInc);
+    }
+#endif
+    for (; i < samples; i++) {
+        acc[i] += in[i] * (gain + step * (i / AM_CHANNELS));
+    }
+}
+
+void toPcm(qint16 *out, const float *acc, int samples)
+{
+    int i = 0;
+#ifdef AM_HAS_SSE2
+    // packs saturates to the s16 range
+    for (; i + 8 <= samples; i += 8) {
+        __m128i a = _mm_cvtps_epi32(_mm_loadu_ps(acc + i));
+        __m128i b = _mm_cvtps_epi32(_mm_loadu_ps(acc + i + 4));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_packs_epi32(a, b));
+    }
+#endif
+    for (; i < samples; i++) {
+        out[i] = static_cast<qint16>(qBound(-32768L, lrintf(acc[i]), 32767L));
+    }
+}
+
+}
+
+AudioMixer::AudioMixer(QObject *parent) : QObject(parent)
+{
+    m_streamPcm = new qint16[AM_BLOCK_FRAMES * AM_CHANNELS];
+    m_mixPcm = new float[AM_BLOCK_FRAMES * AM_CHANNELS];
+}
+
+AudioMixer::~AudioMixer()
+{
+    stopAudioOutput();
+    for (Slot &slot : m_slots) {
+        delete slot.buffer;
+    }
+    delete[] m_streamPcm;
+    delete[] m_mixPcm;
+}
+
+AudioJitterBuffer *AudioMixer::addStream(const QString &serial)
+{
+    int index = findSlot(serial);
+    if (0 <= index) {
+        return m_slots[index].buffer;
+    }
+    index = findSlot(QString());
+    if (0 > index) {
+        qWarning("AudioMixer::all %d streams in use", AUDIO_MIXER_MAX_STREAMS);
+        return nullptr;
+    }
+
+    AudioJitterBuffer *buffer = new AudioJitterBuffer(AM_SAMPLE_RATE, AM_CHANNELS);
+    buffer->init();
+    {
+        QMutexLocker locker(&m_lock);
+        Slot &slot = m_slots[index];
+        slot.serial = serial;
+        slot.buffer = buffer;
+        slot.gain = 1.0f;
+        slot.muted = false;
+        slot.solo = false;
+        slot.targetGain.storeRelease(0);
+        slot.currentGain = 0.0f;
+    }
+    updateGains();
+    startAudioOutput();
+    return buffer;
+}
+
+void AudioMixer::removeStream(const QString &serial)
+{
+    int index = findSlot(serial);
+    if (0 > index) {
+        return;
+    }
+
+    AudioJitterBuffer *buffer = nullptr;
+    {
+        QMutexLocker locker(&m_lock);
+        Slot &slot = m_slots[index];
+        buffer = slot.buffer;
+        slot.buffer = nullptr;
+        slot.serial.clear();
+    }
+    AudioJitterStats stats;
+    buffer->getStats(stats);
+    qInfo("AudioMixer::%s: target %u ms, jitter %u ms, drift %d ppm, %u underruns, %u overruns", serial.toUtf8().data(),
+          stats.targetMs, stats.jitterMs, stats.driftPpm, stats.underruns, stats.overruns);
+    delete buffer;
+
+    if (m_focus == serial) {
+        m_focus.clear();
+    }
+    updateGains();
+    if (!hasStreams()) {
+        stopAudioOutput();
+    }
+}
+
+bool AudioMixer::hasStreams()
+{
+    for (const Slot &slot : m_slots) {
+        if (slot.buffer) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void AudioMixer::setGain(const QString &serial, float gain)
+{
+    int index = findSlot(serial);
+    if (0 <= index) {
+        m_slots[index].gain = qBound(0.0f, gain, AM_MAX_GAIN);
+        updateGains();
+    }
+}
+
+void AudioMixer::setMuted(const QString &serial, bool muted)
+{
+    int index = findSlot(serial);
+    if (0 <= index) {
+        m_slots[index].muted = muted;
+        updateGains();
+    }
+}
+
+void AudioMixer::setSolo(const QString &serial, bool solo)
+{
+    int index = findSlot(serial);
+    if (0 <= index) {
+        m_slots[index].solo = solo;
+        updateGains();
+    }
+}
+
+void AudioMixer::setFocus(const QString &serial)
+{
+    m_focus = serial;
+    updateGains();
+}
+
+void AudioMixer::setDucking(bool enabled, float duckGain)
+{
+    m_ducking = enabled;
+    m_duckGain = qBound(0.0f, duckGain, 1.0f);
+    updateGains();
+}
+
+bool AudioMixer::getStats(const QString &serial, AudioJitterStats &stats)
+{
+    int index = findSlot(serial);
+    if (0 > index) {
+        return false;
+    }
+    m_slots[index].buffer->getStats(stats);
+    stats.latencyMs = stats.fillMs + sinkLatencyMs();
+    return true;
+}
+
+void AudioMixer::mix(char *data, int size)
+{
+    qint16 *out = reinterpret_cast<qint16 *>(data);
+    int frames = size / AM_FRAME_BYTES;
+    if (!m_lock.tryLock()) {
+        memset(data, 0, static_cast<size_t>(size));
+        return;
+    }
+
+    while (0 < frames) {
+        int blockFrames = qMin(frames, AM_BLOCK_FRAMES);
+        int samples = blockFrames * AM_CHANNELS;
+        memset(m_mixPcm, 0, sizeof(float) * static_cast<size_t>(samples));
+
+        for (Slot &slot : m_slots) {
+            if (!slot.buffer) {
+                continue;
+            }
+            // every stream is drained, muted ones too, or their latency would grow
+            int got = slot.buffer->read(reinterpret_cast<char *>(m_streamPcm), blockFrames * AM_FRAME_BYTES);
+            float target = slot.targetGain.loadAcquire() / 65536.0f;
+            float gain = slot.currentGain;
+            slot.currentGain = target;
+            if (0 == got || (0.0f == gain && 0.0f == target)) {
+                continue;
+            }
+            mixInto(m_mixPcm, m_streamPcm, got / 2, gain, (target - gain) / blockFrames);
+        }
+
+        toPcm(out, m_mixPcm, samples);
+        out += samples;
+        frames -= blockFrames;
+    }
+    m_lock.unlock();
+}
+
+int AudioMixer::findSlot(const QString &serial)
+{
+    for (int i = 0; i < AUDIO_MIXER_MAX_STREAMS; i++) {
+        if (serial.isEmpty() ? !m_slots[i].buffer : m_slots[i].serial == serial) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void AudioMixer::updateGains()
+{
+    bool anySolo = false;
+    for (const Slot &slot : m_slots) {
+        anySolo = anySolo || (slot.buffer && slot.solo);
+    }
+    for (Slot &slot : m_slots) {
+        if (!slot.buffer) {
+            continue;
+        }
+        float gain = slot.muted || (anySolo && !slot.solo) ? 0.0f : slot.gain;
+        if (m_ducking && !m_focus.isEmpty() && m_focus != slot.serial) {
+            gain *= m_duckGain;
+        }
+        slot.targetGain.storeRelease(static_cast<int>(gain * 65536.0f));
+    }
+}
+
+void AudioMixer::startAudioOutput()
+{
+#if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
+    if (m_audioOutput) {
+        return;
+    }
+
+    QAudioFormat format;
+    format.setSampleRate(AM_SAMPLE_RATE);
+    format.setChannelCount(AM_CHANNELS);
+    format.setSampleSize(16);
+    format.setCodec("audio/pcm");
+    format.setByteOrder(QAudioFormat::LittleEndian);
+    format.setSampleType(QAudioFormat::SignedInt);
+    QAudioDeviceInfo info(QAudioDeviceInfo::defaultOutputDevice());
+
+    if (!info.isFormatSupported(format)) {
+        qWarning() << "AudioMixer::audio format not supported, cannot play audio.";
+        return;
+    }
+
+    m_audioOutput = new QAudioOutput(format, this);
+    connect(m_audioOutput, &QAudioOutput::stateChanged, this, [](QAudio::State state) {
+        qInfo() << "AudioMixer::audio state changed:" << state;
+    });
+    m_audioOutput->setBufferSize(AM_SAMPLE_RATE * AM_FRAME_BYTES * AM_SINK_BUFFER_MS / 1000);
+    m_outputDevice = new MixerPullDevice(this, this);
+    m_outputDevice->open(QIODevice::ReadOnly);
+    m_audioOutput->start(m_outputDevice);
+#else
+    if (m_audioSink) {
+        return;
+    }
+
+    QAudioFormat format;
+    format.setSampleRate(AM_SAMPLE_RATE);
+    format.setChannelCount(AM_CHANNELS);
+    format.setSampleFormat(QAudioFormat::Int16);
+    QAudioDevice defaultDevice = QMediaDevices::defaultAudioOutput();
+    if (!defaultDevice.isFormatSupported(format)) {
+        qWarning() << "AudioMixer::audio format not supported, cannot play audio.";
+        return;
+    }
+    m_audioSink = new QAudioSink(defaultDevice, format, this);
+    m_audioSink->setBufferSize(AM_SAMPLE_RATE * AM_FRAME_BYTES * AM_SINK_BUFFER_MS / 1000);
+    m_outputDevice = new MixerPullDevice(this, this);
+    m_outputDevice->open(QIODevice::ReadOnly);
+    m_audioSink->start(m_outputDevice);
+    if (QAudio::NoError != m_audioSink->error()) {
+        qWarning() << "AudioMixer::audio output device not available, cannot play audio.";
+        delete m_audioSink;
+        m_audioSink = nullptr;
+        delete m_outputDevice;
+        return;
+    }
+#endif
+}
+
+void AudioMixer::stopAudioOutput()
+{
+#if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
+    if (m_audioOutput) {
+        m_audioOutput->stop();
+        delete m_audioOutput;
+        m_audioOutput = nullptr;
+    }
+#else
+    if (m_audioSink) {
+        m_audioSink->stop();
+        delete m_audioSink;
+        m_audioSink = nullptr;
+    }
+#endif
+    // the sink is gone, nothing pulls any more
+    delete m_outputDevice;
+}
+
+quint32 AudioMixer::sinkLatencyMs()
+{
+#if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
+    int bufferSize = m_audioOutput ? m_audioOutput->bufferSize() : 0;
+#else
+    qsizetype bufferSize = m_audioSink ? m_audioSink->bufferSize() : 0;
+#endif
+    return static_cast<quint32>(bufferSize / AM_FRAME_BYTES * 1000 / AM_SAMPLE_RATE);
+}
@@ -0,0 +1,90 @@
+#ifndef AUDIOMIXER_H
+#define AUDIOMIXER_H
+
+#include <QAtomicInt>
+#include <QMutex>
+#include <QObject>
+#include <QPointer>
+
+#include "audiojitterbuffer.h"
+
+#define AUDIO_MIXER_MAX_STREAMS 32
+
+class QAudioSink;
+class QAudioOutput;
+class QIODevice;
+
+// Mixes the pcm of many devices into one sink. Every device gets its own
+// jitter buffer (AudioMixer::addStream) that its socket thread writes into;
+// the sink pulls the mix. Per device gain, mute and solo, plus ducking: with a
+// focused device and ducking on, all others play at the duck gain.
+// Gain changes ramp over one mix block so they never click. The mix is float,
+// 4 samples at a time with sse2, and costs one multiply-add per sample and
+// stream; muted streams are drained without being mixed.
+class AudioMixer : public QObject
+{
+    Q_OBJECT
+public:
+    explicit AudioMixer(QObject *parent = nullptr);
+    virtual ~AudioMixer();
+
+    // the buffer stays valid until removeStream, nullptr when all slots are taken
+    AudioJitterBuffer *addStream(const QString &serial);
+    void removeStream(const QString &serial);
+    bool hasStreams();
+
+    // control side, gui thread
+    void setGain(const QString &serial, float gain);
+    void setMuted(const QString &serial, bool muted);
+    void setSolo(const QString &serial, bool solo);
+    void setFocus(const QString &serial);
+    void setDucking(bool enabled, float duckGain = 0.25f);
+
+    bool getStats(const QString &serial, AudioJitterStats &stats);
+
+    // pull side, sink thread: fills size bytes of interleaved s16, always all of them
+    void mix(char *data, int size);
+
+private:
+    struct Slot
+    {
+        QString serial;
+        AudioJitterBuffer *buffer = nullptr;
+        // control side
+        float gain = 1.0f;
+        bool muted = false;
+        bool solo = false;
+        // what the mix ramps to, gain * 65536
+        QAtomicInt targetGain;
+        // mix side, new streams fade in
+        float currentGain = 0.0f;
+    };
+
+    int findSlot(const QString &serial);
+    void updateGains();
+    void startAudioOutput();
+    void stopAudioOutput();
+    quint32 sinkLatencyMs();
+
+private:
+    // add and remove hold it, the mix only tries: a table being changed plays
+    // one period of silence instead of blocking the audio thread
+    QMutex m_lock;
+    Slot m_slots[AUDIO_MIXER_MAX_STREAMS];
+    QString m_focus;
+    bool m_ducking = false;
+    float m_duckGain = 0.25f;
+
+    // mix scratch, allocated once
+    qint16 *m_streamPcm = nullptr;
+    float *m_mixPcm = nullptr;
+
+    QPointer<QIODevice> m_outputDevice;
+#if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
+    QAudioOutput *m_audioOutput = nullptr;
+#else
+    QAudioSink *m_audioSink = nullptr;
+#endif
+};
+
+#endif // AUDIOMIXER_H
@@ -1,27 +1,19 @@
-#include <QAudioOutput>
 #include <QCoreApplication>
+#include <QDebug>
 #include <QElapsedTimer>
 #include <QHostAddress>
 #include <QTcpSocket>
 #include <QTime>
 
-#if (QT_VERSION >= QT_VERSION_CHECK(6, 0, 0))
-#include <QAudioSink>
-#include <QAudioDevice>
-#include <QMediaDevices>
-#endif
-
 #include "audiooutput.h"
 
+// pcm format of the sndcpy stream and of the mix
+#define AO_SAMPLE_RATE 48000
+#define AO_CHANNELS 2
+
 AudioOutput::AudioOutput(QObject *parent)
     : QObject(parent)
 {
-    m_running = false;
-#if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
-    m_audioOutput = nullptr;
-#else
-    m_audioSink = nullptr;
-#endif
     connect(&m_sndcpy, &QProcess::readyReadStandardOutput, this, [this]() {
         qInfo() << QString("AudioOutput::") << QString(m_sndcpy.readAllStandardOutput());
     });
@@ -40,9 +32,10 @@ AudioOutput::~AudioOutput()
 
 bool AudioOutput::start(const QString& serial, int port)
 {
-    if (m_running) {
-        stop();
+    if (m_streams.contains(serial)) {
+        stop(serial);
     }
+    port = freePort(port);
 
     QElapsedTimer timeConsumeCount;
     timeConsumeCount.start();
@@ -52,22 +45,43 @@ bool AudioOutput::start(const QString& serial, int port)
         return ret;
     }
 
-    startAudioOutput();
-    startRecvData(port);
-
-    m_running = true;
+    AudioJitterBuffer *buffer = m_mixer.addStream(serial);
+    if (!buffer) {
+        return false;
+    }
+    QByteArray codecRequest;
+    if (0 < m_opusBitRate) {
+        if (AudioStreamDecoder::canDecodeOpus()) {
+            codecRequest = AudioStreamDecoder::opusRequest(m_opusBitRate);
+        } else {
+            qWarning("AudioOutput::no opus decoder in this build, staying on raw pcm");
+        }
+    }
+    startRecvData(serial, port, buffer, codecRequest);
     return true;
 }
 
-void AudioOutput::stop()
+void AudioOutput::stop(const QString &serial)
 {
-    if (!m_running) {
+    if (!m_streams.contains(serial)) {
         return;
     }
-    m_running = false;
+    // the socket writes into the mixer's buffer, it has to go first
+    stopRecvData(serial);
+    m_mixer.removeStream(serial);
 
-    stopRecvData();
-    stopAudioOutput();
+    if (m_streams.isEmpty() && m_workerThread.isRunning()) {
+        m_workerThread.quit();
+        m_workerThread.wait();
+    }
+}
+
+void AudioOutput::stop()
+{
+    const QList<QString> serials = m_streams.keys();
+    for (const QString &serial : serials) {
+        stop(serial);
+    }
 }
 
 void AudioOutput::installonly(const QString &serial, int port)
@@ -75,6 +89,56 @@ void AudioOutput::installonly(const QString &serial, int port)
     runSndcpyProcess(serial, port, false);
 }
 
+bool AudioOutput::isPlaying(const QString &serial)
+{
+    return m_streams.contains(serial);
+}
+
+void AudioOutput::setOpusBitRate(int bitRate)
+{
+    m_opusBitRate = qMax(0, bitRate);
+}
+
+void AudioOutput::setGain(const QString &serial, float gain)
+{
+    m_mixer.setGain(serial, gain);
+}
+
+void AudioOutput::setMuted(const QString &serial, bool muted)
+{
+    m_mixer.setMuted(serial, muted);
+}
+
+void AudioOutput::setSolo(const QString &serial, bool solo)
+{
+    m_mixer.setSolo(serial, solo);
+}
+
+void AudioOutput::setFocus(const QString &serial)
+{
+    m_mixer.setFocus(serial);
+}
+
+void AudioOutput::setDucking(bool enabled, float duckGain)
+{
+    m_mixer.setDucking(enabled, duckGain);
+}
+
+bool AudioOutput::getStats(const QString &serial, AudioJitterStats &stats)
+{
+    return m_mixer.getStats(serial, stats);
+}
+
+void AudioOutput::setRecording(const QString &serial, bool recording)
+{
+    QMutexLocker locker(&m_recordingLock);
+    if (recording) {
+        m_recordingSerials.insert(serial);
+    } else {
+        m_recordingSerials.remove(serial);
+    }
+}
+
 bool AudioOutput::runSndcpyProcess(const QString &serial, int port, bool wait)
 {
     if (QProcess::NotRunning != m_sndcpy.state()) {
@@ -106,132 +170,97 @@ bool AudioOutput::runSndcpyProcess(const QString &serial, int port, bool wait)
     return true;
 }
 
-void AudioOutput::startAudioOutput()
-{
-#if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
-    if (m_audioOutput) {
-        return;
-    }
-
-    QAudioFormat format;
-    format.setSampleRate(48000);
-    format.setChannelCount(2);
-    format.setSampleSize(16);
-    format.setCodec("audio/pcm");
-    format.setByteOrder(QAudioFormat::LittleEndian);
-    format.setSampleType(QAudioFormat::SignedInt);
-    QAudioDeviceInfo info(QAudioDeviceInfo::defaultOutputDevice());
-
-    if (!info.isFormatSupported(format)) {
-        qWarning() << "AudioOutput::audio format not supported, cannot play audio.";
-        return;
-    }
-
-    m_audioOutput = new QAudioOutput(format, this);
-    connect(m_audioOutput, &QAudioOutput::stateChanged, this, [](QAudio::State state) {
-        qInfo() << "AudioOutput::audio state changed:" << state;
-    });
-    m_audioOutput->setBufferSize(48000*2*15/1000 * 20);
-    m_outputDevice = m_audioOutput->start();
-#else
-    if (m_audioSink) {
-        return;
-    }
-
-    QAudioFormat format;
-    format.setSampleRate(48000);
-    format.setChannelCount(2);
-    format.setSampleFormat(QAudioFormat::Int16);
-    QAudioDevice defaultDevice = QMediaDevices::defaultAudioOutput();
-    if (!defaultDevice.isFormatSupported(format)) {
-        qWarning() << "AudioOutput::audio format not supported, cannot play audio.";
-        return;
-    }
-    m_audioSink = new QAudioSink(defaultDevice, format, this);
-    m_outputDevice = m_audioSink->start();
-    if (!m_outputDevice) {
-        qWarning() << "AudioOutput::audio output device not available, cannot play audio.";
-        delete m_audioSink;
-        m_audioSink = nullptr;
-        return;
-    }
-#endif
-}
-
-void AudioOutput::stopAudioOutput()
+int AudioOutput::freePort(int port)
 {
-#if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
-    if (m_audioOutput) {
-        m_audioOutput->stop();
-        delete m_audioOutput;
-        m_audioOutput = nullptr;
-    }
-#else
-    if (m_audioSink) {
-        m_audioSink->stop();
-        delete m_audioSink;
-        m_audioSink = nullptr;
+    // every device needs its own forward
+    bool used = true;
+    while (used) {
+        used = false;
+        for (const Stream &stream : m_streams) {
+            if (stream.port == port) {
+                used = true;
+                port++;
+                break;
+            }
+        }
     }
-#endif
-    m_outputDevice = nullptr;
+    return port;
 }
 
-void AudioOutput::startRecvData(int port)
+void AudioOutput::startRecvData(const QString &serial, int port, AudioJitterBuffer *buffer, const QByteArray &codecRequest)
 {
-    if (m_workerThread.isRunning()) {
-        stopRecvData();
-    }
-
     auto audioSocket = new QTcpSocket();
     audioSocket->moveToThread(&m_workerThread);
-    connect(&m_workerThread, &QThread::finished, audioSocket, &QObject::deleteLater);
-
-    connect(this, &AudioOutput::connectTo, audioSocket, [audioSocket](int port) {
-        audioSocket->connectToHost(QHostAddress::LocalHost, port);
-        if (!audioSocket->waitForConnected(500)) {
-            qWarning("AudioOutput::audio socket connect failed");
-            return;
-        }
-        qInfo("AudioOutput::audio socket connect success");
-    });
-    connect(audioSocket, &QIODevice::readyRead, audioSocket, [this, audioSocket]() {
-        qint64 recv = audioSocket->bytesAvailable();
-        //qDebug() << "AudioOutput::recv data:" << recv;
+    auto decoder = new AudioStreamDecoder(AO_SAMPLE_RATE, AO_CHANNELS);
 
-        if (!m_outputDevice) {
-            return;
+    // the sink pulls on its own thread, hand the pcm over through the jitter buffer
+    AudioStreamDecoder::PcmSink sink = [this, serial, buffer](const char *pcm, int size) {
+        buffer->write(pcm, size);
+        // the copy and the queued signal only for a recording that takes it
+        QMutexLocker locker(&m_recordingLock);
+        if (m_recordingSerials.contains(serial)) {
+            locker.unlock();
+            emit pcmReceived(serial, QByteArray(pcm, size));
         }
-        if (m_buffer.capacity() < recv) {
-            m_buffer.reserve(recv);
+    };
+    connect(audioSocket, &QIODevice::readyRead, audioSocket, [this, serial, audioSocket, decoder, sink]() {
+        qint64 count = 0;
+        while (0 < (count = audioSocket->read(m_recvBuffer, sizeof(m_recvBuffer)))) {
+            if (!decoder->decode(m_recvBuffer, static_cast<int>(count), sink)) {
+                qWarning() << "AudioOutput::" << serial << "broken audio stream, closing it";
+                audioSocket->abort();
+                return;
+            }
         }
-
-        qint64 count = audioSocket->read(m_buffer.data(), recv);
-        m_outputDevice->write(m_buffer.data(), count);
     });
-    connect(audioSocket, &QTcpSocket::stateChanged, audioSocket, [](QAbstractSocket::SocketState state) {
-        qInfo() << "AudioOutput::audio socket state changed:" << state;
-
+    connect(audioSocket, &QTcpSocket::stateChanged, audioSocket, [serial](QAbstractSocket::SocketState state) {
+        qInfo() << "AudioOutput::" << serial << "audio socket state changed:" << state;
     });
 #if QT_VERSION >= QT_VERSION_CHECK(5, 15, 0)
-    connect(audioSocket, &QTcpSocket::errorOccurred, audioSocket, [](QAbstractSocket::SocketError error) {
-        qInfo() << "AudioOutput::audio socket error occurred:" << error;
+    connect(audioSocket, &QTcpSocket::errorOccurred, audioSocket, [serial](QAbstractSocket::SocketError error) {
+        qInfo() << "AudioOutput::" << serial << "audio socket error occurred:" << error;
     });
 #else
-    connect(audioSocket, QOverload<QAbstractSocket::SocketError>::of(&QAbstractSocket::error), audioSocket, [](QAbstractSocket::SocketError error) {
-        qInfo() << "AudioOutput::audio socket error occurred:" << error;
+    connect(audioSocket, QOverload<QAbstractSocket::SocketError>::of(&QAbstractSocket::error), audioSocket, [serial](QAbstractSocket::SocketError error) {
+        qInfo() << "AudioOutput::" << serial << "audio socket error occurred:" << error;
     });
 #endif
 
-    m_workerThread.start();
-    emit connectTo(port);
+    Stream stream;
+    stream.port = port;
+    stream.socket = audioSocket;
+    stream.decoder = decoder;
+    m_streams.insert(serial, stream);
+
+    if (!m_workerThread.isRunning()) {
+        m_workerThread.start();
+    }
+    QMetaObject::invokeMethod(audioSocket, [audioSocket, port, codecRequest]() {
+        audioSocket->connectToHost(QHostAddress::LocalHost, static_cast<quint16>(port));
+        if (!audioSocket->waitForConnected(500)) {
+            qWarning("AudioOutput::audio socket connect failed");
+            return;
+        }
+        qInfo("AudioOutput::audio socket connect success");
+        // stock sndcpy never reads the socket and ignores the request
+        if (!codecRequest.isEmpty()) {
+            audioSocket->write(codecRequest);
+        }
+    }, Qt::QueuedConnection);
 }
 
-void AudioOutput::stopRecvData()
+void AudioOutput::stopRecvData(const QString &serial)
 {
-    if (!m_workerThread.isRunning()) {
+    Stream stream = m_streams.take(serial);
+    if (!stream.socket) {
         return;
     }
-
-    m_workerThread.quit();
-    m_workerThread.wait();
+    // blocking: once this returns nothing writes into the stream's buffer any more
+    QTcpSocket *socket = stream.socket;
+    AudioStreamDecoder *decoder = stream.decoder;
+    QMetaObject::invokeMethod(socket, [socket, decoder]() {
+        socket->abort();
+        delete socket;
+        delete decoder;
+    }, Qt::BlockingQueuedConnection);
 }
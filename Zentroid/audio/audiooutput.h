@@ -1,14 +1,17 @@
 #ifndef AUDIOOUTPUT_H
 #define AUDIOOUTPUT_H
 
+#include <QHash>
+#include <QMutex>
+#include <QSet>
 #include <QThread>
 #include <QProcess>
 #include <QPointer>
-#include <QVector>
 
-class QAudioSink;
-class QAudioOutput;
-class QIODevice;
+#include "audiomixer.h"
+#include "audiostreamdecoder.h"
+
+class QTcpSocket;
 class AudioOutput : public QObject
 {
     Q_OBJECT
@@ -16,31 +19,55 @@ public:
     explicit AudioOutput(QObject *parent = nullptr);
     ~AudioOutput();
 
+    // adds the device to the mix (restarts it if it is playing already), port is
+    // the first local port tried for its sndcpy forward
     bool start(const QString& serial, int port);
+    void stop(const QString& serial);
     void stop();
     void installonly(const QString& serial, int port);
+    bool isPlaying(const QString& serial);
+    // ask the device side for opus at this bit rate (bit/s) from the next start on,
+    // 0 keeps raw pcm. Devices that do not answer stay on raw pcm
+    void setOpusBitRate(int bitRate);
 
-private:
-    bool runSndcpyProcess(const QString& serial, int port, bool wait = true);
-    void startAudioOutput();
-    void stopAudioOutput();
-    void startRecvData(int port);
-    void stopRecvData();
+    // mixing, see AudioMixer
+    void setGain(const QString& serial, float gain);
+    void setMuted(const QString& serial, bool muted);
+    void setSolo(const QString& serial, bool solo);
+    void setFocus(const QString& serial);
+    void setDucking(bool enabled, float duckGain = 0.25f);
+    bool getStats(const QString& serial, AudioJitterStats &stats);
+    // the device's recording has an audio track: from now on its pcm is emitted
+    void setRecording(const QString& serial, bool recording);
 
 signals:
-    void connectTo(int port);
+    // pcm as received, from the worker thread; only for serials marked with setRecording
+    void pcmReceived(const QString& serial, const QByteArray& pcm);
 
 private:
-    QPointer<QIODevice> m_outputDevice;
+    bool runSndcpyProcess(const QString& serial, int port, bool wait = true);
+    int freePort(int port);
+    void startRecvData(const QString& serial, int port, AudioJitterBuffer *buffer, const QByteArray& codecRequest);
+    void stopRecvData(const QString& serial);
+
+private:
+    struct Stream
+    {
+        int port = 0;
+        QTcpSocket *socket = nullptr;   // lives on the worker thread
+        AudioStreamDecoder *decoder = nullptr; // used on the worker thread
+    };
+
+    AudioMixer m_mixer;
     QThread m_workerThread;
     QProcess m_sndcpy;
-    QVector<char> m_buffer;
-    bool m_running = false;
-#if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
-    QAudioOutput* m_audioOutput = nullptr;
-#else
-    QAudioSink *m_audioSink = nullptr;
-#endif
+    QHash<QString, Stream> m_streams;
+    int m_opusBitRate = 0;
+    // read on the worker thread for every chunk
+    QMutex m_recordingLock;
+    QSet<QString> m_recordingSerials;
+    // all sockets read on the worker thread one after the other
+    char m_recvBuffer[16384];
 };
 
 #endif // AUDIOOUTPUT_H
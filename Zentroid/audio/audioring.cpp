@@ -0,0 +1,83 @@
+#include <cstring>
+
+#include "audioring.h"
+
+AudioRing::AudioRing(int capacity)
+{
+    quint32 size = 1;
+    while (size < static_cast<quint32>(qMax(1, capacity))) {
+        size <<= 1;
+    }
+    m_data = new char[size];
+    m_mask = size - 1;
+}
+
+AudioRing::~AudioRing()
+{
+    delete[] m_data;
+}
+
+int AudioRing::capacity() const
+{
+    return static_cast<int>(m_mask + 1);
+}
+
+int AudioRing::write(const char *data, int size)
+{
+    quint32 head = m_head.loadAcquire();
+    quint32 tail = m_tail.loadAcquire();
+    quint32 count = qMin<quint32>(static_cast<quint32>(qMax(0, size)), m_mask + 1 - (head - tail));
+    if (0 == count) {
+        return 0;
+    }
+
+    quint32 offset = head & m_mask;
+    quint32 first = qMin(count, m_mask + 1 - offset);
+    memcpy(m_data + offset, data, first);
+    memcpy(m_data, data + first, count - first);
+    // publish the bytes after they are in place
+    m_head.storeRelease(head + count);
+    return static_cast<int>(count);
+}
+
+int AudioRing::writable() const
+{
+    return static_cast<int>(m_mask + 1 - (m_head.loadAcquire() - m_tail.loadAcquire()));
+}
+
+int AudioRing::read(char *data, int size)
+{
+    quint32 tail = m_tail.loadAcquire();
+    quint32 head = m_head.loadAcquire();
+    quint32 count = qMin<quint32>(static_cast<quint32>(qMax(0, size)), head - tail);
+    if (0 == count) {
+        return 0;
+    }
+
+    quint32 offset = tail & m_mask;
+    quint32 first = qMin(count, m_mask + 1 - offset);
+    memcpy(data, m_data + offset, first);
+    memcpy(data + first, m_data, count - first);
+    // hand the space back after the bytes are copied out
+    m_tail.storeRelease(tail + count);
+    return static_cast<int>(count);
+}
+
+int AudioRing::skip(int size)
+{
+    quint32 tail = m_tail.loadAcquire();
+    quint32 count = qMin<quint32>(static_cast<quint32>(qMax(0, size)), m_head.loadAcquire() - tail);
+    m_tail.storeRelease(tail + count);
+    return static_cast<int>(count);
+}
+
+int AudioRing::readable() const
+{
+    return static_cast<int>(m_head.loadAcquire() - m_tail.loadAcquire());
+}
+
+void AudioRing::clear()
+{
+    m_head.storeRelease(0);
+    m_tail.storeRelease(0);
+}
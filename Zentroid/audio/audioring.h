@@ -0,0 +1,37 @@
+#ifndef AUDIORING_H
+#define AUDIORING_H
+
+#include <QAtomicInteger>
+
+// Lock free byte ring for exactly one producer and one consumer thread.
+// The capacity is fixed at construction (rounded up to a power of two) and
+// nothing is allocated afterwards. Positions run freely and wrap, the unsigned
+// differences stay right.
+class AudioRing
+{
+public:
+    explicit AudioRing(int capacity);
+    ~AudioRing();
+
+    int capacity() const;
+
+    // producer: copies as much as fits, returns the bytes taken
+    int write(const char *data, int size);
+    int writable() const;
+
+    // consumer
+    int read(char *data, int size);
+    int skip(int size);
+    int readable() const;
+
+    // only while neither side runs
+    void clear();
+
+private:
+    char *m_data = nullptr;
+    quint32 m_mask = 0;
+    QAtomicInteger<quint32> m_head;       // written by the producer
+    QAtomicInteger<quint32> m_tail;       // written by the consumer
+};
+
+#endif // AUDIORING_H
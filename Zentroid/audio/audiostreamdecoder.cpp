@@ -0,0 +1,227 @@
+#include <QDebug>
+#include <QtEndian>
+#include <cstring>
+
+extern "C"
+{
+#include "libavcodec/avcodec.h"
+#include "libavutil/channel_layout.h"
+}
+
+#include "audiostreamdecoder.h"
+
+#define ASD_MAGIC "ZAUD"
+#define ASD_MAGIC_SIZE 4
+// magic, codec, sample rate, channels
+#define ASD_HEADER_SIZE 16
+#define ASD_CODEC_OPUS 0x6f707573 // "opus"
+
+static void appendBe32(QByteArray &data, quint32 value)
+{
+    char buffer[4];
+    qToBigEndian(value, buffer);
+    data.append(buffer, 4);
+}
+
+static quint32 readBe32(const char *data)
+{
+    return qFromBigEndian<quint32>(data);
+}
+
+// copies up to need - have bytes, true once the destination is complete
+static bool collect(char *dst, int need, int &have, const char *&data, int &size)
+{
+    int count = qMin(size, need - have);
+    memcpy(dst + have, data, count);
+    have += count;
+    data += count;
+    size -= count;
+    return have == need;
+}
+
+AudioStreamDecoder::AudioStreamDecoder(int sampleRate, int channels)
+    : m_sampleRate(sampleRate)
+    , m_channels(channels)
+{
+}
+
+AudioStreamDecoder::~AudioStreamDecoder()
+{
+    closeDecoder();
+}
+
+bool AudioStreamDecoder::canDecodeOpus()
+{
+    return nullptr != avcodec_find_decoder(AV_CODEC_ID_OPUS);
+}
+
+QByteArray AudioStreamDecoder::opusRequest(int bitRate)
+{
+    QByteArray request(ASD_MAGIC, ASD_MAGIC_SIZE);
+    appendBe32(request, ASD_CODEC_OPUS);
+    appendBe32(request, static_cast<quint32>(bitRate));
+    return request;
+}
+
+bool AudioStreamDecoder::decode(const char *data, int size, const PcmSink &sink)
+{
+    while (0 < size) {
+        switch (m_state) {
+        case ST_RAW:
+            sink(data, size);
+            return true;
+        case ST_BROKEN:
+            return false;
+        case ST_MAGIC:
+            if (!collect(m_header, ASD_MAGIC_SIZE, m_have, data, size)) {
+                break;
+            }
+            if (0 != memcmp(m_header, ASD_MAGIC, ASD_MAGIC_SIZE)) {
+                // no answer to the request: stock sndcpy, these bytes were pcm already
+                qInfo("AudioStreamDecoder::raw pcm stream");
+                m_state = ST_RAW;
+                sink(m_header, ASD_MAGIC_SIZE);
+                break;
+            }
+            m_state = ST_HEADER;
+            break;
+        case ST_HEADER:
+            if (!collect(m_header, ASD_HEADER_SIZE, m_have, data, size)) {
+                break;
+            }
+            if (!openDecoder(readBe32(m_header + 4), static_cast<int>(readBe32(m_header + 8)), static_cast<int>(readBe32(m_header + 12)))) {
+                m_state = ST_BROKEN;
+                break;
+            }
+            m_state = ST_LENGTH;
+            m_have = 0;
+            break;
+        case ST_LENGTH:
+            if (!collect(m_header, 4, m_have, data, size)) {
+                break;
+            }
+            m_need = static_cast<int>(readBe32(m_header));
+            if (0 >= m_need || static_cast<int>(sizeof(m_packet)) < m_need) {
+                qWarning("AudioStreamDecoder::bad packet size %d", m_need);
+                m_state = ST_BROKEN;
+                break;
+            }
+            m_state = ST_PACKET;
+            m_have = 0;
+            break;
+        case ST_PACKET:
+            if (!collect(m_packet, m_need, m_have, data, size)) {
+                break;
+            }
+            if (!decodePacket(m_need, sink)) {
+                m_state = ST_BROKEN;
+                break;
+            }
+            m_state = ST_LENGTH;
+            m_have = 0;
+            break;
+        }
+    }
+    return ST_BROKEN != m_state;
+}
+
+bool AudioStreamDecoder::isCompressed()
+{
+    return nullptr != m_codecCtx;
+}
+
+bool AudioStreamDecoder::openDecoder(quint32 codecId, int sampleRate, int channels)
+{
+    if (ASD_CODEC_OPUS != codecId) {
+        qWarning("AudioStreamDecoder::unknown codec 0x%08x", codecId);
+        return false;
+    }
+    // the jitter buffer and the mixer run at one fixed format
+    if (sampleRate != m_sampleRate || channels != m_channels) {
+        qWarning("AudioStreamDecoder::unexpected format %dHz %d channels", sampleRate, channels);
+        return false;
+    }
+    const AVCodec *codec = avcodec_find_decoder(AV_CODEC_ID_OPUS);
+    if (!codec) {
+        qWarning("AudioStreamDecoder::no opus decoder");
+        return false;
+    }
+
+    m_codecCtx = avcodec_alloc_context3(codec);
+    m_frame = av_frame_alloc();
+    m_avPacket = av_packet_alloc();
+    if (!m_codecCtx || !m_frame || !m_avPacket) {
+        closeDecoder();
+        return false;
+    }
+    m_codecCtx->sample_rate = sampleRate;
+    m_codecCtx->channels = channels;
+    m_codecCtx->channel_layout = static_cast<uint64_t>(av_get_default_channel_layout(channels));
+    if (avcodec_open2(m_codecCtx, codec, nullptr) < 0) {
+        qWarning("AudioStreamDecoder::could not open the opus decoder");
+        closeDecoder();
+        return false;
+    }
+    qInfo("AudioStreamDecoder::opus stream %dHz %d channels", sampleRate, channels);
+    return true;
+}
+
+void AudioStreamDecoder::closeDecoder()
+{
+    if (m_codecCtx) {
+        avcodec_free_context(&m_codecCtx);
+    }
+    if (m_frame) {
+        av_frame_free(&m_frame);
+    }
+    if (m_avPacket) {
+        av_packet_free(&m_avPacket);
+    }
+}
+
+bool AudioStreamDecoder::decodePacket(int size, const PcmSink &sink)
+{
+    // the decoder copies unreferenced packet data
+    m_avPacket->data = reinterpret_cast<uint8_t *>(m_packet);
+    m_avPacket->size = size;
+    int ret = avcodec_send_packet(m_codecCtx, m_avPacket);
+    m_avPacket->data = nullptr;
+    m_avPacket->size = 0;
+    if (AVERROR_INVALIDDATA == ret) {
+        // one damaged packet costs 20ms of audio, not the stream
+        return true;
+    }
+    if (ret < 0) {
+        return false;
+    }
+
+    int maxFrames = static_cast<int>(sizeof(m_pcm) / sizeof(m_pcm[0])) / m_channels;
+    while (0 == (ret = avcodec_receive_frame(m_codecCtx, m_frame))) {
+        int format = m_frame->format;
+        bool planar = AV_SAMPLE_FMT_S16P == format || AV_SAMPLE_FMT_FLTP == format;
+        bool isFloat = AV_SAMPLE_FMT_FLT == format || AV_SAMPLE_FMT_FLTP == format;
+        if (!isFloat && AV_SAMPLE_FMT_S16 != format && AV_SAMPLE_FMT_S16P != format) {
+            qWarning("AudioStreamDecoder::unsupported sample format %d", format);
+            return false;
+        }
+        for (int start = 0; start < m_frame->nb_samples; start += maxFrames) {
+            int frames = qMin(maxFrames, m_frame->nb_samples - start);
+            for (int i = 0; i < frames; i++) {
+                for (int c = 0; c < m_channels; c++) {
+                    int index = planar ? start + i : (start + i) * m_channels + c;
+                    const uint8_t *plane = m_frame->data[planar ? c : 0];
+                    qint16 sample = 0;
+                    if (isFloat) {
+                        float value = reinterpret_cast<const float *>(plane)[index] * 32768.0f;
+                        sample = static_cast<qint16>(qBound(-32768.0f, value, 32767.0f));
+                    } else {
+                        sample = reinterpret_cast<const qint16 *>(plane)[index];
+                    }
+                    m_pcm[i * m_channels + c] = sample;
+                }
+            }
+            sink(reinterpret_cast<const char *>(m_pcm), frames * m_channels * 2);
+        }
+    }
+    return AVERROR(EAGAIN) == ret;
+}
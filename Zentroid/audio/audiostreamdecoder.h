@@ -0,0 +1,66 @@
+#ifndef AUDIOSTREAMDECODER_H
+#define AUDIOSTREAMDECODER_H
+
+#include <QByteArray>
+#include <functional>
+
+struct AVCodecContext;
+struct AVFrame;
+struct AVPacket;
+
+// Turns the bytes of a device audio socket into interleaved s16 pcm.
+// Stock sndcpy sends raw pcm from the first byte. A device side that knows
+// the codec request answers it with a header (magic, codec, sample rate,
+// channels) followed by opus packets, each with a 4 byte big endian length,
+// which are decoded here with libavcodec. The first 4 bytes tell the two
+// apart; raw pcm is passed on untouched.
+// Lives on the socket's thread, after init nothing is allocated.
+class AudioStreamDecoder
+{
+public:
+    using PcmSink = std::function<void(const char *pcm, int size)>;
+
+    AudioStreamDecoder(int sampleRate, int channels);
+    ~AudioStreamDecoder();
+
+    // true if this host can decode opus
+    static bool canDecodeOpus();
+    // written to the socket once connected, asks for opus at bitRate (bit/s)
+    static QByteArray opusRequest(int bitRate);
+
+    // bytes as read from the socket, decoded pcm goes to sink; false once the
+    // stream is broken (unknown codec, oversized packet, decoder failure)
+    bool decode(const char *data, int size, const PcmSink &sink);
+    bool isCompressed();
+
+private:
+    enum State
+    {
+        ST_MAGIC,
+        ST_HEADER,
+        ST_LENGTH,
+        ST_PACKET,
+        ST_RAW,
+        ST_BROKEN,
+    };
+
+    bool openDecoder(quint32 codec, int sampleRate, int channels);
+    void closeDecoder();
+    bool decodePacket(int size, const PcmSink &sink);
+
+private:
+    int m_sampleRate = 0;
+    int m_channels = 0;
+    State m_state = ST_MAGIC;
+    // header, length or packet being collected
+    int m_need = 0;
+    int m_have = 0;
+    char m_header[16];
+    char m_packet[8192];
+    qint16 m_pcm[5760 * 2]; // 120ms at 48kHz stereo, the longest opus packet
+    AVCodecContext *m_codecCtx = nullptr;
+    AVFrame *m_frame = nullptr;
+    AVPacket *m_avPacket = nullptr;
+};
+
+#endif // AUDIOSTREAMDECODER_H
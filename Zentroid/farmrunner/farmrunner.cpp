@@ -0,0 +1,285 @@
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QRandomGenerator>
+#include <QSettings>
+
+#include "adbprocess.h"
+#include "farmrunner.h"
+#include "inputscript.h"
+
+#define GROUP_FARM "farm"
+#define GROUP_DEVICES "devices"
+
+// a forward client this far behind is dropped instead of buffering without end
+#define FR_MAX_CLIENT_BACKLOG (16 * 1024 * 1024)
+#define FR_DEFAULT_MAX_CONCURRENT 8
+
+FarmRunner::FarmRunner(QObject *parent) : QObject(parent)
+{
+    qsc::IDeviceManage &manage = qsc::IDeviceManage::getInstance();
+    connect(&manage, &qsc::IDeviceManage::deviceConnected, this, &FarmRunner::onDeviceConnected);
+    connect(&manage, &qsc::IDeviceManage::deviceDisconnected, this, &FarmRunner::onDeviceDisconnected);
+    connect(&manage, &qsc::IDeviceManage::bulkConnectFinished, this, &FarmRunner::onBulkConnectFinished);
+    connect(this, &FarmRunner::packetReceived, this, &FarmRunner::onPacketReceived, Qt::QueuedConnection);
+}
+
+FarmRunner::~FarmRunner()
+{
+    stop();
+}
+
+bool FarmRunner::start(const QString &configFile)
+{
+    if (!QFileInfo(configFile).isFile()) {
+        qCritical("farm: config %s not found", configFile.toUtf8().data());
+        return false;
+    }
+    QSettings settings(configFile, QSettings::IniFormat);
+#if (QT_VERSION < QT_VERSION_CHECK(6, 0, 0))
+    settings.setIniCodec("UTF-8");
+#endif
+    QString baseDir = QFileInfo(configFile).absolutePath();
+    auto resolve = [&baseDir](const QString &path) {
+        return path.isEmpty() || QFileInfo(path).isAbsolute() ? path : baseDir + "/" + path;
+    };
+
+    settings.beginGroup(GROUP_FARM);
+    QString adbPath = resolve(settings.value("AdbPath", "").toString());
+    QString serverPath = resolve(settings.value("ServerPath", "").toString());
+    if (serverPath.isEmpty()) {
+        serverPath = QString::fromLocal8Bit(qgetenv("ZENTROID_SERVER_PATH"));
+    }
+    if (serverPath.isEmpty()) {
+        serverPath = QCoreApplication::applicationDirPath() + "/scrcpy-server";
+    }
+    int maxConcurrent = settings.value("MaxConcurrent", FR_DEFAULT_MAX_CONCURRENT).toInt();
+    quint16 metricsPort = static_cast<quint16>(settings.value("MetricsPort", 0).toUInt());
+    quint32 bandwidthKbps = settings.value("BandwidthBudgetKbps", 0).toUInt();
+
+    qsc::DeviceParams defaults;
+    defaults.serverLocalPath = serverPath;
+    defaults.display = false;
+    defaults.maxSize = static_cast<quint16>(settings.value("MaxSize", defaults.maxSize).toUInt());
+    defaults.bitRate = settings.value("BitRate", defaults.bitRate).toUInt();
+    defaults.maxFps = settings.value("MaxFps", defaults.maxFps).toUInt();
+    defaults.recordPath = resolve(settings.value("RecordPath", "").toString());
+    defaults.recordFileFormat = settings.value("RecordFormat", defaults.recordFileFormat).toString();
+    defaults.autoReconnect = settings.value("AutoReconnect", true).toBool();
+    defaults.stayAwake = settings.value("StayAwake", defaults.stayAwake).toBool();
+    defaults.controlProbe = settings.value("ControlProbe", defaults.controlProbe).toBool();
+    defaults.logLevel = settings.value("LogLevel", "info").toString();
+    settings.endGroup();
+
+    if (!adbPath.isEmpty()) {
+        qsc::AdbProcess::setAdbPath(adbPath);
+    }
+
+    QList<qsc::DeviceParams> params;
+    int count = settings.beginReadArray(GROUP_DEVICES);
+    for (int i = 0; i < count; i++) {
+        settings.setArrayIndex(i);
+        qsc::DeviceParams device = defaults;
+        device.serial = settings.value("serial", "").toString().trimmed();
+        if (device.serial.isEmpty() || m_devices.contains(device.serial)) {
+            qWarning("farm: device %d has no serial or a duplicate one, skipped", i + 1);
+            continue;
+        }
+        // the recorder is the only consumer besides forwarding, a device with
+        // neither still runs its script
+        device.recordFile = settings.value("record", !defaults.recordPath.isEmpty()).toBool() && !defaults.recordPath.isEmpty();
+        device.scid = QRandomGenerator::global()->bounded(1, 10000) & 0x7FFFFFFF;
+        QString keymap = resolve(settings.value("keymap", "").toString());
+        if (!keymap.isEmpty()) {
+            QFile keymapFile(keymap);
+            if (keymapFile.open(QIODevice::ReadOnly)) {
+                device.gameScript = keymapFile.readAll();
+            } else {
+                qWarning("farm: %s: cannot open keymap %s", device.serial.toUtf8().data(), keymap.toUtf8().data());
+            }
+        }
+
+        FarmDevice *farmDevice = new FarmDevice;
+        farmDevice->serial = device.serial;
+        farmDevice->script = resolve(settings.value("script", "").toString());
+        farmDevice->forwardPort = static_cast<quint16>(settings.value("forwardPort", 0).toUInt());
+        if (!farmDevice->script.isEmpty()) {
+            farmDevice->input = new InputScript(this);
+            if (!farmDevice->input->load(farmDevice->script)) {
+                delete farmDevice->input;
+                farmDevice->input = Q_NULLPTR;
+            }
+        }
+        m_devices.insert(device.serial, farmDevice);
+        params.append(device);
+    }
+    settings.endArray();
+
+    if (params.isEmpty()) {
+        qCritical("farm: no devices in %s", configFile.toUtf8().data());
+        return false;
+    }
+
+    qsc::IDeviceManage &manage = qsc::IDeviceManage::getInstance();
+    // nothing is decoded here, the decode budget has nothing to measure
+    if (0 < bandwidthKbps) {
+        manage.setStreamBudget(true, bandwidthKbps, 0.0);
+    }
+    if (0 < metricsPort) {
+        manage.startMetricsServer(metricsPort);
+    }
+
+    m_pending = params.size();
+    qInfo("farm: connecting %d devices, %d at a time", params.size(), maxConcurrent);
+    return manage.connectDevices(params, maxConcurrent);
+}
+
+void FarmRunner::stop()
+{
+    for (FarmDevice *device : m_devices) {
+        if (device->input) {
+            device->input->stop();
+        }
+        stopForward(device);
+    }
+    qsc::IDeviceManage::getInstance().disconnectAllDevice();
+    qDeleteAll(m_devices);
+    m_devices.clear();
+}
+
+void FarmRunner::onDeviceConnected(bool success, const QString &serial, const QString &deviceName, const QSize &size)
+{
+    FarmDevice *farmDevice = m_devices.value(serial, Q_NULLPTR);
+    if (!farmDevice) {
+        return;
+    }
+    if (!success) {
+        qWarning("farm: %s did not connect", serial.toUtf8().data());
+        return;
+    }
+    qInfo("farm: %s (%s) up, %dx%d", serial.toUtf8().data(), deviceName.toUtf8().data(), size.width(), size.height());
+
+    QPointer<qsc::IDevice> device = qsc::IDeviceManage::getInstance().getDevice(serial);
+    if (!device) {
+        return;
+    }
+    if (farmDevice->forwardPort && startForward(farmDevice)) {
+        device->setVideoPacketCallback([this, serial](const QByteArray &data, bool config, bool keyFrame) {
+            emit packetReceived(serial, data, config, keyFrame);
+        });
+    }
+    if (farmDevice->input) {
+        farmDevice->input->start(device, size);
+    }
+}
+
+void FarmRunner::onDeviceDisconnected(QString serial)
+{
+    FarmDevice *farmDevice = m_devices.value(serial, Q_NULLPTR);
+    if (!farmDevice) {
+        return;
+    }
+    qInfo("farm: %s disconnected", serial.toUtf8().data());
+    if (farmDevice->input) {
+        farmDevice->input->stop();
+    }
+    stopForward(farmDevice);
+}
+
+void FarmRunner::onBulkConnectFinished(const QList<qsc::DeviceConnectTimings> &timings)
+{
+    int connected = 0;
+    for (const qsc::DeviceConnectTimings &timing : timings) {
+        if (timing.success) {
+            connected++;
+        }
+    }
+    qInfo("farm: %d of %d devices connected", connected, m_pending);
+}
+
+void FarmRunner::onPacketReceived(const QString &serial, const QByteArray &data, bool config, bool keyFrame)
+{
+    FarmDevice *farmDevice = m_devices.value(serial, Q_NULLPTR);
+    if (!farmDevice || !farmDevice->forwardServer) {
+        return;
+    }
+    if (config) {
+        farmDevice->configPacket = data;
+    }
+
+    for (auto it = farmDevice->clients.begin(); it != farmDevice->clients.end();) {
+        QTcpSocket *socket = it->socket.data();
+        if (!socket || QAbstractSocket::ConnectedState != socket->state()) {
+            it = farmDevice->clients.erase(it);
+            continue;
+        }
+        if (FR_MAX_CLIENT_BACKLOG < socket->bytesToWrite()) {
+            qWarning("farm: %s: forward client too slow, dropped", serial.toUtf8().data());
+            socket->abort();
+            it = farmDevice->clients.erase(it);
+            continue;
+        }
+        if (keyFrame) {
+            it->waitKeyFrame = false;
+        }
+        if (config || !it->waitKeyFrame) {
+            socket->write(data);
+        }
+        ++it;
+    }
+}
+
+void FarmRunner::onNewForwardClient(FarmDevice *device)
+{
+    while (device->forwardServer->hasPendingConnections()) {
+        QTcpSocket *socket = device->forwardServer->nextPendingConnection();
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        // the stream is one way, a client cannot send anything
+        socket->setReadBufferSize(1);
+        if (!device->configPacket.isEmpty()) {
+            socket->write(device->configPacket);
+        }
+        ForwardClient client;
+        client.socket = socket;
+        device->clients.append(client);
+    }
+}
+
+bool FarmRunner::startForward(FarmDevice *device)
+{
+    if (device->forwardServer) {
+        return true;
+    }
+    device->forwardServer = new QTcpServer(this);
+    if (!device->forwardServer->listen(QHostAddress::LocalHost, device->forwardPort)) {
+        qWarning("farm: %s: cannot forward on port %d: %s", device->serial.toUtf8().data(), device->forwardPort,
+                 device->forwardServer->errorString().toUtf8().data());
+        delete device->forwardServer;
+        device->forwardServer = Q_NULLPTR;
+        return false;
+    }
+    connect(device->forwardServer, &QTcpServer::newConnection, this, [this, device]() { onNewForwardClient(device); });
+    qInfo("farm: %s: h264 on tcp://127.0.0.1:%d", device->serial.toUtf8().data(), device->forwardPort);
+    return true;
+}
+
+void FarmRunner::stopForward(FarmDevice *device)
+{
+    if (!device->forwardServer) {
+        return;
+    }
+    QPointer<qsc::IDevice> iDevice = qsc::IDeviceManage::getInstance().getDevice(device->serial);
+    if (iDevice) {
+        iDevice->setVideoPacketCallback(Q_NULLPTR);
+    }
+    for (const ForwardClient &client : device->clients) {
+        if (client.socket) {
+            client.socket->disconnectFromHost();
+        }
+    }
+    device->clients.clear();
+    device->configPacket.clear();
+    delete device->forwardServer;
+    device->forwardServer = Q_NULLPTR;
+}
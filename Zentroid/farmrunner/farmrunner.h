@@ -0,0 +1,63 @@
+#ifndef FARMRUNNER_H
+#define FARMRUNNER_H
+
+#include <QHash>
+#include <QList>
+#include <QPointer>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+#include "ZentroidCore.h"
+
+class InputScript;
+
+// Drives a rack of devices from an ini file without any window: connects all of
+// them in one bulk bring-up, records them, forwards their raw h264 stream to
+// local tcp clients and runs an input script per device once it is up.
+// Nothing is decoded, the load per device is the stream read and the recorder.
+class FarmRunner : public QObject
+{
+    Q_OBJECT
+public:
+    explicit FarmRunner(QObject *parent = Q_NULLPTR);
+    virtual ~FarmRunner();
+
+    bool start(const QString &configFile);
+    void stop();
+
+signals:
+    // from the stream threads to the main thread
+    void packetReceived(const QString &serial, const QByteArray &data, bool config, bool keyFrame);
+
+private:
+    struct ForwardClient
+    {
+        QPointer<QTcpSocket> socket;
+        // a late client starts at the next key frame, its decoder has nothing before
+        bool waitKeyFrame = true;
+    };
+    struct FarmDevice
+    {
+        QString serial;
+        QString script;
+        quint16 forwardPort = 0;
+        InputScript *input = Q_NULLPTR;
+        QTcpServer *forwardServer = Q_NULLPTR;
+        QList<ForwardClient> clients;
+        QByteArray configPacket;
+    };
+
+    void onDeviceConnected(bool success, const QString &serial, const QString &deviceName, const QSize &size);
+    void onDeviceDisconnected(QString serial);
+    void onBulkConnectFinished(const QList<qsc::DeviceConnectTimings> &timings);
+    void onPacketReceived(const QString &serial, const QByteArray &data, bool config, bool keyFrame);
+    void onNewForwardClient(FarmDevice *device);
+    bool startForward(FarmDevice *device);
+    void stopForward(FarmDevice *device);
+
+private:
+    QHash<QString, FarmDevice *> m_devices;
+    int m_pending = 0;
+};
+
+#endif // FARMRUNNER_H
@@ -0,0 +1,216 @@
+#include <QDebug>
+#include <QFile>
+#include <QMouseEvent>
+#include <QTextStream>
+
+#include "inputscript.h"
+
+// a swipe is sent as one move per frame at 60 fps
+#define IS_SWIPE_STEP_MS 16
+#define IS_DEFAULT_SWIPE_MS 300
+// a loop without any wait would spin the event loop
+#define IS_MIN_LOOP_MS 10
+
+InputScript::InputScript(QObject *parent) : QObject(parent)
+{
+    m_timer.setSingleShot(true);
+    connect(&m_timer, &QTimer::timeout, this, &InputScript::step);
+}
+
+InputScript::~InputScript()
+{
+    stop();
+}
+
+bool InputScript::load(const QString &file)
+{
+    QFile scriptFile(file);
+    if (!scriptFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        qWarning("input script: cannot open %s", file.toUtf8().data());
+        return false;
+    }
+
+    m_file = file;
+    m_commands.clear();
+    QTextStream in(&scriptFile);
+    int lineNumber = 0;
+    while (!in.atEnd()) {
+        if (!parseLine(in.readLine(), ++lineNumber)) {
+            m_commands.clear();
+            return false;
+        }
+    }
+    return true;
+}
+
+void InputScript::start(QPointer<qsc::IDevice> device, const QSize &frameSize)
+{
+    stop();
+    if (!device || m_commands.isEmpty()) {
+        return;
+    }
+    m_device = device;
+    m_frameSize = frameSize;
+    m_next = 0;
+    m_timer.start(0);
+}
+
+void InputScript::stop()
+{
+    m_timer.stop();
+    m_device = Q_NULLPTR;
+}
+
+bool InputScript::isRunning()
+{
+    return m_timer.isActive();
+}
+
+bool InputScript::parseLine(const QString &line, int lineNumber)
+{
+    QString text = line.trimmed();
+    if (text.isEmpty() || text.startsWith('#')) {
+        return true;
+    }
+
+#if (QT_VERSION < QT_VERSION_CHECK(5, 14, 0))
+    QStringList words = text.split(' ', QString::SkipEmptyParts);
+#else
+    QStringList words = text.split(' ', Qt::SkipEmptyParts);
+#endif
+    QString name = words.takeFirst().toLower();
+    QList<int> numbers;
+    bool numeric = true;
+    for (const QString &word : words) {
+        bool ok = false;
+        numbers.append(word.toInt(&ok));
+        numeric = numeric && ok;
+    }
+
+    Command command;
+    if ("wait" == name && numeric && 1 == numbers.size()) {
+        command.type = CT_WAIT;
+        command.ms = qMax(0, numbers[0]);
+        m_commands.append(command);
+    } else if ("tap" == name && numeric && 2 == numbers.size()) {
+        command.pos = QPoint(numbers[0], numbers[1]);
+        command.type = CT_PRESS;
+        m_commands.append(command);
+        command.type = CT_RELEASE;
+        m_commands.append(command);
+    } else if ("swipe" == name && numeric && (4 == numbers.size() || 5 == numbers.size())) {
+        QPoint from(numbers[0], numbers[1]);
+        QPoint to(numbers[2], numbers[3]);
+        int duration = 5 == numbers.size() ? qMax(0, numbers[4]) : IS_DEFAULT_SWIPE_MS;
+        int steps = qMax(1, duration / IS_SWIPE_STEP_MS);
+
+        command.type = CT_PRESS;
+        command.pos = from;
+        m_commands.append(command);
+        for (int i = 1; i <= steps; i++) {
+            Command wait;
+            wait.type = CT_WAIT;
+            wait.ms = duration / steps;
+            m_commands.append(wait);
+            command.type = CT_MOVE;
+            command.pos = from + (to - from) * i / steps;
+            m_commands.append(command);
+        }
+        command.type = CT_RELEASE;
+        command.pos = to;
+        m_commands.append(command);
+    } else if ("key" == name && 1 == words.size()) {
+        command.type = CT_KEY;
+        command.arg = words[0].toLower();
+        m_commands.append(command);
+    } else if ("text" == name && !words.isEmpty()) {
+        command.type = CT_TEXT;
+        command.arg = text.mid(text.indexOf(' ') + 1);
+        m_commands.append(command);
+    } else if ("loop" == name && words.isEmpty()) {
+        command.type = CT_LOOP;
+        m_commands.append(command);
+    } else {
+        qWarning("input script %s:%d: cannot parse \"%s\"", m_file.toUtf8().data(), lineNumber, text.toUtf8().data());
+        return false;
+    }
+    return true;
+}
+
+void InputScript::step()
+{
+    // a device gone mid script ends it
+    if (!m_device) {
+        emit finished();
+        return;
+    }
+
+    while (m_next < m_commands.size()) {
+        const Command &command = m_commands[m_next++];
+        switch (command.type) {
+        case CT_WAIT:
+            if (0 < command.ms) {
+                m_timer.start(command.ms);
+                return;
+            }
+            break;
+        case CT_PRESS:
+            sendMouse(QEvent::MouseButtonPress, command.pos);
+            break;
+        case CT_MOVE:
+            sendMouse(QEvent::MouseMove, command.pos);
+            break;
+        case CT_RELEASE:
+            sendMouse(QEvent::MouseButtonRelease, command.pos);
+            break;
+        case CT_KEY:
+            if (!sendKey(command.arg)) {
+                qWarning("input script %s: unknown key %s", m_file.toUtf8().data(), command.arg.toUtf8().data());
+            }
+            break;
+        case CT_TEXT: {
+            QString text = command.arg;
+            m_device->postTextInput(text);
+            break;
+        }
+        case CT_LOOP:
+            m_next = 0;
+            m_timer.start(IS_MIN_LOOP_MS);
+            return;
+        }
+    }
+
+    m_device = Q_NULLPTR;
+    emit finished();
+}
+
+void InputScript::sendMouse(QEvent::Type type, const QPoint &pos)
+{
+    Qt::MouseButton button = QEvent::MouseMove == type ? Qt::NoButton : Qt::LeftButton;
+    Qt::MouseButtons buttons = QEvent::MouseButtonRelease == type ? Qt::NoButton : Qt::LeftButton;
+    // frame and show size are the same, positions go through unscaled
+    QMouseEvent event(type, QPointF(pos), QPointF(pos), button, buttons, Qt::NoModifier);
+    m_device->mouseEvent(&event, m_frameSize, m_frameSize);
+}
+
+bool InputScript::sendKey(const QString &name)
+{
+    if ("home" == name) {
+        m_device->postGoHome();
+    } else if ("back" == name) {
+        m_device->postGoBack();
+    } else if ("menu" == name) {
+        m_device->postGoMenu();
+    } else if ("appswitch" == name) {
+        m_device->postAppSwitch();
+    } else if ("power" == name) {
+        m_device->postPower();
+    } else if ("volumeup" == name) {
+        m_device->postVolumeUp();
+    } else if ("volumedown" == name) {
+        m_device->postVolumeDown();
+    } else {
+        return false;
+    }
+    return true;
+}
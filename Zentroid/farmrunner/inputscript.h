@@ -0,0 +1,67 @@
+#ifndef INPUTSCRIPT_H
+#define INPUTSCRIPT_H
+
+#include <QList>
+#include <QPointer>
+#include <QSize>
+#include <QTimer>
+
+#include "ZentroidCore.h"
+
+// Scripted input for one device, one command per line, # starts a comment:
+//   wait <ms>
+//   tap <x> <y>
+//   swipe <x1> <y1> <x2> <y2> [ms]
+//   key home|back|menu|appswitch|power|volumeup|volumedown
+//   text <anything up to the end of the line>
+//   loop                 start over from the first line
+// Positions are device pixels of the video frame.
+class InputScript : public QObject
+{
+    Q_OBJECT
+public:
+    explicit InputScript(QObject *parent = Q_NULLPTR);
+    virtual ~InputScript();
+
+    bool load(const QString &file);
+    void start(QPointer<qsc::IDevice> device, const QSize &frameSize);
+    void stop();
+    bool isRunning();
+
+signals:
+    void finished();
+
+private:
+    enum CommandType
+    {
+        CT_WAIT,
+        CT_PRESS,
+        CT_MOVE,
+        CT_RELEASE,
+        CT_KEY,
+        CT_TEXT,
+        CT_LOOP,
+    };
+    struct Command
+    {
+        CommandType type = CT_WAIT;
+        QPoint pos;
+        int ms = 0;
+        QString arg;
+    };
+
+    bool parseLine(const QString &line, int lineNumber);
+    void step();
+    void sendMouse(QEvent::Type type, const QPoint &pos);
+    bool sendKey(const QString &name);
+
+private:
+    QString m_file;
+    QList<Command> m_commands;
+    int m_next = 0;
+    QPointer<qsc::IDevice> m_device;
+    QSize m_frameSize;
+    QTimer m_timer;
+};
+
+#endif // INPUTSCRIPT_H
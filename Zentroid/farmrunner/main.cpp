@@ -0,0 +1,101 @@
+#include <cstring>
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QMetaObject>
+
+#ifdef Q_OS_WIN32
+#include <windows.h>
+#else
+#include <QSocketNotifier>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "farmrunner.h"
+
+namespace {
+
+#ifdef Q_OS_WIN32
+
+BOOL WINAPI consoleCtrlHandler(DWORD type)
+{
+    if (CTRL_C_EVENT != type && CTRL_BREAK_EVENT != type && CTRL_CLOSE_EVENT != type) {
+        return FALSE;
+    }
+    // runs on a thread of its own, posting to the event loop is safe from there
+    QMetaObject::invokeMethod(QCoreApplication::instance(), "quit", Qt::QueuedConnection);
+    return TRUE;
+}
+
+void installQuitHandlers()
+{
+    SetConsoleCtrlHandler(consoleCtrlHandler, TRUE);
+}
+
+#else
+
+// the handler only writes a byte, the notifier quits from the event loop
+int g_signalFds[2] = { -1, -1 };
+
+void onQuitSignal(int)
+{
+    char signalByte = 1;
+    ssize_t ret = ::write(g_signalFds[0], &signalByte, sizeof(signalByte));
+    Q_UNUSED(ret)
+}
+
+void installQuitHandlers()
+{
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, g_signalFds)) {
+        qWarning("socketpair for signal handling failed, SIGINT/SIGTERM keep their default action");
+        return;
+    }
+
+    QSocketNotifier *notifier = new QSocketNotifier(g_signalFds[1], QSocketNotifier::Read, QCoreApplication::instance());
+    QObject::connect(notifier, &QSocketNotifier::activated, QCoreApplication::instance(), []() {
+        char signalByte;
+        ssize_t ret = ::read(g_signalFds[1], &signalByte, sizeof(signalByte));
+        Q_UNUSED(ret)
+        qInfo("signal received, stopping");
+        QCoreApplication::quit();
+    });
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = onQuitSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGINT, &action, nullptr);
+    sigaction(SIGTERM, &action, nullptr);
+}
+
+#endif
+
+}
+
+int main(int argc, char *argv[])
+{
+    // no widgets, no platform plugin: runs on a server without a display
+    QCoreApplication a(argc, argv);
+    a.setApplicationName("zentroid-farm");
+
+    QString configFile = QCoreApplication::applicationDirPath() + "/config/farm.ini";
+    if (1 < argc) {
+        configFile = QString::fromLocal8Bit(argv[1]);
+    }
+
+    // stop through the event loop so recordings get their trailer
+    installQuitHandlers();
+
+    FarmRunner runner;
+    if (!runner.start(configFile)) {
+        qCritical("usage: zentroid-farm [config.ini]");
+        return 1;
+    }
+
+    int ret = a.exec();
+    runner.stop();
+    return ret;
+}
@@ -8,9 +8,9 @@ GroupController::GroupController(QObject *parent) : QObject(parent)
 
 }
 
-bool GroupController::isHost(const QString &serial)
+bool GroupController::isHost(qsc::IDevice *device)
 {
-    auto data = qsc::IDeviceManage::getInstance().getDevice(serial)->getUserData();
+    auto data = device->getUserData();
     if (!data) {
         return true;
     }
@@ -18,16 +18,6 @@ bool GroupController::isHost(const QString &serial)
     return static_cast<VideoForm*>(data)->isHost();
 }
 
-QSize GroupController::getFrameSize(const QString &serial)
-{
-    auto data = qsc::IDeviceManage::getInstance().getDevice(serial)->getUserData();
-    if (!data) {
-        return QSize();
-    }
-
-    return static_cast<VideoForm*>(data)->frameSize();
-}
-
 GroupController &GroupController::instance()
 {
     static GroupController gc;
@@ -36,408 +26,116 @@ GroupController &GroupController::instance()
 
 void GroupController::updateDeviceState(const QString &serial)
 {
-    if (!m_devices.contains(serial)) {
-        return;
-    }
-
-    auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
-    if (!device) {
-        return;
-    }
-
-    if (isHost(serial)) {
-        device->registerDeviceObserver(this);
-    } else {
-        device->deRegisterDeviceObserver(this);
-    }
-}
-
-void GroupController::addDevice(const QString &serial)
-{
-    if (m_devices.contains(serial)) {
-        return;
-    }
-
-    m_devices.append(serial);
-}
-
-void GroupController::removeDevice(const QString &serial)
-{
-    if (!m_devices.contains(serial)) {
-        return;
-    }
-
-    m_devices.removeOne(serial);
-
-    auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
-    if (!device) {
-        return;
-    }
-
-    if (isHost(serial)) {
-        device->deRegisterDeviceObserver(this);
-    }
-}
-
-void GroupController::mouseEvent(const QMouseEvent *from, const QSize &frameSize, const QSize &showSize)
-{
-    Q_UNUSED(frameSize);
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
-        if (!device) {
-            continue;
-        }
-
-        device->mouseEvent(from, getFrameSize(serial), showSize);
-    }
-}
-
-void GroupController::wheelEvent(const QWheelEvent *from, const QSize &frameSize, const QSize &showSize)
-{
-    Q_UNUSED(frameSize);
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
-        if (!device) {
-            continue;
-        }
-
-        device->wheelEvent(from, getFrameSize(serial), showSize);
-    }
-}
-
-void GroupController::keyEvent(const QKeyEvent *from, const QSize &frameSize, const QSize &showSize)
-{
-    Q_UNUSED(frameSize);
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
-        if (!device) {
-            continue;
+    for (const auto& member : m_members) {
+        if (member.serial == serial) {
+            rebuild();
+            return;
         }
-
-        device->keyEvent(from, getFrameSize(serial), showSize);
     }
 }
 
-void GroupController::postGoBack()
-{
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
-        if (!device) {
-            continue;
-        }
-
-        device->postGoBack();
-    }
-}
-
-void GroupController::postGoHome()
-{
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
-        if (!device) {
-            continue;
-        }
-
-        device->postGoHome();
-    }
-}
-
-void GroupController::postGoMenu()
-{
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
-        if (!device) {
-            continue;
-        }
-
-        device->postGoMenu();
-    }
-}
-
-void GroupController::postAppSwitch()
-{
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
-        if (!device) {
-            continue;
-        }
-
-        device->postAppSwitch();
-    }
-}
-
-void GroupController::postPower()
-{
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
-        if (!device) {
-            continue;
-        }
-
-        device->postPower();
-    }
-}
-
-void GroupController::postVolumeUp()
-{
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
-        if (!device) {
-            continue;
-        }
-
-        device->postVolumeUp();
-    }
-}
-
-void GroupController::postVolumeDown()
-{
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
-        if (!device) {
-            continue;
-        }
-
-        device->postVolumeDown();
-    }
-}
-
-void GroupController::postCopy()
-{
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
-        if (!device) {
-            continue;
-        }
-
-        device->postCopy();
-    }
-}
-
-void GroupController::postCut()
+void GroupController::addDevice(const QString &serial)
 {
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
-        if (!device) {
-            continue;
+    for (const auto& member : m_members) {
+        if (member.serial == serial) {
+            return;
         }
-
-        device->postCut();
     }
-}
 
-void GroupController::setDisplayPower(bool on)
-{
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
-        if (!device) {
-            continue;
-        }
-
-        device->setDisplayPower(on);
-    }
+    Member member;
+    member.serial = serial;
+    member.device = qsc::IDeviceManage::getInstance().getDevice(serial);
+    m_members.append(member);
+    rebuild();
 }
 
-void GroupController::expandNotificationPanel()
-{
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
-        if (!device) {
-            continue;
-        }
-
-        device->expandNotificationPanel();
-    }
-}
-
-void GroupController::collapsePanel()
+void GroupController::removeDevice(const QString &serial)
 {
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
-        if (!device) {
+    for (int i = 0; i < m_members.size(); i++) {
+        if (m_members[i].serial != serial) {
             continue;
         }
 
-        device->collapsePanel();
-    }
-}
-
-void GroupController::postBackOrScreenOn(bool down)
-{
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
+        if (m_members[i].device && m_members[i].host) {
+            m_members[i].device->deRegisterDeviceObserver(this);
         }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
-        if (!device) {
-            continue;
-        }
-
-        device->postBackOrScreenOn(down);
+        m_members.remove(i);
+        rebuild();
+        return;
     }
 }
 
-void GroupController::postTextInput(QString &text)
+void GroupController::rebuild()
 {
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
-        if (!device) {
+    QStringList hosts;
+    QStringList targets;
+    for (auto& member : m_members) {
+        if (!member.device) {
+            member.host = false;
             continue;
         }
 
-        device->postTextInput(text);
-    }
-}
-
-void GroupController::requestDeviceClipboard()
-{
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
-        if (!device) {
-            continue;
+        member.host = isHost(member.device);
+        if (member.host) {
+            hosts << member.serial;
+            member.device->registerDeviceObserver(this);
+        } else {
+            targets << member.serial;
+            member.device->deRegisterDeviceObserver(this);
         }
-
-        device->requestDeviceClipboard();
     }
-}
 
-void GroupController::setDeviceClipboard(bool pause)
-{
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
-        if (!device) {
-            continue;
+    for (const auto& serial : m_hosts) {
+        if (!hosts.contains(serial)) {
+            qsc::IDeviceManage::getInstance().setBroadcastTargets(serial, QStringList());
         }
-
-        device->setDeviceClipboard(pause);
     }
-}
-
-void GroupController::clipboardPaste()
-{
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
-        if (!device) {
-            continue;
-        }
-
-        device->clipboardPaste();
+    for (const auto& serial : hosts) {
+        qsc::IDeviceManage::getInstance().setBroadcastTargets(serial, targets);
     }
+    m_hosts = hosts;
 }
 
 void GroupController::pushFileRequest(const QString &file, const QString &devicePath)
 {
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
-        if (!device) {
+    for (const auto& member : m_members) {
+        if (member.host || !member.device) {
             continue;
         }
 
-        device->pushFileRequest(file, devicePath);
+        member.device->pushFileRequest(file, devicePath);
     }
 }
 
 void GroupController::installApkRequest(const QString &apkFile)
 {
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
-        if (!device) {
+    for (const auto& member : m_members) {
+        if (member.host || !member.device) {
             continue;
         }
 
-        device->installApkRequest(apkFile);
+        member.device->installApkRequest(apkFile);
     }
 }
 
 void GroupController::screenshot()
 {
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
-        if (!device) {
+    for (const auto& member : m_members) {
+        if (member.host || !member.device) {
             continue;
         }
 
-        device->screenshot();
+        member.device->screenshot();
     }
 }
 
 void GroupController::showTouch(bool show)
 {
-    for (const auto& serial : m_devices) {
-        if (true == isHost(serial)) {
-            continue;
-        }
-        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
-        if (!device) {
+    for (const auto& member : m_members) {
+        if (member.host || !member.device) {
             continue;
         }
 
-        device->showTouch(show);
+        member.device->showTouch(show);
     }
 }
@@ -2,6 +2,8 @@
 #define GROUPCONTROLLER_H
 
 #include <QObject>
+#include <QPointer>
+#include <QStringList>
 #include <QVector>
 
 #include "ZentroidCore.h"
@@ -18,39 +20,30 @@ public:
 
 private:
     // DeviceObserver
-    void mouseEvent(const QMouseEvent *from, const QSize &frameSize, const QSize &showSize) override;
-    void wheelEvent(const QWheelEvent *from, const QSize &frameSize, const QSize &showSize) override;
-    void keyEvent(const QKeyEvent *from, const QSize &frameSize, const QSize &showSize) override;
-
-    void postGoBack() override;
-    void postGoHome() override;
-    void postGoMenu() override;
-    void postAppSwitch() override;
-    void postPower() override;
-    void postVolumeUp() override;
-    void postVolumeDown() override;
-    void postCopy() override;
-    void postCut() override;
-    void setDisplayPower(bool on) override;
-    void expandNotificationPanel() override;
-    void collapsePanel() override;
-    void postBackOrScreenOn(bool down) override;
-    void postTextInput(QString &text) override;
-    void requestDeviceClipboard() override;
-    void setDeviceClipboard(bool pause = true) override;
-    void clipboardPaste() override;
+    // input and control messages reach the group through the core broadcast,
+    // only requests that are not control messages are forwarded from here
     void pushFileRequest(const QString &file, const QString &devicePath = "") override;
     void installApkRequest(const QString &apkFile) override;
     void screenshot() override;
     void showTouch(bool show) override;
 
 private:
+    struct Member
+    {
+        QString serial;
+        QPointer<qsc::IDevice> device;
+        bool host = false;
+    };
+
     explicit GroupController(QObject *parent = nullptr);
-    bool isHost(const QString& serial);
-    QSize getFrameSize(const QString& serial);
+    bool isHost(qsc::IDevice *device);
+    // split members into hosts and targets and hand that to the core broadcast
+    void rebuild();
 
 private:
-    QVector<QString> m_devices;
+    QVector<Member> m_members;
+    // hosts currently mirrored by the core
+    QStringList m_hosts;
 };
 
 #endif // GROUPCONTROLLER_H
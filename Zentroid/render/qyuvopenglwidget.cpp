@@ -131,12 +131,34 @@ const QSize &QYUVOpenGLWidget::frameSize()
 
 void QYUVOpenGLWidget::updateTextures(quint8 *dataY, quint8 *dataU, quint8 *dataV, quint32 linesizeY, quint32 linesizeU, quint32 linesizeV)
 {
-    if (m_textureInited) {
-        updateTexture(m_texture[0], 0, dataY, linesizeY);
-        updateTexture(m_texture[1], 1, dataU, linesizeU);
-        updateTexture(m_texture[2], 2, dataV, linesizeV);
-        update();
+    updateTextures(dataY, dataU, dataV, linesizeY, linesizeU, linesizeV, 0, m_frameSize.height());
+}
+
+void QYUVOpenGLWidget::updateTextures(
+    quint8 *dataY, quint8 *dataU, quint8 *dataV, quint32 linesizeY, quint32 linesizeU, quint32 linesizeV, int firstRow, int rowCount)
+{
+    if (!m_textureInited) {
+        return;
+    }
+    // textures about to be recreated or just recreated hold nothing yet
+    if (m_fullUpload || m_needUpdate) {
+        firstRow = 0;
+        rowCount = m_frameSize.height();
+        m_fullUpload = m_needUpdate;
     }
+    firstRow = qBound(0, firstRow, m_frameSize.height());
+    rowCount = qBound(0, rowCount, m_frameSize.height() - firstRow);
+    if (0 == rowCount) {
+        return;
+    }
+
+    // chroma rows covering the luma band, an odd edge takes the row it shares
+    int chromaFirst = firstRow / 2;
+    int chromaCount = (firstRow + rowCount + 1) / 2 - chromaFirst;
+    updateTexture(m_texture[0], 0, dataY, linesizeY, firstRow, rowCount);
+    updateTexture(m_texture[1], 1, dataU, linesizeU, chromaFirst, chromaCount);
+    updateTexture(m_texture[2], 2, dataV, linesizeV, chromaFirst, chromaCount);
+    update();
 }
 
 void QYUVOpenGLWidget::initializeGL()
@@ -250,6 +272,7 @@ void QYUVOpenGLWidget::initTextures()
     glTexImage2D(GL_TEXTURE_2D, 0, GL_LUMINANCE, m_frameSize.width() / 2, m_frameSize.height() / 2, 0, GL_LUMINANCE, GL_UNSIGNED_BYTE, nullptr);
 
     m_textureInited = true;
+    m_fullUpload = true;
 }
 
 void QYUVOpenGLWidget::deInitTextures()
@@ -262,16 +285,20 @@ void QYUVOpenGLWidget::deInitTextures()
     m_textureInited = false;
 }
 
-void QYUVOpenGLWidget::updateTexture(GLuint texture, quint32 textureType, quint8 *pixels, quint32 stride)
+void QYUVOpenGLWidget::updateTexture(GLuint texture, quint32 textureType, quint8 *pixels, quint32 stride, int firstRow, int rowCount)
 {
     if (!pixels)
         return;
 
     QSize size = 0 == textureType ? m_frameSize : m_frameSize / 2;
+    rowCount = qMin(rowCount, size.height() - firstRow);
+    if (0 >= rowCount) {
+        return;
+    }
 
     makeCurrent();
     glBindTexture(GL_TEXTURE_2D, texture);
     glPixelStorei(GL_UNPACK_ROW_LENGTH, static_cast<GLint>(stride));
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size.width(), size.height(), GL_LUMINANCE, GL_UNSIGNED_BYTE, pixels);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, firstRow, size.width(), rowCount, GL_LUMINANCE, GL_UNSIGNED_BYTE, pixels + static_cast<qint64>(firstRow) * stride);
     doneCurrent();
 }
@@ -20,6 +20,8 @@ public:
     void setFrameSize(const QSize &frameSize);
     const QSize &frameSize();
     void updateTextures(quint8 *dataY, quint8 *dataU, quint8 *dataV, quint32 linesizeY, quint32 linesizeU, quint32 linesizeV);
+    // uploads only the luma rows [firstRow, firstRow + rowCount) and the chroma rows under them
+    void updateTextures(quint8 *dataY, quint8 *dataU, quint8 *dataV, quint32 linesizeY, quint32 linesizeU, quint32 linesizeV, int firstRow, int rowCount);
 
 protected:
     void initializeGL() override;
@@ -30,13 +32,15 @@ private:
     void initShader();
     void initTextures();
     void deInitTextures();
-    void updateTexture(GLuint texture, quint32 textureType, quint8 *pixels, quint32 stride);
+    void updateTexture(GLuint texture, quint32 textureType, quint8 *pixels, quint32 stride, int firstRow, int rowCount);
 
 private:
     // video frame size
     QSize m_frameSize = { -1, -1 };
     bool m_needUpdate = false;
     bool m_textureInited = false;
+    // new textures are empty, the next upload must cover the whole frame
+    bool m_fullUpload = true;
 
     // vertex buffer object (VBO): default is VertexBuffer (GL_ARRAY_BUFFER) type
     QOpenGLBuffer m_vbo;
@@ -0,0 +1,510 @@
+#include <cstring>
+#include <functional>
+
+#include <QFileInfo>
+#include <QHash>
+#include <QSignalSpy>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTemporaryFile>
+#include <QtEndian>
+#include <QtTest>
+
+#include "adbwireclient.h"
+
+#define TST_TIMEOUT_MS 5000
+#define TST_SERIAL "emulator-5554"
+// what the client cuts push data into
+#define TST_SYNC_DATA_MAX (64 * 1024)
+#define TST_S_IFDIR 0040000
+
+// speaks the adb server side of the smart socket protocol, one handler call per request
+class MockAdbServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    // returns false once the connection left the request protocol (shell stream, sync)
+    std::function<bool(QTcpSocket *, const QByteArray &)> handler;
+    QList<QByteArray> requests;
+    // bytes the client sent after its last request
+    QByteArray streamed;
+    // same bytes per connection, the handler removes what it consumed
+    std::function<void(QTcpSocket *, QByteArray &)> streamHandler;
+
+    bool listen()
+    {
+        connect(&m_server, &QTcpServer::newConnection, this, &MockAdbServer::onNewConnection);
+        return m_server.listen(QHostAddress::LocalHost, 0);
+    }
+
+    quint16 port() const
+    {
+        return m_server.serverPort();
+    }
+
+    static void okay(QTcpSocket *socket)
+    {
+        socket->write("OKAY");
+    }
+
+    static void fail(QTcpSocket *socket, const QByteArray &message)
+    {
+        socket->write("FAIL" + QString("%1").arg(message.size(), 4, 16, QChar('0')).toLatin1() + message);
+    }
+
+    static void hostData(QTcpSocket *socket, const QByteArray &data)
+    {
+        socket->write(QString("%1").arg(data.size(), 4, 16, QChar('0')).toLatin1() + data);
+    }
+
+    static void shellPacket(QTcpSocket *socket, char id, const QByteArray &data)
+    {
+        char header[5];
+        header[0] = id;
+        qToLittleEndian<quint32>(static_cast<quint32>(data.size()), reinterpret_cast<uchar *>(header + 1));
+        socket->write(header, sizeof(header));
+        socket->write(data);
+    }
+
+    static void syncHeader(QTcpSocket *socket, const char *id, quint32 value)
+    {
+        char header[8];
+        memcpy(header, id, 4);
+        qToLittleEndian<quint32>(value, reinterpret_cast<uchar *>(header + 4));
+        socket->write(header, sizeof(header));
+    }
+
+private:
+    void onNewConnection()
+    {
+        while (m_server.hasPendingConnections()) {
+            QTcpSocket *socket = m_server.nextPendingConnection();
+            m_requestMode[socket] = true;
+            connect(socket, &QTcpSocket::readyRead, this, [this, socket]() { onReadyRead(socket); });
+            connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        }
+    }
+
+    void onReadyRead(QTcpSocket *socket)
+    {
+        QByteArray &buffer = m_buffers[socket];
+        buffer.append(socket->readAll());
+        while (m_requestMode.value(socket)) {
+            if (buffer.size() < 4) {
+                return;
+            }
+            int length = buffer.left(4).toInt(nullptr, 16);
+            if (buffer.size() < 4 + length) {
+                return;
+            }
+            QByteArray request = buffer.mid(4, length);
+            buffer.remove(0, 4 + length);
+            requests << request;
+            m_requestMode[socket] = handler(socket, request);
+        }
+        streamed.append(buffer);
+        if (streamHandler && !buffer.isEmpty()) {
+            QByteArray &stream = m_streams[socket];
+            stream.append(buffer);
+            streamHandler(socket, stream);
+        }
+        buffer.clear();
+    }
+
+private:
+    QTcpServer m_server;
+    QHash<QTcpSocket *, QByteArray> m_buffers;
+    QHash<QTcpSocket *, QByteArray> m_streams;
+    QHash<QTcpSocket *, bool> m_requestMode;
+};
+
+class TestAdbWireClient : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void shellExitZero();
+    void shellExitNonZero();
+    void shellCutOff();
+    void shellRefused();
+    void devices();
+    void forward();
+    void forwardFail();
+    void reverse();
+    void reverseFail();
+    void pushChunked();
+    void pushIntoDirectory();
+    void pushFail();
+    void serverUnreachable();
+
+private:
+    // transport switch, then the shell reply: stdout, stderr and an exit status (or none)
+    void serveShell(const QByteArray &out, const QByteArray &err, int exitCode);
+    // transport switch and sync:, then the device end of sync: STAT answered with
+    // remoteMode, DONE with OKAY or with FAIL and the failure text
+    void serveSync(quint32 remoteMode, const QByteArray &failure);
+    // a local file of the given size with a byte pattern that shows misordered chunks
+    static bool writePushFile(QTemporaryFile &file, int size, QByteArray &content);
+
+private:
+    QScopedPointer<MockAdbServer> m_server;
+    // sync packets the client sent: id and payload (empty for DONE and QUIT)
+    QList<QPair<QByteArray, QByteArray>> m_syncPackets;
+};
+
+void TestAdbWireClient::init()
+{
+    m_server.reset(new MockAdbServer);
+    QVERIFY(m_server->listen());
+    qputenv("ADB_SERVER_SOCKET", QString("tcp:%1").arg(m_server->port()).toLatin1());
+    m_syncPackets.clear();
+}
+
+void TestAdbWireClient::serveShell(const QByteArray &out, const QByteArray &err, int exitCode)
+{
+    m_server->handler = [out, err, exitCode](QTcpSocket *socket, const QByteArray &request) {
+        if (request.startsWith("host:transport")) {
+            MockAdbServer::okay(socket);
+            return true;
+        }
+        MockAdbServer::okay(socket);
+        if (!out.isEmpty()) {
+            MockAdbServer::shellPacket(socket, 1, out);
+        }
+        if (!err.isEmpty()) {
+            MockAdbServer::shellPacket(socket, 2, err);
+        }
+        if (exitCode >= 0) {
+            MockAdbServer::shellPacket(socket, 3, QByteArray(1, static_cast<char>(exitCode)));
+        } else {
+            socket->disconnectFromHost();
+        }
+        return false;
+    };
+}
+
+void TestAdbWireClient::serveSync(quint32 remoteMode, const QByteArray &failure)
+{
+    m_server->handler = [](QTcpSocket *socket, const QByteArray &request) {
+        MockAdbServer::okay(socket);
+        // sync: leaves the request protocol
+        return request.startsWith("host:transport");
+    };
+    m_server->streamHandler = [this, remoteMode, failure](QTcpSocket *socket, QByteArray &stream) {
+        while (8 <= stream.size()) {
+            QByteArray id = stream.left(4);
+            quint32 value = qFromLittleEndian<quint32>(reinterpret_cast<const uchar *>(stream.constData() + 4));
+            // DONE carries the mtime and QUIT nothing, the others a payload of that length
+            int payloadSize = ("DONE" == id || "QUIT" == id) ? 0 : static_cast<int>(value);
+            if (stream.size() < 8 + payloadSize) {
+                return;
+            }
+            m_syncPackets.append(qMakePair(id, stream.mid(8, payloadSize)));
+            stream.remove(0, 8 + payloadSize);
+
+            if ("STAT" == id) {
+                // mode, size, mtime
+                MockAdbServer::syncHeader(socket, "STAT", remoteMode);
+                char sizeAndTime[8] = {};
+                socket->write(sizeAndTime, sizeof(sizeAndTime));
+            } else if ("DONE" == id && failure.isEmpty()) {
+                MockAdbServer::syncHeader(socket, "OKAY", 0);
+            } else if ("DONE" == id) {
+                MockAdbServer::syncHeader(socket, "FAIL", static_cast<quint32>(failure.size()));
+                socket->write(failure);
+            }
+        }
+    };
+}
+
+bool TestAdbWireClient::writePushFile(QTemporaryFile &file, int size, QByteArray &content)
+{
+    content.resize(size);
+    for (int i = 0; i < size; i++) {
+        content[i] = static_cast<char>((i * 131 + i / TST_SYNC_DATA_MAX) & 0xff);
+    }
+    if (!file.open() || file.write(content) != size) {
+        return false;
+    }
+    file.close();
+    return true;
+}
+
+void TestAdbWireClient::shellExitZero()
+{
+    serveShell("hello\n", "", 0);
+
+    AdbWireClient client;
+    QSignalSpy finished(&client, &AdbWireClient::finished);
+    QSignalSpy output(&client, &AdbWireClient::standardOutput);
+    QVERIFY(client.start(TST_SERIAL, QStringList() << "shell"
+                                                   << "echo"
+                                                   << "hello"));
+    QVERIFY(finished.wait(TST_TIMEOUT_MS));
+
+    QCOMPARE(finished.at(0).at(0).toBool(), true);
+    QCOMPARE(output.size(), 1);
+    QCOMPARE(output.at(0).at(0).toByteArray(), QByteArray("hello\n"));
+    QCOMPARE(m_server->requests.size(), 2);
+    QCOMPARE(m_server->requests.at(0), QByteArray("host:transport:" TST_SERIAL));
+    QCOMPARE(m_server->requests.at(1), QByteArray("shell,v2,raw:echo hello"));
+    // stdin is closed right away: id 4, empty payload
+    QTRY_COMPARE(m_server->streamed, QByteArray("\x04\x00\x00\x00\x00", 5));
+}
+
+void TestAdbWireClient::shellExitNonZero()
+{
+    serveShell("", "ls: /nope: No such file or directory\n", 1);
+
+    AdbWireClient client;
+    QSignalSpy finished(&client, &AdbWireClient::finished);
+    QSignalSpy errors(&client, &AdbWireClient::errorOutput);
+    QVERIFY(client.start(TST_SERIAL, QStringList() << "shell"
+                                                   << "ls"
+                                                   << "/nope"));
+    QVERIFY(finished.wait(TST_TIMEOUT_MS));
+
+    QCOMPARE(finished.size(), 1);
+    QCOMPARE(finished.at(0).at(0).toBool(), false);
+    QCOMPARE(errors.size(), 1);
+    QVERIFY(errors.at(0).at(0).toString().contains("No such file"));
+}
+
+void TestAdbWireClient::shellCutOff()
+{
+    serveShell("partial", "", -1);
+
+    AdbWireClient client;
+    QSignalSpy finished(&client, &AdbWireClient::finished);
+    QVERIFY(client.start(TST_SERIAL, QStringList() << "shell"
+                                                   << "logcat"));
+    QVERIFY(finished.wait(TST_TIMEOUT_MS));
+
+    QCOMPARE(finished.size(), 1);
+    QCOMPARE(finished.at(0).at(0).toBool(), false);
+}
+
+void TestAdbWireClient::shellRefused()
+{
+    // a device without shell_v2
+    m_server->handler = [](QTcpSocket *socket, const QByteArray &request) {
+        if (request.startsWith("host:transport")) {
+            MockAdbServer::okay(socket);
+            return true;
+        }
+        MockAdbServer::fail(socket, "closed");
+        socket->disconnectFromHost();
+        return false;
+    };
+
+    AdbWireClient client;
+    QSignalSpy finished(&client, &AdbWireClient::finished);
+    QSignalSpy unreachable(&client, &AdbWireClient::unreachable);
+    QVERIFY(client.start(TST_SERIAL, QStringList() << "shell"
+                                                   << "true"));
+    QVERIFY(unreachable.wait(TST_TIMEOUT_MS));
+
+    QTest::qWait(100);
+    QCOMPARE(finished.size(), 0);
+    QVERIFY(!client.isActive());
+}
+
+void TestAdbWireClient::devices()
+{
+    QByteArray list = TST_SERIAL "\tdevice\n";
+    m_server->handler = [list](QTcpSocket *socket, const QByteArray &request) {
+        MockAdbServer::okay(socket);
+        MockAdbServer::hostData(socket, list);
+        return false;
+    };
+
+    AdbWireClient client;
+    QSignalSpy finished(&client, &AdbWireClient::finished);
+    QSignalSpy output(&client, &AdbWireClient::standardOutput);
+    QVERIFY(client.start("", QStringList() << "devices"));
+    QVERIFY(finished.wait(TST_TIMEOUT_MS));
+
+    QCOMPARE(finished.at(0).at(0).toBool(), true);
+    QCOMPARE(m_server->requests.at(0), QByteArray("host:devices"));
+    QCOMPARE(output.at(0).at(0).toByteArray(), list);
+}
+
+void TestAdbWireClient::forward()
+{
+    m_server->handler = [](QTcpSocket *socket, const QByteArray &request) {
+        MockAdbServer::okay(socket);
+        MockAdbServer::okay(socket);
+        return false;
+    };
+
+    AdbWireClient client;
+    QSignalSpy finished(&client, &AdbWireClient::finished);
+    QVERIFY(client.start(TST_SERIAL, QStringList() << "forward"
+                                                   << "tcp:27183"
+                                                   << "localabstract:scrcpy"));
+    QVERIFY(finished.wait(TST_TIMEOUT_MS));
+
+    QCOMPARE(finished.at(0).at(0).toBool(), true);
+    QCOMPARE(m_server->requests.at(0), QByteArray("host-serial:" TST_SERIAL ":forward:tcp:27183;localabstract:scrcpy"));
+}
+
+void TestAdbWireClient::forwardFail()
+{
+    m_server->handler = [](QTcpSocket *socket, const QByteArray &request) {
+        MockAdbServer::okay(socket);
+        MockAdbServer::fail(socket, "cannot bind listener");
+        return false;
+    };
+
+    AdbWireClient client;
+    QSignalSpy finished(&client, &AdbWireClient::finished);
+    QSignalSpy errors(&client, &AdbWireClient::errorOutput);
+    QVERIFY(client.start(TST_SERIAL, QStringList() << "forward"
+                                                   << "tcp:27183"
+                                                   << "localabstract:scrcpy"));
+    QVERIFY(finished.wait(TST_TIMEOUT_MS));
+
+    QCOMPARE(finished.at(0).at(0).toBool(), false);
+    QCOMPARE(errors.at(0).at(0).toString(), QString("cannot bind listener"));
+}
+
+void TestAdbWireClient::reverse()
+{
+    m_server->handler = [](QTcpSocket *socket, const QByteArray &request) {
+        MockAdbServer::okay(socket);
+        if (request.startsWith("host:transport")) {
+            return true;
+        }
+        MockAdbServer::okay(socket);
+        return false;
+    };
+
+    AdbWireClient client;
+    QSignalSpy finished(&client, &AdbWireClient::finished);
+    QVERIFY(client.start(TST_SERIAL, QStringList() << "reverse"
+                                                   << "localabstract:scrcpy"
+                                                   << "tcp:27183"));
+    QVERIFY(finished.wait(TST_TIMEOUT_MS));
+
+    QCOMPARE(finished.at(0).at(0).toBool(), true);
+    QCOMPARE(m_server->requests.size(), 2);
+    QCOMPARE(m_server->requests.at(0), QByteArray("host:transport:" TST_SERIAL));
+    QCOMPARE(m_server->requests.at(1), QByteArray("reverse:forward:localabstract:scrcpy;tcp:27183"));
+}
+
+void TestAdbWireClient::reverseFail()
+{
+    m_server->handler = [](QTcpSocket *socket, const QByteArray &request) {
+        MockAdbServer::okay(socket);
+        if (request.startsWith("host:transport")) {
+            return true;
+        }
+        MockAdbServer::fail(socket, "listener 'localabstract:scrcpy' not found");
+        return false;
+    };
+
+    AdbWireClient client;
+    QSignalSpy finished(&client, &AdbWireClient::finished);
+    QSignalSpy errors(&client, &AdbWireClient::errorOutput);
+    QVERIFY(client.start(TST_SERIAL, QStringList() << "reverse"
+                                                   << "--remove"
+                                                   << "localabstract:scrcpy"));
+    QVERIFY(finished.wait(TST_TIMEOUT_MS));
+
+    QCOMPARE(finished.at(0).at(0).toBool(), false);
+    QCOMPARE(m_server->requests.at(1), QByteArray("reverse:killforward:localabstract:scrcpy"));
+    QCOMPARE(errors.at(0).at(0).toString(), QString("listener 'localabstract:scrcpy' not found"));
+}
+
+void TestAdbWireClient::pushChunked()
+{
+    // two full chunks and a short one
+    QTemporaryFile file;
+    QByteArray content;
+    QVERIFY(writePushFile(file, 2 * TST_SYNC_DATA_MAX + 1000, content));
+    serveSync(0, "");
+
+    AdbWireClient client;
+    QSignalSpy finished(&client, &AdbWireClient::finished);
+    QVERIFY(client.start(TST_SERIAL, QStringList() << "push" << file.fileName() << "/data/local/tmp/scrcpy-server.jar"));
+    QVERIFY(finished.wait(TST_TIMEOUT_MS));
+    QCOMPARE(finished.at(0).at(0).toBool(), true);
+    QTRY_COMPARE(m_syncPackets.last().first, QByteArray("QUIT"));
+
+    QCOMPARE(m_server->requests.size(), 2);
+    QCOMPARE(m_server->requests.at(0), QByteArray("host:transport:" TST_SERIAL));
+    QCOMPARE(m_server->requests.at(1), QByteArray("sync:"));
+    // STAT, SEND, DATA x3, DONE, QUIT
+    QCOMPARE(m_syncPackets.size(), 7);
+    QCOMPARE(m_syncPackets.at(0).first, QByteArray("STAT"));
+    QCOMPARE(m_syncPackets.at(0).second, QByteArray("/data/local/tmp/scrcpy-server.jar"));
+    QCOMPARE(m_syncPackets.at(1).first, QByteArray("SEND"));
+    // path and decimal mode 0100644
+    QCOMPARE(m_syncPackets.at(1).second, QByteArray("/data/local/tmp/scrcpy-server.jar,33188"));
+    QByteArray pushed;
+    for (int i = 2; i < 5; i++) {
+        QCOMPARE(m_syncPackets.at(i).first, QByteArray("DATA"));
+        QVERIFY(m_syncPackets.at(i).second.size() <= TST_SYNC_DATA_MAX);
+        pushed += m_syncPackets.at(i).second;
+    }
+    QCOMPARE(m_syncPackets.at(2).second.size(), TST_SYNC_DATA_MAX);
+    QCOMPARE(pushed, content);
+    QCOMPARE(m_syncPackets.at(5).first, QByteArray("DONE"));
+}
+
+void TestAdbWireClient::pushIntoDirectory()
+{
+    QTemporaryFile file;
+    QByteArray content;
+    QVERIFY(writePushFile(file, 100, content));
+    serveSync(TST_S_IFDIR | 0755, "");
+
+    AdbWireClient client;
+    QSignalSpy finished(&client, &AdbWireClient::finished);
+    QVERIFY(client.start(TST_SERIAL, QStringList() << "push" << file.fileName() << "/sdcard"));
+    QVERIFY(finished.wait(TST_TIMEOUT_MS));
+
+    QCOMPARE(finished.at(0).at(0).toBool(), true);
+    QCOMPARE(m_syncPackets.at(1).first, QByteArray("SEND"));
+    QCOMPARE(m_syncPackets.at(1).second, ("/sdcard/" + QFileInfo(file.fileName()).fileName() + ",33188").toUtf8());
+    QCOMPARE(m_syncPackets.at(2).second, content);
+}
+
+void TestAdbWireClient::pushFail()
+{
+    QTemporaryFile file;
+    QByteArray content;
+    QVERIFY(writePushFile(file, TST_SYNC_DATA_MAX + 1, content));
+    serveSync(0, "No space left on device");
+
+    AdbWireClient client;
+    QSignalSpy finished(&client, &AdbWireClient::finished);
+    QSignalSpy errors(&client, &AdbWireClient::errorOutput);
+    QVERIFY(client.start(TST_SERIAL, QStringList() << "push" << file.fileName() << "/data/local/tmp/scrcpy-server.jar"));
+    QVERIFY(finished.wait(TST_TIMEOUT_MS));
+
+    QCOMPARE(finished.size(), 1);
+    QCOMPARE(finished.at(0).at(0).toBool(), false);
+    QCOMPARE(errors.size(), 1);
+    QVERIFY(errors.at(0).at(0).toString().contains("No space left on device"));
+    // no QUIT after a failure
+    QCOMPARE(m_syncPackets.last().first, QByteArray("DONE"));
+}
+
+void TestAdbWireClient::serverUnreachable()
+{
+    quint16 port = m_server->port();
+    m_server.reset();
+    qputenv("ADB_SERVER_SOCKET", QString("tcp:%1").arg(port).toLatin1());
+
+    AdbWireClient client;
+    QSignalSpy unreachable(&client, &AdbWireClient::unreachable);
+    QVERIFY(client.start("", QStringList() << "devices"));
+    QVERIFY(unreachable.wait(TST_TIMEOUT_MS));
+}
+
+QTEST_GUILESS_MAIN(TestAdbWireClient)
+
+#include "tst_adbwireclient.moc"
@@ -0,0 +1,182 @@
+#include <algorithm>
+
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QMutex>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QThread>
+#include <QTimer>
+#include <QtTest>
+
+#include "audiojitterbuffer.h"
+#include "audiostreamdecoder.h"
+
+// the sndcpy format
+#define TST_SAMPLE_RATE 48000
+#define TST_CHANNELS 2
+#define TST_FRAME_BYTES (TST_CHANNELS * 2)
+// the source writes and the sink pulls 10ms at a time, like sndcpy and the audio sink
+#define TST_PERIOD_FRAMES 480
+#define TST_PERIOD_MS 10
+// a 1ms click every 250ms (a whole number of periods), silence in between
+#define TST_CLICK_EVERY_FRAMES 12000
+#define TST_CLICK_FRAMES 48
+#define TST_CLICK_LEVEL 30000
+#define TST_DETECT_LEVEL 10000
+#define TST_DURATION_MS 4000
+// the first clicks land while the buffer fills up to its target
+#define TST_WARMUP_CLICKS 2
+#define TST_MAX_MEDIAN_MS 150
+
+// the device end: writes paced pcm to a local socket and notes when each click went out
+class PcmSource : public QThread
+{
+public:
+    PcmSource(quint16 port, const QElapsedTimer &clock) : m_port(port), m_clock(clock) {}
+
+    QVector<qint64> clickUs()
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_clickUs;
+    }
+
+protected:
+    void run() override
+    {
+        QTcpSocket socket;
+        socket.connectToHost(QHostAddress::LocalHost, m_port);
+        if (!socket.waitForConnected(1000)) {
+            return;
+        }
+
+        QByteArray period(TST_PERIOD_FRAMES * TST_FRAME_BYTES, '\0');
+        qint64 startUs = m_clock.nsecsElapsed() / 1000;
+        qint64 frame = 0;
+        for (int i = 0; i * TST_PERIOD_MS < TST_DURATION_MS; i++) {
+            qint64 dueUs = startUs + static_cast<qint64>(i) * TST_PERIOD_MS * 1000;
+            qint64 nowUs = m_clock.nsecsElapsed() / 1000;
+            if (dueUs > nowUs) {
+                QThread::usleep(static_cast<unsigned long>(dueUs - nowUs));
+            }
+
+            bool click = 0 == frame % TST_CLICK_EVERY_FRAMES;
+            qint16 *samples = reinterpret_cast<qint16 *>(period.data());
+            for (int f = 0; f < TST_PERIOD_FRAMES; f++) {
+                qint16 value = click && f < TST_CLICK_FRAMES ? TST_CLICK_LEVEL : 0;
+                for (int c = 0; c < TST_CHANNELS; c++) {
+                    samples[f * TST_CHANNELS + c] = value;
+                }
+            }
+            if (click) {
+                QMutexLocker locker(&m_mutex);
+                m_clickUs.append(m_clock.nsecsElapsed() / 1000);
+            }
+            socket.write(period);
+            socket.waitForBytesWritten(TST_PERIOD_MS);
+            frame += TST_PERIOD_FRAMES;
+        }
+        socket.flush();
+        socket.waitForBytesWritten(100);
+        socket.disconnectFromHost();
+    }
+
+private:
+    const quint16 m_port;
+    const QElapsedTimer &m_clock;
+    QMutex m_mutex;
+    QVector<qint64> m_clickUs;
+};
+
+// End-to-end latency of the host audio path: pcm written to a local socket goes
+// through AudioStreamDecoder and AudioJitterBuffer, a paced sink pulls it out the
+// way the audio sink does. A click is timed from the source write to the sink
+// read; the sink's own device buffer comes on top of this.
+class TestAudioLatency : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void endToEndLatency();
+};
+
+void TestAudioLatency::endToEndLatency()
+{
+    QElapsedTimer clock;
+    clock.start();
+
+    AudioJitterBuffer buffer(TST_SAMPLE_RATE, TST_CHANNELS);
+    QVERIFY(buffer.init());
+    AudioStreamDecoder decoder(TST_SAMPLE_RATE, TST_CHANNELS);
+    AudioStreamDecoder::PcmSink sink = [&buffer](const char *pcm, int size) { buffer.write(pcm, size); };
+
+    QTcpServer server;
+    QVERIFY(server.listen(QHostAddress::LocalHost, 0));
+    QTcpSocket *socket = nullptr;
+    char recvBuffer[16384];
+    connect(&server, &QTcpServer::newConnection, this, [&]() {
+        socket = server.nextPendingConnection();
+        connect(socket, &QIODevice::readyRead, this, [&]() {
+            qint64 count = 0;
+            while (0 < (count = socket->read(recvBuffer, sizeof(recvBuffer)))) {
+                decoder.decode(recvBuffer, static_cast<int>(count), sink);
+            }
+        });
+    });
+
+    // the sink: one period per tick, a click counts at the position of its first frame
+    QVector<qint64> heardUs;
+    bool inClick = false;
+    QByteArray pulled(TST_PERIOD_FRAMES * TST_FRAME_BYTES, '\0');
+    QTimer pull;
+    pull.setTimerType(Qt::PreciseTimer);
+    pull.setInterval(TST_PERIOD_MS);
+    connect(&pull, &QTimer::timeout, this, [&]() {
+        qint64 readUs = clock.nsecsElapsed() / 1000;
+        int size = buffer.read(pulled.data(), pulled.size());
+        const qint16 *samples = reinterpret_cast<const qint16 *>(pulled.constData());
+        for (int f = 0; f < size / TST_FRAME_BYTES; f++) {
+            bool loud = TST_DETECT_LEVEL < qAbs(static_cast<int>(samples[f * TST_CHANNELS]));
+            if (loud && !inClick) {
+                heardUs.append(readUs + static_cast<qint64>(f) * 1000000 / TST_SAMPLE_RATE);
+            }
+            inClick = loud;
+        }
+    });
+
+    PcmSource source(server.serverPort(), clock);
+    QEventLoop loop;
+    connect(&source, &QThread::finished, &loop, [&loop]() {
+        // let the buffer play out
+        QTimer::singleShot(500, &loop, &QEventLoop::quit);
+    });
+    pull.start();
+    source.start();
+    loop.exec();
+    pull.stop();
+    source.wait();
+
+    QVector<qint64> clickUs = source.clickUs();
+    QVERIFY(TST_WARMUP_CLICKS < clickUs.size());
+    QCOMPARE(heardUs.size(), clickUs.size());
+
+    QVector<double> latencyMs;
+    for (int i = TST_WARMUP_CLICKS; i < clickUs.size(); i++) {
+        latencyMs.append((heardUs[i] - clickUs[i]) / 1000.0);
+    }
+    std::sort(latencyMs.begin(), latencyMs.end());
+    double medianMs = latencyMs[latencyMs.size() / 2];
+
+    AudioJitterStats stats;
+    buffer.getStats(stats);
+    qInfo("latency min %.1fms median %.1fms max %.1fms, buffer target %ums jitter %ums underruns %u", latencyMs.first(), medianMs, latencyMs.last(),
+          stats.targetMs, stats.jitterMs, stats.underruns);
+    QTest::setBenchmarkResult(medianMs, QTest::WalltimeMilliseconds);
+
+    QVERIFY(0.0 <= latencyMs.first());
+    QVERIFY2(medianMs < TST_MAX_MEDIAN_MS, qPrintable(QString("median latency %1ms").arg(medianMs)));
+}
+
+QTEST_GUILESS_MAIN(TestAudioLatency)
+
+#include "tst_audiolatency.moc"
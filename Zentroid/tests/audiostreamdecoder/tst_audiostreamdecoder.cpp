@@ -0,0 +1,194 @@
+#include <QSignalSpy>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QtEndian>
+#include <QtTest>
+
+#include "audiostreamdecoder.h"
+
+#define TST_TIMEOUT_MS 5000
+#define TST_SAMPLE_RATE 48000
+#define TST_CHANNELS 2
+#define TST_BIT_RATE 64000
+#define TST_PACKETS 50
+// 20ms per opus packet
+#define TST_PACKET_FRAMES 960
+// small reads split headers, lengths and packets across calls like a slow socket does
+#define TST_READ_SIZE 7
+
+namespace {
+
+void appendBe32(QByteArray &data, quint32 value)
+{
+    char buffer[4];
+    qToBigEndian(value, buffer);
+    data.append(buffer, 4);
+}
+
+// what a device side that understood the request sends: header, then length prefixed opus
+QByteArray opusStream(int sampleRate, int channels, int packets)
+{
+    // celt fullband 20ms stereo, the range coder reads the silence flag: a complete silent frame
+    static const char silentPacket[] = { '\xfc', '\xff', '\xfe' };
+
+    QByteArray stream("ZAUD");
+    appendBe32(stream, 0x6f707573); // "opus"
+    appendBe32(stream, static_cast<quint32>(sampleRate));
+    appendBe32(stream, static_cast<quint32>(channels));
+    for (int i = 0; i < packets; i++) {
+        appendBe32(stream, sizeof(silentPacket));
+        stream.append(silentPacket, sizeof(silentPacket));
+    }
+    return stream;
+}
+
+}
+
+// the device end of the audio forward: waits for the codec request, answers with a canned stream
+class LoopbackDevice : public QObject
+{
+    Q_OBJECT
+
+public:
+    QByteArray request;
+
+    bool listen(const QByteArray &reply, int requestSize)
+    {
+        m_reply = reply;
+        m_requestSize = requestSize;
+        connect(&m_server, &QTcpServer::newConnection, this, &LoopbackDevice::onNewConnection);
+        return m_server.listen(QHostAddress::LocalHost, 0);
+    }
+
+    quint16 port() const
+    {
+        return m_server.serverPort();
+    }
+
+private:
+    void onNewConnection()
+    {
+        QTcpSocket *socket = m_server.nextPendingConnection();
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        if (0 == m_requestSize) {
+            // stock sndcpy: pcm from the first byte, the request is never read
+            socket->write(m_reply);
+            socket->disconnectFromHost();
+            return;
+        }
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() {
+            request.append(socket->readAll());
+            if (request.size() < m_requestSize) {
+                return;
+            }
+            socket->write(m_reply);
+            socket->disconnectFromHost();
+        });
+    }
+
+private:
+    QTcpServer m_server;
+    QByteArray m_reply;
+    int m_requestSize = 0;
+};
+
+class TestAudioStreamDecoder : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void opusLoopback();
+    void rawPcmLoopback();
+    void unknownCodec();
+
+private:
+    // connects to the device, sends the request and decodes everything it answers
+    bool receive(LoopbackDevice &device, const QByteArray &codecRequest, QByteArray &pcm, bool &compressed);
+};
+
+bool TestAudioStreamDecoder::receive(LoopbackDevice &device, const QByteArray &codecRequest, QByteArray &pcm, bool &compressed)
+{
+    AudioStreamDecoder decoder(TST_SAMPLE_RATE, TST_CHANNELS);
+    AudioStreamDecoder::PcmSink sink = [&pcm](const char *data, int size) { pcm.append(data, size); };
+    bool ok = true;
+
+    QTcpSocket socket;
+    connect(&socket, &QIODevice::readyRead, this, [&socket, &decoder, &sink, &ok]() {
+        char buffer[TST_READ_SIZE];
+        qint64 count = 0;
+        while (ok && 0 < (count = socket.read(buffer, sizeof(buffer)))) {
+            ok = decoder.decode(buffer, static_cast<int>(count), sink);
+        }
+    });
+    QSignalSpy closed(&socket, &QTcpSocket::disconnected);
+    socket.connectToHost(QHostAddress::LocalHost, device.port());
+    if (!socket.waitForConnected(TST_TIMEOUT_MS)) {
+        return false;
+    }
+    socket.write(codecRequest);
+    if (!closed.wait(TST_TIMEOUT_MS)) {
+        return false;
+    }
+    compressed = decoder.isCompressed();
+    return ok;
+}
+
+void TestAudioStreamDecoder::opusLoopback()
+{
+    if (!AudioStreamDecoder::canDecodeOpus()) {
+        QSKIP("this libavcodec has no opus decoder");
+    }
+
+    QByteArray codecRequest = AudioStreamDecoder::opusRequest(TST_BIT_RATE);
+    LoopbackDevice device;
+    QVERIFY(device.listen(opusStream(TST_SAMPLE_RATE, TST_CHANNELS, TST_PACKETS), codecRequest.size()));
+
+    QByteArray pcm;
+    bool compressed = false;
+    QVERIFY(receive(device, codecRequest, pcm, compressed));
+
+    QCOMPARE(device.request, codecRequest);
+    QVERIFY(compressed);
+    // every packet decodes to 20ms, the decoder may still hold back the last one
+    int packetBytes = TST_PACKET_FRAMES * TST_CHANNELS * 2;
+    QVERIFY(pcm.size() >= (TST_PACKETS - 1) * packetBytes);
+    QVERIFY(pcm.size() <= TST_PACKETS * packetBytes);
+    QCOMPARE(pcm.size() % (TST_CHANNELS * 2), 0);
+    QCOMPARE(pcm.count('\0'), pcm.size());
+}
+
+void TestAudioStreamDecoder::rawPcmLoopback()
+{
+    QByteArray source;
+    for (int i = 0; i < TST_PACKET_FRAMES * TST_CHANNELS; i++) {
+        qint16 sample = static_cast<qint16>((i * 97) % 20000 - 10000);
+        source.append(reinterpret_cast<const char *>(&sample), sizeof(sample));
+    }
+    LoopbackDevice device;
+    QVERIFY(device.listen(source, 0));
+
+    QByteArray pcm;
+    bool compressed = true;
+    QVERIFY(receive(device, AudioStreamDecoder::opusRequest(TST_BIT_RATE), pcm, compressed));
+
+    QVERIFY(!compressed);
+    QCOMPARE(pcm, source);
+}
+
+void TestAudioStreamDecoder::unknownCodec()
+{
+    QByteArray codecRequest = AudioStreamDecoder::opusRequest(TST_BIT_RATE);
+    QByteArray stream = opusStream(TST_SAMPLE_RATE, TST_CHANNELS, 1);
+    stream.replace(4, 4, "flac");
+    LoopbackDevice device;
+    QVERIFY(device.listen(stream, codecRequest.size()));
+
+    QByteArray pcm;
+    bool compressed = false;
+    QVERIFY(!receive(device, codecRequest, pcm, compressed));
+    QVERIFY(pcm.isEmpty());
+}
+
+QTEST_GUILESS_MAIN(TestAudioStreamDecoder)
+
+#include "tst_audiostreamdecoder.moc"
@@ -0,0 +1,165 @@
+#include <QDataStream>
+#include <QFile>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include "inputrecorder.h"
+#include "inputreplayer.h"
+
+// the view shows the frame at half size, recorded positions double on the device
+#define TST_FRAME_W 1080
+#define TST_FRAME_H 1920
+#define TST_SHOW_W 540
+#define TST_SHOW_H 960
+// recorded between the drag and the key, a non-realtime replay must not wait for it
+#define TST_PAUSE_MS 300
+
+// scrcpy control protocol, see ControlMsg::serializeData
+#define TST_TYPE_INJECT_KEYCODE 0
+#define TST_TYPE_INJECT_TOUCH 2
+#define TST_ACTION_DOWN 0
+#define TST_ACTION_UP 1
+#define TST_ACTION_MOVE 2
+#define TST_POINTER_ID_GENERIC_FINGER static_cast<quint64>(-2)
+#define TST_BUTTON_PRIMARY 1
+#define TST_AKEYCODE_ENTER 66
+#define TST_INJECT_TOUCH_SIZE 32
+#define TST_INJECT_KEYCODE_SIZE 14
+
+// Records a short session with InputRecorder and replays it through InputReplayer
+// without the recorded timing. The replayer hands the Controller a send function
+// that appends to a buffer, so that buffer stands in for the control socket: it
+// holds exactly the bytes a device would have read, one send per message.
+class TestInputReplayer : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void replayNormalMapping();
+    void replayMissingFile();
+
+private:
+    static QByteArray touch(quint8 action, const QPoint &pos, bool pressed, quint32 actionButton, quint32 buttons);
+    static QByteArray keycode(quint8 action, quint32 keycode);
+    void recordSession(const QString &fileName);
+
+private:
+    QTemporaryDir m_dir;
+};
+
+void TestInputReplayer::initTestCase()
+{
+    QVERIFY(m_dir.isValid());
+}
+
+QByteArray TestInputReplayer::touch(quint8 action, const QPoint &pos, bool pressed, quint32 actionButton, quint32 buttons)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::BigEndian);
+    stream << static_cast<quint8>(TST_TYPE_INJECT_TOUCH) << action << TST_POINTER_ID_GENERIC_FINGER;
+    stream << static_cast<qint32>(pos.x()) << static_cast<qint32>(pos.y()) << static_cast<quint16>(TST_FRAME_W) << static_cast<quint16>(TST_FRAME_H);
+    stream << static_cast<quint16>(pressed ? 0xffff : 0) << actionButton << buttons;
+    return data;
+}
+
+QByteArray TestInputReplayer::keycode(quint8 action, quint32 keycode)
+{
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream.setByteOrder(QDataStream::BigEndian);
+    // repeat 0, no meta state
+    stream << static_cast<quint8>(TST_TYPE_INJECT_KEYCODE) << action << keycode << static_cast<quint32>(0) << static_cast<quint32>(0);
+    return data;
+}
+
+void TestInputReplayer::recordSession(const QString &fileName)
+{
+    const QSize frameSize(TST_FRAME_W, TST_FRAME_H);
+    const QSize showSize(TST_SHOW_W, TST_SHOW_H);
+
+    InputRecorder recorder;
+    QVERIFY(recorder.open(fileName));
+
+    // a drag, a hover the normal mapping drops, then enter
+    QMouseEvent press(QEvent::MouseButtonPress, QPointF(100, 50), QPointF(100, 50), Qt::LeftButton, Qt::LeftButton, Qt::NoModifier);
+    recorder.recordMouse(&press, frameSize, showSize);
+    QMouseEvent move(QEvent::MouseMove, QPointF(110, 60), QPointF(110, 60), Qt::NoButton, Qt::LeftButton, Qt::NoModifier);
+    recorder.recordMouse(&move, frameSize, showSize);
+    QMouseEvent release(QEvent::MouseButtonRelease, QPointF(110, 60), QPointF(110, 60), Qt::LeftButton, Qt::NoButton, Qt::NoModifier);
+    recorder.recordMouse(&release, frameSize, showSize);
+    QMouseEvent hover(QEvent::MouseMove, QPointF(200, 200), QPointF(200, 200), Qt::NoButton, Qt::NoButton, Qt::NoModifier);
+    recorder.recordMouse(&hover, frameSize, showSize);
+
+    QTest::qSleep(TST_PAUSE_MS);
+
+    QKeyEvent keyPress(QEvent::KeyPress, Qt::Key_Return, Qt::NoModifier, "\r");
+    recorder.recordKey(&keyPress, frameSize, showSize);
+    QKeyEvent keyRelease(QEvent::KeyRelease, Qt::Key_Return, Qt::NoModifier, "\r");
+    recorder.recordKey(&keyRelease, frameSize, showSize);
+    recorder.close();
+}
+
+void TestInputReplayer::replayNormalMapping()
+{
+    QString recordFile = m_dir.filePath("session.zinr");
+    QString dumpFile = m_dir.filePath("control.bin");
+    recordSession(recordFile);
+    if (QTest::currentTestFailed()) {
+        return;
+    }
+
+    qsc::InputReplayParams params;
+    params.recordFile = recordFile;
+    params.realtime = false;
+    params.controlDumpFile = dumpFile;
+
+    InputReplayer replayer;
+    qsc::InputReplayStats stats;
+    QVERIFY(replayer.replay(params, stats));
+
+    QCOMPARE(stats.mouseEvents, 4u);
+    QCOMPARE(stats.wheelEvents, 0u);
+    QCOMPARE(stats.keyEvents, 2u);
+    // the hover sends nothing
+    QCOMPARE(stats.controlMsgs, 5u);
+    QCOMPARE(stats.controlBytes, static_cast<quint64>(3 * TST_INJECT_TOUCH_SIZE + 2 * TST_INJECT_KEYCODE_SIZE));
+
+    QByteArray expected;
+    expected += touch(TST_ACTION_DOWN, QPoint(200, 100), true, TST_BUTTON_PRIMARY, TST_BUTTON_PRIMARY);
+    expected += touch(TST_ACTION_MOVE, QPoint(220, 120), false, 0, TST_BUTTON_PRIMARY);
+    expected += touch(TST_ACTION_UP, QPoint(220, 120), false, TST_BUTTON_PRIMARY, 0);
+    expected += keycode(TST_ACTION_DOWN, TST_AKEYCODE_ENTER);
+    expected += keycode(TST_ACTION_UP, TST_AKEYCODE_ENTER);
+    QCOMPARE(expected.size(), 3 * TST_INJECT_TOUCH_SIZE + 2 * TST_INJECT_KEYCODE_SIZE);
+    QCOMPARE(replayer.controlStream().toHex(), expected.toHex());
+
+    QFile dump(dumpFile);
+    QVERIFY(dump.open(QIODevice::ReadOnly));
+    QCOMPARE(dump.readAll(), expected);
+
+    // the recorded pause is in the file but the replay fed the events back to back
+    QVERIFY(TST_PAUSE_MS * 1000 <= stats.recordedTimeUs);
+    QVERIFY2(stats.wallTimeUs < stats.recordedTimeUs, qPrintable(QString("replay took %1us").arg(stats.wallTimeUs)));
+    QVERIFY(stats.latencyMinUs <= stats.latencyAvgUs && stats.latencyAvgUs <= stats.latencyMaxUs);
+}
+
+void TestInputReplayer::replayMissingFile()
+{
+    qsc::InputReplayParams params;
+    params.recordFile = m_dir.filePath("missing.zinr");
+    params.realtime = false;
+
+    InputReplayer replayer;
+    qsc::InputReplayStats stats;
+    QVERIFY(!replayer.replay(params, stats));
+    QCOMPARE(stats.controlMsgs, 0u);
+    QVERIFY(replayer.controlStream().isEmpty());
+}
+
+QTEST_GUILESS_MAIN(TestInputReplayer)
+
+#include "tst_inputreplayer.moc"
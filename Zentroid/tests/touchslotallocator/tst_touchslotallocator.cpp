@@ -0,0 +1,198 @@
+#include <algorithm>
+
+#include <QHash>
+#include <QList>
+#include <QRandomGenerator>
+#include <QtTest>
+
+#include "touchslotallocator.h"
+
+#define TST_SEED 0x5eed
+#define TST_ROUNDS 20000
+// keys pressed at once in one chord, more than any capacity so chords overflow
+#define TST_MAX_CHORD 80
+#define TST_KEYS 128
+
+class TestTouchSlotAllocator : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void fillEveryCapacity();
+    void repeatedPressOwnsSeveralSlots();
+    void chordStress_data();
+    void chordStress();
+    void shrinkKeepsHeldSlots();
+
+private:
+    // what the allocator has to agree with: the slots every key holds
+    static bool checkModel(const TouchSlotAllocator &slots, const QHash<int, QList<int>> &held, QString &error);
+};
+
+bool TestTouchSlotAllocator::checkModel(const TouchSlotAllocator &slots, const QHash<int, QList<int>> &held, QString &error)
+{
+    quint64 seen = 0;
+    int count = 0;
+    for (auto it = held.constBegin(); it != held.constEnd(); ++it) {
+        int lowest = TOUCH_SLOT_MAX_NUM;
+        for (int slot : it.value()) {
+            quint64 bit = quint64(1) << slot;
+            if (seen & bit) {
+                error = QString("slot %1 handed out twice").arg(slot);
+                return false;
+            }
+            seen |= bit;
+            lowest = qMin(lowest, slot);
+            count++;
+        }
+        if (slots.get(it.key()) != lowest) {
+            error = QString("key %1 resolves to %2, expected %3").arg(it.key()).arg(slots.get(it.key())).arg(lowest);
+            return false;
+        }
+    }
+    if (slots.activeCount() != count) {
+        error = QString("%1 slots active, %2 held").arg(slots.activeCount()).arg(count);
+        return false;
+    }
+    return true;
+}
+
+void TestTouchSlotAllocator::fillEveryCapacity()
+{
+    for (int capacity = 1; capacity <= TOUCH_SLOT_MAX_NUM; capacity++) {
+        TouchSlotAllocator slots(capacity);
+        quint64 seen = 0;
+        for (int key = 0; key < capacity; key++) {
+            int slot = slots.attach(key);
+            QVERIFY(0 <= slot && slot < capacity);
+            QVERIFY(!(seen & (quint64(1) << slot)));
+            seen |= quint64(1) << slot;
+        }
+        QCOMPARE(slots.activeCount(), capacity);
+        QCOMPARE(slots.attach(capacity), -1);
+        QCOMPARE(slots.get(capacity), -1);
+
+        for (int key = 0; key < capacity; key++) {
+            QVERIFY(0 <= slots.detach(key));
+        }
+        QCOMPARE(slots.activeCount(), 0);
+        QCOMPARE(slots.detach(0), -1);
+    }
+}
+
+void TestTouchSlotAllocator::repeatedPressOwnsSeveralSlots()
+{
+    TouchSlotAllocator slots(10);
+    QCOMPARE(slots.attach(Qt::Key_A), 0);
+    QCOMPARE(slots.attach(Qt::Key_B), 1);
+    QCOMPARE(slots.attach(Qt::Key_A), 2);
+    QCOMPARE(slots.get(Qt::Key_A), 0);
+
+    QCOMPARE(slots.detach(Qt::Key_A), 0);
+    QCOMPARE(slots.get(Qt::Key_A), 2);
+    QCOMPARE(slots.detach(Qt::Key_A), 2);
+    QCOMPARE(slots.get(Qt::Key_A), -1);
+    QCOMPARE(slots.activeCount(), 1);
+}
+
+void TestTouchSlotAllocator::chordStress_data()
+{
+    QTest::addColumn<int>("capacity");
+    QTest::newRow("android default") << 10;
+    QTest::newRow("tablet") << 20;
+    QTest::newRow("all slots") << TOUCH_SLOT_MAX_NUM;
+}
+
+void TestTouchSlotAllocator::chordStress()
+{
+    QFETCH(int, capacity);
+    QRandomGenerator random(TST_SEED);
+    TouchSlotAllocator slots(capacity);
+    QHash<int, QList<int>> held;
+    int heldCount = 0;
+    int full = 0;
+    QString error;
+
+    for (int round = 0; round < TST_ROUNDS; round++) {
+        // a chord: keys pressed together, some of them already down (fast repeats)
+        int chord = random.bounded(1, TST_MAX_CHORD + 1);
+        for (int i = 0; i < chord; i++) {
+            int key = random.bounded(TST_KEYS);
+            int slot = slots.attach(key);
+            if (heldCount == capacity) {
+                QCOMPARE(slot, -1);
+                full++;
+                continue;
+            }
+            QVERIFY2(0 <= slot && slot < capacity, qPrintable(QString("round %1: slot %2").arg(round).arg(slot)));
+            held[key].append(slot);
+            heldCount++;
+        }
+        QVERIFY2(checkModel(slots, held, error), qPrintable(QString("round %1 after press: %2").arg(round).arg(error)));
+
+        // release part of the chord, or all of it so the allocator drains every now and then
+        bool releaseAll = 0 == random.bounded(8);
+        const QList<int> keys = held.keys();
+        for (int key : keys) {
+            if (!releaseAll && random.bounded(2)) {
+                continue;
+            }
+            QList<int> &owned = held[key];
+            int lowest = *std::min_element(owned.begin(), owned.end());
+            QCOMPARE(slots.detach(key), lowest);
+            owned.removeOne(lowest);
+            heldCount--;
+            if (owned.isEmpty()) {
+                held.remove(key);
+            }
+        }
+        QVERIFY2(checkModel(slots, held, error), qPrintable(QString("round %1 after release: %2").arg(round).arg(error)));
+        if (releaseAll) {
+            // a key that held several slots keeps the rest until released again
+            while (!held.isEmpty()) {
+                int key = held.constBegin().key();
+                QVERIFY(0 <= slots.detach(key));
+                held[key].removeFirst();
+                heldCount--;
+                if (held[key].isEmpty()) {
+                    held.remove(key);
+                }
+            }
+            QCOMPARE(heldCount, 0);
+            QCOMPARE(slots.activeCount(), 0);
+        }
+    }
+
+    // everything released: no slot leaked
+    for (auto it = held.constBegin(); it != held.constEnd(); ++it) {
+        for (int i = 0; i < it.value().size(); i++) {
+            QVERIFY(0 <= slots.detach(it.key()));
+        }
+    }
+    QCOMPARE(slots.activeCount(), 0);
+    for (int key = 0; key < TST_KEYS; key++) {
+        QCOMPARE(slots.get(key), -1);
+    }
+    // the chords were wide enough to run the allocator full
+    QVERIFY(0 < full);
+}
+
+void TestTouchSlotAllocator::shrinkKeepsHeldSlots()
+{
+    TouchSlotAllocator slots(20);
+    for (int key = 0; key < 15; key++) {
+        QCOMPARE(slots.attach(key), key);
+    }
+    slots.setCapacity(10);
+    QCOMPARE(slots.get(14), 14);
+    QCOMPARE(slots.attach(100), -1);
+
+    QCOMPARE(slots.detach(3), 3);
+    QCOMPARE(slots.attach(100), 3);
+    QCOMPARE(slots.detach(14), 14);
+    QCOMPARE(slots.activeCount(), 14);
+}
+
+QTEST_GUILESS_MAIN(TestTouchSlotAllocator)
+
+#include "tst_touchslotallocator.moc"
@@ -1,4 +1,5 @@
-﻿#include <QDebug>
+﻿#include <QApplication>
+#include <QDebug>
 #include <QFile>
 #include <QFileDialog>
 #include <QInputDialog>
@@ -42,6 +43,35 @@ Dialog::Dialog(QWidget *parent) : QWidget(parent), ui(new Ui::Widget), m_cleanWi
     // Log the canonical keymap directory at startup
     qInfo() << "[Keymap] Canonical keymap directory:" << getKeyMapPath();
     outLog("Keymap dir: " + getKeyMapPath(), false);
+    // compiled keymaps are cached next to their json sources
+    qsc::IDeviceManage::getInstance().setKeyMapCacheDir(getKeyMapPath() + "/.cache");
+    if (Config::getInstance().getMetricsPort()) {
+        qsc::IDeviceManage::getInstance().startMetricsServer(Config::getInstance().getMetricsPort());
+    }
+    quint32 bandwidthBudget = Config::getInstance().getBandwidthBudget();
+    double decodeBudget = Config::getInstance().getDecodeBudget();
+    if (bandwidthBudget || 0.0 < decodeBudget) {
+        qsc::IDeviceManage::getInstance().setStreamBudget(true, bandwidthBudget, decodeBudget);
+    }
+#ifdef HAS_QT_MULTIMEDIA
+    // the device window in front plays at full volume, the other devices are ducked
+    m_audioOutput.setDucking(true);
+    m_audioOutput.setOpusBitRate(Config::getInstance().getAudioOpusBitRate());
+    connect(qApp, &QApplication::focusChanged, this, [this](QWidget *old, QWidget *now) {
+        Q_UNUSED(old);
+        VideoForm *videoForm = now ? qobject_cast<VideoForm *>(now->window()) : Q_NULLPTR;
+        if (videoForm) {
+            m_audioOutput.setFocus(videoForm->getSerial());
+        }
+    });
+    // device audio goes into the device's recording as well
+    connect(&m_audioOutput, &AudioOutput::pcmReceived, this, [](const QString &serial, const QByteArray &pcm) {
+        auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
+        if (device) {
+            device->pushRecordAudio(pcm);
+        }
+    });
+#endif
 
     updateBootConfig(true);
 
@@ -385,8 +415,13 @@ void Dialog::on_startServerBtn_clicked()
     }
     params.stayAwake = ui->stayAwakeCheck->isChecked();
     params.recordFile = ui->recordScreenCheck->isChecked();
+#ifdef HAS_QT_MULTIMEDIA
+    // the track is fixed once the recording starts: only when the device's audio already plays
+    params.recordAudio = params.recordFile && m_audioOutput.isPlaying(params.serial);
+#endif
     params.recordPath = ui->recordPathEdt->text().trimmed();
     params.recordFileFormat = ui->formatBox->currentText().trimmed();
+    params.screenshotFormat = Config::getInstance().getScreenshotFormat();
     params.serverLocalPath = getServerPath();
     params.serverRemotePath = Config::getInstance().getServerPath();
     params.pushFilePath = Config::getInstance().getPushFilePath();
@@ -396,7 +431,14 @@ void Dialog::on_startServerBtn_clicked()
     params.codecName = Config::getInstance().getCodecName();
     params.scid = QRandomGenerator::global()->bounded(1, 10000) & 0x7FFFFFFF;
 
-    qsc::IDeviceManage::getInstance().connectDevice(params);
+    bool connecting = qsc::IDeviceManage::getInstance().connectDevice(params);
+#ifdef HAS_QT_MULTIMEDIA
+    if (connecting && params.recordAudio) {
+        m_audioRecordSerials.insert(params.serial);
+    }
+#else
+    Q_UNUSED(connecting);
+#endif
 }
 
 void Dialog::on_stopServerBtn_clicked()
@@ -538,6 +580,12 @@ void Dialog::getIPbyIp()
 void Dialog::onDeviceConnected(bool success, const QString &serial, const QString &deviceName, const QSize &size)
 {
     Q_UNUSED(deviceName);
+#ifdef HAS_QT_MULTIMEDIA
+    // the recorder runs from here until the device disconnects
+    if (m_audioRecordSerials.remove(serial)) {
+        m_audioOutput.setRecording(serial, success);
+    }
+#endif
     if (!success) {
         return;
     }
@@ -603,6 +651,9 @@ void Dialog::onDeviceConnected(bool success, const QString &serial, const QStrin
 void Dialog::onDeviceDisconnected(QString serial)
 {
     GroupController::instance().removeDevice(serial);
+#ifdef HAS_QT_MULTIMEDIA
+    m_audioOutput.setRecording(serial, false);
+#endif
     auto device = qsc::IDeviceManage::getInstance().getDevice(serial);
     if (!device) {
         return;
@@ -1017,7 +1068,7 @@ void Dialog::on_startAudioBtn_clicked()
 
 void Dialog::on_stopAudioBtn_clicked()
 {
-    m_audioOutput.stop();
+    m_audioOutput.stop(ui->serialBox->currentText());
 }
 
 void Dialog::on_installSndcpyBtn_clicked()
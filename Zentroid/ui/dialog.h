@@ -122,6 +122,8 @@ private:
     QAction *m_quit;
 #ifdef HAS_QT_MULTIMEDIA
     AudioOutput m_audioOutput;
+    // connecting with an audio track, see AudioOutput::setRecording
+    QSet<QString> m_audioRecordSerials;
 #endif
     QTimer m_autoUpdatetimer;
 
@@ -205,7 +205,8 @@ void VideoForm::showFPS(bool show)
     m_fpsLabel->setVisible(show);
 }
 
-void VideoForm::updateRender(int width, int height, uint8_t* dataY, uint8_t* dataU, uint8_t* dataV, int linesizeY, int linesizeU, int linesizeV)
+void VideoForm::updateRender(int width, int height, uint8_t* dataY, uint8_t* dataU, uint8_t* dataV, int linesizeY, int linesizeU, int linesizeV,
+                             int firstRow, int rowCount)
 {
     if (m_videoWidget->isHidden()) {
         if (m_loadingWidget) {
@@ -217,7 +218,10 @@ void VideoForm::updateRender(int width, int height, uint8_t* dataY, uint8_t* dat
 
     updateShowSize(QSize(width, height));
     m_videoWidget->setFrameSize(QSize(width, height));
-    m_videoWidget->updateTextures(dataY, dataU, dataV, linesizeY, linesizeU, linesizeV);
+    if (0 > rowCount) {
+        rowCount = height - firstRow;
+    }
+    m_videoWidget->updateTextures(dataY, dataU, dataV, linesizeY, linesizeU, linesizeV, firstRow, rowCount);
 }
 
 void VideoForm::setSerial(const QString &serial)
@@ -225,6 +229,11 @@ void VideoForm::setSerial(const QString &serial)
     m_serial = serial;
 }
 
+const QString &VideoForm::getSerial()
+{
+    return m_serial;
+}
+
 void VideoForm::showToolForm(bool show)
 {
     if (!m_toolForm) {
@@ -696,6 +705,25 @@ void VideoForm::updateFPS(quint32 fps)
     m_fpsLabel->setText(QString("FPS:%1").arg(fps));
 }
 
+void VideoForm::updateHealth(qsc::DeviceHealth health)
+{
+    if (!m_fpsLabel) {
+        return;
+    }
+    // the fps counter doubles as the health light
+    switch (health) {
+    case qsc::DH_DEGRADED:
+        m_fpsLabel->setStyleSheet(R"(QLabel {color: #FFD700;})");
+        break;
+    case qsc::DH_STALLED:
+        m_fpsLabel->setStyleSheet(R"(QLabel {color: #FF3030;})");
+        break;
+    default:
+        m_fpsLabel->setStyleSheet(R"(QLabel {color: #00FF00;})");
+        break;
+    }
+}
+
 void VideoForm::grabCursor(bool grab)
 {
 #if defined(Q_OS_LINUX)
@@ -724,6 +752,39 @@ void VideoForm::onFrame(int width, int height, uint8_t *dataY, uint8_t *dataU, u
     updateRender(width, height, dataY, dataU, dataV, linesizeY, linesizeU, linesizeV);
 }
 
+void VideoForm::onFrameDiff(int width, int height, uint8_t *dataY, uint8_t *dataU, uint8_t *dataV, int linesizeY, int linesizeU, int linesizeV,
+                            const qsc::FrameDirtyMap &dirty)
+{
+    // the textures already hold this picture
+    if (!dirty.changed && !m_videoWidget->isHidden() && m_videoWidget->frameSize() == QSize(width, height)) {
+        return;
+    }
+
+    // upload the band of rows between the first and the last changed tile
+    int firstRow = 0;
+    int rowCount = height;
+    if (dirty.changed && dirty.tiles && 0 < dirty.tileSize) {
+        int first = -1;
+        int last = -1;
+        for (int row = 0; row < dirty.rows; row++) {
+            for (int column = 0; column < dirty.columns; column++) {
+                if (dirty.isDirty(column, row)) {
+                    if (0 > first) {
+                        first = row;
+                    }
+                    last = row;
+                    break;
+                }
+            }
+        }
+        if (0 <= first) {
+            firstRow = first * dirty.tileSize;
+            rowCount = qMin(height, (last + 1) * dirty.tileSize) - firstRow;
+        }
+    }
+    updateRender(width, height, dataY, dataU, dataV, linesizeY, linesizeU, linesizeV, firstRow, rowCount);
+}
+
 void VideoForm::staysOnTop(bool top)
 {
     bool needShow = false;
@@ -25,8 +25,10 @@ public:
 
     void staysOnTop(bool top = true);
     void updateShowSize(const QSize &newSize);
-    void updateRender(int width, int height, uint8_t* dataY, uint8_t* dataU, uint8_t* dataV, int linesizeY, int linesizeU, int linesizeV);
+    void updateRender(int width, int height, uint8_t* dataY, uint8_t* dataU, uint8_t* dataV, int linesizeY, int linesizeU, int linesizeV,
+                      int firstRow = 0, int rowCount = -1);
     void setSerial(const QString& serial);
+    const QString &getSerial();
     QRect getGrabCursorRect();
     const QSize &frameSize();
     QPixmap getScreenshot() const;
@@ -46,7 +48,10 @@ public:
 private:
     void onFrame(int width, int height, uint8_t* dataY, uint8_t* dataU, uint8_t* dataV,
                  int linesizeY, int linesizeU, int linesizeV) override;
+    void onFrameDiff(int width, int height, uint8_t* dataY, uint8_t* dataU, uint8_t* dataV,
+                     int linesizeY, int linesizeU, int linesizeV, const qsc::FrameDirtyMap &dirty) override;
     void updateFPS(quint32 fps) override;
+    void updateHealth(qsc::DeviceHealth health) override;
     void grabCursor(bool grab) override;
 
     void updateStyleSheet(bool vertical);
@@ -47,6 +47,21 @@
 #define COMMON_CODEC_NAME_KEY "CodecName"
 #define COMMON_CODEC_NAME_DEF ""
 
+#define COMMON_METRICS_PORT_KEY "MetricsPort"
+#define COMMON_METRICS_PORT_DEF 0
+
+#define COMMON_BANDWIDTH_BUDGET_KEY "BandwidthBudgetKbps"
+#define COMMON_BANDWIDTH_BUDGET_DEF 0
+
+#define COMMON_DECODE_BUDGET_KEY "DecodeBudgetCores"
+#define COMMON_DECODE_BUDGET_DEF 0.0
+
+#define COMMON_AUDIO_OPUS_BITRATE_KEY "AudioOpusBitRate"
+#define COMMON_AUDIO_OPUS_BITRATE_DEF 0
+
+#define COMMON_SCREENSHOT_FORMAT_KEY "ScreenshotFormat"
+#define COMMON_SCREENSHOT_FORMAT_DEF "png"
+
 // user config
 #define COMMON_RECORD_KEY "RecordPath"
 #define COMMON_RECORD_DEF ""
@@ -370,6 +385,51 @@ QString Config::getCodecName()
     return codecName;
 }
 
+quint16 Config::getMetricsPort()
+{
+    quint16 port = 0;
+    m_settings->beginGroup(GROUP_COMMON);
+    port = static_cast<quint16>(m_settings->value(COMMON_METRICS_PORT_KEY, COMMON_METRICS_PORT_DEF).toUInt());
+    m_settings->endGroup();
+    return port;
+}
+
+quint32 Config::getBandwidthBudget()
+{
+    quint32 kbps = 0;
+    m_settings->beginGroup(GROUP_COMMON);
+    kbps = m_settings->value(COMMON_BANDWIDTH_BUDGET_KEY, COMMON_BANDWIDTH_BUDGET_DEF).toUInt();
+    m_settings->endGroup();
+    return kbps;
+}
+
+double Config::getDecodeBudget()
+{
+    double cores = 0.0;
+    m_settings->beginGroup(GROUP_COMMON);
+    cores = m_settings->value(COMMON_DECODE_BUDGET_KEY, COMMON_DECODE_BUDGET_DEF).toDouble();
+    m_settings->endGroup();
+    return cores;
+}
+
+int Config::getAudioOpusBitRate()
+{
+    int bitRate = 0;
+    m_settings->beginGroup(GROUP_COMMON);
+    bitRate = m_settings->value(COMMON_AUDIO_OPUS_BITRATE_KEY, COMMON_AUDIO_OPUS_BITRATE_DEF).toInt();
+    m_settings->endGroup();
+    return bitRate;
+}
+
+QString Config::getScreenshotFormat()
+{
+    QString format;
+    m_settings->beginGroup(GROUP_COMMON);
+    format = m_settings->value(COMMON_SCREENSHOT_FORMAT_KEY, COMMON_SCREENSHOT_FORMAT_DEF).toString();
+    m_settings->endGroup();
+    return format;
+}
+
 QStringList Config::getConnectedGroups()
 {
     return m_userData->childGroups();
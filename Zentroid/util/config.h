@@ -49,6 +49,11 @@ public:
     QString getLogLevel();
     QString getCodecOptions();
     QString getCodecName();
+    quint16 getMetricsPort();
+    quint32 getBandwidthBudget();
+    double getDecodeBudget();
+    int getAudioOpusBitRate();
+    QString getScreenshotFormat();
     QStringList getConnectedGroups();
 
     // user data:common